@@ -0,0 +1,289 @@
+/**
+ * @file bench.c
+ * @brief mo 的端到端压测驱动
+ *
+ * 对每个接口、每个并发级别，用一个 curl multi 句柄保持固定数量的请求在飞，
+ * 跑满指定请求数后输出吞吐量和 p50/p99/p999 延迟。查询参数按序号变化，
+ * 避免所有请求都落在同一条缓存上。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#define BENCH_MAX_LEVELS 16
+
+struct bench_config {
+    const char *target;
+    const char *endpoints;
+    size_t levels[BENCH_MAX_LEVELS];
+    size_t level_count;
+    size_t requests;
+    size_t warmup;
+    long timeout;
+};
+
+struct bench_result {
+    size_t done;
+    size_t errors;
+    double wall_s;
+    double *latency_ms;
+};
+
+/**
+ * 生成第 seq 个请求的查询串
+ *
+ * @return 0表示成功，-1表示不认识的接口
+ */
+static int build_query(const char *endpoint, size_t seq, char *out, size_t len) {
+    static const char *names[] = { "JOHN DOE", "AHMAD BIN ALI", "LIM CHEE KEONG", "SITI NOR", "TAN AH KOW" };
+    static const char *companies[] = { "abc", "trading", "logistics", "maju", "jaya" };
+
+    if (strcmp(endpoint, "q") == 0) return snprintf(out, len, "q=01%08zu", seq % 100000000) < 0 ? -1 : 0;
+    if (strcmp(endpoint, "id") == 0) return snprintf(out, len, "id=900101%02zu%04zu", (size_t) 1 + seq % 14, seq % 10000) < 0 ? -1 : 0;
+    if (strcmp(endpoint, "ssm") == 0) return snprintf(out, len, "ssm=2020010%05zu", seq % 100000) < 0 ? -1 : 0;
+    if (strcmp(endpoint, "social") == 0) return snprintf(out, len, "social=user%zu", seq) < 0 ? -1 : 0;
+
+    if (strcmp(endpoint, "name") == 0 || strcmp(endpoint, "comp") == 0) {
+        const char *v = endpoint[0] == 'n' ? names[seq % 5] : companies[seq % 5];
+        char *esc = curl_easy_escape(NULL, v, 0);
+
+        if (!esc) return -1;
+
+        snprintf(out, len, "%s=%s", endpoint, esc);
+        curl_free(esc);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+static size_t discard(void *contents, size_t size, size_t nmemb, void *userp) {
+    (void) contents; (void) userp;
+    return size * nmemb;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static CURL *make_request(const struct bench_config *cfg, const char *endpoint, size_t seq) {
+    char query[256];
+    char url[512];
+
+    if (build_query(endpoint, seq, query, sizeof(query)) != 0) return NULL;
+
+    snprintf(url, sizeof(url), "%s/?%s", cfg -> target, query);
+
+    CURL *curl = curl_easy_init();
+
+    if (!curl) return NULL;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, cfg -> timeout);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    return curl;
+}
+
+/**
+ * 以固定并发跑 total 个请求，每个请求的延迟记录在 out -> latency_ms（调用者负责 free）
+ */
+static void run_level(const struct bench_config *cfg, const char *endpoint, size_t concurrency, size_t total, struct bench_result *out) {
+    CURLM *multi = curl_multi_init();
+    size_t started = 0;
+    int running = 0;
+
+    memset(out, 0, sizeof(*out));
+    out -> latency_ms = calloc(total ? total : 1, sizeof(double));
+
+    double t0 = now_s();
+
+    while (out -> done < total) {
+        while (started < total && started - out -> done < concurrency) {
+            CURL *curl = make_request(cfg, endpoint, started++);
+
+            if (!curl) {
+                out -> errors++;
+                out -> done++;
+                continue;
+            }
+
+            curl_multi_add_handle(multi, curl);
+        }
+
+        curl_multi_perform(multi, &running);
+
+        CURLMsg *msg;
+        int left;
+
+        while ((msg = curl_multi_info_read(multi, &left))) {
+            if (msg -> msg != CURLMSG_DONE) continue;
+
+            CURL *curl = msg -> easy_handle;
+            long status = 0;
+            curl_off_t total_us = 0;
+
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+
+            if (msg -> data.result != CURLE_OK || status < 200 || status >= 300) out -> errors++;
+            if (out -> latency_ms) out -> latency_ms[out -> done] = total_us / 1000.0;
+
+            out -> done++;
+
+            curl_multi_remove_handle(multi, curl);
+            curl_easy_cleanup(curl);
+        }
+
+        // 有请求刚完成时先回到循环开头补位，否则等待套接字就绪
+        bool refill = started < total && started - out -> done < concurrency;
+
+        if (out -> done < total && !refill) curl_multi_poll(multi, NULL, 0, 100, NULL);
+    }
+
+    out -> wall_s = now_s() - t0;
+
+    curl_multi_cleanup(multi);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p) {
+    if (n == 0) return 0.0;
+
+    size_t idx = (size_t) (p * (n - 1) + 0.5);
+
+    return sorted[idx < n ? idx : n - 1];
+}
+
+static int parse_levels(const char *spec, struct bench_config *cfg) {
+    char *copy = strdup(spec);
+    char *save = NULL;
+
+    if (!copy) return -1;
+
+    cfg -> level_count = 0;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok && cfg -> level_count < BENCH_MAX_LEVELS; tok = strtok_r(NULL, ",", &save)) {
+        size_t v = strtoul(tok, NULL, 10);
+
+        if (v) cfg -> levels[cfg -> level_count++] = v;
+    }
+
+    free(copy);
+
+    return cfg -> level_count ? 0 : -1;
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项]\n", prog);
+    printf("  -t, --target <地址>         mo 的地址 (默认 http://127.0.0.1:8080)\n");
+    printf("  -e, --endpoints <列表>      要压测的接口，逗号分隔 (默认 q,id,name,ssm,comp,social)\n");
+    printf("  -c, --concurrency <列表>    并发级别，逗号分隔 (默认 1,8,32)\n");
+    printf("  -n, --requests <数量>       每个并发级别的请求数 (默认 500)\n");
+    printf("  -w, --warmup <数量>         每个接口正式测量前的预热请求数 (默认 20)\n");
+    printf("  -T, --timeout <秒>          单个请求超时 (默认 30)\n");
+    printf("  -h, --help                  显示此帮助信息\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct bench_config cfg = {
+        .target = "http://127.0.0.1:8080",
+        .endpoints = "q,id,name,ssm,comp,social",
+        .levels = { 1, 8, 32 },
+        .level_count = 3,
+        .requests = 500,
+        .warmup = 20,
+        .timeout = 30,
+    };
+
+    static struct option long_opts[] = {
+        {"target",      required_argument, NULL, 't'},
+        {"endpoints",   required_argument, NULL, 'e'},
+        {"concurrency", required_argument, NULL, 'c'},
+        {"requests",    required_argument, NULL, 'n'},
+        {"warmup",      required_argument, NULL, 'w'},
+        {"timeout",     required_argument, NULL, 'T'},
+        {"help",        no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:e:c:n:w:T:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 't': cfg.target = optarg; break;
+            case 'e': cfg.endpoints = optarg; break;
+            case 'c':
+                if (parse_levels(optarg, &cfg) != 0) {
+                    fprintf(stderr, "无效的并发级别: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'n': cfg.requests = strtoul(optarg, NULL, 10); break;
+            case 'w': cfg.warmup = strtoul(optarg, NULL, 10); break;
+            case 'T': cfg.timeout = atol(optarg); break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    printf("%-8s %6s %8s %7s %10s %9s %9s %9s\n", "endpoint", "conc", "requests", "errors", "req/s", "p50(ms)", "p99(ms)", "p999(ms)");
+
+    char *endpoints = strdup(cfg.endpoints);
+    char *save = NULL;
+    int rc = 0;
+
+    for (char *ep = strtok_r(endpoints, ",", &save); ep; ep = strtok_r(NULL, ",", &save)) {
+        char probe[256];
+
+        if (build_query(ep, 0, probe, sizeof(probe)) != 0) {
+            fprintf(stderr, "未知接口: %s\n", ep);
+            rc = 1;
+            continue;
+        }
+
+        struct bench_result res;
+
+        if (cfg.warmup) {
+            run_level(&cfg, ep, cfg.levels[0], cfg.warmup, &res);
+            free(res.latency_ms);
+        }
+
+        for (size_t i = 0; i < cfg.level_count; i++) {
+            run_level(&cfg, ep, cfg.levels[i], cfg.requests, &res);
+
+            qsort(res.latency_ms, res.done, sizeof(double), cmp_double);
+
+            printf("%-8s %6zu %8zu %7zu %10.1f %9.2f %9.2f %9.2f\n",
+                ep, cfg.levels[i], res.done, res.errors,
+                res.wall_s > 0 ? res.done / res.wall_s : 0.0,
+                percentile(res.latency_ms, res.done, 0.50),
+                percentile(res.latency_ms, res.done, 0.99),
+                percentile(res.latency_ms, res.done, 0.999));
+            fflush(stdout);
+
+            free(res.latency_ms);
+        }
+    }
+
+    free(endpoints);
+    curl_global_cleanup();
+
+    return rc;
+}
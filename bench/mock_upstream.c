@@ -0,0 +1,297 @@
+/**
+ * @file mock_upstream.c
+ * @brief 压测用的本地上游模拟服务
+ *
+ * 一个端口同时模拟所有政府站点和社交媒体探测，按路径前缀区分来源，返回 bench/fixtures 下的页面：
+ * - /semakmule  Semak Mule API（JSON）
+ * - /sspi       移民局 SSPI 页面
+ * - /ejudgment  eJudgment 搜索（JSON）
+ * - /wanted     PDRM 通缉名单
+ * - /sprm       SPRM 贪污犯名单
+ * - /company    黄页搜索结果
+ * - /social/<目标下标>/<用户名>  下标能被 3 整除的目标返回 200 且页面包含用户名，其余返回 404
+ *
+ * 每个请求按 --latency-ms 和 --jitter-ms 随机延迟，并按 --error-rate 返回 503、按 --reset-rate 直接断开连接。
+ * 把 mo 的 MO_*_URL 环境变量指向本服务即可在本地复现完整的查询链路。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <microhttpd.h>
+
+struct route {
+    const char *prefix;
+    const char *fixture;
+    const char *content_type;
+    char *body;
+    size_t size;
+    unsigned long hits;
+};
+
+static struct route routes[] = {
+    { "/semakmule", "semakmule.json", "application/json", NULL, 0, 0 },
+    { "/sspi",      "sspi.html",      "text/html; charset=utf-8", NULL, 0, 0 },
+    { "/ejudgment", "ejudgment.json", "application/json", NULL, 0, 0 },
+    { "/wanted",    "wanted.html",    "text/html; charset=utf-8", NULL, 0, 0 },
+    { "/sprm",      "sprm.html",      "text/html; charset=utf-8", NULL, 0, 0 },
+    { "/company",   "company.html",   "text/html; charset=utf-8", NULL, 0, 0 },
+    { "/social",    NULL,             "text/html; charset=utf-8", NULL, 0, 0 },
+};
+
+#define ROUTE_COUNT (sizeof(routes) / sizeof(routes[0]))
+
+struct mock_config {
+    unsigned int port;
+    const char *fixtures;
+    unsigned int latency_ms;
+    unsigned int jitter_ms;
+    double error_rate;
+    double reset_rate;
+};
+
+static struct mock_config cfg = { 9000, "bench/fixtures", 0, 0, 0.0, 0.0 };
+static volatile sig_atomic_t stop = 0;
+static unsigned long errors_injected = 0;
+static unsigned long resets_injected = 0;
+
+static void on_signal(int sig) {
+    (void) sig;
+    stop = 1;
+}
+
+/**
+ * 每个连接线程各自的随机数状态
+ */
+static double random_unit(void) {
+    static __thread unsigned int seed = 0;
+
+    if (seed == 0) seed = (unsigned int) time(NULL) ^ (unsigned int) (uintptr_t) &seed;
+
+    return (double) rand_r(&seed) / ((double) RAND_MAX + 1.0);
+}
+
+/**
+ * 读入整个 fixture 文件
+ *
+ * @return 0表示成功，-1表示文件不存在或读取失败
+ */
+static int load_fixture(struct route *r) {
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/%s", cfg.fixtures, r -> fixture);
+
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        fprintf(stderr, "[mock] 无法打开 %s\n", path);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    r -> body = size > 0 ? malloc((size_t) size) : NULL;
+
+    if (!r -> body || fread(r -> body, 1, (size_t) size, fp) != (size_t) size) {
+        fprintf(stderr, "[mock] 读取 %s 失败\n", path);
+        fclose(fp);
+        free(r -> body);
+        r -> body = NULL;
+        return -1;
+    }
+
+    r -> size = (size_t) size;
+    fclose(fp);
+
+    return 0;
+}
+
+static void simulate_latency(void) {
+    unsigned int ms = cfg.latency_ms;
+
+    if (cfg.jitter_ms) ms += (unsigned int) (random_unit() * (cfg.jitter_ms + 1));
+    if (ms) usleep(ms * 1000);
+}
+
+static enum MHD_Result reply(struct MHD_Connection *connection, unsigned int status, const char *type, const void *body, size_t size, enum MHD_ResponseMemoryMode mode) {
+    struct MHD_Response *resp = MHD_create_response_from_buffer(size, (void *) body, mode);
+
+    if (!resp) return MHD_NO;
+
+    MHD_add_response_header(resp, "Content-Type", type);
+
+    enum MHD_Result ret = MHD_queue_response(connection, status, resp);
+
+    MHD_destroy_response(resp);
+    return ret;
+}
+
+/**
+ * /social/<目标下标>/<用户名>：约三分之一的目标"存在"该用户
+ */
+static enum MHD_Result reply_social(struct MHD_Connection *connection, const struct route *r, const char *rest) {
+    char *end = NULL;
+    unsigned long idx = strtoul(rest[0] == '/' ? rest + 1 : rest, &end, 10);
+    const char *user = end && *end == '/' ? end + 1 : "";
+
+    if (idx % 3 != 0 || !*user) {
+        static const char missing[] = "<html><body><h1>404 Not Found</h1></body></html>";
+        return reply(connection, MHD_HTTP_NOT_FOUND, r -> content_type, missing, sizeof(missing) - 1, MHD_RESPMEM_PERSISTENT);
+    }
+
+    char *page = malloc(256 + strlen(user));
+
+    if (!page) return MHD_NO;
+
+    int n = sprintf(page, "<html><head><title>%s</title></head><body><div class=\"profile\">@%s</div></body></html>", user, user);
+
+    return reply(connection, MHD_HTTP_OK, r -> content_type, page, (size_t) n, MHD_RESPMEM_MUST_FREE);
+}
+
+static enum MHD_Result handle_request(void *cls, struct MHD_Connection *connection,
+    const char *url, const char *method, const char *version,
+    const char *upload_data, size_t *upload_data_size, void **con_cls) {
+
+    (void) cls; (void) method; (void) version; (void) upload_data;
+
+    // 第一次回调只有请求头；POST 体不关心，收到就丢弃，收完再回复
+    if (!*con_cls) {
+        *con_cls = (void *) 1;
+        return MHD_YES;
+    }
+
+    if (*upload_data_size) {
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
+
+    struct route *r = NULL;
+
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        size_t len = strlen(routes[i].prefix);
+
+        if (strncmp(url, routes[i].prefix, len) == 0 && (url[len] == '\0' || url[len] == '/')) {
+            r = &routes[i];
+            break;
+        }
+    }
+
+    if (!r) {
+        static const char unknown[] = "unknown mock route\n";
+        return reply(connection, MHD_HTTP_NOT_FOUND, "text/plain", unknown, sizeof(unknown) - 1, MHD_RESPMEM_PERSISTENT);
+    }
+
+    __atomic_fetch_add(&r -> hits, 1, __ATOMIC_RELAXED);
+
+    simulate_latency();
+
+    double roll = random_unit();
+
+    if (roll < cfg.reset_rate) {
+        __atomic_fetch_add(&resets_injected, 1, __ATOMIC_RELAXED);
+        return MHD_NO;
+    }
+
+    if (roll < cfg.reset_rate + cfg.error_rate) {
+        static const char unavailable[] = "<html><body><h1>503 Service Unavailable</h1></body></html>";
+
+        __atomic_fetch_add(&errors_injected, 1, __ATOMIC_RELAXED);
+        return reply(connection, MHD_HTTP_SERVICE_UNAVAILABLE, "text/html", unavailable, sizeof(unavailable) - 1, MHD_RESPMEM_PERSISTENT);
+    }
+
+    if (!r -> fixture) return reply_social(connection, r, url + strlen(r -> prefix));
+
+    return reply(connection, MHD_HTTP_OK, r -> content_type, r -> body, r -> size, MHD_RESPMEM_PERSISTENT);
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项]\n", prog);
+    printf("  -p, --port <端口>          监听端口 (默认 9000)\n");
+    printf("  -f, --fixtures <目录>      fixture 页面目录 (默认 bench/fixtures)\n");
+    printf("  -l, --latency-ms <毫秒>    每个请求的固定延迟 (默认 0)\n");
+    printf("  -j, --jitter-ms <毫秒>     在固定延迟上叠加 0..N 毫秒的随机抖动 (默认 0)\n");
+    printf("  -e, --error-rate <比例>    返回 503 的概率，0..1 (默认 0)\n");
+    printf("  -r, --reset-rate <比例>    直接断开连接的概率，0..1 (默认 0)\n");
+    printf("  -h, --help                 显示此帮助信息\n");
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_opts[] = {
+        {"port",       required_argument, NULL, 'p'},
+        {"fixtures",   required_argument, NULL, 'f'},
+        {"latency-ms", required_argument, NULL, 'l'},
+        {"jitter-ms",  required_argument, NULL, 'j'},
+        {"error-rate", required_argument, NULL, 'e'},
+        {"reset-rate", required_argument, NULL, 'r'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "p:f:l:j:e:r:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'p': cfg.port = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'f': cfg.fixtures = optarg; break;
+            case 'l': cfg.latency_ms = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'j': cfg.jitter_ms = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'e': cfg.error_rate = atof(optarg); break;
+            case 'r': cfg.reset_rate = atof(optarg); break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        if (routes[i].fixture && load_fixture(&routes[i]) != 0) return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    // 每个连接一个线程，模拟延迟时直接睡眠也不会拖慢其他连接
+    struct MHD_Daemon *daemon = MHD_start_daemon(
+        MHD_USE_THREAD_PER_CONNECTION | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
+        (uint16_t) cfg.port, NULL, NULL, &handle_request, NULL,
+        MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int) 30,
+        MHD_OPTION_END);
+
+    if (!daemon) {
+        fprintf(stderr, "[mock] 无法在端口 %u 启动\n", cfg.port);
+        return 1;
+    }
+
+    printf("[mock] 监听 127.0.0.1:%u | 延迟 %ums + 抖动 %ums | 503 %.1f%% | 断开 %.1f%%\n",
+        cfg.port, cfg.latency_ms, cfg.jitter_ms, cfg.error_rate * 100, cfg.reset_rate * 100);
+    printf("export MO_SEMAKMULE_URL=http://127.0.0.1:%u/semakmule\n", cfg.port);
+    printf("export MO_SSPI_URL=http://127.0.0.1:%u/sspi\n", cfg.port);
+    printf("export MO_EJUDGMENT_URL=http://127.0.0.1:%u/ejudgment\n", cfg.port);
+    printf("export MO_WANTED_URL=http://127.0.0.1:%u/wanted\n", cfg.port);
+    printf("export MO_SPRM_URL=http://127.0.0.1:%u/sprm\n", cfg.port);
+    printf("export MO_COMPANY_URL=http://127.0.0.1:%u/company\n", cfg.port);
+    printf("export MO_SOCIAL_URL=http://127.0.0.1:%u/social\n", cfg.port);
+    fflush(stdout);
+
+    while (!stop) pause();
+
+    MHD_stop_daemon(daemon);
+
+    printf("[mock] 请求统计:");
+
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        printf(" %s=%lu", routes[i].prefix + 1, routes[i].hits);
+        free(routes[i].body);
+    }
+
+    printf(" | 注入 503: %lu | 注入断开: %lu\n", errors_injected, resets_injected);
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#!/bin/sh
+# 端到端压测：启动 mock_upstream，让 mo 的所有上游指向它，再用 mo_bench 以固定并发压测各接口
+#
+# 用法: run_bench.sh <mo> <mock_upstream> <mo_bench> [mo_bench 参数...]
+#
+# 可用环境变量调整：
+#   MOCK_PORT (9000)  MO_PORT (8089)  MOCK_LATENCY_MS (50)  MOCK_JITTER_MS (20)
+#   MOCK_ERROR_RATE (0)  MOCK_RESET_RATE (0)  BENCH_FIXTURES (脚本同目录下的 fixtures)
+
+set -eu
+
+if [ $# -lt 3 ]; then
+    echo "用法: $0 <mo> <mock_upstream> <mo_bench> [mo_bench 参数...]" >&2
+    exit 1
+fi
+
+MO=$1
+MOCK=$2
+BENCH=$3
+shift 3
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+MOCK_PORT=${MOCK_PORT:-9000}
+MO_PORT=${MO_PORT:-8089}
+FIXTURES=${BENCH_FIXTURES:-$HERE/fixtures}
+WORK=$(mktemp -d)
+
+MOCK_PID=""
+MO_PID=""
+
+cleanup() {
+    # mo 从标准输入读取 'q' 安全退出
+    [ -n "$MO_PID" ] && { echo q >&3 2>/dev/null || true; wait "$MO_PID" 2>/dev/null || true; }
+    [ -n "$MOCK_PID" ] && { kill "$MOCK_PID" 2>/dev/null || true; wait "$MOCK_PID" 2>/dev/null || true; }
+    rm -rf "$WORK"
+}
+
+trap cleanup EXIT INT TERM
+
+"$MOCK" --port "$MOCK_PORT" --fixtures "$FIXTURES" \
+    --latency-ms "${MOCK_LATENCY_MS:-50}" --jitter-ms "${MOCK_JITTER_MS:-20}" \
+    --error-rate "${MOCK_ERROR_RATE:-0}" --reset-rate "${MOCK_RESET_RATE:-0}" &
+MOCK_PID=$!
+
+BASE="http://127.0.0.1:$MOCK_PORT"
+
+export MO_SEMAKMULE_URL="$BASE/semakmule"
+export MO_SSPI_URL="$BASE/sspi"
+export MO_EJUDGMENT_URL="$BASE/ejudgment"
+export MO_WANTED_URL="$BASE/wanted"
+export MO_SPRM_URL="$BASE/sprm"
+export MO_COMPANY_URL="$BASE/company"
+export MO_SOCIAL_URL="$BASE/social"
+
+mkfifo "$WORK/stdin"
+"$MO" --port "$MO_PORT" --access-log "" < "$WORK/stdin" > "$WORK/mo.log" 2>&1 &
+MO_PID=$!
+exec 3> "$WORK/stdin"
+
+# 等 mo 开始监听
+i=0
+until curl -s -o /dev/null "http://127.0.0.1:$MO_PORT/metrics"; do
+    i=$((i + 1))
+
+    if [ $i -ge 50 ]; then
+        echo "mo 未能启动，日志如下:" >&2
+        cat "$WORK/mo.log" >&2
+        exit 1
+    fi
+
+    sleep 0.2
+done
+
+"$BENCH" --target "http://127.0.0.1:$MO_PORT" "$@"
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+// 每个线程一个环形缓冲区，容量必须是 2 的幂；写满时丢弃新记录并计数，不阻塞请求线程
+#ifndef ACCESS_LOG_RING_SIZE
+#define ACCESS_LOG_RING_SIZE 1024
+#endif
+
+// 后台线程的刷盘间隔
+#ifndef ACCESS_LOG_FLUSH_MS
+#define ACCESS_LOG_FLUSH_MS 200
+#endif
+
+#ifndef ACCESS_LOG_DEFAULT_PATH
+#define ACCESS_LOG_DEFAULT_PATH "access.ndjson"
+#endif
+
+// 单个日志文件的大小上限与保留的历史文件数
+#ifndef ACCESS_LOG_MAX_BYTES
+#define ACCESS_LOG_MAX_BYTES (64L * 1024 * 1024)
+#endif
+
+#ifndef ACCESS_LOG_KEEP
+#define ACCESS_LOG_KEEP 5
+#endif
+
+#define ACCESS_LOG_PATH_MAX 128
+#define ACCESS_LOG_MAX_TIMINGS 4
+
+struct access_log_timing {
+    const char *source;
+    uint32_t ms;
+};
+
+/**
+ * 一条访问记录：请求开始时 begin，过程中追加各数据源耗时，请求结束时 commit
+ * source 必须是静态字符串（写盘在后台线程进行）
+ */
+struct access_log_entry {
+    struct timespec started;
+    struct timespec wall;
+    char method[8];
+    char path[ACCESS_LOG_PATH_MAX];
+    char ip[48];
+    unsigned int status;
+    uint32_t latency_us;
+    bool completed;
+    uint8_t n_timings;
+    struct access_log_timing timings[ACCESS_LOG_MAX_TIMINGS];
+};
+
+struct access_log_stats {
+    unsigned long written;
+    unsigned long dropped;
+    unsigned long rotations;
+    size_t threads;
+};
+
+int access_log_start(const char *path, long max_bytes, int keep);
+
+void access_log_stop(void);
+
+void access_log_begin(struct access_log_entry *e, const char *method, const char *path, const char *ip);
+
+void access_log_timing(struct access_log_entry *e, const char *source, long ms);
+
+void access_log_commit(struct access_log_entry *e, unsigned int status, bool completed);
+
+void access_log_get_stats(struct access_log_stats *out);
+
+#endif
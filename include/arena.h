@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+// 每个内存块的默认大小，大于它的单次分配独占一个块
+#ifndef ARENA_BLOCK_SIZE
+#define ARENA_BLOCK_SIZE 4096
+#endif
+
+struct arena_block;
+
+struct arena {
+    struct arena_block *head;
+    size_t block_size;
+};
+
+void arena_init(struct arena *a, size_t block_size);
+
+void *arena_alloc(struct arena *a, size_t size);
+
+char *arena_strdup(struct arena *a, const char *s);
+
+char *arena_sprintf(struct arena *a, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+void arena_free(struct arena *a);
+
+#endif
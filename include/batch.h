@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <microhttpd.h>
+
+// 单个批量请求内同时执行的查询数上限
+#ifndef BATCH_MAX_CONCURRENCY
+#define BATCH_MAX_CONCURRENCY 16
+#endif
+
+#ifndef BATCH_MAX_ITEMS
+#define BATCH_MAX_ITEMS 10000
+#endif
+
+#ifndef BATCH_MAX_BODY
+#define BATCH_MAX_BODY (4 * 1024 * 1024)
+#endif
+
+struct batch_job;
+
+struct batch_job *batch_job_new(const char *body, size_t len, struct MHD_Connection *connection, size_t max_concurrency, char *err, size_t err_len);
+
+ssize_t batch_send_chunk(void *cls, uint64_t pos, char *buf, size_t max);
+
+void batch_job_free(void *cls);
+
+#endif
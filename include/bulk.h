@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef BULK_H
+#define BULK_H
+
+#include <stddef.h>
+
+// 输入按约这么大的段切分（在换行处对齐），每段由一个线程解码并生成一块输出
+#ifndef BULK_SEGMENT_BYTES
+#define BULK_SEGMENT_BYTES (1024 * 1024)
+#endif
+
+// 每个线程最多领先写出位置这么多段，限制未写出的输出缓冲总量
+#ifndef BULK_WINDOW_PER_THREAD
+#define BULK_WINDOW_PER_THREAD 4
+#endif
+
+// 一次 mykad_decode_batch 处理的行数
+#ifndef BULK_BLOCK_LINES
+#define BULK_BLOCK_LINES 1024
+#endif
+
+enum bulk_kind {
+    BULK_IC,
+    BULK_SSM,
+};
+
+enum bulk_format {
+    BULK_NDJSON,
+    BULK_CSV,
+};
+
+struct bulk_config {
+    enum bulk_kind kind;
+    enum bulk_format format;
+    unsigned int threads;
+    const char *input;
+    const char *output;
+};
+
+struct bulk_stats {
+    size_t bytes_in;
+    size_t bytes_out;
+    size_t lines;
+    size_t valid;
+    size_t dropped;     // 输出缓冲扩容失败而没有写出的行
+    double seconds;
+};
+
+int bulk_run(const struct bulk_config *cfg, struct bulk_stats *stats);
+
+int bulk_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "metrics.h"
+
+// 回放时每次交给写回调的块大小，与 curl 默认的接收缓冲一致，流式解析器看到的切分方式和真实传输相近
+#ifndef CAPTURE_REPLAY_CHUNK
+#define CAPTURE_REPLAY_CHUNK 16384
+#endif
+
+enum capture_mode {
+    CAPTURE_OFF = 0,
+    CAPTURE_RECORD,
+    CAPTURE_REPLAY,
+};
+
+struct capture_stats {
+    unsigned long recorded;
+    unsigned long replayed;
+    unsigned long misses;
+    size_t entries;
+};
+
+int capture_start(enum capture_mode mode, const char *path);
+
+void capture_stop(void);
+
+enum capture_mode capture_get_mode(void);
+
+int capture_record(enum metrics_source src, const char *url, const char *post, long status, const char *body, size_t len);
+
+int capture_lookup(enum metrics_source src, const char *url, const char *post, long *status, const char **body, size_t *len);
+
+void capture_get_stats(struct capture_stats *out);
+
+#endif
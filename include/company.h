@@ -3,7 +3,14 @@
 #ifndef COMPANY_H
 #define COMPANY_H
 
+#include <stddef.h>
+
 #include "memory.h"
+#include "response.h"
+
+#ifndef COMPANY_URL
+#define COMPANY_URL "https://malaysiayp.com"
+#endif
 
 struct company_entry {
     char *name;       
@@ -18,5 +25,7 @@ int company_search(const char *keyword, struct company_entry **results, size_t *
 
 void company_free_results(struct company_entry *results, size_t count);
 
+int company_results_to_json(const struct company_entry *results, size_t count, struct response_builder *out);
+
 
 #endif
\ No newline at end of file
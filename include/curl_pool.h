@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef CURL_POOL_H
+#define CURL_POOL_H
+
+#include <curl/curl.h>
+
+#ifndef CURL_POOL_MAX_IDLE
+#define CURL_POOL_MAX_IDLE 32
+#endif
+
+struct curl_pool_stats {
+    unsigned long acquired;
+    unsigned long created;
+    unsigned long recycled;
+    unsigned long conn_reused;
+    unsigned long conn_new;
+};
+
+int curl_pool_init(void);
+
+void curl_pool_cleanup(void);
+
+CURL *curl_pool_acquire(void);
+
+void curl_pool_release(CURL *curl);
+
+void curl_pool_get_stats(struct curl_pool_stats *out);
+
+#endif
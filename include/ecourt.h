@@ -3,14 +3,54 @@
 #ifndef  ECOURT_H
 #define ECOURT_H
 
+#include <stdint.h>
+#include <sys/types.h>
+#include <microhttpd.h>
+
 #define MAX_SEARCH_LEN 256
 #define MAX_RESULT_LEN 8192
 
+// 分页搜索默认最多抓取的页数（?name= 可用 &max_pages=N 调整）
+#ifndef EJUDGMENT_DEFAULT_PAGES
+#define EJUDGMENT_DEFAULT_PAGES 10
+#endif
+
+// 分页搜索最多抓取的页数，max_pages 超过时按此截断
+#ifndef EJUDGMENT_MAX_PAGES
+#define EJUDGMENT_MAX_PAGES 50
+#endif
+
+// 分页搜索同时在途的页数
+#ifndef EJUDGMENT_PAGE_CONCURRENCY
+#define EJUDGMENT_PAGE_CONCURRENCY 8
+#endif
+
 typedef struct {
     char *raw_json;     
     int total_results;  
 } EJudgmentResponse;
 
+typedef struct {
+    const char* search;
+    const char* jurisdictionType;
+    const char* courtCategory;
+    const char* court;
+    const char* judgeName;
+    const char* caseType;
+    const char* dateOfAPFrom;
+    const char* dateOfAPTo;
+    const char* dateOfResultFrom;
+    const char* dateOfResultTo;
+    int currPage;
+    const char* ordering;
+} EJudgmentQuery;
+
+typedef void (*ejudgment_done_fn)(EJudgmentResponse* resp, void *userdata);
+
+struct ejudgment_paged;
+
+typedef void (*ejudgment_paged_ready_fn)(struct ejudgment_paged *paged, void *userdata);
+
 EJudgmentResponse* ejudgment_search(
     const char* search,
     const char* jurisdictionType,
@@ -28,6 +68,16 @@ EJudgmentResponse* ejudgment_search(
     int delayBetweenRetries
 );
 
+int ejudgment_search_async(const EJudgmentQuery *query, int maxRetries, int delayBetweenRetries, ejudgment_done_fn done, void *userdata);
+
+int ejudgment_search_paged(const EJudgmentQuery *query, int maxPages, int maxRetries, int delayBetweenRetries, const char *title, ejudgment_paged_ready_fn ready, void *userdata);
+
+void ejudgment_paged_attach(struct ejudgment_paged *paged, struct MHD_Connection *connection);
+
+ssize_t ejudgment_paged_send_chunk(void *cls, uint64_t pos, char *buf, size_t max);
+
+void ejudgment_paged_free(void *cls);
+
 void ejudgment_response_free(EJudgmentResponse* resp);
 
 char* ecourt_open_document(const char* documentId);
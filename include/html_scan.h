@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef HTML_SCAN_H
+#define HTML_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef HTML_SCAN_MAX_FIELDS
+#define HTML_SCAN_MAX_FIELDS 16
+#endif
+
+struct html_field {
+    const char *start;
+    const char *stop;
+    char *out;
+    size_t out_len;
+};
+
+struct html_scan_stats {
+    uint64_t bytes;
+    uint64_t nanos;
+    uint64_t calls;
+};
+
+const char *html_scan_find(const char *hay, size_t len, const char *needle, size_t nlen);
+
+size_t html_scan_fields(const char *html, size_t len, struct html_field *fields, size_t n);
+
+const char *html_scan_attr(const char *tag, const char *end, const char *attr, size_t *value_len);
+
+size_t html_decode_entities(const char *src, size_t len, char *out, size_t out_len);
+
+size_t html_to_text(const char *src, size_t len, char *out, size_t out_len);
+
+void html_scan_record(size_t bytes, const struct timespec *started);
+
+void html_scan_get_stats(struct html_scan_stats *out);
+
+#endif
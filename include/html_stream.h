@@ -0,0 +1,74 @@
+#pragma once
+
+#ifndef HTML_STREAM_H
+#define HTML_STREAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "memory.h"
+
+#ifndef HTML_MATCHER_MAX
+#define HTML_MATCHER_MAX 64
+#endif
+
+struct html_matcher {
+    char pattern[HTML_MATCHER_MAX];
+    size_t len;
+    size_t fail[HTML_MATCHER_MAX];
+    size_t state;
+};
+
+enum html_capture_phase {
+    HTML_CAPTURE_SEEK,
+    HTML_CAPTURE_TAG,
+    HTML_CAPTURE_BODY,
+    HTML_CAPTURE_DONE
+};
+
+struct html_capture {
+    struct html_matcher start;
+    struct html_matcher end;
+    bool skip_tag;
+    enum html_capture_phase phase;
+    struct memory value;
+    size_t max;
+};
+
+typedef void (*html_block_fn)(const char *block, size_t len, void *userdata);
+
+struct html_block {
+    struct html_matcher start;
+    struct memory block;
+    size_t max;
+    bool in_block;
+    bool truncated;
+    html_block_fn on_block;
+    void *userdata;
+};
+
+int html_matcher_init(struct html_matcher *m, const char *pattern);
+
+size_t html_matcher_feed(struct html_matcher *m, const char *data, size_t len, bool *matched);
+
+int html_capture_init(struct html_capture *c, const char *start, const char *end, bool skip_tag, size_t max);
+
+size_t html_capture_feed(struct html_capture *c, const char *data, size_t len);
+
+bool html_capture_done(const struct html_capture *c);
+
+char *html_capture_take(struct html_capture *c);
+
+char *html_capture_take_text(struct html_capture *c);
+
+void html_capture_free(struct html_capture *c);
+
+int html_block_init(struct html_block *b, const char *start, size_t max, html_block_fn on_block, void *userdata);
+
+int html_block_feed(struct html_block *b, const char *data, size_t len);
+
+void html_block_finish(struct html_block *b);
+
+void html_block_free(struct html_block *b);
+
+#endif
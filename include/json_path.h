@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef JSON_PATH_H
+#define JSON_PATH_H
+
+// 嵌套层数上限，超过即视为非法输入
+#ifndef JSON_PATH_MAX_DEPTH
+#define JSON_PATH_MAX_DEPTH 64
+#endif
+
+bool json_path_valid(const char *json, size_t len);
+
+int json_path_find(const char *json, size_t len, const char *path, const char **value, size_t *value_len);
+
+int json_path_int(const char *json, size_t len, const char *path, long *out);
+
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef JUDGMENT_STORE_H
+#define JUDGMENT_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// ?name= 从本地镜像最多返回的判决数（按判决日期从新到旧）
+#ifndef JUDGMENT_STORE_MAX_RESULTS
+#define JUDGMENT_STORE_MAX_RESULTS 50
+#endif
+
+// 查询最多取这么多个词，多出的忽略
+#ifndef JUDGMENT_QUERY_MAX_TOKENS
+#define JUDGMENT_QUERY_MAX_TOKENS 8
+#endif
+
+// 单个索引词最长字节数，超出部分截断
+#ifndef JUDGMENT_TOKEN_MAX
+#define JUDGMENT_TOKEN_MAX 48
+#endif
+
+// 后台增量同步的间隔（秒），--judgment-sync 可调，0 表示不同步
+#ifndef JUDGMENT_SYNC_INTERVAL
+#define JUDGMENT_SYNC_INTERVAL 900
+#endif
+
+// 同步失败后的重试间隔（秒）
+#ifndef JUDGMENT_SYNC_RETRY_SECONDS
+#define JUDGMENT_SYNC_RETRY_SECONDS 60
+#endif
+
+// 首次回填（还没有同步水位）最多翻的页数；有水位后一直翻到水位为止
+#ifndef JUDGMENT_SYNC_MAX_PAGES
+#define JUDGMENT_SYNC_MAX_PAGES 20
+#endif
+
+// 入库队列最多排队的页数，超出的页直接丢弃（之后由增量同步补齐）
+#ifndef JUDGMENT_INGEST_QUEUE_MAX
+#define JUDGMENT_INGEST_QUEUE_MAX 256
+#endif
+
+struct judgment_store_stats {
+    size_t judgments;
+    size_t tokens;
+    size_t file_bytes;
+    uint32_t watermark;
+    uint32_t sync_watermark;
+    time_t last_sync;
+    unsigned long syncs;
+    unsigned long synced;
+    unsigned long ingested;
+    unsigned long searches;
+    unsigned long local_hits;
+    size_t ingest_queued;
+    unsigned long ingest_dropped;
+};
+
+int judgment_store_open(const char *path);
+
+void judgment_store_close(void);
+
+bool judgment_store_loaded(void);
+
+int judgment_store_ingest(const char *json, size_t len, uint32_t *oldest);
+
+int judgment_store_ingest_async(char *json, size_t len);
+
+char *judgment_store_search(const char *query, size_t max, size_t *returned, size_t *total, size_t *len);
+
+int judgment_store_sync_once(void);
+
+int judgment_store_sync_start(int interval);
+
+void judgment_store_sync_stop(void);
+
+void judgment_store_get_stats(struct judgment_store_stats *out);
+
+#endif
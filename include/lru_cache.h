@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <stddef.h>
+
+struct lru_cache;
+
+struct lru_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long inserts;
+    unsigned long evictions;
+    unsigned long expirations;
+    size_t size;
+    size_t capacity;
+};
+
+struct lru_cache *lru_cache_new(size_t capacity);
+
+void lru_cache_free(struct lru_cache *cache);
+
+int lru_cache_get(struct lru_cache *cache, const char *key, void **value, size_t *len);
+
+int lru_cache_put(struct lru_cache *cache, const char *key, const void *value, size_t len, int ttl_seconds);
+
+void lru_cache_get_stats(struct lru_cache *cache, struct lru_cache_stats *out);
+
+#endif
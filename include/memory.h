@@ -5,9 +5,51 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+// 缓冲池只回收容量在此范围内的缓冲区，最多保留 MEMORY_POOL_SIZE 个
+#ifndef MEMORY_POOL_SIZE
+#define MEMORY_POOL_SIZE 64
+#endif
+
+#ifndef MEMORY_POOL_MAX_CAP
+#define MEMORY_POOL_MAX_CAP (1024 * 1024)
+#endif
+
+// Content-Length 预分配的上限，防止上游报一个离谱的长度
+#ifndef MEMORY_PRESIZE_MAX
+#define MEMORY_PRESIZE_MAX (64 * 1024 * 1024)
+#endif
+
 struct memory {
     char *data;
     size_t size;
+    size_t cap;
 };
 
-#endif
\ No newline at end of file
+struct memory_stats {
+    unsigned long mallocs;
+    unsigned long reallocs;
+    unsigned long pool_hits;
+    unsigned long pool_returns;
+    unsigned long presized;
+    unsigned long appends;
+};
+
+int memory_reserve(struct memory *mem, size_t need);
+
+int memory_append(struct memory *mem, const void *data, size_t len);
+
+char *memory_detach(struct memory *mem);
+
+void memory_release(struct memory *mem);
+
+size_t memory_write_callback(void *contents, size_t size, size_t nmemb, void *userp);
+
+size_t memory_header_callback(char *buffer, size_t size, size_t nitems, void *userp);
+
+void memory_attach_curl(void *curl, struct memory *mem);
+
+void memory_pool_cleanup(void);
+
+void memory_get_stats(struct memory_stats *out);
+
+#endif
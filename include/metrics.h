@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <curl/curl.h>
+
+#include "memory.h"
+
+#ifndef METRICS_H
+#define METRICS_H
+
+// 计数器分片数：每个线程固定写一个分片，导出时再求和
+#ifndef METRICS_SHARDS
+#define METRICS_SHARDS 16
+#endif
+
+enum metrics_endpoint {
+    METRICS_EP_Q,
+    METRICS_EP_ID,
+    METRICS_EP_NAME,
+    METRICS_EP_SSM,
+    METRICS_EP_COMP,
+    METRICS_EP_SOCIAL,
+    METRICS_EP_BATCH,
+    METRICS_EP_METRICS,
+    METRICS_EP_OTHER,
+    METRICS_EP_COUNT
+};
+
+enum metrics_source {
+    METRICS_SRC_SEMAKMULE,
+    METRICS_SRC_SSPI,
+    METRICS_SRC_EJUDGMENT,
+    METRICS_SRC_RMP,
+    METRICS_SRC_SPRM,
+    METRICS_SRC_COMPANY,
+    METRICS_SRC_SOCIAL,
+    METRICS_SRC_COUNT
+};
+
+void metrics_request_begin(enum metrics_endpoint ep);
+
+void metrics_request_end(enum metrics_endpoint ep, unsigned int status, long latency_us);
+
+void metrics_upstream_begin(enum metrics_source src);
+
+void metrics_upstream_end(enum metrics_source src, CURL *curl, bool ok);
+
+void metrics_upstream_retry(enum metrics_source src);
+
+const char *metrics_source_name(enum metrics_source src);
+
+int metrics_render(struct memory *out);
+
+#endif
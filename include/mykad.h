@@ -3,13 +3,65 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "memory.h"
+#include "arena.h"
 
 #ifndef MYKAD_H
 #define MYKAD_H
 
-char* mykad_check(const char *ic_no);
-char* mykad_get_birth_province(const char *ic_no);
+// 校验结果标志位，三项都通过才算有效号码
+#define MYKAD_DIGITS_OK 0x01
+#define MYKAD_DATE_OK   0x02
+#define MYKAD_PLACE_OK  0x04
+#define MYKAD_VALID     (MYKAD_DIGITS_OK | MYKAD_DATE_OK | MYKAD_PLACE_OK)
 
-#endif
\ No newline at end of file
+enum mykad_gender {
+    MYKAD_GENDER_UNKNOWN = 0,
+    MYKAD_GENDER_MALE,
+    MYKAD_GENDER_FEMALE,
+};
+
+enum mykad_place_kind {
+    MYKAD_PLACE_UNKNOWN = 0,
+    MYKAD_PLACE_STATE,
+    MYKAD_PLACE_COUNTRY,
+    MYKAD_PLACE_REGION,
+};
+
+/**
+ * 出生地代码（号码第 7、8 位）对应的地点；州属代码的 state 为 1..16 的州属编号，其余为 0
+ */
+struct mykad_place {
+    uint8_t kind;
+    uint8_t state;
+    const char *name;
+};
+
+/**
+ * 批量解码的输出（按列存放），数组由调用者提供，长度至少为 capacity
+ *
+ * birth 为 YYYYMMDD，serial 为最后 4 位流水号，无法解析的号码对应位置为 0。
+ */
+struct mykad_batch {
+    size_t capacity;
+    uint32_t *birth;
+    uint16_t *serial;
+    uint8_t *place;
+    uint8_t *gender;
+    uint8_t *flags;
+};
+
+int mykad_batch_init(struct mykad_batch *batch, size_t capacity);
+
+void mykad_batch_free(struct mykad_batch *batch);
+
+size_t mykad_decode_batch(const char *const *ic_nos, size_t n, long today, struct mykad_batch *out);
+
+const struct mykad_place *mykad_place(uint8_t code);
+
+char* mykad_check(const char *ic_no, struct arena *arena);
+char* mykad_get_birth_province(const char *ic_no, struct arena *arena);
+
+#endif
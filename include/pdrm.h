@@ -2,17 +2,69 @@
 
 #include <stddef.h>
 #include "memory.h"
+#include "lru_cache.h"
 
 #ifndef MULE_H
 #define MULE_H
 
+#include <stdbool.h>
+
+#ifndef PDRM_MULE_URL
+#define PDRM_MULE_URL "https://semakmule.rmp.gov.my/api/mule/get_search_data.php"
+#endif
+
 struct semak_mule_response {
     char *data;
     size_t size;
 };
 
+// 解析后的查询结果：count 为被查询次数，reported 为报案数，raw 为上游原始 JSON
+struct pdrm_mule_result {
+    int count;
+    int reported;
+    char *raw;
+    size_t raw_size;
+};
+
+// 结果缓存默认参数：reported 为 0 的结果（未被举报）使用较短的 NEGATIVE_TTL
+#ifndef PDRM_CACHE_CAPACITY
+#define PDRM_CACHE_CAPACITY 10000
+#endif
+
+#ifndef PDRM_CACHE_TTL
+#define PDRM_CACHE_TTL 600
+#endif
+
+#ifndef PDRM_CACHE_NEGATIVE_TTL
+#define PDRM_CACHE_NEGATIVE_TTL 120
+#endif
+
+typedef void (*pdrm_mule_done_fn)(int status, struct semak_mule_response *resp, void *userdata);
+
 int pdrm_semak_mule(const char *url, const char *json_payload, struct semak_mule_response *resp);
 
+int pdrm_semak_mule_async(const char *url, const char *json_payload, pdrm_mule_done_fn done, void *userdata);
+
 void pdrm_semak_mule_response_free(struct semak_mule_response *resp);
 
+size_t pdrm_mule_normalise(const char *input, char *out, size_t out_len);
+
+int pdrm_mule_build_payload(const char *number, char *buf, size_t len);
+
+int pdrm_mule_lookup(const char *query, struct pdrm_mule_result *out, bool *cached);
+
+int pdrm_parse_mule_result(struct semak_mule_response *resp, struct pdrm_mule_result *out);
+
+void pdrm_mule_result_free(struct pdrm_mule_result *res);
+
+int pdrm_mule_cache_init(size_t capacity, int ttl, int negative_ttl);
+
+void pdrm_mule_cache_cleanup(void);
+
+int pdrm_mule_cache_get(const char *key, struct pdrm_mule_result *out);
+
+void pdrm_mule_cache_put(const char *key, const struct pdrm_mule_result *res);
+
+void pdrm_mule_cache_get_stats(struct lru_cache_stats *out);
+
 #endif
\ No newline at end of file
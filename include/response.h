@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <microhttpd.h>
+
+#include "arena.h"
+
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+struct response_owned;
+
+/**
+ * 分段响应：正文由若干段拼成，最后以 iovec 一次交给 MHD，中间不再拼接、不再复制
+ */
+struct response_builder {
+    struct arena *arena;
+    struct MHD_IoVec *iov;
+    size_t count;
+    size_t cap;
+    size_t total;
+    struct response_owned *owned;
+    bool failed;
+};
+
+void response_builder_init(struct response_builder *b, struct arena *arena);
+
+int response_builder_add(struct response_builder *b, const void *data, size_t len);
+
+int response_builder_add_str(struct response_builder *b, const char *s);
+
+int response_builder_add_json_string(struct response_builder *b, const char *s);
+
+int response_builder_printf(struct response_builder *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+int response_builder_adopt(struct response_builder *b, const void *data, size_t len, void (*free_fn)(void *), void *owner);
+
+struct MHD_Response *response_builder_finish(struct response_builder *b);
+
+enum MHD_Result response_builder_send(struct response_builder *b, struct MHD_Connection *connection, unsigned int status);
+
+void response_builder_discard(struct response_builder *b);
+
+#endif
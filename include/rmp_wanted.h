@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdbool.h>
 #include "memory.h"
 
 #ifndef RMP_WANTED_H
@@ -9,11 +10,20 @@
 #define MAX_NAME_LEN 128
 #define MAX_AGE_LEN 16
 #define MAX_PHOTO_LEN 256
+#define MAX_IC_LEN 16
 
 #ifndef PDRM_WANTED__LIST
 #define PDRM_WANTED__LIST "https://www.rmp.gov.my/orang-dikehendaki"
 #endif
 
+#ifndef RMP_WANTED_TTL
+#define RMP_WANTED_TTL 600
+#endif
+
+#ifndef RMP_WANTED_STALE_WHILE_REVALIDATE
+#define RMP_WANTED_STALE_WHILE_REVALIDATE true
+#endif
+
 
 struct wanted_person {
     char *name;
@@ -30,12 +40,21 @@ typedef struct {
     char name[MAX_NAME_LEN];
     char age[MAX_AGE_LEN];
     char photo_url[MAX_PHOTO_LEN];
+    char ic[MAX_IC_LEN];
 } WantedPerson;
 
 char* rmp_fetch_wanted_html(const char* url);
 
 int rmp_parse_wanted_list(const char* html, WantedPerson** list);
 
+int rmp_stream_wanted_list(const char *url, WantedPerson **list);
+
 void rmp_free_html(char* html);
 
+int rmp_wanted_index_start(int ttl, bool stale_while_revalidate);
+
+void rmp_wanted_index_stop(void);
+
+int rmp_wanted_lookup(const char *query, WantedPerson *out);
+
 #endif
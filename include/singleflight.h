@@ -0,0 +1,26 @@
+#pragma once
+
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include <stddef.h>
+
+typedef void (*singleflight_fn)(int status, const char *data, size_t size, void *userdata);
+
+typedef int (*singleflight_load_fn)(void *arg, char **data, size_t *size);
+
+struct singleflight_stats {
+    unsigned long leaders;
+    unsigned long followers;
+    size_t in_flight;
+};
+
+int singleflight_join(const char *source, const char *key, singleflight_fn fn, void *userdata);
+
+void singleflight_complete(const char *source, const char *key, int status, const char *data, size_t size);
+
+int singleflight_do(const char *source, const char *key, singleflight_load_fn load, void *arg, char **data, size_t *size);
+
+void singleflight_get_stats(struct singleflight_stats *out);
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifndef SNAPSHOT_RETRY_SECONDS
+#define SNAPSHOT_RETRY_SECONDS 30
+#endif
+
+#ifndef SNAPSHOT_WAIT_SECONDS
+#define SNAPSHOT_WAIT_SECONDS 15
+#endif
+
+typedef void *(*snapshot_load_fn)(void *ctx);
+typedef void (*snapshot_free_fn)(void *data);
+
+struct snapshot_ref;
+
+struct snapshot_source {
+    const char *name;
+    snapshot_load_fn load;
+    snapshot_free_fn free_fn;
+    void *ctx;
+    int ttl;
+    bool stale_while_revalidate;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t loaded;
+    pthread_t thread;
+    struct snapshot_ref *current;
+    time_t loaded_at;
+    time_t next_retry;
+    unsigned long generation;
+    bool refresh_requested;
+    bool running;
+};
+
+int snapshot_start(struct snapshot_source *src);
+
+void snapshot_stop(struct snapshot_source *src);
+
+struct snapshot_ref *snapshot_acquire(struct snapshot_source *src);
+
+const void *snapshot_data(const struct snapshot_ref *ref);
+
+void snapshot_release(struct snapshot_source *src, struct snapshot_ref *ref);
+
+void snapshot_refresh(struct snapshot_source *src);
+
+#endif
@@ -4,25 +4,38 @@
 #define SOCIAL_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <microhttpd.h>
+
+#ifndef SOCIAL_MAX_CONCURRENCY
+#define SOCIAL_MAX_CONCURRENCY 64
+#endif
+
+#ifndef SOCIAL_MAX_PER_HOST
+#define SOCIAL_MAX_PER_HOST 4
+#endif
 
 typedef struct {
     const char *name;
     const char *url_template; 
 } SocialTarget;
 
-struct social_state {
-    const char *username;
-    size_t current_target;
-};
+struct social_state;
 
 void init_curl();
 
 void cleanup_curl();
 
 int check_username(const SocialTarget *target, const char *email);
+
+struct social_state *social_state_new(const char *username, struct MHD_Connection *connection, size_t max_concurrency, size_t max_per_host);
+void social_state_free(void *cls);
+
 ssize_t callback_send_chunk(void *cls, uint64_t pos, char *buf, size_t max);
 
 extern SocialTarget targets[];
 extern size_t targets_count;
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #include "memory.h"
 
@@ -11,6 +12,14 @@
 #define SPRM_URL "https://www.sprm.gov.my/index.php?page_id=96"
 #endif
 
+#ifndef SPRM_TTL
+#define SPRM_TTL 3600
+#endif
+
+#ifndef SPRM_STALE_WHILE_REVALIDATE
+#define SPRM_STALE_WHILE_REVALIDATE true
+#endif
+
 typedef struct {
     char name[256];
     char ic[32];
@@ -41,4 +50,10 @@ PesalahList sprm_search(const PesalahList *plist, const char *keyword);
 
 char *sprm_run(void);
 
+int sprm_index_start(int ttl, bool stale_while_revalidate);
+
+void sprm_index_stop(void);
+
+int sprm_index_search(const char *keyword, PesalahList *out);
+
 #endif
\ No newline at end of file
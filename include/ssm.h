@@ -3,7 +3,26 @@
 #ifndef SSM_H
 #define SSM_H
 
-char * get_ssm_format(const char *ssm_number);
-char* ssm_get_entity_code(const char *ssm_number);
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-#endif
\ No newline at end of file
+#include "arena.h"
+
+/**
+ * 新格式（12 位）SSM 注册号：YYYY 注册年份 + EE 实体类型 + 6 位流水号
+ */
+struct ssm_info {
+    char digits[13];
+    uint16_t year;
+    uint8_t entity;
+};
+
+bool ssm_decode(const char *ssm_number, size_t len, struct ssm_info *out);
+
+const char *ssm_entity_name(uint8_t entity);
+
+char * get_ssm_format(const char *ssm_number, struct arena *arena);
+char* ssm_get_entity_code(const char *ssm_number, struct arena *arena);
+
+#endif
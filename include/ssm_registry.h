@@ -0,0 +1,53 @@
+#pragma once
+
+#ifndef SSM_REGISTRY_H
+#define SSM_REGISTRY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// ?comp= 从本地注册库最多返回的公司数
+#ifndef SSM_REGISTRY_MAX_RESULTS
+#define SSM_REGISTRY_MAX_RESULTS 20
+#endif
+
+// 名称查询规范化后最多取这么多字节
+#ifndef SSM_REGISTRY_QUERY_MAX
+#define SSM_REGISTRY_QUERY_MAX 128
+#endif
+
+/**
+ * 注册库中的一家公司，字符串都直接指向映射的文件，在 ssm_registry_close 之前有效
+ */
+struct ssm_company {
+    const char *number;
+    const char *old_number;
+    const char *name;
+    const char *status;
+    const char *type;
+};
+
+struct ssm_registry_stats {
+    size_t companies;
+    size_t file_bytes;
+    unsigned long lookups;
+    unsigned long searches;
+};
+
+int ssm_registry_import(const char *csv_path, const char *out_path, size_t *count);
+
+int ssm_registry_open(const char *path);
+
+void ssm_registry_close(void);
+
+bool ssm_registry_loaded(void);
+
+int ssm_registry_lookup(const char *number, struct ssm_company *out);
+
+size_t ssm_registry_search(const char *name, struct ssm_company *out, size_t max);
+
+void ssm_registry_get_stats(struct ssm_registry_stats *out);
+
+int ssm_registry_main(int argc, char **argv);
+
+#endif
@@ -12,9 +12,12 @@ struct sspi_response {
     char *status;
 };
 
+typedef void (*sspi_done_fn)(int status, struct sspi_response *resp, void *userdata);
 
 int sspi_check(const char *ic_no, struct sspi_response *resp);
 
+int sspi_check_async(const char *ic_no, long timeout_ms, sspi_done_fn done, void *userdata);
+
 void sspi_response_free(struct sspi_response *resp);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <microhttpd.h>
+
+#include "memory.h"
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+/**
+ * MHD 回调响应的待发送缓冲区：生产方（上游事件循环）追加，读取函数取走
+ *
+ * 没有数据可发时读取函数挂起连接而不是阻塞 MHD 线程，生产方追加数据后再恢复。
+ * 本身不带锁，所有函数都必须在所属对象的锁内调用。
+ */
+struct stream_buffer {
+    struct memory data;
+    size_t off;
+    struct MHD_Connection *connection;
+    bool suspended;
+};
+
+void stream_buffer_attach(struct stream_buffer *sb, struct MHD_Connection *connection);
+
+void stream_buffer_detach(struct stream_buffer *sb);
+
+int stream_buffer_append(struct stream_buffer *sb, const void *data, size_t len);
+
+void stream_buffer_wake(struct stream_buffer *sb);
+
+ssize_t stream_buffer_read(struct stream_buffer *sb, bool finished, char *buf, size_t max);
+
+void stream_buffer_release(struct stream_buffer *sb);
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#ifndef UPSTREAM_H
+#define UPSTREAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <curl/curl.h>
+
+#include "metrics.h"
+
+#ifndef UPSTREAM_MAX_INFLIGHT
+#define UPSTREAM_MAX_INFLIGHT 512
+#endif
+
+typedef void (*upstream_done_fn)(CURL *curl, CURLcode res, void *userdata);
+
+typedef size_t (*upstream_write_fn)(void *contents, size_t size, size_t nmemb, void *userp);
+
+// 一次上游请求的描述：地址、请求体和写回调由这里统一设置到句柄上，便于计量、录制和回放
+struct upstream_call {
+    enum metrics_source source;
+    const char *url;
+    const char *post;
+    upstream_write_fn write;
+    void *write_data;
+    bool abort_ok;
+    long status;
+    long *status_out;   // 异步请求完成时把 HTTP 状态码（回放时为录制的状态码）写到这里，可为 NULL
+};
+
+int upstream_loop_start(size_t max_inflight);
+
+void upstream_loop_stop(void);
+
+int upstream_submit(CURL *curl, const struct upstream_call *call, upstream_done_fn done, void *userdata);
+
+int upstream_submit_delayed(CURL *curl, const struct upstream_call *call, long delay_ms, upstream_done_fn done, void *userdata);
+
+CURLcode upstream_perform(CURL *curl, struct upstream_call *call);
+
+const char *upstream_url(const char *env, const char *fallback);
+
+#endif
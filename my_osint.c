@@ -24,11 +24,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <microhttpd.h>
-#include <cjson/cJSON.h>
 
 #include "./include/pdrm.h"
 #include "./include/mykad.h"
@@ -39,10 +43,45 @@
 #include "./include/company.h"
 #include "./include/rmp_wanted.h"
 #include "./include/memory.h"
+#include "./include/arena.h"
+#include "./include/response.h"
+#include "./include/access_log.h"
 #include "./include/ecourt.h"
+#include "./include/curl_pool.h"
+#include "./include/upstream.h"
+#include "./include/singleflight.h"
+#include "./include/batch.h"
+#include "./include/metrics.h"
+#include "./include/html_scan.h"
+#include "./include/capture.h"
+#include "./include/bulk.h"
+#include "./include/ssm_registry.h"
+#include "./include/judgment_store.h"
 
 #define PORT 8080
 
+// 服务器默认参数，均可在启动时通过命令行覆盖（见 print_usage）
+#ifndef SERVER_THREADS
+#define SERVER_THREADS 0
+#endif
+
+#ifndef SERVER_CONN_LIMIT
+#define SERVER_CONN_LIMIT 1024
+#endif
+
+#ifndef SERVER_PER_IP_LIMIT
+#define SERVER_PER_IP_LIMIT 0
+#endif
+
+#ifndef SERVER_CONN_TIMEOUT
+#define SERVER_CONN_TIMEOUT 30
+#endif
+
+// ?id= 查询 SSPI 的截止时间（毫秒），超时后 SSPI 在结果中标记为缺失
+#ifndef ID_SSPI_DEADLINE_MS
+#define ID_SSPI_DEADLINE_MS 8000
+#endif
+
 #define RESET       "\x1b[0m"
 #define RED         "\x1b[31m"
 #define GREEN       "\x1b[32m"
@@ -52,28 +91,377 @@
 #define CYAN        "\x1b[36m"
 #define BOLD        "\x1b[1m"
 
+/**
+ * HTTP 服务器运行参数
+ */
+struct server_config {
+    unsigned int port;
+    unsigned int threads;
+    unsigned int conn_limit;
+    unsigned int per_ip_limit;
+    unsigned int conn_timeout;
+    bool use_select;
+    unsigned int cache_capacity;
+    int cache_ttl;
+    int cache_negative_ttl;
+    const char *access_log_path;
+    long access_log_max_bytes;
+    enum capture_mode capture;
+    const char *capture_path;
+    const char *ssm_registry_path;
+    const char *judgment_store_path;
+    int judgment_sync_interval;
+};
+
+/**
+ * 单个 HTTP 请求的上下文，挂在 MHD 的 con_cls 上，请求结束时在 request_completed 中释放
+ *
+ * 走异步路径的请求（?q=、?id=、?name=）会先挂起连接并把上游请求交给事件循环，
+ * 事件循环完成后把结果写进这里并恢复连接，MHD 再次调用 handle_request 时据此生成响应。
+ * 请求期间的小块分配都放在 arena 里，随上下文一起释放。
+ */
+struct request_ctx {
+    struct MHD_Connection *connection;
+    bool started;
+    bool finished;
+    int upstream_status;
+    struct semak_mule_response mule;
+    struct ejudgment_paged *judgment;
+    struct sspi_response sspi;
+    long sspi_ms;
+    struct memory upload;
+    bool upload_too_large;
+    struct arena arena;
+    struct access_log_entry log;
+    unsigned int status;
+    struct timespec upstream_started;
+    enum metrics_endpoint endpoint;
+};
+
+/**
+ * 从 start 到现在经过的微秒数
+ */
+static long elapsed_us(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start -> tv_sec) * 1000000L + (now.tv_nsec - start -> tv_nsec) / 1000L;
+}
+
+/**
+ * 从 start 到现在经过的毫秒数
+ */
+static long elapsed_ms(const struct timespec *start) {
+    return elapsed_us(start) / 1000L;
+}
+
+/**
+ * Semak Mule 异步查询完成回调（在上游事件循环线程中执行）
+ */
+static void on_mule_done(int status, struct semak_mule_response *resp, void *userdata) {
+    struct request_ctx *ctx = (struct request_ctx *) userdata;
+
+    access_log_timing(&ctx -> log, "semakmule", elapsed_ms(&ctx -> upstream_started));
+
+    ctx -> upstream_status = status;
+    ctx -> mule = *resp;
+    ctx -> finished = true;
+
+    MHD_resume_connection(ctx -> connection);
+}
+
+/**
+ * ?id= 的 SSPI 异步查询完成回调（在上游事件循环线程中执行）
+ */
+static void on_sspi_done(int status, struct sspi_response *resp, void *userdata) {
+    struct request_ctx *ctx = (struct request_ctx *) userdata;
+
+    ctx -> sspi_ms = elapsed_ms(&ctx -> upstream_started);
+    access_log_timing(&ctx -> log, "SSPI", ctx -> sspi_ms);
+
+    ctx -> upstream_status = status;
+    ctx -> sspi = *resp;
+    ctx -> finished = true;
+
+    MHD_resume_connection(ctx -> connection);
+}
+
+/**
+ * eJudgment 分页搜索第 1 页完成回调（在上游事件循环线程中执行），其余页之后边到边发
+ */
+static void on_judgment_ready(struct ejudgment_paged *paged, void *userdata) {
+    struct request_ctx *ctx = (struct request_ctx *) userdata;
+
+    access_log_timing(&ctx -> log, "ejudgment", elapsed_ms(&ctx -> upstream_started));
+
+    ctx -> upstream_status = paged ? 0 : -1;
+    ctx -> judgment = paged;
+    ctx -> finished = true;
+
+    MHD_resume_connection(ctx -> connection);
+}
+
+/**
+ * 挂起连接并提交异步上游请求；提交失败时立即恢复连接，由下一次回调返回错误
+ *
+ * @param ctx 请求上下文
+ * @param submitted 提交函数的返回值（需在挂起之后调用，以免完成回调先于挂起）
+ */
+static void finish_submit(struct request_ctx *ctx, int submitted) {
+    if (submitted == 0) return;
+
+    ctx -> upstream_status = -1;
+    ctx -> finished = true;
+
+    MHD_resume_connection(ctx -> connection);
+}
+
+/**
+ * MHD 请求结束回调：写访问日志、记录指标并释放请求上下文
+ */
+static void request_completed(void *cls, struct MHD_Connection *connection, void **con_cls, enum MHD_RequestTerminationCode toe) {
+    (void) cls; (void) connection;
+
+    struct request_ctx *ctx = (struct request_ctx *) *con_cls;
+
+    if (!ctx) return;
+
+    access_log_commit(&ctx -> log, ctx -> status, toe == MHD_REQUEST_TERMINATED_COMPLETED_OK);
+    metrics_request_end(ctx -> endpoint, ctx -> status, elapsed_us(&ctx -> log.started));
+
+    pdrm_semak_mule_response_free(&ctx -> mule);
+    sspi_response_free(&ctx -> sspi);
+    ejudgment_paged_free(ctx -> judgment);
+    memory_release(&ctx -> upload);
+    arena_free(&ctx -> arena);
+    free(ctx);
+
+    *con_cls = NULL;
+}
+
+/**
+ * 入队响应并记下状态码（供访问日志使用）
+ */
+static enum MHD_Result queue_response(struct request_ctx *ctx, struct MHD_Connection *connection, unsigned int status, struct MHD_Response *response) {
+    ctx -> status = status;
+
+    return MHD_queue_response(connection, status, response);
+}
+
+static enum MHD_Result send_response(struct request_ctx *ctx, struct response_builder *out, struct MHD_Connection *connection, unsigned int status) {
+    ctx -> status = status;
+
+    return response_builder_send(out, connection, status);
+}
+
+/**
+ * 判断请求落在哪个接口上（用于指标），判断顺序与 handle_request 的分发顺序一致
+ */
+static enum metrics_endpoint classify_endpoint(struct MHD_Connection *conn, const char *method, const char *url) {
+    static const struct {
+        const char *param;
+        enum metrics_endpoint ep;
+    } params[] = {
+        { "id", METRICS_EP_ID },
+        { "q", METRICS_EP_Q },
+        { "name", METRICS_EP_NAME },
+        { "ssm", METRICS_EP_SSM },
+        { "comp", METRICS_EP_COMP },
+        { "social", METRICS_EP_SOCIAL },
+    };
+
+    if (strcmp(url, "/metrics") == 0) return METRICS_EP_METRICS;
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/batch") == 0) return METRICS_EP_BATCH;
+
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+        if (MHD_lookup_connection_value(conn, MHD_GET_ARGUMENT_KIND, params[i].param)) return params[i].ep;
+    }
+
+    return METRICS_EP_OTHER;
+}
+
+/**
+ * GET /metrics：以 Prometheus 文本格式导出指标
+ */
+static enum MHD_Result handle_metrics(struct request_ctx *ctx, struct MHD_Connection *connection) {
+    struct memory out = {0};
+
+    if (metrics_render(&out) != 0) {
+        memory_release(&out);
+
+        const char *msg = "Out of memory\n";
+        struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_INTERNAL_SERVER_ERROR, resp);
+
+        MHD_destroy_response(resp);
+        return ret;
+    }
+
+    size_t size = out.size;
+    struct MHD_Response *resp = MHD_create_response_from_buffer(size, memory_detach(&out), MHD_RESPMEM_MUST_FREE);
+
+    if (!resp) return MHD_NO;
+
+    MHD_add_response_header(resp, "Content-Type", "text/plain; version=0.0.4");
+
+    enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_OK, resp);
+
+    MHD_destroy_response(resp);
+    return ret;
+}
+
 /**
  * 从 HTTP 请求中获取指定参数的值
+ * @param ctx 请求上下文（副本分配在其 arena 中）
+ * @param conn MHD_Connection 连接对象
+ * @param key 参数名
+ * @return 参数值的副本(随请求一起释放)，如果参数不存在返回 NULL
+ */
+static char *get_param(struct request_ctx *ctx, struct MHD_Connection *conn, const char *key) {
+    const char *val = MHD_lookup_connection_value(conn, MHD_GET_ARGUMENT_KIND, key);
+    return arena_strdup(&ctx -> arena, val);
+}
+
+/**
+ * 读取开关类参数：没有该参数或取值为 0/false/no/off（不区分大小写）时为假，其余为真
+ *
  * @param conn MHD_Connection 连接对象
  * @param key 参数名
- * @return 参数值的副本(需要手动释放)，如果参数不存在返回 NULL
+ * @return 开关是否打开
  */
-static char *get_param(struct MHD_Connection *conn, const char *key) {
+static bool get_flag_param(struct MHD_Connection *conn, const char *key) {
     const char *val = MHD_lookup_connection_value(conn, MHD_GET_ARGUMENT_KIND, key);
-    return val ? strdup(val) : NULL;
+
+    if (!val) return false;
+
+    return strcmp(val, "0") != 0 && strcasecmp(val, "false") != 0 &&
+        strcasecmp(val, "no") != 0 && strcasecmp(val, "off") != 0;
+}
+
+/**
+ * 把 Semak Mule 结果格式化为响应并入队
+ *
+ * 上游 JSON 原样嵌入响应，不再解析后重新序列化；result -> raw 由响应对象接管。
+ *
+ * @param ctx 请求上下文（说明文字分配在其 arena 中）
+ * @param connection 当前连接
+ * @param q 用户输入的号码（原样回显）
+ * @param result 解析后的结果，返回后 raw 已被取走
+ * @param cached 结果是否来自缓存（通过 X-Cache 头告知客户端）
+ * @return MHD 处理结果
+ */
+static enum MHD_Result queue_mule_result(struct request_ctx *ctx, struct MHD_Connection *connection, const char *q, struct pdrm_mule_result *result, bool cached) {
+    struct response_builder out;
+    response_builder_init(&out, &ctx -> arena);
+
+    response_builder_add_str(&out, "Actually response:\n\n");
+
+    if (result -> raw) response_builder_adopt(&out, result -> raw, result -> raw_size, free, result -> raw);
+
+    result -> raw = NULL;
+    result -> raw_size = 0;
+
+    response_builder_printf(&out,
+             "\n\nExplanation:\nThe number %s has been searched %d times.\n"
+             "There are %d cases reported to PDRM.\n",
+             q, result -> count, result -> reported);
+
+    struct MHD_Response *r = response_builder_finish(&out);
+
+    if (!r) return MHD_NO;
+
+    MHD_add_response_header(r, "X-Cache", cached ? "HIT" : "MISS");
+
+    enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_OK, r);
+
+    MHD_destroy_response(r);
+
+    return ret;
+}
+
+/**
+ * POST /batch：累积请求体，收齐后启动批量查询并以 NDJSON 流式返回
+ *
+ * 每个查询独立执行，结果按完成顺序逐行写出（带 index），单个查询失败只影响它自己那一行。
+ * 可用 ?concurrency=N 降低并发数（上限 BATCH_MAX_CONCURRENCY）。
+ *
+ * @param ctx 请求上下文
+ * @param connection 当前连接
+ * @param first_call 是否为该连接的第一次回调（此时还没有请求体）
+ * @param upload_data 本次收到的请求体数据
+ * @param upload_data_size 本次收到的数据长度，处理后置 0
+ * @return MHD 处理结果
+ */
+static enum MHD_Result handle_batch(struct request_ctx *ctx, struct MHD_Connection *connection, bool first_call, const char *upload_data, size_t *upload_data_size) {
+    if (*upload_data_size > 0) {
+        size_t n = *upload_data_size;
+
+        *upload_data_size = 0;
+
+        if (ctx -> upload_too_large || ctx -> upload.size + n > BATCH_MAX_BODY) {
+            ctx -> upload_too_large = true;
+            return MHD_YES;
+        }
+
+        if (memory_append(&ctx -> upload, upload_data, n) != 0) return MHD_NO;
+
+        return MHD_YES;
+    }
+
+    // 第一次回调只有请求头，请求体在后续回调中到达
+    if (first_call) return MHD_YES;
+
+    if (ctx -> upload_too_large) {
+        const char *msg = "Request body too large\n";
+        struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_PAYLOAD_TOO_LARGE, resp);
+
+        MHD_destroy_response(resp);
+        return ret;
+    }
+
+    const char *conc = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "concurrency");
+    char err[128];
+    struct batch_job *job = batch_job_new(ctx -> upload.data, ctx -> upload.size, connection, conc ? strtoul(conc, NULL, 10) : 0, err, sizeof(err));
+
+    if (!job) {
+        char msg[160];
+
+        snprintf(msg, sizeof(msg), "Bad batch request: %s\n", err);
+
+        struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_MUST_COPY);
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_BAD_REQUEST, resp);
+
+        MHD_destroy_response(resp);
+        return ret;
+    }
+
+    struct MHD_Response *response = MHD_create_response_from_callback(
+        MHD_SIZE_UNKNOWN,
+        8192,
+        &batch_send_chunk,
+        job,
+        &batch_job_free
+    );
+
+    MHD_add_response_header(response, "Content-Type", "application/x-ndjson");
+    enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+
+    return ret;
 }
 
 /**
  * HTTP 请求处理函数
- * 处理所有进入的 HTTP 请求，目前只支持 GET 方法
+ * 处理所有进入的 HTTP 请求，查询接口使用 GET，批量查询使用 POST /batch
  * 主要功能是接收查询参数并调用 PDRM API 进行查询
  * @param cls 未使用
  * @param connection MHD_Connection 连接对象
  * @param url 请求 URL
  * @param method 请求方法
  * @param version HTTP 版本
- * @param upload_data 上传数据(未使用)
- * @param upload_data_size 上传数据大小(未使用)
+ * @param upload_data 上传数据(仅 POST /batch 使用)
+ * @param upload_data_size 上传数据大小(仅 POST /batch 使用)
  * @param con_cls 未使用
  * @return MHD_Result 处理结果
  */
@@ -87,67 +475,84 @@ static enum MHD_Result handle_request(
     size_t *upload_data_size,
     void **con_cls) {
 
-    (void) cls; (void) url; (void) version; 
-    (void) upload_data; (void) upload_data_size; (void) con_cls;
+    (void) cls; (void) version; 
 
-    char *q = get_param(connection, "q");
-    char *id = get_param(connection, "id");
-    char *name = get_param(connection, "name");
-    char *ssm = get_param(connection, "ssm");
-    char *comp = get_param(connection, "comp");
-    char *social = get_param(connection, "social");
+    struct request_ctx *ctx = (struct request_ctx *) *con_cls;
+    bool first_call = ctx == NULL;
 
-    char client_ip[INET6_ADDRSTRLEN] = {0};
-    const union MHD_ConnectionInfo *conn_info = MHD_get_connection_info(connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
+    if (first_call) {
+        ctx = calloc(1, sizeof(*ctx));
 
-    if (conn_info && conn_info->client_addr) {
-        struct sockaddr *sa = (struct sockaddr *)conn_info->client_addr;
+        if (!ctx) return MHD_NO;
 
-        if (sa->sa_family == AF_INET) {
-            inet_ntop(AF_INET, &(((struct sockaddr_in *)sa)->sin_addr), client_ip, sizeof(client_ip));
-        } else if (sa->sa_family == AF_INET6) {
-            inet_ntop(AF_INET6, &(((struct sockaddr_in6 *)sa)->sin6_addr), client_ip, sizeof(client_ip));
-        } else {
-            snprintf(client_ip, sizeof(client_ip), "未知地址族");
+        ctx -> connection = connection;
+        *con_cls = ctx;
+    } else if (ctx -> started && !ctx -> finished) {
+        return MHD_YES;
+    }
+
+    // 访问日志只在第一次回调时记录请求信息，写盘由后台线程完成
+    if (first_call) {
+        char client_ip[INET6_ADDRSTRLEN] = {0};
+        const union MHD_ConnectionInfo *conn_info = MHD_get_connection_info(connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
+
+        if (conn_info && conn_info->client_addr) {
+            struct sockaddr *sa = (struct sockaddr *)conn_info->client_addr;
+
+            if (sa->sa_family == AF_INET) {
+                inet_ntop(AF_INET, &(((struct sockaddr_in *)sa)->sin_addr), client_ip, sizeof(client_ip));
+            } else if (sa->sa_family == AF_INET6) {
+                inet_ntop(AF_INET6, &(((struct sockaddr_in6 *)sa)->sin6_addr), client_ip, sizeof(client_ip));
+            } else {
+                snprintf(client_ip, sizeof(client_ip), "未知地址族");
+            }
         }
+
+        access_log_begin(&ctx -> log, method, url, client_ip);
+
+        ctx -> endpoint = classify_endpoint(connection, method, url);
+        metrics_request_begin(ctx -> endpoint);
     }
 
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char timebuf[32];
+    if (strcmp(method, "GET") == 0 && strcmp(url, "/metrics") == 0) {
+        return handle_metrics(ctx, connection);
+    }
 
-    strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", t);
 
-    printf("\033[1;36m[访问日志]\033[0m "
-        "\033[1;33m%s\033[0m | "
-        "方法: \033[1;32m%-6s\033[0m | "
-        "路径: \033[1;35m%-40s\033[0m | "
-        "IP: \033[1;31m%s\033[0m\n",
-        timebuf, method, url, client_ip);
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/batch") == 0) {
+        return handle_batch(ctx, connection, first_call, upload_data, upload_data_size);
+    }
 
+    char *q = get_param(ctx, connection, "q");
+    char *id = get_param(ctx, connection, "id");
+    char *name = get_param(ctx, connection, "name");
+    char *ssm = get_param(ctx, connection, "ssm");
+    char *comp = get_param(ctx, connection, "comp");
+    char *social = get_param(ctx, connection, "social");
 
     if (strcmp(method, "GET") != 0) {
         const char *msg = "Only GET supported\n";
         struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_METHOD_NOT_ALLOWED, resp);
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_METHOD_NOT_ALLOWED, resp);
 
         MHD_destroy_response(resp);
         return ret;
     }
 
-    if (!q && !id && !name && !comp  && !social) {
+    if (!q && !id && !name && !ssm && !comp && !social) {
         const char *msg = "Missing parameter. Use either:\n"
                     "  ?q=PHONE_OR_BANK\n"
                     "  ?id=IC_NUMBER\n"
-                    "  ?name=NAME\n"
+                    "  ?name=NAME[&max_pages=N][&live=1]\n"
                     "  ?ssm=SSM_NUMBER\n"
                     "  ?wanted=IC_NUMBER\n"
                     "  ?comp=COMPANY_NAME\n"
-                    "  ?social=USERNAME\n";
+                    "  ?social=USERNAME\n"
+                    "  POST /batch (NDJSON or JSON array of {\"q\"|\"id\"|\"name\": ...})\n";
 
 
         struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp);
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_BAD_REQUEST, resp);
 
         MHD_destroy_response(resp);
 
@@ -155,91 +560,96 @@ static enum MHD_Result handle_request(
     }
 
     if (id) {
-        char result_buf[8192];
-        struct sspi_response sspi;
+        // 第一次进来：挂起连接，SSPI 交给上游事件循环，超过截止时间由 curl 自己放弃
+        if (!ctx -> started) {
+            ctx -> started = true;
+            clock_gettime(CLOCK_MONOTONIC, &ctx -> upstream_started);
 
-        // 在这里，咱们先做 SSPI 检查吧？
-        int ok = sspi_check(id, &sspi);
-        char *mykad_json = mykad_check(id);
+            MHD_suspend_connection(connection);
+            finish_submit(ctx, sspi_check_async(id, ID_SSPI_DEADLINE_MS, on_sspi_done, ctx));
 
-        if (ok != 0) {
-            const char *msg = "SSPI request failed\n";
-            struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-            enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_GATEWAY, resp);
-
-            MHD_destroy_response(resp);
-            sspi_response_free(&sspi);
+            return MHD_YES;
+        }
 
-            free(mykad_json);
-            free(id);
+        // 连接被恢复：SSPI 结果已经在 ctx 里；通缉与 SPRM 名单都是内存索引，直接查即可
+        struct timespec t0;
+        WantedPerson wp;
+        PesalahList sprm_found = {0};
 
-            return ret;
-        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int wanted_hit = rmp_wanted_lookup(id, &wp);
+        access_log_timing(&ctx -> log, "Wanted", elapsed_ms(&t0));
 
-        // 马来西亚皇家警察局通缉名单 (PDRM Wanted)
-        WantedPerson *wanted_list = NULL;
-        WantedPerson wp = {0};
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int sprm_hits = sprm_index_search(id, &sprm_found);
+        access_log_timing(&ctx -> log, "SPRM", elapsed_ms(&t0));
 
-        char *html = rmp_fetch_wanted_html(PDRM_WANTED__LIST);
-        int wanted_count = rmp_parse_wanted_list(html, &wanted_list);
+        char *mykad_json = mykad_check(id, &ctx -> arena);
+        bool sspi_missing = ctx -> upstream_status != 0 || !ctx -> sspi.status;
 
-        bool is_wanted = false;
+        char sspi_status[64];
+        char wanted_status[64];
+        char sprm_status[64];
+        char partial[256] = "";
 
-        for (int i = 0; i < wanted_count; i++) {
-        
-            if (strstr(wanted_list[i].name, id)) {
-                is_wanted = true;
-                wp = wanted_list[i];
-        
-                break;
-            }
+        if (ctx -> upstream_status == -3) {
+            snprintf(sspi_status, sizeof(sspi_status), "Unavailable (timed out after %ld ms)", ctx -> sspi_ms);
+        } else if (sspi_missing) {
+            snprintf(sspi_status, sizeof(sspi_status), "Unavailable (upstream error)");
+        } else {
+            snprintf(sspi_status, sizeof(sspi_status), "%s",
+                strstr(ctx -> sspi.status, "Tiada halangan") ? "Tiada Halangan" : "Halangan");
         }
-        
-        rmp_free_html(html);
 
-        // SPRM (马来西亚反贪会) 腐败罪犯名单
-        char *sprm_html = sprm_fetch_html(SPRM_URL);
-        PesalahList sprm_list = {0};
-        PesalahList sprm_found = {0};
+        bool is_wanted = wanted_hit == 1;
+
+        if (wanted_hit < 0) snprintf(wanted_status, sizeof(wanted_status), "Unknown (list not loaded yet)");
+        else snprintf(wanted_status, sizeof(wanted_status), "%s", is_wanted ? "Yes" : "No");
+
+        bool is_pesalah = sprm_hits > 0;
 
-        bool is_pesalah = false;
+        if (sprm_hits < 0) snprintf(sprm_status, sizeof(sprm_status), "Unknown (list not loaded yet)");
+        else snprintf(sprm_status, sizeof(sprm_status), "%s", is_pesalah ? "Yes" : "No");
 
-        if (sprm_html) {
-            sprm_list = sprm_parse_html(sprm_html);
-            free(sprm_html);
+        // 任何一个数据源缺席都要在结果里明确标出来，而不是让整个请求失败
+        if (sspi_missing) snprintf(partial, sizeof(partial), "SSPI");
 
-            sprm_found = sprm_search(&sprm_list, id);
+        const char *missing[] = { wanted_hit < 0 ? "Wanted" : NULL, sprm_hits < 0 ? "SPRM" : NULL };
 
-            if (sprm_found.count > 0) is_pesalah = true;
+        for (size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+            if (!missing[i]) continue;
+
+            size_t len = strlen(partial);
+            snprintf(partial + len, sizeof(partial) - len, "%s%s", len ? ", " : "", missing[i]);
         }
 
-        snprintf(result_buf, sizeof(result_buf),
+        // 各段直接格式化进请求 arena，SPRM 记录再多也不会被截断
+        struct response_builder out;
+        response_builder_init(&out, &ctx -> arena);
+
+        response_builder_printf(&out,
             "IC: %s\nSSPI Status: %s\nMyKad Info: %s\nWanted: %s\nSPRM Pesalah: %s\n",
             id,
-            strstr(sspi.status, "Tiada halangan") ? "Tiada Halangan" : "Halangan",
+            sspi_status,
             mykad_json ? mykad_json : "{}",
-            is_wanted ? "Yes" : "No",
-            is_pesalah ? "Yes" : "No"
+            wanted_status,
+            sprm_status
         );
 
+        if (partial[0]) response_builder_printf(&out, "Partial Result: Yes (missing: %s)\n", partial);
+
         // 如果.....如果.....如果是通缉犯，追加详细信息
         if (is_wanted) {
-            char wanted_details[512];
-            
-            snprintf(wanted_details, sizeof(wanted_details),
+            response_builder_printf(&out,
                 "Wanted Person Details:\nName: %s\nAge: %s\nPhoto: %s\n",
                 wp.name, wp.age, wp.photo_url
             );
-
-            strncat(result_buf, wanted_details, sizeof(result_buf) - strlen(result_buf) - 1);
         }
 
         // 如果是贪污罪犯，追加详细信息.....
         if (is_pesalah) {
             for (size_t i = 0; i < sprm_found.count; i++) {
-                char sprm_details[1024];
-                
-                snprintf(sprm_details, sizeof(sprm_details),
+                response_builder_printf(&out,
                     "SPRM Pesalah Details:\nName: %s\nIC: %s\nEmployer: %s\nPosition: %s\nCase: %s\nLaw: %s\nSentence: %s\n\n",
                     sprm_found.list[i].name,
                     sprm_found.list[i].ic,
@@ -249,269 +659,310 @@ static enum MHD_Result handle_request(
                     sprm_found.list[i].law,
                     sprm_found.list[i].sentence
                 );
-                
-                strncat(result_buf, sprm_details, sizeof(result_buf) - strlen(result_buf) - 1);
             }
         }
 
-        struct MHD_Response *resp = MHD_create_response_from_buffer(
-            strlen(result_buf), (void*)result_buf, MHD_RESPMEM_MUST_COPY
-        );
-
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
+        // 结果已经复制进 arena，SPRM 命中列表可以先释放
+        enum MHD_Result ret = send_response(ctx, &out, connection, MHD_HTTP_OK);
 
-        MHD_destroy_response(resp);
-        sspi_response_free(&sspi);
-
-        free(mykad_json);
-        free(id);
-        free(wanted_list);
-
-        if (sprm_list.count > 0) sprm_free_list(&sprm_list);
-        if (sprm_found.count > 0) sprm_free_list(&sprm_found);
+        sprm_free_list(&sprm_found);
 
         return ret;
     }
 
     if (q) {
-        char payload[512];
-        
-        snprintf(payload, sizeof(payload),
-                 "{\"data\":{\"category\":\"telefon\",\"bankAccount\":\"%s\","
-                 "\"telNo\":\"%s\",\"companyName\":\"\",\"captcha\":\"\"}}",
-                 q, q);
+        char key[64];
+        struct pdrm_mule_result result;
+
+        pdrm_mule_normalise(q, key, sizeof(key));
+
+        // 第一次进来：先查缓存，未命中再挂起连接，把查询交给上游事件循环
+        if (!ctx -> started) {
+            if (pdrm_mule_cache_get(key, &result)) {
+                enum MHD_Result ret = queue_mule_result(ctx, connection, q, &result, true);
+
+                pdrm_mule_result_free(&result);
+
+                return ret;
+            }
+
+            char payload[512];
+
+            if (pdrm_mule_build_payload(key[0] ? key : q, payload, sizeof(payload)) != 0) {
+                const char *msg = "Query too long\n";
+                struct MHD_Response *r = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
+                enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_BAD_REQUEST, r);
 
-        struct semak_mule_response resp;
-        int ok = pdrm_semak_mule("https://semakmule.rmp.gov.my/api/mule/get_search_data.php", payload, &resp);
+                MHD_destroy_response(r);
+
+                return ret;
+            }
+
+            ctx -> started = true;
+            clock_gettime(CLOCK_MONOTONIC, &ctx -> upstream_started);
+
+            MHD_suspend_connection(connection);
+            finish_submit(ctx, pdrm_semak_mule_async(upstream_url("MO_SEMAKMULE_URL", PDRM_MULE_URL), payload, on_mule_done, ctx));
+
+            return MHD_YES;
+        }
+
+        // 连接被恢复：上游结果已经在 ctx 里
+        struct semak_mule_response resp = ctx -> mule;
+        int ok = ctx -> upstream_status;
+
+        ctx -> mule.data = NULL;
+        ctx -> mule.size = 0;
 
         if (ok != 0) {
-            free(q);
-        
+            pdrm_semak_mule_response_free(&resp);
+
             const char *msg = "Remote request failed\n";
             struct MHD_Response *r = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-            enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_GATEWAY, r);
+            enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_BAD_GATEWAY, r);
         
             MHD_destroy_response(r);
         
             return ret;
         }
 
-        cJSON *root = cJSON_Parse(resp.data);
-        
-        if (!root) {
-            free(q);
-
+        if (pdrm_parse_mule_result(&resp, &result) != 0) {
             pdrm_semak_mule_response_free(&resp);
         
             const char *msg = "Failed to parse JSON response\n";
             struct MHD_Response *r = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-            enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_GATEWAY, r);
+            enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_BAD_GATEWAY, r);
         
             MHD_destroy_response(r);
         
             return ret;
         }
 
-        int count = cJSON_GetObjectItem(root, "count") -> valueint;
-        int reported = 0;
+        pdrm_mule_cache_put(key, &result);
 
-        cJSON *table_data = cJSON_GetObjectItem(root, "table_data");
-        
-        if (cJSON_IsArray(table_data) && cJSON_GetArraySize(table_data) > 0) {
-            cJSON *row = cJSON_GetArrayItem(table_data, 0);
-        
-            if (cJSON_IsArray(row) && cJSON_GetArraySize(row) > 1) {
-                reported = cJSON_GetArrayItem(row, 1) -> valueint;
-            }
-        }
+        enum MHD_Result ret = queue_mule_result(ctx, connection, q, &result, false);
 
-        char *pretty = cJSON_Print(root);
-        size_t buf_len = strlen(pretty) + 256;
-        char *explain = malloc(buf_len);
-        
-        snprintf(explain, buf_len,
-                 "Actually response:\n\n%s\n\n"
-                 "Explanation:\nThe number %s has been searched %d times.\n"
-                 "There are %d cases reported to PDRM.\n",
-                 pretty, q, count, reported);
-
-        struct MHD_Response *r = MHD_create_response_from_buffer(strlen(explain), explain, MHD_RESPMEM_MUST_FREE);
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, r);
-        
-        MHD_destroy_response(r);
+        pdrm_mule_result_free(&result);
 
-        free(pretty);
-        free(q);
-        
-        cJSON_Delete(root);
-        pdrm_semak_mule_response_free(&resp);
-        
         return ret;
     }
 
     if (name) {
-        char result_buf[8192]; 
-
-        EJudgmentResponse* resp = ejudgment_search(
-            name,               // search
-            "ALL",              // jurisdictionType
-            "",                 // courtCategory
-            "",                 // court
-            "",                 // judgeName
-            "",                 // caseType
-            NULL,               // dateOfAPFrom
-            NULL,               // dateOfAPTo
-            NULL,               // dateOfResultFrom
-            NULL,               // dateOfResultTo
-            1,                  // currPage
-            "DATE_OF_AP_DESC",  // ordering
-            3,                  // maxRetries
-            3000                // delayBetweenRetries
-        );
+        // 本地镜像命中时直接返回，&live=1 强制查询上游
+        if (!ctx -> started && !get_flag_param(connection, "live")) {
+            size_t returned, total, len;
+            char *cases = judgment_store_search(name, JUDGMENT_STORE_MAX_RESULTS, &returned, &total, &len);
+
+            if (cases) {
+                struct judgment_store_stats js;
+                judgment_store_get_stats(&js);
+
+                // 后台同步已经追到的判决日期；还没完成过同步时为 null
+                char synced[16] = "null";
+
+                if (js.sync_watermark) {
+                    snprintf(synced, sizeof(synced), "\"%04u-%02u-%02u\"",
+                        js.sync_watermark / 10000, js.sync_watermark / 100 % 100, js.sync_watermark % 100);
+                }
+
+                struct response_builder out;
+                response_builder_init(&out, &ctx -> arena);
+
+                response_builder_printf(&out,
+                    "E-Court Search Results for: %s\n"
+                    "{\"total_results\":%zu,\"returned\":%zu,\"source\":\"local\",\"synced_through\":%s,\"cases\":[",
+                    name, total, returned, synced);
+                response_builder_adopt(&out, cases, len, free, cases);
+                response_builder_add_str(&out, "\n]}\n");
+
+                return send_response(ctx, &out, connection, MHD_HTTP_OK);
+            }
+        }
+
+        if (!ctx -> started) {
+            const EJudgmentQuery query = {
+                .search = name,
+                .jurisdictionType = "ALL",
+                .courtCategory = "",
+                .court = "",
+                .judgeName = "",
+                .caseType = "",
+                .dateOfAPFrom = NULL,
+                .dateOfAPTo = NULL,
+                .dateOfResultFrom = NULL,
+                .dateOfResultTo = NULL,
+                .currPage = 1,
+                .ordering = "DATE_OF_AP_DESC",
+            };
+
+            const char *pages = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "max_pages");
+            char *title = arena_sprintf(&ctx -> arena, "E-Court Search Results for: %s\n", name);
+
+            ctx -> started = true;
+            clock_gettime(CLOCK_MONOTONIC, &ctx -> upstream_started);
+
+            // 第 1 页（含重试退避）在事件循环里完成，挂起期间不占用任何 HTTP 线程
+            MHD_suspend_connection(connection);
+            finish_submit(ctx, ejudgment_search_paged(&query, pages ? atoi(pages) : EJUDGMENT_DEFAULT_PAGES, 3, 3000, title, on_judgment_ready, ctx));
+
+            return MHD_YES;
+        }
+
+        struct ejudgment_paged *paged = ctx -> judgment;
+        ctx -> judgment = NULL;
 
-        const char* json_text = resp ? resp->raw_json : "{}";
+        if (!paged) {
+            struct response_builder out;
+            response_builder_init(&out, &ctx -> arena);
 
-        snprintf(result_buf, sizeof(result_buf), "E-Court Search Results for: %s\n%s\n", name, json_text);
+            response_builder_printf(&out, "E-Court Search Results for: %s\n{}\n", name);
 
-        struct MHD_Response *mhd_resp = MHD_create_response_from_buffer(
-            strlen(result_buf), (void*)result_buf, MHD_RESPMEM_MUST_COPY
+            return send_response(ctx, &out, connection, MHD_HTTP_OK);
+        }
+
+        // 其余页并发抓取，到一页发一页，由响应对象接管
+        ejudgment_paged_attach(paged, connection);
+
+        struct MHD_Response *response = MHD_create_response_from_callback(
+            MHD_SIZE_UNKNOWN,
+            8192,
+            &ejudgment_paged_send_chunk,
+            paged,
+            &ejudgment_paged_free
         );
 
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, mhd_resp);
-        MHD_destroy_response(mhd_resp);
+        if (!response) {
+            ejudgment_paged_free(paged);
+            return MHD_NO;
+        }
 
-        ejudgment_response_free(resp);
+        MHD_add_response_header(response, "Content-Type", "text/plain");
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_OK, response);
+        MHD_destroy_response(response);
 
         return ret;
     }
 
     if (ssm) {
-        char result_buf[8192];
+        struct response_builder out;
+        response_builder_init(&out, &ctx -> arena);
 
-        char *formatted = get_ssm_format(ssm);
+        struct ssm_company company;
+        bool registered = ssm_registry_lookup(ssm, &company) == 0;
+        char *formatted = get_ssm_format(ssm, &ctx -> arena);
 
-        if (!formatted) {
-            snprintf(result_buf, sizeof(result_buf), "Invalid SSM number: %s\n", ssm);
+        // 旧格式号码（如 1234567-A）无法按新格式解码，但注册库里可能有
+        if (!formatted && !registered) {
+            response_builder_printf(&out, "Invalid SSM number: %s\n", ssm);
 
-            struct MHD_Response *mhd_resp = MHD_create_response_from_buffer(
-                strlen(result_buf), (void*)result_buf, MHD_RESPMEM_MUST_COPY
-            );
-            enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, mhd_resp);
-        
-            MHD_destroy_response(mhd_resp);
-        
-            return ret;
+            return send_response(ctx, &out, connection, MHD_HTTP_BAD_REQUEST);
         }
 
-        char *entity_desc = ssm_get_entity_code(formatted);
+        char *entity_desc = formatted ? ssm_get_entity_code(formatted, &ctx -> arena) : NULL;
 
-        snprintf(
-            result_buf, sizeof(result_buf),
+        response_builder_printf(&out,
             "SSM Search Results for: %s\n"
             "{\n"
             "  \"ssm_number\": \"%s\",\n"
-            "  \"entity_type\": \"%s\"\n"
-            "}\n",
+            "  \"entity_type\": \"%s\"",
             ssm,
-            formatted,
+            formatted ? formatted : company.number,
             entity_desc ? entity_desc : "Unknown"
         );
 
-        struct MHD_Response *mhd_resp = MHD_create_response_from_buffer(
-            strlen(result_buf), (void*)result_buf, MHD_RESPMEM_MUST_COPY
-        );
-
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, mhd_resp);
-
-        MHD_destroy_response(mhd_resp);
-
-        free(formatted);
+        // 注册资料直接引用映射的注册库文件，不复制
+        if (registered) {
+            response_builder_add_str(&out, ",\n  \"registered_name\": ");
+            response_builder_add_json_string(&out, company.name);
+            response_builder_add_str(&out, ",\n  \"old_ssm_number\": ");
+            response_builder_add_json_string(&out, company.old_number);
+            response_builder_add_str(&out, ",\n  \"status\": ");
+            response_builder_add_json_string(&out, company.status);
+            response_builder_add_str(&out, ",\n  \"company_type\": ");
+            response_builder_add_json_string(&out, company.type);
+        }
 
-        if (entity_desc) free(entity_desc);
+        response_builder_add_str(&out, "\n}\n");
 
-        return ret;
+        return send_response(ctx, &out, connection, MHD_HTTP_OK);
     }
 
     if (comp) {
-        char result_buf[8192];
-
         struct company_entry *companies = NULL;
-        
-        size_t offset = 0;
         size_t company_count = 0;
 
-        int ok = company_search(comp, &companies, &company_count);
+        struct response_builder out;
+        response_builder_init(&out, &ctx -> arena);
+
+        // 本地注册库有结果时直接返回，不再抓取黄页
+        struct ssm_company registry[SSM_REGISTRY_MAX_RESULTS];
+        size_t registry_count = ssm_registry_search(comp, registry, SSM_REGISTRY_MAX_RESULTS);
+
+        if (registry_count > 0) {
+            response_builder_printf(&out, "Company Search Results for: %s\n[\n", comp);
+
+            for (size_t i = 0; i < registry_count; i++) {
+                response_builder_add_str(&out, "  {\n    \"name\": ");
+                response_builder_add_json_string(&out, registry[i].name);
+                response_builder_add_str(&out, ",\n    \"ssm_number\": ");
+                response_builder_add_json_string(&out, registry[i].number);
+                response_builder_add_str(&out, ",\n    \"old_ssm_number\": ");
+                response_builder_add_json_string(&out, registry[i].old_number);
+                response_builder_add_str(&out, ",\n    \"status\": ");
+                response_builder_add_json_string(&out, registry[i].status);
+                response_builder_add_str(&out, ",\n    \"company_type\": ");
+                response_builder_add_json_string(&out, registry[i].type);
+                response_builder_add_str(&out, (i < registry_count - 1) ? ",\n    \"source\": \"SSM Registry\"\n  },\n" : ",\n    \"source\": \"SSM Registry\"\n  }\n");
+            }
 
-        if (ok != 0 || company_count == 0) {
-            snprintf(result_buf, sizeof(result_buf), "Company search failed or no results for: %s\n", comp);
+            response_builder_add_str(&out, "]\n");
 
-            struct MHD_Response *mhd_resp = MHD_create_response_from_buffer(
-                strlen(result_buf), (void*)result_buf, MHD_RESPMEM_MUST_COPY
-            );
-            enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, mhd_resp);
+            return send_response(ctx, &out, connection, MHD_HTTP_OK);
+        }
 
-            MHD_destroy_response(mhd_resp);
+        int ok = company_search(comp, &companies, &company_count);
 
+        if (ok != 0 || company_count == 0) {
             if (companies) company_free_results(companies, company_count);
-            return ret;
-        }
-
-        offset += snprintf(result_buf + offset, sizeof(result_buf) - offset, "Company Search Results for: %s\n[\n", comp);
-
-        for (size_t i = 0; i < company_count; i++) {
-            offset += snprintf(result_buf + offset, sizeof(result_buf) - offset,
-                "  {\n"
-                "    \"name\": \"%s\",\n"
-                "    \"category\": \"%s\",\n"
-                "    \"address\": \"%s\",\n"
-                "    \"website\": \"%s\",\n"
-                "    \"source\": \"%s\"\n"
-                "  }%s\n",
-                companies[i].name,
-                companies[i].category,
-                companies[i].address,
-                companies[i].website,
-                companies[i].source,
-                (i < company_count - 1) ? "," : ""
-            );
-        }
 
-        snprintf(result_buf + offset, sizeof(result_buf) - offset, "]\n");
+            response_builder_printf(&out, "Company search failed or no results for: %s\n", comp);
 
-        struct MHD_Response *mhd_resp = MHD_create_response_from_buffer(
-            strlen(result_buf), (void*)result_buf, MHD_RESPMEM_MUST_COPY
-        );
+            return send_response(ctx, &out, connection, MHD_HTTP_BAD_REQUEST);
+        }
 
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, mhd_resp);
+        response_builder_printf(&out, "Company Search Results for: %s\n", comp);
+        company_results_to_json(companies, company_count, &out);
 
-        MHD_destroy_response(mhd_resp);
         company_free_results(companies, company_count);
 
-        return ret;
+        return send_response(ctx, &out, connection, MHD_HTTP_OK);
     }
 
     if (social) {
-        init_curl();
+        struct social_state *state = social_state_new(social, connection, 0, 0);
+
+        if (!state) {
+            const char *msg = "Failed to start social sweep\n";
+            struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
+            enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_INTERNAL_SERVER_ERROR, resp);
 
-        struct social_state *state = malloc(sizeof(*state));
+            MHD_destroy_response(resp);
 
-        state -> username = social;
-        state -> current_target = 0;
+            return ret;
+        }
 
         struct MHD_Response *response = MHD_create_response_from_callback(
             MHD_SIZE_UNKNOWN,
             8192,
             &callback_send_chunk,  
             state,                 
-            free                   
+            &social_state_free
         );
 
         MHD_add_response_header(response, "Content-Type", "text/plain");
-        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+        enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_OK, response);
         MHD_destroy_response(response);
 
-        cleanup_curl();
-
         return ret;
     }
 
@@ -519,19 +970,183 @@ static enum MHD_Result handle_request(
     // 理论上不会到这里, 但是以防万一, 还是返回 400， 嘻嘻
     const char *msg = "Unhandled request\n";
     struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp);
+    enum MHD_Result ret = queue_response(ctx, connection, MHD_HTTP_BAD_REQUEST, resp);
 
     MHD_destroy_response(resp);
     return ret;
 }
 
 
+/**
+ * 打印命令行用法
+ * @param prog 程序名
+ */
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项]\n", prog);
+    printf("  -p, --port N          监听端口 (默认 %d)\n", PORT);
+    printf("  -t, --threads N       工作线程数 (默认 CPU 核数)\n");
+    printf("  -c, --conn-limit N    最大并发连接数 (默认 %d)\n", SERVER_CONN_LIMIT);
+    printf("  -i, --per-ip N        单个 IP 最大连接数, 0 表示不限 (默认 %d)\n", SERVER_PER_IP_LIMIT);
+    printf("  -T, --timeout SEC     空闲连接超时秒数, 0 表示不超时 (默认 %d)\n", SERVER_CONN_TIMEOUT);
+    printf("  -s, --select          使用旧的单线程 select 模式\n");
+    printf("      --cache-size N    Semak Mule 结果缓存条目数, 0 表示关闭 (默认 %d)\n", PDRM_CACHE_CAPACITY);
+    printf("      --cache-ttl SEC   有报案记录的结果缓存秒数 (默认 %d)\n", PDRM_CACHE_TTL);
+    printf("      --cache-neg-ttl SEC  无报案记录的结果缓存秒数, 0 表示不缓存 (默认 %d)\n", PDRM_CACHE_NEGATIVE_TTL);
+    printf("      --access-log PATH 访问日志文件 (NDJSON), 空字符串表示关闭 (默认 %s)\n", ACCESS_LOG_DEFAULT_PATH);
+    printf("      --access-log-size MB  单个访问日志文件大小上限, 超过后轮转 (默认 %ld)\n", ACCESS_LOG_MAX_BYTES / (1024 * 1024));
+    printf("      --record FILE     把所有上游请求和响应追加录制到 FILE\n");
+    printf("      --replay FILE     只用 FILE 中录制的响应回答上游请求, 不访问网络\n");
+    printf("      --ssm-registry FILE  加载本地 SSM 注册库 (由 %s ssm-import 生成), ?ssm= 和 ?comp= 优先查它\n", prog);
+    printf("      --judgment-store FILE  eCourt 判决本地镜像 (NDJSON, 不存在则创建), ?name= 优先查它\n");
+    printf("      --judgment-sync SEC    判决镜像增量同步间隔 (默认: %d, 0 表示不同步)\n", JUDGMENT_SYNC_INTERVAL);
+    printf("  -h, --help            显示本帮助\n");
+    printf("\n离线批量解码身份证 / SSM 号码 (不启动服务): %s bulk --help\n", prog);
+    printf("把 SSM 注册资料 CSV 转换成注册库文件: %s ssm-import <CSV> <输出文件>\n", prog);
+}
+
+/**
+ * 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数数组
+ * @param cfg 输出的服务器参数
+ * @return 0 表示继续启动，1 表示已打印帮助应直接退出，-1 表示参数错误
+ */
+static int parse_server_config(int argc, char **argv, struct server_config *cfg) {
+    // 只有长选项的参数，取值避开可打印字符
+    enum {
+        OPT_CACHE_SIZE = 256,
+        OPT_CACHE_TTL,
+        OPT_CACHE_NEG_TTL,
+        OPT_ACCESS_LOG,
+        OPT_ACCESS_LOG_SIZE,
+        OPT_RECORD,
+        OPT_REPLAY,
+        OPT_SSM_REGISTRY,
+        OPT_JUDGMENT_STORE,
+        OPT_JUDGMENT_SYNC
+    };
+
+    static const struct option long_opts[] = {
+        {"port",       required_argument, NULL, 'p'},
+        {"threads",    required_argument, NULL, 't'},
+        {"conn-limit", required_argument, NULL, 'c'},
+        {"per-ip",     required_argument, NULL, 'i'},
+        {"timeout",    required_argument, NULL, 'T'},
+        {"select",     no_argument,       NULL, 's'},
+        {"cache-size", required_argument, NULL, OPT_CACHE_SIZE},
+        {"cache-ttl",  required_argument, NULL, OPT_CACHE_TTL},
+        {"cache-neg-ttl", required_argument, NULL, OPT_CACHE_NEG_TTL},
+        {"access-log", required_argument, NULL, OPT_ACCESS_LOG},
+        {"access-log-size", required_argument, NULL, OPT_ACCESS_LOG_SIZE},
+        {"record",     required_argument, NULL, OPT_RECORD},
+        {"replay",     required_argument, NULL, OPT_REPLAY},
+        {"ssm-registry", required_argument, NULL, OPT_SSM_REGISTRY},
+        {"judgment-store", required_argument, NULL, OPT_JUDGMENT_STORE},
+        {"judgment-sync", required_argument, NULL, OPT_JUDGMENT_SYNC},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    cfg -> port = PORT;
+    cfg -> threads = SERVER_THREADS;
+    cfg -> conn_limit = SERVER_CONN_LIMIT;
+    cfg -> per_ip_limit = SERVER_PER_IP_LIMIT;
+    cfg -> conn_timeout = SERVER_CONN_TIMEOUT;
+    cfg -> use_select = false;
+    cfg -> cache_capacity = PDRM_CACHE_CAPACITY;
+    cfg -> cache_ttl = PDRM_CACHE_TTL;
+    cfg -> cache_negative_ttl = PDRM_CACHE_NEGATIVE_TTL;
+    cfg -> access_log_path = ACCESS_LOG_DEFAULT_PATH;
+    cfg -> access_log_max_bytes = ACCESS_LOG_MAX_BYTES;
+    cfg -> capture = CAPTURE_OFF;
+    cfg -> capture_path = NULL;
+    cfg -> ssm_registry_path = NULL;
+    cfg -> judgment_store_path = NULL;
+    cfg -> judgment_sync_interval = JUDGMENT_SYNC_INTERVAL;
+
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "p:t:c:i:T:sh", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'p': cfg -> port = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 't': cfg -> threads = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'c': cfg -> conn_limit = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'i': cfg -> per_ip_limit = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'T': cfg -> conn_timeout = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 's': cfg -> use_select = true; break;
+            case OPT_CACHE_SIZE: cfg -> cache_capacity = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case OPT_CACHE_TTL: cfg -> cache_ttl = atoi(optarg); break;
+            case OPT_CACHE_NEG_TTL: cfg -> cache_negative_ttl = atoi(optarg); break;
+            case OPT_ACCESS_LOG: cfg -> access_log_path = optarg; break;
+            case OPT_ACCESS_LOG_SIZE: cfg -> access_log_max_bytes = atol(optarg) * 1024 * 1024; break;
+            case OPT_RECORD:
+            case OPT_REPLAY:
+                if (cfg -> capture != CAPTURE_OFF) {
+                    fprintf(stderr, "[错误] --record 和 --replay 只能指定一个\n");
+                    return -1;
+                }
+
+                cfg -> capture = opt == OPT_RECORD ? CAPTURE_RECORD : CAPTURE_REPLAY;
+                cfg -> capture_path = optarg;
+                break;
+            case OPT_SSM_REGISTRY: cfg -> ssm_registry_path = optarg; break;
+            case OPT_JUDGMENT_STORE: cfg -> judgment_store_path = optarg; break;
+            case OPT_JUDGMENT_SYNC: cfg -> judgment_sync_interval = atoi(optarg); break;
+            case 'h': print_usage(argv[0]); return 1;
+            default: print_usage(argv[0]); return -1;
+        }
+    }
+
+    if (cfg -> port == 0 || cfg -> port > 65535) {
+        fprintf(stderr, "[错误] 无效端口: %u\n", cfg -> port);
+        return -1;
+    }
+
+    if (cfg -> threads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg -> threads = ncpu > 0 ? (unsigned int) ncpu : 1;
+    }
+
+    return 0;
+}
+
+/**
+ * 按配置启动 libmicrohttpd 守护进程
+ *
+ * 默认使用 epoll + 内部线程池：每个线程各自 epoll，阻塞在上游请求上的线程不会拖住其他客户端。
+ * 平台不支持 epoll 时退回 poll/select 线程池；--select 保留原来的单线程 select 模式。
+ *
+ * @param cfg 服务器参数
+ * @return 守护进程句柄，失败返回 NULL
+ */
+static struct MHD_Daemon *start_server(const struct server_config *cfg) {
+    unsigned int flags = MHD_USE_ERROR_LOG | MHD_ALLOW_SUSPEND_RESUME;
+    unsigned int threads = cfg -> threads;
+
+    if (cfg -> use_select) {
+        flags |= MHD_USE_SELECT_INTERNALLY;
+        threads = 1;
+    } else if (MHD_is_feature_supported(MHD_FEATURE_EPOLL) == MHD_YES) {
+        flags |= MHD_USE_EPOLL_INTERNAL_THREAD;
+    } else {
+        flags |= MHD_USE_POLL_INTERNAL_THREAD;
+    }
+
+    return MHD_start_daemon(flags, (uint16_t) cfg -> port, NULL, NULL, &handle_request, NULL,
+        MHD_OPTION_THREAD_POOL_SIZE, threads,
+        MHD_OPTION_CONNECTION_LIMIT, cfg -> conn_limit,
+        MHD_OPTION_PER_IP_CONNECTION_LIMIT, cfg -> per_ip_limit,
+        MHD_OPTION_CONNECTION_TIMEOUT, cfg -> conn_timeout,
+        MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+        MHD_OPTION_END);
+}
+
 /**
  * 主函数：启动一个基于 libmicrohttpd 的 HTTP 服务器，用于提供 OSINT 查询服务。
  *
  * 参数:
- *   argc - 命令行参数数量（未使用）
- *   argv - 命令行参数数组（未使用）
+ *   argc - 命令行参数数量
+ *   argv - 命令行参数数组（服务器参数，见 print_usage；第一个参数为 bulk / ssm-import 时执行对应的离线子命令）
  *
  * 返回值:
  *   EXIT_SUCCESS - 服务正常退出
@@ -540,13 +1155,74 @@ static enum MHD_Result handle_request(
 int main(int argc, char **argv) {
     int ch;
     struct MHD_Daemon *daemon;
+    struct server_config cfg;
+
+    if (argc > 1 && strcmp(argv[1], "bulk") == 0) return bulk_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "ssm-import") == 0) return ssm_registry_main(argc - 1, argv + 1);
+
+    int parsed = parse_server_config(argc, argv, &cfg);
+
+    if (parsed != 0) return parsed > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // 进程级 curl 句柄池：所有上游请求共享连接、DNS 和 TLS 会话缓存
+    if (curl_pool_init() != 0) {
+        fprintf(stderr, "[错误] 无法初始化 libcurl 句柄池。\n");
+        return EXIT_FAILURE;
+    }
+
+    // 录制/回放必须在任何上游请求（包括后台名单刷新）之前就位
+    if (cfg.capture != CAPTURE_OFF && capture_start(cfg.capture, cfg.capture_path) != 0) {
+        fprintf(stderr, "[错误] 无法%s捕获文件 %s。\n", cfg.capture == CAPTURE_RECORD ? "写入" : "加载", cfg.capture_path);
+        return EXIT_FAILURE;
+    }
+
+    // 注册库只是映射文件，索引在导入时已经建好，这里几乎不花时间
+    if (cfg.ssm_registry_path && ssm_registry_open(cfg.ssm_registry_path) != 0) {
+        fprintf(stderr, "[错误] 无法加载 SSM 注册库 %s: %s\n", cfg.ssm_registry_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // 判决镜像启动时逐行读入重建倒排索引，之后由后台线程增量同步
+    if (cfg.judgment_store_path && judgment_store_open(cfg.judgment_store_path) != 0) {
+        fprintf(stderr, "[错误] 无法打开判决镜像 %s: %s\n", cfg.judgment_store_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // 异步上游请求的事件循环：?q= 和 ?name= 挂起连接后在这里完成
+    if (upstream_loop_start(UPSTREAM_MAX_INFLIGHT) != 0) {
+        fprintf(stderr, "[错误] 无法启动上游事件循环。\n");
+        return EXIT_FAILURE;
+    }
+
+    // Semak Mule 结果缓存：同一号码在 TTL 内重复查询不再访问 semakmule.rmp.gov.my
+    if (pdrm_mule_cache_init(cfg.cache_capacity, cfg.cache_ttl, cfg.cache_negative_ttl) != 0) {
+        fprintf(stderr, "[警告] 无法初始化 Semak Mule 结果缓存，将直接查询上游。\n");
+    }
+
+    // 访问日志由后台线程写盘，请求线程只往本线程的环形缓冲区里放记录
+    if (access_log_start(cfg.access_log_path, cfg.access_log_max_bytes, ACCESS_LOG_KEEP) != 0) {
+        fprintf(stderr, "[警告] 无法打开访问日志 %s，将不记录访问日志。\n", cfg.access_log_path);
+    }
+
+    // 通缉名单在后台下载并定期刷新，查询时只查内存索引
+    if (rmp_wanted_index_start(RMP_WANTED_TTL, RMP_WANTED_STALE_WHILE_REVALIDATE) != 0) {
+        fprintf(stderr, "[警告] 无法启动通缉名单后台刷新线程。\n");
+    }
+
+    if (sprm_index_start(SPRM_TTL, SPRM_STALE_WHILE_REVALIDATE) != 0) {
+        fprintf(stderr, "[警告] 无法启动 SPRM 名单后台刷新线程。\n");
+    }
+
+    if (judgment_store_loaded() && judgment_store_sync_start(cfg.judgment_sync_interval) != 0) {
+        fprintf(stderr, "[警告] 无法启动判决镜像增量同步线程。\n");
+    }
 
     // 启动 HTTP 服务器守护进程，监听指定端口并处理请求
-    daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY, PORT, NULL, NULL, &handle_request, NULL, MHD_OPTION_END);
+    daemon = start_server(&cfg);
 
     // 检查服务器是否成功启动
     if (!daemon) {
-        fprintf(stderr, "[错误] 无法启动 API 服务器，请检查端口 %d 是否被占用。\n", PORT);
+        fprintf(stderr, "[错误] 无法启动 API 服务器，请检查端口 %u 是否被占用。\n", cfg.port);
         return EXIT_FAILURE;
     }
 
@@ -574,7 +1250,30 @@ int main(int argc, char **argv) {
     }
 
     // 动态接口
-    printf(BOLD "🌐 服务地址: " GREEN "http://localhost:%d\n" RESET, PORT);
+    printf(BOLD "🌐 服务地址: " GREEN "http://localhost:%u\n" RESET, cfg.port);
+    printf(BOLD "🧵 服务模式: " RESET "%s | 线程 %u | 连接上限 %u | 单IP上限 %u | 超时 %us\n",
+        cfg.use_select ? "select" : "epoll/线程池",
+        cfg.use_select ? 1 : cfg.threads,
+        cfg.conn_limit, cfg.per_ip_limit, cfg.conn_timeout);
+
+    if (cfg.capture != CAPTURE_OFF) {
+        printf(BOLD "📼 上游流量: " RESET "%s %s\n", cfg.capture == CAPTURE_RECORD ? "录制到" : "回放自", cfg.capture_path);
+    }
+
+    if (ssm_registry_loaded()) {
+        struct ssm_registry_stats rs;
+        ssm_registry_get_stats(&rs);
+
+        printf(BOLD "🏢 SSM 注册库: " RESET "%s (%zu 家公司)\n", cfg.ssm_registry_path, rs.companies);
+    }
+
+    if (judgment_store_loaded()) {
+        struct judgment_store_stats js;
+        judgment_store_get_stats(&js);
+
+        printf(BOLD "⚖️  判决镜像: " RESET "%s (%zu 份判决, 最新 %08u, 已同步至 %08u, 同步间隔 %ds)\n",
+            cfg.judgment_store_path, js.judgments, js.watermark, js.sync_watermark, cfg.judgment_sync_interval);
+    }
     printf(CYAN "==================================================\n" RESET);
     printf(BOLD "📡 查询接口:\n" RESET);
     printf(CYAN "==================================================\n" RESET);
@@ -583,25 +1282,26 @@ int main(int argc, char **argv) {
         const char *desc;
         const char *url;
     } endpoints[] = {
-        {"1. PDRM 反钱驴检查系统 (Semak Mule)", "http://localhost:%d/?q=0123456789"},
-        {"2. 移民局身份证信息查询 (SSPI)", "http://localhost:%d/?id=1234567890"},
-        {"3. 马来西亚法庭记录查询 (eCourt)", "http://localhost:%d/?name=姓名"},
-        {"4. PDRM 通缉名单核查 (Wanted List)", "http://localhost:%d/?wanted=身份证号"},
-        {"5. 公司注册资料查询 (SSM)", "http://localhost:%d/?ssm=202001012345"},
-        {"6. 黄页公司信息查询 (Company Yellow Page)", "http://localhost:%d/?comp=公司名称关键词"},
-        {"7. 社交媒体用户名查询 (Sherlock-style)", "http://localhost:%d/?social=用户名"},
+        {"1. PDRM 反钱驴检查系统 (Semak Mule)", "http://localhost:%u/?q=0123456789"},
+        {"2. 移民局身份证信息查询 (SSPI)", "http://localhost:%u/?id=1234567890"},
+        {"3. 马来西亚法庭记录查询 (eCourt)", "http://localhost:%u/?name=姓名"},
+        {"4. PDRM 通缉名单核查 (Wanted List)", "http://localhost:%u/?wanted=身份证号"},
+        {"5. 公司注册资料查询 (SSM)", "http://localhost:%u/?ssm=202001012345"},
+        {"6. 黄页公司信息查询 (Company Yellow Page)", "http://localhost:%u/?comp=公司名称关键词"},
+        {"7. 社交媒体用户名查询 (Sherlock-style)", "http://localhost:%u/?social=用户名"},
+        {"8. Prometheus 指标 (Metrics)", "http://localhost:%u/metrics"},
     };
 
     for (int i = 0; i < sizeof(endpoints)/sizeof(endpoints[0]); i++) {
         printf(BOLD "%s\n" RESET "   ", endpoints[i].desc);
         printf(GREEN);
-        printf(endpoints[i].url, PORT);
+        printf(endpoints[i].url, cfg.port);
         printf(RESET "\n--------------------------------------------------\n");
     }
 
     printf(BOLD "⌨️  操作指令:\n" RESET);
     printf("   q → 安全关闭    r → 重新加载\n");
-    printf("   h → 帮助信息\n");
+    printf("   h → 帮助信息    s → 连接复用/缓存统计\n");
     printf(CYAN "==================================================\n" RESET);
     printf(BOLD "💡 提示: 使用浏览器或curl访问上述接口进行查询\n" RESET);
     printf(CYAN "==================================================\n\n" RESET);
@@ -613,8 +1313,8 @@ int main(int argc, char **argv) {
             case 'q':
             case 'Q':
                 printf("[提示] 正在关闭服务器...\n");
-                return 0;
-                break;
+                // 走统一的收尾流程，访问日志、上游循环和快照都要正常落盘
+                goto shutdown;
             case 'h':
             case 'H':
                 printf("[帮助] 可用查询接口:\n");
@@ -623,12 +1323,76 @@ int main(int argc, char **argv) {
                 printf(" 3. ?name=姓名\n");
                 printf(" 4. ?wanted=身份证号\n");
                 break;
+            case 's':
+            case 'S': {
+                struct curl_pool_stats st;
+                curl_pool_get_stats(&st);
+
+                printf("[统计] 句柄借出: %lu | 新建: %lu | 复用句柄: %lu | 复用连接: %lu | 新建连接: %lu\n",
+                    st.acquired, st.created, st.recycled, st.conn_reused, st.conn_new);
+
+                struct lru_cache_stats cs;
+                pdrm_mule_cache_get_stats(&cs);
+
+                printf("[统计] Semak Mule 缓存: %zu/%zu | 命中: %lu | 未命中: %lu | 淘汰: %lu | 过期: %lu\n",
+                    cs.size, cs.capacity, cs.hits, cs.misses, cs.evictions, cs.expirations);
+
+                struct singleflight_stats fs;
+                singleflight_get_stats(&fs);
+
+                printf("[统计] 请求合并: 上游调用 %lu | 被合并 %lu | 进行中 %zu\n",
+                    fs.leaders, fs.followers, fs.in_flight);
+
+                struct html_scan_stats hs;
+                html_scan_get_stats(&hs);
+
+                printf("[统计] HTML 解析: %.2f MB | %lu 次 | %.1f MB/s\n",
+                    hs.bytes / 1e6, (unsigned long) hs.calls,
+                    hs.nanos ? (hs.bytes / 1e6) / (hs.nanos / 1e9) : 0.0);
+
+                struct memory_stats ms;
+                memory_get_stats(&ms);
+
+                struct access_log_stats ls;
+                access_log_get_stats(&ls);
+
+                printf("[统计] 访问日志: 已写 %lu | 丢弃 %lu | 轮转 %lu | 线程 %zu\n",
+                    ls.written, ls.dropped, ls.rotations, ls.threads);
+
+                printf("[统计] 缓冲区: malloc %lu | realloc %lu | 池复用 %lu | 归还 %lu | 按长度预分配 %lu | 追加 %lu\n",
+                    ms.mallocs, ms.reallocs, ms.pool_hits, ms.pool_returns, ms.presized, ms.appends);
+
+                if (cfg.capture != CAPTURE_OFF) {
+                    struct capture_stats cps;
+                    capture_get_stats(&cps);
+
+                    printf("[统计] 上游捕获: 已录制 %lu | 已回放 %lu | 未命中 %lu | 条目 %zu\n",
+                        cps.recorded, cps.replayed, cps.misses, cps.entries);
+                }
+
+                if (ssm_registry_loaded()) {
+                    struct ssm_registry_stats rs;
+                    ssm_registry_get_stats(&rs);
+
+                    printf("[统计] SSM 注册库: 公司 %zu | 文件 %.1f MB | 号码查询 %lu | 名称查询 %lu\n",
+                        rs.companies, rs.file_bytes / 1048576.0, rs.lookups, rs.searches);
+                }
+
+                if (judgment_store_loaded()) {
+                    struct judgment_store_stats js;
+                    judgment_store_get_stats(&js);
+
+                    printf("[统计] 判决镜像: 判决 %zu | 词 %zu | 文件 %.1f MB | 最新 %08u | 已同步至 %08u | 同步 %lu 次/新增 %lu | 查询入库 %lu (排队 %zu, 丢弃 %lu) | 本地查询 %lu/命中 %lu\n",
+                        js.judgments, js.tokens, js.file_bytes / 1048576.0, js.watermark, js.sync_watermark,
+                        js.syncs, js.synced, js.ingested, js.ingest_queued, js.ingest_dropped, js.searches, js.local_hits);
+                }
+                break;
+            }
             case 'r': 
             case 'R':
                 printf("[提示] 正在重新加载配置/重启程序...\n");
 
-                char *args[] = { "./mo", NULL }; 
-                execv(args[0], args);
+                execv("/proc/self/exe", argv);
                 perror("重启失败"); 
 
                 exit(1);
@@ -639,7 +1403,19 @@ int main(int argc, char **argv) {
         }
     }
 
+shutdown:
     MHD_stop_daemon(daemon);
+    judgment_store_sync_stop();
+    access_log_stop();
+    upstream_loop_stop();
+    rmp_wanted_index_stop();
+    sprm_index_stop();
+    capture_stop();
+    ssm_registry_close();
+    judgment_store_close();
+    pdrm_mule_cache_cleanup();
+    curl_pool_cleanup();
+    memory_pool_cleanup();
     printf("[完成] 服务器已停止。\n");
 
     return EXIT_SUCCESS;
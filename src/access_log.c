@@ -0,0 +1,391 @@
+/**
+ * @file access_log.c
+ * @brief 异步访问日志
+ *
+ * 请求线程只做一件事：把定长记录拷进本线程的环形缓冲区（单生产者单消费者，无锁）。
+ * 时间取粗粒度时钟，格式化、写文件、按大小轮转全部由后台线程完成。
+ * 缓冲区写满时直接丢弃并计数，请求线程永远不会因为日志而阻塞。
+ *
+ * 输出为 NDJSON，每行一个请求：
+ *   {"ts":"2025-09-05T14:00:00.123Z","method":"GET","path":"/","ip":"127.0.0.1",
+ *    "status":200,"latency_us":812345,"sources":{"SSPI":811,"Wanted":0}}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "../include/access_log.h"
+
+#if defined(CLOCK_REALTIME_COARSE)
+#define WALL_CLOCK CLOCK_REALTIME_COARSE
+#elif defined(CLOCK_REALTIME_FAST)
+#define WALL_CLOCK CLOCK_REALTIME_FAST
+#else
+#define WALL_CLOCK CLOCK_REALTIME
+#endif
+
+#define RING_MASK (ACCESS_LOG_RING_SIZE - 1)
+
+_Static_assert((ACCESS_LOG_RING_SIZE & RING_MASK) == 0, "ACCESS_LOG_RING_SIZE must be a power of two");
+
+struct ring {
+    size_t head;
+    size_t tail;
+    struct ring *next;
+    struct access_log_entry slots[ACCESS_LOG_RING_SIZE];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t writer;
+    bool running;
+    bool stopping;
+    struct ring *rings;
+    FILE *fp;
+    char *path;
+    long max_bytes;
+    long bytes;
+    int keep;
+    unsigned long written;
+    unsigned long dropped;
+    unsigned long dropped_reported;
+    unsigned long rotations;
+    size_t threads;
+} logger = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+// 每个请求线程第一次写日志时分配自己的缓冲区，之后不再加锁
+static __thread struct ring *thread_ring = NULL;
+
+static void copy_field(char *dst, size_t len, const char *src) {
+    if (!src) src = "";
+
+    size_t n = strnlen(src, len - 1);
+
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+/**
+ * 请求开始：记录起始时间与请求信息（字符串会被截断复制）
+ */
+void access_log_begin(struct access_log_entry *e, const char *method, const char *path, const char *ip) {
+    clock_gettime(CLOCK_MONOTONIC, &e -> started);
+
+    copy_field(e -> method, sizeof(e -> method), method);
+    copy_field(e -> path, sizeof(e -> path), path);
+    copy_field(e -> ip, sizeof(e -> ip), ip);
+
+    e -> status = 0;
+    e -> n_timings = 0;
+}
+
+/**
+ * 追加一个数据源的耗时（超过 ACCESS_LOG_MAX_TIMINGS 个时忽略）
+ *
+ * @param source 数据源名称，必须是静态字符串
+ * @param ms 耗时（毫秒）
+ */
+void access_log_timing(struct access_log_entry *e, const char *source, long ms) {
+    if (e -> n_timings >= ACCESS_LOG_MAX_TIMINGS) return;
+
+    e -> timings[e -> n_timings].source = source;
+    e -> timings[e -> n_timings].ms = ms < 0 ? 0 : (uint32_t) ms;
+    e -> n_timings++;
+}
+
+static struct ring *get_ring(void) {
+    if (thread_ring) return thread_ring;
+
+    struct ring *r = calloc(1, sizeof(*r));
+
+    if (!r) return NULL;
+
+    pthread_mutex_lock(&logger.lock);
+
+    r -> next = logger.rings;
+    logger.rings = r;
+    logger.threads++;
+
+    pthread_mutex_unlock(&logger.lock);
+
+    thread_ring = r;
+
+    return r;
+}
+
+/**
+ * 请求结束：计算耗时并放入本线程的缓冲区
+ *
+ * @param e 记录
+ * @param status HTTP 状态码（未发送响应时为 0）
+ * @param completed 请求是否正常完成（false 表示客户端断开、超时等）
+ */
+void access_log_commit(struct access_log_entry *e, unsigned int status, bool completed) {
+    if (!__atomic_load_n(&logger.running, __ATOMIC_ACQUIRE)) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long us = (now.tv_sec - e -> started.tv_sec) * 1000000L + (now.tv_nsec - e -> started.tv_nsec) / 1000L;
+
+    e -> latency_us = us < 0 ? 0 : (uint32_t) us;
+    e -> status = status;
+    e -> completed = completed;
+
+    clock_gettime(WALL_CLOCK, &e -> wall);
+
+    struct ring *r = get_ring();
+
+    if (!r) {
+        __atomic_fetch_add(&logger.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    size_t head = __atomic_load_n(&r -> head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&r -> tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= ACCESS_LOG_RING_SIZE) {
+        __atomic_fetch_add(&logger.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    r -> slots[head & RING_MASK] = *e;
+
+    __atomic_store_n(&r -> head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void write_escaped(FILE *fp, const char *s) {
+    for (; *s; s++) {
+        unsigned char c = (unsigned char) *s;
+
+        if (c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+}
+
+/**
+ * 格式化一条记录；同一秒内的时间前缀只格式化一次
+ */
+static void write_entry(FILE *fp, const struct access_log_entry *e) {
+    static time_t cached_sec = -1;
+    static char cached_ts[32];
+
+    if (e -> wall.tv_sec != cached_sec) {
+        struct tm tm;
+
+        gmtime_r(&e -> wall.tv_sec, &tm);
+        strftime(cached_ts, sizeof(cached_ts), "%Y-%m-%dT%H:%M:%S", &tm);
+        cached_sec = e -> wall.tv_sec;
+    }
+
+    fprintf(fp, "{\"ts\":\"%s.%03ldZ\",\"method\":\"", cached_ts, e -> wall.tv_nsec / 1000000L);
+    write_escaped(fp, e -> method);
+    fputs("\",\"path\":\"", fp);
+    write_escaped(fp, e -> path);
+    fputs("\",\"ip\":\"", fp);
+    write_escaped(fp, e -> ip);
+    fprintf(fp, "\",\"status\":%u,\"latency_us\":%u", e -> status, e -> latency_us);
+
+    if (!e -> completed) fputs(",\"aborted\":true", fp);
+
+    if (e -> n_timings) {
+        fputs(",\"sources\":{", fp);
+
+        for (uint8_t i = 0; i < e -> n_timings; i++) {
+            fputs(i ? ",\"" : "\"", fp);
+            write_escaped(fp, e -> timings[i].source ? e -> timings[i].source : "?");
+            fprintf(fp, "\":%u", e -> timings[i].ms);
+        }
+
+        fputc('}', fp);
+    }
+
+    fputs("}\n", fp);
+}
+
+/**
+ * 当前文件写满后轮转：path → path.1 → path.2 …，最旧的被覆盖
+ */
+static void rotate(void) {
+    char from[1024], to[1024];
+
+    fclose(logger.fp);
+    logger.fp = NULL;
+
+    for (int i = logger.keep - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", logger.path, i);
+        snprintf(to, sizeof(to), "%s.%d", logger.path, i + 1);
+        rename(from, to);
+    }
+
+    if (logger.keep > 0) {
+        snprintf(to, sizeof(to), "%s.1", logger.path);
+        rename(logger.path, to);
+    }
+
+    logger.fp = fopen(logger.path, logger.keep > 0 ? "a" : "w");
+    logger.bytes = 0;
+    __atomic_fetch_add(&logger.rotations, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * 把所有线程缓冲区中的记录写入文件
+ */
+static void drain(void) {
+    pthread_mutex_lock(&logger.lock);
+    struct ring *rings = logger.rings;
+    pthread_mutex_unlock(&logger.lock);
+
+    for (struct ring *r = rings; r; r = r -> next) {
+        size_t tail = __atomic_load_n(&r -> tail, __ATOMIC_RELAXED);
+        size_t head = __atomic_load_n(&r -> head, __ATOMIC_ACQUIRE);
+
+        for (; tail != head; tail++) {
+            if (!logger.fp) continue;
+
+            long before = ftell(logger.fp);
+
+            write_entry(logger.fp, &r -> slots[tail & RING_MASK]);
+            __atomic_fetch_add(&logger.written, 1, __ATOMIC_RELAXED);
+
+            long after = ftell(logger.fp);
+
+            if (before >= 0 && after >= before) logger.bytes += after - before;
+
+            if (logger.max_bytes > 0 && logger.bytes >= logger.max_bytes) rotate();
+        }
+
+        __atomic_store_n(&r -> tail, tail, __ATOMIC_RELEASE);
+    }
+
+    unsigned long dropped = __atomic_load_n(&logger.dropped, __ATOMIC_RELAXED);
+
+    // 丢弃数有变化时写一条汇总记录，日志里能看出哪段时间不完整
+    if (logger.fp && dropped != logger.dropped_reported) {
+        fprintf(logger.fp, "{\"type\":\"dropped\",\"count\":%lu,\"total\":%lu}\n",
+            dropped - logger.dropped_reported, dropped);
+        logger.dropped_reported = dropped;
+    }
+
+    if (logger.fp) fflush(logger.fp);
+}
+
+static void *writer_main(void *arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&logger.lock);
+
+    while (!logger.stopping) {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+
+        deadline.tv_nsec += (ACCESS_LOG_FLUSH_MS % 1000) * 1000000L;
+        deadline.tv_sec += ACCESS_LOG_FLUSH_MS / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        pthread_cond_timedwait(&logger.cond, &logger.lock, &deadline);
+
+        pthread_mutex_unlock(&logger.lock);
+        drain();
+        pthread_mutex_lock(&logger.lock);
+    }
+
+    pthread_mutex_unlock(&logger.lock);
+
+    return NULL;
+}
+
+/**
+ * 启动访问日志
+ *
+ * @param path 日志文件路径，NULL 或空字符串表示关闭日志
+ * @param max_bytes 单个文件的大小上限，<= 0 表示不轮转
+ * @param keep 轮转时保留的历史文件数
+ * @return 0表示成功（或已关闭），-1表示文件无法打开或线程创建失败
+ */
+int access_log_start(const char *path, long max_bytes, int keep) {
+    if (!path || !path[0]) return 0;
+    if (logger.running) return 0;
+
+    logger.fp = fopen(path, "a");
+
+    if (!logger.fp) {
+        fprintf(stderr, "[ERR] 无法打开访问日志 %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fseek(logger.fp, 0, SEEK_END);
+
+    logger.path = strdup(path);
+    logger.max_bytes = max_bytes;
+    logger.bytes = ftell(logger.fp) > 0 ? ftell(logger.fp) : 0;
+    logger.keep = keep < 0 ? 0 : keep;
+    logger.stopping = false;
+
+    if (!logger.path || pthread_create(&logger.writer, NULL, writer_main, NULL) != 0) {
+        fclose(logger.fp);
+        free(logger.path);
+
+        logger.fp = NULL;
+        logger.path = NULL;
+
+        return -1;
+    }
+
+    __atomic_store_n(&logger.running, true, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * 停止访问日志：写完剩余记录后关闭文件（应在 HTTP 服务停止之后调用）
+ */
+void access_log_stop(void) {
+    if (!logger.running) return;
+
+    __atomic_store_n(&logger.running, false, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&logger.lock);
+    logger.stopping = true;
+    pthread_cond_signal(&logger.cond);
+    pthread_mutex_unlock(&logger.lock);
+
+    pthread_join(logger.writer, NULL);
+
+    drain();
+
+    if (logger.fp) fclose(logger.fp);
+
+    free(logger.path);
+
+    logger.fp = NULL;
+    logger.path = NULL;
+
+    // 缓冲区不释放：请求线程的 thread_ring 仍指向它们，重新 start 时可以继续使用
+}
+
+void access_log_get_stats(struct access_log_stats *out) {
+    if (!out) return;
+
+    pthread_mutex_lock(&logger.lock);
+    out -> threads = logger.threads;
+    pthread_mutex_unlock(&logger.lock);
+
+    out -> written = __atomic_load_n(&logger.written, __ATOMIC_RELAXED);
+    out -> rotations = __atomic_load_n(&logger.rotations, __ATOMIC_RELAXED);
+    out -> dropped = __atomic_load_n(&logger.dropped, __ATOMIC_RELAXED);
+}
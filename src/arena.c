@@ -0,0 +1,141 @@
+/**
+ * @file arena.c
+ * @brief 请求级内存池
+ *
+ * 一个请求里的小块分配（参数副本、格式化结果等）都从这里切，
+ * 请求结束时 arena_free 一次性归还，不需要逐个 free，也不会漏。
+ *
+ * 所有函数都接受 a == NULL，此时退化为普通的 malloc/strdup，
+ * 返回值由调用者 free —— 同一个函数因此既能服务 HTTP 请求，也能给没有请求上下文的调用方用。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "../include/arena.h"
+
+#define ARENA_ALIGN 16
+
+struct arena_block {
+    struct arena_block *next;
+    size_t cap;
+    size_t used;
+    _Alignas(ARENA_ALIGN) char data[];
+};
+
+/**
+ * 初始化内存池（零初始化的 struct arena 同样可用）
+ *
+ * @param a 内存池
+ * @param block_size 每块大小，0 表示使用 ARENA_BLOCK_SIZE
+ */
+void arena_init(struct arena *a, size_t block_size) {
+    a -> head = NULL;
+    a -> block_size = block_size;
+}
+
+/**
+ * 从内存池分配 size 字节（按 16 字节对齐，内容未初始化）
+ *
+ * @param a 内存池，NULL 时等同于 malloc
+ * @param size 字节数
+ * @return 分配到的内存，失败返回 NULL
+ */
+void *arena_alloc(struct arena *a, size_t size) {
+    if (!a) return malloc(size ? size : 1);
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    struct arena_block *b = a -> head;
+
+    if (!b || b -> cap - b -> used < size) {
+        size_t block = a -> block_size ? a -> block_size : ARENA_BLOCK_SIZE;
+        size_t cap = size > block ? size : block;
+
+        b = malloc(sizeof(*b) + cap);
+
+        if (!b) return NULL;
+
+        b -> cap = cap;
+        b -> used = 0;
+
+        // 独占块挂在当前块后面，当前块剩余的空间还能继续用
+        if (cap > block && a -> head) {
+            b -> next = a -> head -> next;
+            a -> head -> next = b;
+        } else {
+            b -> next = a -> head;
+            a -> head = b;
+        }
+    }
+
+    void *p = b -> data + b -> used;
+    b -> used += size;
+
+    return p;
+}
+
+/**
+ * 复制字符串到内存池
+ *
+ * @param a 内存池，NULL 时等同于 strdup
+ * @param s 源字符串
+ * @return 副本，s 为 NULL 或内存不足时返回 NULL
+ */
+char *arena_strdup(struct arena *a, const char *s) {
+    if (!s) return NULL;
+
+    size_t len = strlen(s);
+    char *p = arena_alloc(a, len + 1);
+
+    if (p) memcpy(p, s, len + 1);
+
+    return p;
+}
+
+/**
+ * 在内存池中格式化字符串
+ *
+ * @param a 内存池，NULL 时结果由调用者 free
+ * @return 格式化结果，失败返回 NULL
+ */
+char *arena_sprintf(struct arena *a, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) return NULL;
+
+    char *p = arena_alloc(a, (size_t) n + 1);
+
+    if (!p) return NULL;
+
+    va_start(ap, fmt);
+    vsnprintf(p, (size_t) n + 1, fmt, ap);
+    va_end(ap);
+
+    return p;
+}
+
+/**
+ * 释放内存池中的全部内存，之后仍可继续分配
+ */
+void arena_free(struct arena *a) {
+    if (!a) return;
+
+    struct arena_block *b = a -> head;
+
+    while (b) {
+        struct arena_block *next = b -> next;
+
+        free(b);
+        b = next;
+    }
+
+    a -> head = NULL;
+}
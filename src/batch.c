@@ -0,0 +1,568 @@
+/**
+ * @file batch.c
+ * @brief 批量查询：一次 POST 提交多个号码/身份证/姓名，结果以 NDJSON 流式返回
+ *
+ * 请求体可以是 NDJSON（每行一个对象）、JSON 数组，或 {"queries": [...]}，
+ * 每个查询对象包含 q、id、name 之一。查询交给上游事件循环并发执行（同时在途的不超过并发上限），
+ * 哪个先完成哪个先写回客户端，每行带 index 以便调用方对应回原始顺序。
+ * 没有结果可发时读取函数挂起连接，由查询完成回调恢复，不占用任何线程。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <microhttpd.h>
+#include <cjson/cJSON.h>
+
+#include "../include/batch.h"
+#include "../include/memory.h"
+#include "../include/pdrm.h"
+#include "../include/sspi.h"
+#include "../include/mykad.h"
+#include "../include/rmp_wanted.h"
+#include "../include/sprm.h"
+#include "../include/ecourt.h"
+#include "../include/upstream.h"
+#include "../include/stream_buffer.h"
+
+enum batch_kind {
+    BATCH_INVALID,
+    BATCH_Q,
+    BATCH_ID,
+    BATCH_NAME
+};
+
+struct batch_item {
+    enum batch_kind kind;
+    char *query;
+};
+
+/**
+ * 引用计数：MHD 响应持有一份，每个在途的查询各持有一份
+ */
+struct batch_job {
+    pthread_mutex_t lock;
+
+    struct batch_item *items;
+    size_t count;
+    size_t next;
+    size_t remaining;
+    size_t inflight;
+    size_t max_concurrency;
+    size_t refs;
+    bool cancelled;
+
+    struct stream_buffer out;
+};
+
+/**
+ * 一个在途查询：完成回调据此找回任务和位置
+ */
+struct batch_run {
+    struct batch_job *job;
+    size_t index;
+    struct timespec started;
+};
+
+static const char *kind_name(enum batch_kind kind) {
+    switch (kind) {
+        case BATCH_Q: return "q";
+        case BATCH_ID: return "id";
+        case BATCH_NAME: return "name";
+        default: return "invalid";
+    }
+}
+
+static long elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start -> tv_sec) * 1000L + (now.tv_nsec - start -> tv_nsec) / 1000000L;
+}
+
+/**
+ * 把一个查询对象加入任务列表；无法识别的对象也占一个位置，执行时输出错误行
+ */
+static int add_item(struct batch_job *job, size_t *cap, const cJSON *obj) {
+    if (job -> count >= BATCH_MAX_ITEMS) return -1;
+
+    if (job -> count == *cap) {
+        size_t ncap = *cap ? *cap * 2 : 64;
+        struct batch_item *items = realloc(job -> items, ncap * sizeof(*items));
+
+        if (!items) return -1;
+
+        job -> items = items;
+        *cap = ncap;
+    }
+
+    struct batch_item *item = &job -> items[job -> count++];
+    static const struct { const char *key; enum batch_kind kind; } keys[] = {
+        { "q", BATCH_Q }, { "id", BATCH_ID }, { "name", BATCH_NAME }
+    };
+
+    item -> kind = BATCH_INVALID;
+    item -> query = NULL;
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        const cJSON *v = cJSON_GetObjectItemCaseSensitive(obj, keys[i].key);
+
+        if (!cJSON_IsString(v) || !v -> valuestring[0]) continue;
+
+        item -> kind = keys[i].kind;
+        item -> query = strdup(v -> valuestring);
+
+        if (!item -> query) return -1;
+
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * 展开一个顶层 JSON 值：数组逐个展开，带 queries 的对象展开其数组，其余对象视为单个查询
+ */
+static int add_value(struct batch_job *job, size_t *cap, const cJSON *value) {
+    const cJSON *list = value;
+
+    if (cJSON_IsObject(value)) {
+        const cJSON *queries = cJSON_GetObjectItemCaseSensitive(value, "queries");
+
+        if (!cJSON_IsArray(queries)) return add_item(job, cap, value);
+
+        list = queries;
+    }
+
+    if (!cJSON_IsArray(list)) return add_item(job, cap, value);
+
+    const cJSON *el;
+
+    cJSON_ArrayForEach(el, list) {
+        if (add_item(job, cap, el) != 0) return -1;
+    }
+
+    return 0;
+}
+
+static void job_destroy(struct batch_job *job) {
+    for (size_t i = 0; i < job -> count; i++) free(job -> items[i].query);
+
+    free(job -> items);
+    stream_buffer_release(&job -> out);
+
+    pthread_mutex_destroy(&job -> lock);
+
+    free(job);
+}
+
+static void job_unref(struct batch_job *job) {
+    pthread_mutex_lock(&job -> lock);
+    bool last = --job -> refs == 0;
+    pthread_mutex_unlock(&job -> lock);
+
+    if (last) job_destroy(job);
+}
+
+static void batch_pump(struct batch_job *job);
+
+// 当前线程正在为哪个任务执行 batch_pump：同一任务里同步完成的查询（如缓存命中）不再递归开始下一个，由外层循环接着领取
+static __thread struct batch_job *pumping = NULL;
+
+/**
+ * 输出一个查询的结果行，并补上下一个查询
+ *
+ * @param run 查询（由这里释放）
+ * @param result 查询结果（由这里接管），NULL 表示失败
+ * @param error 失败原因
+ */
+static void finish_item(struct batch_run *run, cJSON *result, const char *error) {
+    struct batch_job *job = run -> job;
+    const struct batch_item *item = &job -> items[run -> index];
+    cJSON *line = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(line, "index", (double) run -> index);
+    cJSON_AddStringToObject(line, "type", kind_name(item -> kind));
+
+    if (item -> query) cJSON_AddStringToObject(line, "query", item -> query);
+
+    cJSON_AddBoolToObject(line, "ok", result != NULL);
+    cJSON_AddNumberToObject(line, "elapsed_ms", (double) elapsed_ms(&run -> started));
+
+    if (result) cJSON_AddItemToObject(line, "result", result);
+    else cJSON_AddStringToObject(line, "error", error ? error : "unknown error");
+
+    char *text = cJSON_PrintUnformatted(line);
+    size_t len = text ? strlen(text) : 0;
+
+    cJSON_Delete(line);
+
+    pthread_mutex_lock(&job -> lock);
+
+    if (text && memory_reserve(&job -> out.data, job -> out.data.size + len + 2) == 0) {
+        memory_append(&job -> out.data, text, len);
+        memory_append(&job -> out.data, "\n", 1);
+    }
+
+    job -> inflight--;
+    job -> remaining--;
+
+    stream_buffer_wake(&job -> out);
+
+    pthread_mutex_unlock(&job -> lock);
+
+    free(text);
+    free(run);
+
+    batch_pump(job);
+    job_unref(job);
+}
+
+static cJSON *q_result(const struct pdrm_mule_result *res, bool cached) {
+    cJSON *out = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(out, "count", res -> count);
+    cJSON_AddNumberToObject(out, "reported", res -> reported);
+    cJSON_AddBoolToObject(out, "cached", cached);
+
+    return out;
+}
+
+static void q_done(int status, struct semak_mule_response *resp, void *userdata) {
+    struct batch_run *run = (struct batch_run *) userdata;
+    struct pdrm_mule_result res;
+
+    if (status != 0) {
+        pdrm_semak_mule_response_free(resp);
+        finish_item(run, NULL, "upstream request failed");
+        return;
+    }
+
+    int rc = pdrm_parse_mule_result(resp, &res);
+
+    pdrm_semak_mule_response_free(resp);
+
+    if (rc != 0) {
+        finish_item(run, NULL, "invalid upstream response");
+        return;
+    }
+
+    char key[64];
+
+    pdrm_mule_normalise(run -> job -> items[run -> index].query, key, sizeof(key));
+    pdrm_mule_cache_put(key, &res);
+
+    cJSON *out = q_result(&res, false);
+
+    pdrm_mule_result_free(&res);
+
+    finish_item(run, out, NULL);
+}
+
+/**
+ * 号码查询：缓存命中直接出结果，否则提交异步查询
+ */
+static void start_q(struct batch_run *run, const char *query) {
+    char key[64];
+    char payload[512];
+    struct pdrm_mule_result res;
+
+    pdrm_mule_normalise(query, key, sizeof(key));
+
+    if (pdrm_mule_cache_get(key, &res)) {
+        cJSON *out = q_result(&res, true);
+
+        pdrm_mule_result_free(&res);
+        finish_item(run, out, NULL);
+
+        return;
+    }
+
+    if (pdrm_mule_build_payload(key[0] ? key : query, payload, sizeof(payload)) != 0 ||
+        pdrm_semak_mule_async(upstream_url("MO_SEMAKMULE_URL", PDRM_MULE_URL), payload, q_done, run) != 0) {
+        finish_item(run, NULL, "upstream request failed");
+    }
+}
+
+/**
+ * 身份证查询：SSPI 走上游，通缉名单、SPRM 和 MyKad 都是本地查找，在完成回调里一并做掉
+ */
+static void id_done(int status, struct sspi_response *sspi, void *userdata) {
+    struct batch_run *run = (struct batch_run *) userdata;
+    const char *query = run -> job -> items[run -> index].query;
+    cJSON *out = cJSON_CreateObject();
+
+    if (status == 0 && sspi -> status) {
+        cJSON_AddStringToObject(out, "sspi", strstr(sspi -> status, "Tiada halangan") ? "Tiada Halangan" : "Halangan");
+    } else {
+        cJSON_AddNullToObject(out, "sspi");
+    }
+
+    sspi_response_free(sspi);
+
+    WantedPerson wp;
+    int hit = rmp_wanted_lookup(query, &wp);
+
+    if (hit < 0) {
+        cJSON_AddNullToObject(out, "wanted");
+    } else if (hit == 0) {
+        cJSON_AddBoolToObject(out, "wanted", false);
+    } else {
+        cJSON *w = cJSON_CreateObject();
+
+        cJSON_AddStringToObject(w, "name", wp.name);
+        cJSON_AddStringToObject(w, "age", wp.age);
+        cJSON_AddStringToObject(w, "photo", wp.photo_url);
+        cJSON_AddItemToObject(out, "wanted", w);
+    }
+
+    PesalahList found;
+    int hits = sprm_index_search(query, &found);
+
+    if (hits < 0) {
+        cJSON_AddNullToObject(out, "sprm");
+    } else {
+        cJSON_AddNumberToObject(out, "sprm", hits);
+        sprm_free_list(&found);
+    }
+
+    char *mykad = mykad_check(query, NULL);
+    cJSON *info = mykad ? cJSON_Parse(mykad) : NULL;
+
+    if (info) cJSON_AddItemToObject(out, "mykad", info);
+    else cJSON_AddNullToObject(out, "mykad");
+
+    free(mykad);
+
+    finish_item(run, out, NULL);
+}
+
+static void name_done(EJudgmentResponse *resp, void *userdata) {
+    struct batch_run *run = (struct batch_run *) userdata;
+
+    if (!resp || !resp -> raw_json) {
+        ejudgment_response_free(resp);
+        finish_item(run, NULL, "upstream request failed");
+        return;
+    }
+
+    cJSON *parsed = cJSON_Parse(resp -> raw_json);
+
+    ejudgment_response_free(resp);
+
+    if (!parsed) {
+        finish_item(run, NULL, "invalid upstream response");
+        return;
+    }
+
+    finish_item(run, parsed, NULL);
+}
+
+/**
+ * 开始执行一个查询；结果总是经由 finish_item 输出（可能在这里直接输出）
+ */
+static void start_item(struct batch_run *run) {
+    const struct batch_item *item = &run -> job -> items[run -> index];
+
+    clock_gettime(CLOCK_MONOTONIC, &run -> started);
+
+    switch (item -> kind) {
+        case BATCH_Q:
+            start_q(run, item -> query);
+            break;
+
+        case BATCH_ID:
+            if (sspi_check_async(item -> query, 0, id_done, run) != 0) {
+                struct sspi_response none = {0};
+
+                id_done(-1, &none, run);
+            }
+            break;
+
+        case BATCH_NAME: {
+            const EJudgmentQuery q = {
+                item -> query, "ALL", "", "", "", "", NULL, NULL, NULL, NULL, 1, "DATE_OF_AP_DESC"
+            };
+
+            if (ejudgment_search_async(&q, 3, 3000, name_done, run) != 0) finish_item(run, NULL, "upstream request failed");
+            break;
+        }
+
+        default:
+            finish_item(run, NULL, "expected an object with one of q, id, name");
+            break;
+    }
+}
+
+/**
+ * 在并发上限内开始后续查询，直到全部开始或客户端断开
+ *
+ * 提交时不持有任务锁：合并进来的查询可能在提交失败时被同步回调。
+ */
+static void batch_pump(struct batch_job *job) {
+    struct batch_job *outer = pumping;
+
+    if (outer == job) return;
+
+    pumping = job;
+
+    for (;;) {
+        pthread_mutex_lock(&job -> lock);
+
+        if (job -> cancelled || job -> next >= job -> count || job -> inflight >= job -> max_concurrency) {
+            pthread_mutex_unlock(&job -> lock);
+            break;
+        }
+
+        size_t index = job -> next++;
+
+        job -> inflight++;
+        job -> refs++;
+
+        pthread_mutex_unlock(&job -> lock);
+
+        struct batch_run *run = calloc(1, sizeof(*run));
+
+        // 这一项也要有一行结果，输出才能和输入一一对应；不经 cJSON，避免再次分配
+        if (!run) {
+            char line[128];
+            int n = snprintf(line, sizeof(line), "{\"index\":%zu,\"type\":\"%s\",\"ok\":false,\"error\":\"out of memory\"}\n",
+                index, kind_name(job -> items[index].kind));
+
+            pthread_mutex_lock(&job -> lock);
+
+            if (memory_reserve(&job -> out.data, job -> out.data.size + (size_t) n + 1) == 0) {
+                memory_append(&job -> out.data, line, (size_t) n);
+            }
+
+            job -> inflight--;
+            job -> remaining--;
+            job -> refs--;
+            stream_buffer_wake(&job -> out);
+            pthread_mutex_unlock(&job -> lock);
+            continue;
+        }
+
+        run -> job = job;
+        run -> index = index;
+
+        start_item(run);
+    }
+
+    pumping = outer;
+}
+
+/**
+ * 解析请求体并开始执行查询
+ *
+ * @param body 请求体
+ * @param len 请求体长度
+ * @param connection 结果要写回的连接，没有结果可发时读取函数会挂起它
+ * @param max_concurrency 同时执行的查询数，0 或超过 BATCH_MAX_CONCURRENCY 时取 BATCH_MAX_CONCURRENCY
+ * @param err 失败时输出原因
+ * @param err_len err 缓冲区大小
+ * @return 任务句柄（交给 MHD 回调响应，由 batch_job_free 释放），失败返回 NULL
+ */
+struct batch_job *batch_job_new(const char *body, size_t len, struct MHD_Connection *connection, size_t max_concurrency, char *err, size_t err_len) {
+    if (!body || len == 0) {
+        snprintf(err, err_len, "empty request body");
+        return NULL;
+    }
+
+    struct batch_job *job = calloc(1, sizeof(*job));
+
+    if (!job) {
+        snprintf(err, err_len, "out of memory");
+        return NULL;
+    }
+
+    pthread_mutex_init(&job -> lock, NULL);
+
+    // 逐个解析顶层 JSON 值，NDJSON 与单个数组/对象走同一条路径
+    size_t cap = 0;
+    const char *p = body;
+    const char *end = body + len;
+
+    for (;;) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+
+        if (p >= end) break;
+
+        const char *parse_end = NULL;
+        cJSON *value = cJSON_ParseWithOpts(p, &parse_end, 0);
+
+        if (!value) {
+            snprintf(err, err_len, "invalid JSON at byte %zu", (size_t) (p - body));
+            job_destroy(job);
+            return NULL;
+        }
+
+        int rc = add_value(job, &cap, value);
+
+        cJSON_Delete(value);
+
+        if (rc != 0) {
+            snprintf(err, err_len, "too many queries (max %d)", BATCH_MAX_ITEMS);
+            job_destroy(job);
+            return NULL;
+        }
+
+        p = parse_end;
+    }
+
+    if (job -> count == 0) {
+        snprintf(err, err_len, "no queries in request body");
+        job_destroy(job);
+        return NULL;
+    }
+
+    if (max_concurrency == 0 || max_concurrency > BATCH_MAX_CONCURRENCY) max_concurrency = BATCH_MAX_CONCURRENCY;
+    if (max_concurrency > job -> count) max_concurrency = job -> count;
+
+    job -> remaining = job -> count;
+    job -> max_concurrency = max_concurrency;
+    job -> refs = 1;
+
+    stream_buffer_attach(&job -> out, connection);
+
+    // 调用方的引用在返回前一直有效，开头几个查询即使同步完成也不会提前释放任务
+    batch_pump(job);
+
+    return job;
+}
+
+/**
+ * MHD 回调响应的读取函数：有完成的结果就立即发出，否则挂起连接等下一条
+ */
+ssize_t batch_send_chunk(void *cls, uint64_t pos, char *buf, size_t max) {
+    struct batch_job *job = (struct batch_job *) cls;
+
+    (void) pos;
+
+    pthread_mutex_lock(&job -> lock);
+
+    ssize_t n = stream_buffer_read(&job -> out, job -> remaining == 0, buf, max);
+
+    pthread_mutex_unlock(&job -> lock);
+
+    return n;
+}
+
+/**
+ * MHD 响应释放回调：不再开始新的查询，在途的查询结束后由最后一个持有者释放任务
+ */
+void batch_job_free(void *cls) {
+    struct batch_job *job = (struct batch_job *) cls;
+
+    if (!job) return;
+
+    pthread_mutex_lock(&job -> lock);
+    job -> cancelled = true;
+    stream_buffer_detach(&job -> out);
+    pthread_mutex_unlock(&job -> lock);
+
+    job_unref(job);
+}
@@ -0,0 +1,704 @@
+/**
+ * @file bulk.c
+ * @brief 离线批量解码（mo bulk）
+ *
+ * MyKad 解码和 SSM 格式化都不需要访问网络，逐个走 HTTP 接口完全是浪费。
+ * 这里把按行分隔的输入文件整个 mmap 进来，按约 BULK_SEGMENT_BYTES 切成段（段边界对齐到换行），
+ * 工作线程按顺序领取段、解码、把结果格式化进本段自己的输出缓冲；
+ * 主线程按段的顺序把已完成的缓冲直接组成 iovec 交给 writev，不再拼接复制，输出顺序与输入一致。
+ *
+ * 每个线程最多领先写出位置 BULK_WINDOW_PER_THREAD 段，输出再大内存占用也是有界的。
+ * 格式化不用 printf，数字和字段都直接写进缓冲区。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "../include/bulk.h"
+#include "../include/memory.h"
+#include "../include/mykad.h"
+#include "../include/ssm.h"
+
+// 单次 writev 最多合并的段数
+#define BULK_IOV_MAX 64
+
+struct bulk_segment {
+    const char *begin;
+    const char *end;
+    struct memory out;
+    size_t lines;
+    size_t valid;
+    size_t dropped;
+    bool done;
+};
+
+struct bulk_job {
+    const struct bulk_config *cfg;
+    struct bulk_segment *segs;
+    size_t nsegs;
+    size_t next;
+    size_t written;
+    size_t window;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static char *put(char *p, const char *s, size_t n) {
+    memcpy(p, s, n);
+    return p + n;
+}
+
+#define PUT_LIT(p, lit) put((p), (lit), sizeof(lit) - 1)
+
+static char *put_str(char *p, const char *s) {
+    return put(p, s, strlen(s));
+}
+
+static char *put_digits(char *p, unsigned int v, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        p[i] = (char) ('0' + v % 10);
+        v /= 10;
+    }
+
+    return p + width;
+}
+
+/**
+ * 写一个带引号的 JSON 字符串，最多占 6 * n + 2 字节
+ */
+static char *put_json_string(char *p, const char *s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+
+    *p++ = '"';
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char) c;
+        } else if (c < 0x20) {
+            p = PUT_LIT(p, "\\u00");
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 15];
+        } else {
+            *p++ = (char) c;
+        }
+    }
+
+    *p++ = '"';
+
+    return p;
+}
+
+/**
+ * 写一个 CSV 字段，含逗号、引号或换行时加引号并把引号加倍，最多占 2 * n + 2 字节
+ */
+static char *put_csv_field(char *p, const char *s, size_t n) {
+    if (!memchr(s, ',', n) && !memchr(s, '"', n) && !memchr(s, '\n', n)) return put(p, s, n);
+
+    *p++ = '"';
+
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '"') *p++ = '"';
+        *p++ = s[i];
+    }
+
+    *p++ = '"';
+
+    return p;
+}
+
+static char *put_date(char *p, uint32_t yyyymmdd) {
+    p = put_digits(p, yyyymmdd / 10000, 4);
+    *p++ = '-';
+    p = put_digits(p, yyyymmdd / 100 % 100, 2);
+    *p++ = '-';
+
+    return put_digits(p, yyyymmdd % 100, 2);
+}
+
+/**
+ * 取下一行并去掉首尾空白和 '\r'
+ *
+ * @return 下一行的起点
+ */
+static const char *next_line(const char *p, const char *end, const char **line, size_t *len) {
+    const char *nl = memchr(p, '\n', (size_t) (end - p));
+    const char *stop = nl ? nl : end;
+    const char *s = p;
+
+    while (s < stop && (*s == ' ' || *s == '\t')) s++;
+    while (stop > s && (stop[-1] == '\r' || stop[-1] == ' ' || stop[-1] == '\t')) stop--;
+
+    *line = s;
+    *len = (size_t) (stop - s);
+
+    return nl ? nl + 1 : end;
+}
+
+/**
+ * 按格式输出第 i 个身份证号码的解码结果
+ *
+ * @return 0表示已写出，-1表示缓冲区扩容失败、这一行被丢弃
+ */
+static int format_ic(struct memory *out, enum bulk_format format, const char *raw, size_t len, const struct mykad_batch *b, size_t i) {
+    if (memory_reserve(out, out -> size + 384 + 6 * len) != 0) return -1;
+
+    char *p = out -> data + out -> size;
+    uint8_t flags = b -> flags[i];
+    const struct mykad_place *pl = mykad_place(b -> place[i]);
+    const char *gender = b -> gender[i] == MYKAD_GENDER_MALE ? "male" : "female";
+    const char *kind = pl -> kind == MYKAD_PLACE_STATE ? "state" :
+        pl -> kind == MYKAD_PLACE_COUNTRY ? "country" :
+        pl -> kind == MYKAD_PLACE_REGION ? "region" : "unknown";
+
+    if (format == BULK_CSV) {
+        p = put_csv_field(p, raw, len);
+
+        if (!(flags & MYKAD_DIGITS_OK)) {
+            p = PUT_LIT(p, ",false,,,,,,\n");
+        } else {
+            p = flags == MYKAD_VALID ? PUT_LIT(p, ",true,") : PUT_LIT(p, ",false,");
+
+            if (flags & MYKAD_DATE_OK) p = put_date(p, b -> birth[i]);
+
+            *p++ = ',';
+            p = put_digits(p, b -> place[i], 2);
+            *p++ = ',';
+            if (pl -> name) p = put_str(p, pl -> name);
+            *p++ = ',';
+            p = put_str(p, kind);
+            *p++ = ',';
+            p = put_str(p, gender);
+            *p++ = ',';
+            p = put_digits(p, b -> serial[i], 4);
+            *p++ = '\n';
+        }
+    } else {
+        p = PUT_LIT(p, "{\"ic\":");
+        p = put_json_string(p, raw, len);
+
+        if (!(flags & MYKAD_DIGITS_OK)) {
+            p = PUT_LIT(p, ",\"valid\":false,\"error\":\"Invalid IC number\"}\n");
+        } else {
+            p = flags == MYKAD_VALID ? PUT_LIT(p, ",\"valid\":true,\"birth\":") : PUT_LIT(p, ",\"valid\":false,\"birth\":");
+
+            if (flags & MYKAD_DATE_OK) {
+                *p++ = '"';
+                p = put_date(p, b -> birth[i]);
+                *p++ = '"';
+            } else {
+                p = PUT_LIT(p, "null");
+            }
+
+            p = PUT_LIT(p, ",\"place_code\":\"");
+            p = put_digits(p, b -> place[i], 2);
+            p = PUT_LIT(p, "\",\"place\":");
+
+            if (pl -> name) {
+                *p++ = '"';
+                p = put_str(p, pl -> name);
+                *p++ = '"';
+            } else {
+                p = PUT_LIT(p, "null");
+            }
+
+            p = PUT_LIT(p, ",\"place_type\":\"");
+            p = put_str(p, kind);
+            p = PUT_LIT(p, "\",\"gender\":\"");
+            p = put_str(p, gender);
+            p = PUT_LIT(p, "\",\"serial\":\"");
+            p = put_digits(p, b -> serial[i], 4);
+            p = PUT_LIT(p, "\"}\n");
+        }
+    }
+
+    out -> size = (size_t) (p - out -> data);
+
+    return 0;
+}
+
+/**
+ * 按格式输出一个 SSM 号码的解码结果
+ *
+ * @return 1表示号码有效，0表示无效，-1表示缓冲区扩容失败、这一行被丢弃
+ */
+static int format_ssm(struct memory *out, enum bulk_format format, const char *raw, size_t len) {
+    struct ssm_info info;
+    bool ok = ssm_decode(raw, len, &info);
+
+    if (memory_reserve(out, out -> size + 256 + 6 * len) != 0) return -1;
+
+    char *p = out -> data + out -> size;
+    const char *entity = ok ? ssm_entity_name(info.entity) : NULL;
+
+    if (!entity) entity = "Unknown Entity";
+
+    if (format == BULK_CSV) {
+        p = put_csv_field(p, raw, len);
+
+        if (!ok) {
+            p = PUT_LIT(p, ",false,,,,\n");
+        } else {
+            p = PUT_LIT(p, ",true,");
+            p = put(p, info.digits, 12);
+            *p++ = ',';
+            p = put_digits(p, info.year, 4);
+            *p++ = ',';
+            p = put_digits(p, info.entity, 2);
+            *p++ = ',';
+            p = put_str(p, entity);
+            *p++ = '\n';
+        }
+    } else {
+        p = PUT_LIT(p, "{\"ssm\":");
+        p = put_json_string(p, raw, len);
+
+        if (!ok) {
+            p = PUT_LIT(p, ",\"valid\":false,\"error\":\"Invalid SSM number\"}\n");
+        } else {
+            p = PUT_LIT(p, ",\"valid\":true,\"formatted\":\"");
+            p = put(p, info.digits, 12);
+            p = PUT_LIT(p, "\",\"year\":");
+            p = put_digits(p, info.year, 4);
+            p = PUT_LIT(p, ",\"entity_code\":\"");
+            p = put_digits(p, info.entity, 2);
+            p = PUT_LIT(p, "\",\"entity\":\"");
+            p = put_str(p, entity);
+            p = PUT_LIT(p, "\"}\n");
+        }
+    }
+
+    out -> size = (size_t) (p - out -> data);
+
+    return ok ? 1 : 0;
+}
+
+/**
+ * 解码一段身份证号码：每攒够 BULK_BLOCK_LINES 行交给 mykad_decode_batch 一次
+ */
+static void process_ic(const struct bulk_config *cfg, struct bulk_segment *seg) {
+    char slots[BULK_BLOCK_LINES][16];
+    const char *ptrs[BULK_BLOCK_LINES];
+    const char *raw[BULK_BLOCK_LINES];
+    size_t raw_len[BULK_BLOCK_LINES];
+
+    uint32_t birth[BULK_BLOCK_LINES];
+    uint16_t serial[BULK_BLOCK_LINES];
+    uint8_t place[BULK_BLOCK_LINES];
+    uint8_t gender[BULK_BLOCK_LINES];
+    uint8_t flags[BULK_BLOCK_LINES];
+    struct mykad_batch batch = { BULK_BLOCK_LINES, birth, serial, place, gender, flags };
+
+    const char *p = seg -> begin;
+
+    while (p < seg -> end) {
+        size_t n = 0;
+
+        while (n < BULK_BLOCK_LINES && p < seg -> end) {
+            const char *line;
+            size_t len;
+
+            p = next_line(p, seg -> end, &line, &len);
+
+            if (len == 0) continue;
+
+            // mmap 里的行不以 '\0' 结尾，复制进 16 字节的槽；超长的行截到 15 字节，解码时按长度拒绝
+            size_t c = len < 15 ? len : 15;
+
+            memcpy(slots[n], line, c);
+            slots[n][c] = '\0';
+
+            ptrs[n] = slots[n];
+            raw[n] = line;
+            raw_len[n] = len;
+            n++;
+        }
+
+        seg -> valid += mykad_decode_batch(ptrs, n, 0, &batch);
+        seg -> lines += n;
+
+        for (size_t i = 0; i < n; i++) {
+            if (format_ic(&seg -> out, cfg -> format, raw[i], raw_len[i], &batch, i) != 0) seg -> dropped++;
+        }
+    }
+}
+
+static void process_ssm(const struct bulk_config *cfg, struct bulk_segment *seg) {
+    const char *p = seg -> begin;
+
+    while (p < seg -> end) {
+        const char *line;
+        size_t len;
+
+        p = next_line(p, seg -> end, &line, &len);
+
+        if (len == 0) continue;
+
+        int rc = format_ssm(&seg -> out, cfg -> format, line, len);
+
+        if (rc < 0) seg -> dropped++;
+        else seg -> valid += (size_t) rc;
+
+        seg -> lines++;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct bulk_job *job = (struct bulk_job *) arg;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&job -> next, 1, __ATOMIC_RELAXED);
+
+        if (i >= job -> nsegs) break;
+
+        // 领先写出位置太多就等一等，避免输出缓冲无限增长
+        pthread_mutex_lock(&job -> lock);
+        while (i >= job -> written + job -> window) pthread_cond_wait(&job -> cond, &job -> lock);
+        pthread_mutex_unlock(&job -> lock);
+
+        struct bulk_segment *seg = &job -> segs[i];
+
+        // 预留和输入差不多大的输出，大多数段不需要再扩容
+        memory_reserve(&seg -> out, (size_t) (seg -> end - seg -> begin) * (job -> cfg -> format == BULK_CSV ? 4 : 10) + 1);
+
+        if (job -> cfg -> kind == BULK_IC) process_ic(job -> cfg, seg);
+        else process_ssm(job -> cfg, seg);
+
+        pthread_mutex_lock(&job -> lock);
+        seg -> done = true;
+        pthread_cond_broadcast(&job -> cond);
+        pthread_mutex_unlock(&job -> lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * writev 直到全部写完
+ *
+ * @return 0表示成功，-1表示写入失败
+ */
+static int write_all(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        while (cnt > 0 && (size_t) n >= iov -> iov_len) {
+            n -= (ssize_t) iov -> iov_len;
+            iov++;
+            cnt--;
+        }
+
+        if (cnt > 0) {
+            iov -> iov_base = (char *) iov -> iov_base + n;
+            iov -> iov_len -= (size_t) n;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * 在换行处切段
+ *
+ * @return 段数组（调用者负责 free），失败返回 NULL
+ */
+static struct bulk_segment *split_segments(const char *data, size_t size, size_t *count) {
+    size_t cap = size / BULK_SEGMENT_BYTES + 1;
+    struct bulk_segment *segs = calloc(cap, sizeof(*segs));
+    size_t n = 0;
+    const char *p = data;
+    const char *end = data + size;
+
+    if (!segs) return NULL;
+
+    while (p < end && n < cap) {
+        const char *stop = (size_t) (end - p) > BULK_SEGMENT_BYTES ? p + BULK_SEGMENT_BYTES : end;
+
+        if (stop < end) {
+            const char *nl = memchr(stop, '\n', (size_t) (end - stop));
+            stop = nl ? nl + 1 : end;
+        }
+
+        // 最后一段吃掉剩余的全部输入
+        if (n == cap - 1) stop = end;
+
+        segs[n].begin = p;
+        segs[n].end = stop;
+        n++;
+
+        p = stop;
+    }
+
+    *count = n;
+
+    return segs;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * 执行一次批量解码
+ *
+ * @param cfg 参数，cfg -> output 为 NULL 时写到标准输出
+ * @param stats 输出的统计，可为 NULL
+ * @return 0表示成功，-1表示输入无法读取或输出写入失败
+ */
+int bulk_run(const struct bulk_config *cfg, struct bulk_stats *stats) {
+    double started = now_seconds();
+    int fd = open(cfg -> input, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "[bulk] 无法打开 %s: %s\n", cfg -> input, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    const char *data = NULL;
+
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "[bulk] 无法映射 %s: %s\n", cfg -> input, strerror(errno));
+            close(fd);
+            return -1;
+        }
+
+        // MADV_* 是枚举值而不是位标志，两个建议要分开给
+        madvise((void *) data, size, MADV_SEQUENTIAL);
+        madvise((void *) data, size, MADV_WILLNEED);
+    }
+
+    close(fd);
+
+    int out_fd = STDOUT_FILENO;
+
+    if (cfg -> output && (out_fd = open(cfg -> output, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "[bulk] 无法写入 %s: %s\n", cfg -> output, strerror(errno));
+        if (data) munmap((void *) data, size);
+        return -1;
+    }
+
+    struct bulk_job job = { .cfg = cfg };
+    int rc = 0;
+    size_t bytes_out = 0;
+
+    job.segs = data ? split_segments(data, size, &job.nsegs) : NULL;
+
+    if (data && !job.segs) rc = -1;
+
+    if (rc == 0 && cfg -> format == BULK_CSV) {
+        static const char ic_header[] = "ic,valid,birth,place_code,place,place_type,gender,serial\n";
+        static const char ssm_header[] = "ssm,valid,formatted,year,entity_code,entity\n";
+        struct iovec h = cfg -> kind == BULK_IC ?
+            (struct iovec) { (void *) ic_header, sizeof(ic_header) - 1 } :
+            (struct iovec) { (void *) ssm_header, sizeof(ssm_header) - 1 };
+
+        bytes_out += h.iov_len;
+        rc = write_all(out_fd, &h, 1);
+    }
+
+    unsigned int nthreads = cfg -> threads ? cfg -> threads : 1;
+
+    if (nthreads > job.nsegs) nthreads = job.nsegs ? (unsigned int) job.nsegs : 1;
+
+    job.window = (size_t) nthreads * BULK_WINDOW_PER_THREAD;
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    pthread_t *threads = calloc(nthreads, sizeof(*threads));
+    unsigned int started_threads = 0;
+
+    for (unsigned int i = 0; threads && i < nthreads && job.nsegs; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &job) != 0) break;
+        started_threads++;
+    }
+
+    // 一个线程都起不来时在当前线程里算（窗口足够大，不会阻塞）
+    if (started_threads == 0 && job.nsegs) {
+        job.window = job.nsegs;
+        worker_main(&job);
+    }
+
+    size_t lines = 0;
+    size_t valid = 0;
+    size_t dropped = 0;
+
+    // 主线程负责按顺序写出：把已完成的连续若干段一次 writev 出去；写失败后只回收不再写
+    while (job.written < job.nsegs) {
+        pthread_mutex_lock(&job.lock);
+        while (!job.segs[job.written].done) pthread_cond_wait(&job.cond, &job.lock);
+
+        size_t first = job.written;
+        size_t last = first;
+
+        while (last < job.nsegs && last - first < BULK_IOV_MAX && job.segs[last].done) last++;
+
+        pthread_mutex_unlock(&job.lock);
+
+        struct iovec iov[BULK_IOV_MAX];
+        int cnt = 0;
+
+        for (size_t i = first; i < last; i++) {
+            struct bulk_segment *seg = &job.segs[i];
+
+            lines += seg -> lines;
+            valid += seg -> valid;
+            dropped += seg -> dropped;
+            bytes_out += seg -> out.size;
+
+            if (seg -> out.size) iov[cnt++] = (struct iovec) { seg -> out.data, seg -> out.size };
+        }
+
+        if (rc == 0 && cnt && write_all(out_fd, iov, cnt) != 0) {
+            fprintf(stderr, "[bulk] 写出失败: %s\n", strerror(errno));
+            rc = -1;
+        }
+
+        for (size_t i = first; i < last; i++) memory_release(&job.segs[i].out);
+
+        pthread_mutex_lock(&job.lock);
+        job.written = last;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (unsigned int i = 0; i < started_threads; i++) pthread_join(threads[i], NULL);
+
+    free(threads);
+    free(job.segs);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.cond);
+
+    if (data) munmap((void *) data, size);
+    if (out_fd != STDOUT_FILENO && close(out_fd) != 0) rc = -1;
+
+    if (stats) {
+        stats -> bytes_in = size;
+        stats -> bytes_out = bytes_out;
+        stats -> lines = lines;
+        stats -> valid = valid;
+        stats -> dropped = dropped;
+        stats -> seconds = now_seconds() - started;
+    }
+
+    return rc;
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s bulk [选项] <输入文件>\n", prog);
+    printf("  输入文件每行一个号码，结果按输入顺序输出\n");
+    printf("  -k, --kind ic|ssm          号码类型 (默认 ic)\n");
+    printf("  -f, --format ndjson|csv    输出格式 (默认 ndjson)\n");
+    printf("  -t, --threads N            工作线程数 (默认 CPU 核数)\n");
+    printf("  -o, --output FILE          输出文件 (默认标准输出)\n");
+    printf("  -h, --help                 显示本帮助\n");
+}
+
+/**
+ * mo bulk 子命令入口
+ *
+ * @param argc 参数个数（argv[0] 为 "bulk"）
+ * @param argv 参数数组
+ * @return 进程退出码
+ */
+int bulk_main(int argc, char **argv) {
+    static const struct option long_opts[] = {
+        {"kind",    required_argument, NULL, 'k'},
+        {"format",  required_argument, NULL, 'f'},
+        {"threads", required_argument, NULL, 't'},
+        {"output",  required_argument, NULL, 'o'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    struct bulk_config cfg = { BULK_IC, BULK_NDJSON, 0, NULL, NULL };
+    const char *prog = "mo";
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "k:f:t:o:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'k':
+                if (strcmp(optarg, "ic") == 0) cfg.kind = BULK_IC;
+                else if (strcmp(optarg, "ssm") == 0) cfg.kind = BULK_SSM;
+                else {
+                    fprintf(stderr, "[错误] 未知的号码类型: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                if (strcmp(optarg, "ndjson") == 0) cfg.format = BULK_NDJSON;
+                else if (strcmp(optarg, "csv") == 0) cfg.format = BULK_CSV;
+                else {
+                    fprintf(stderr, "[错误] 未知的输出格式: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't': cfg.threads = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'o': cfg.output = optarg; break;
+            case 'h': print_usage(prog); return EXIT_SUCCESS;
+            default: print_usage(prog); return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1) {
+        print_usage(prog);
+        return EXIT_FAILURE;
+    }
+
+    cfg.input = argv[optind];
+
+    if (cfg.threads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.threads = ncpu > 0 ? (unsigned int) ncpu : 1;
+    }
+
+    struct bulk_stats st;
+
+    if (bulk_run(&cfg, &st) != 0) return EXIT_FAILURE;
+
+    fprintf(stderr, "[bulk] %zu 行 | 有效 %zu | 输入 %.1f MB | 输出 %.1f MB | %.2f s | %.2f M 行/s | %.0f MB/s | 线程 %u\n",
+        st.lines, st.valid, st.bytes_in / 1e6, st.bytes_out / 1e6, st.seconds,
+        st.seconds > 0 ? st.lines / st.seconds / 1e6 : 0.0,
+        st.seconds > 0 ? st.bytes_in / st.seconds / 1e6 : 0.0, cfg.threads);
+
+    // 内存不足丢掉的行不能悄悄吞掉，否则输出和输入对不上
+    if (st.dropped) {
+        fprintf(stderr, "[bulk] 内存不足，%zu 行未写出，输出不完整\n", st.dropped);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
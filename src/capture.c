@@ -0,0 +1,349 @@
+/**
+ * @file capture.c
+ * @brief 上游流量的录制与回放
+ *
+ * 录制模式下，每一次上游请求/响应都追加写入一个捕获文件；
+ * 回放模式下，启动时把整个捕获文件读进内存建好哈希表，之后所有上游请求都直接从表里取响应，
+ * 不再访问网络。抓一份生产流量，就能离线、可重复地压测解析和拼装响应的开销。
+ *
+ * 请求的键由数据源名、规范化后的 URL 和请求体组成：
+ * scheme 和主机名统一转成小写，丢掉 #fragment 和末尾多余的 '?'。
+ * 同一个键录制了多次时，回放以最后一次为准。
+ *
+ * 文件格式：开头是 CAPTURE_MAGIC，之后每条记录为
+ * { uint32 键长, uint32 响应体长, int32 HTTP 状态码 } + 键 + 响应体，整数按本机字节序。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "../include/capture.h"
+#include "../include/memory.h"
+
+#define CAPTURE_MAGIC "MOCAP1\n"
+#define CAPTURE_MAGIC_LEN (sizeof(CAPTURE_MAGIC) - 1)
+
+struct capture_header {
+    uint32_t key_len;
+    uint32_t body_len;
+    int32_t status;
+};
+
+struct capture_entry {
+    const char *key;
+    size_t key_len;
+    const char *body;
+    size_t body_len;
+    long status;
+    uint64_t hash;
+    struct capture_entry *next;
+};
+
+static enum capture_mode mode = CAPTURE_OFF;
+
+// 录制：追加写入的文件，多个请求线程和事件循环线程共用，写入时持锁
+static pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *record_fp = NULL;
+
+// 回放：整个文件读入 replay_buf，表项直接指向其中的键和响应体，加载后只读，查询无需加锁
+static char *replay_buf = NULL;
+static struct capture_entry *replay_entries = NULL;
+static struct capture_entry **replay_buckets = NULL;
+static size_t replay_nbuckets = 0;
+static size_t replay_count = 0;
+
+static unsigned long recorded = 0;
+static unsigned long replayed = 0;
+static unsigned long misses = 0;
+
+static uint64_t hash_bytes(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/**
+ * 拼出请求的键："<数据源>\n<规范化 URL>\n<请求体>"
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+static int build_key(enum metrics_source src, const char *url, const char *post, struct memory *out) {
+    const char *name = metrics_source_name(src);
+    const char *scheme_end = strstr(url, "://");
+    const char *host_end = NULL;
+    size_t url_len = strcspn(url, "#");
+
+    if (scheme_end) host_end = scheme_end + 3 + strcspn(scheme_end + 3, "/?#");
+
+    while (url_len > 0 && url[url_len - 1] == '?') url_len--;
+
+    if (memory_reserve(out, strlen(name) + url_len + (post ? strlen(post) : 0) + 3) != 0) return -1;
+
+    memory_append(out, name, strlen(name));
+    memory_append(out, "\n", 1);
+
+    char *start = out -> data + out -> size;
+    size_t lower = host_end && (size_t) (host_end - url) < url_len ? (size_t) (host_end - url) : (host_end ? url_len : 0);
+
+    memory_append(out, url, url_len);
+
+    for (size_t i = 0; i < lower; i++) start[i] = (char) tolower((unsigned char) start[i]);
+
+    memory_append(out, "\n", 1);
+
+    if (post) memory_append(out, post, strlen(post));
+
+    return 0;
+}
+
+static struct capture_entry *find_entry(const char *key, size_t key_len, uint64_t hash) {
+    struct capture_entry *e = replay_buckets[hash & (replay_nbuckets - 1)];
+
+    while (e && (e -> hash != hash || e -> key_len != key_len || memcmp(e -> key, key, key_len) != 0)) e = e -> next;
+
+    return e;
+}
+
+static void replay_free(void) {
+    free(replay_buckets);
+    free(replay_entries);
+    free(replay_buf);
+
+    replay_buckets = NULL;
+    replay_entries = NULL;
+    replay_buf = NULL;
+    replay_nbuckets = 0;
+    replay_count = 0;
+}
+
+/**
+ * 读入捕获文件并建立索引
+ *
+ * @return 0表示成功，-1表示文件无法读取或格式不对
+ */
+static int replay_load(const char *path) {
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        fprintf(stderr, "[capture] 无法打开 %s\n", path);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (size < (long) CAPTURE_MAGIC_LEN || !(replay_buf = malloc((size_t) size)) ||
+        fread(replay_buf, 1, (size_t) size, fp) != (size_t) size ||
+        memcmp(replay_buf, CAPTURE_MAGIC, CAPTURE_MAGIC_LEN) != 0) {
+        fprintf(stderr, "[capture] %s 不是有效的捕获文件\n", path);
+        fclose(fp);
+        replay_free();
+        return -1;
+    }
+
+    fclose(fp);
+
+    // 第一遍数记录数，确定哈希表大小；文件尾部被截断的半条记录直接忽略
+    size_t total = 0;
+    size_t off = CAPTURE_MAGIC_LEN;
+    struct capture_header h;
+
+    while (off + sizeof(h) <= (size_t) size) {
+        memcpy(&h, replay_buf + off, sizeof(h));
+
+        if ((size_t) size - off - sizeof(h) < (size_t) h.key_len + h.body_len) break;
+
+        off += sizeof(h) + h.key_len + h.body_len;
+        total++;
+    }
+
+    replay_nbuckets = 64;
+    while (replay_nbuckets < total * 2) replay_nbuckets <<= 1;
+
+    replay_buckets = calloc(replay_nbuckets, sizeof(*replay_buckets));
+    replay_entries = calloc(total ? total : 1, sizeof(*replay_entries));
+
+    if (!replay_buckets || !replay_entries) {
+        replay_free();
+        return -1;
+    }
+
+    off = CAPTURE_MAGIC_LEN;
+
+    for (size_t i = 0; i < total; i++) {
+        memcpy(&h, replay_buf + off, sizeof(h));
+        off += sizeof(h);
+
+        const char *key = replay_buf + off;
+        uint64_t hash = hash_bytes(key, h.key_len);
+        struct capture_entry *e = find_entry(key, h.key_len, hash);
+
+        // 重复录制的键以后出现的为准
+        if (!e) {
+            e = &replay_entries[replay_count++];
+            e -> key = key;
+            e -> key_len = h.key_len;
+            e -> hash = hash;
+            e -> next = replay_buckets[hash & (replay_nbuckets - 1)];
+            replay_buckets[hash & (replay_nbuckets - 1)] = e;
+        }
+
+        e -> body = key + h.key_len;
+        e -> body_len = h.body_len;
+        e -> status = h.status;
+
+        off += h.key_len + h.body_len;
+    }
+
+    return 0;
+}
+
+/**
+ * 开启录制或回放（在任何上游请求发出之前调用一次）
+ *
+ * @param mode CAPTURE_RECORD 追加写入 path（文件不存在时新建），CAPTURE_REPLAY 从 path 读取
+ * @param path 捕获文件路径
+ * @return 0表示成功，-1表示失败（此时保持 CAPTURE_OFF）
+ */
+int capture_start(enum capture_mode new_mode, const char *path) {
+    if (!path || mode != CAPTURE_OFF) return -1;
+
+    if (new_mode == CAPTURE_RECORD) {
+        record_fp = fopen(path, "ab");
+
+        if (!record_fp) {
+            fprintf(stderr, "[capture] 无法写入 %s\n", path);
+            return -1;
+        }
+
+        if (ftell(record_fp) == 0 && fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_LEN, record_fp) != CAPTURE_MAGIC_LEN) {
+            fclose(record_fp);
+            record_fp = NULL;
+            return -1;
+        }
+    } else if (new_mode == CAPTURE_REPLAY) {
+        if (replay_load(path) != 0) return -1;
+    } else {
+        return -1;
+    }
+
+    mode = new_mode;
+
+    return 0;
+}
+
+/**
+ * 结束录制或回放，关闭文件并释放回放数据（进程退出前、上游循环停止后调用）
+ */
+void capture_stop(void) {
+    pthread_mutex_lock(&record_lock);
+
+    if (record_fp) {
+        fclose(record_fp);
+        record_fp = NULL;
+    }
+
+    pthread_mutex_unlock(&record_lock);
+
+    replay_free();
+    mode = CAPTURE_OFF;
+}
+
+enum capture_mode capture_get_mode(void) {
+    return mode;
+}
+
+/**
+ * 录制一次上游请求的响应
+ *
+ * @param src 数据源
+ * @param url 请求地址
+ * @param post 请求体，GET 请求传 NULL
+ * @param status HTTP 状态码
+ * @param body 响应体（写回调主动中止时是已收到的部分）
+ * @param len 响应体长度
+ * @return 0表示已写入，-1表示未处于录制模式或写入失败
+ */
+int capture_record(enum metrics_source src, const char *url, const char *post, long status, const char *body, size_t len) {
+    if (mode != CAPTURE_RECORD || !url) return -1;
+
+    struct memory key = {0};
+
+    if (build_key(src, url, post, &key) != 0) return -1;
+
+    struct capture_header h = { (uint32_t) key.size, (uint32_t) len, (int32_t) status };
+    int rc = -1;
+
+    pthread_mutex_lock(&record_lock);
+
+    if (record_fp &&
+        fwrite(&h, sizeof(h), 1, record_fp) == 1 &&
+        fwrite(key.data, 1, key.size, record_fp) == key.size &&
+        (len == 0 || fwrite(body, 1, len, record_fp) == len)) {
+        fflush(record_fp);
+        rc = 0;
+    }
+
+    pthread_mutex_unlock(&record_lock);
+
+    memory_release(&key);
+
+    if (rc == 0) __atomic_fetch_add(&recorded, 1, __ATOMIC_RELAXED);
+
+    return rc;
+}
+
+/**
+ * 在回放数据中查找一次上游请求的响应
+ *
+ * @param src 数据源
+ * @param url 请求地址
+ * @param post 请求体，GET 请求传 NULL
+ * @param status 输出的 HTTP 状态码
+ * @param body 输出的响应体，指向回放数据内部，capture_stop 之前有效，调用者不要释放
+ * @param len 输出的响应体长度
+ * @return 0表示命中，-1表示没有录制过这个请求
+ */
+int capture_lookup(enum metrics_source src, const char *url, const char *post, long *status, const char **body, size_t *len) {
+    if (mode != CAPTURE_REPLAY || !url) return -1;
+
+    struct memory key = {0};
+
+    if (build_key(src, url, post, &key) != 0) return -1;
+
+    struct capture_entry *e = find_entry(key.data, key.size, hash_bytes(key.data, key.size));
+
+    memory_release(&key);
+
+    if (!e) {
+        __atomic_fetch_add(&misses, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    __atomic_fetch_add(&replayed, 1, __ATOMIC_RELAXED);
+
+    if (status) *status = e -> status;
+    if (body) *body = e -> body;
+    if (len) *len = e -> body_len;
+
+    return 0;
+}
+
+void capture_get_stats(struct capture_stats *out) {
+    if (!out) return;
+
+    out -> recorded = __atomic_load_n(&recorded, __ATOMIC_RELAXED);
+    out -> replayed = __atomic_load_n(&replayed, __ATOMIC_RELAXED);
+    out -> misses = __atomic_load_n(&misses, __ATOMIC_RELAXED);
+    out -> entries = replay_count;
+}
@@ -1,113 +1,181 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include <curl/curl.h>
 
 #include "../include/memory.h"
 #include "../include/company.h"
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
+#include "../include/html_stream.h"
+#include "../include/response.h"
+#include "../include/arena.h"
 
+// 单个字段最多保留的字节数
+#define COMPANY_FIELD_MAX 1024
 
 /**
- * CURL写回调函数，用于接收HTTP响应数据并存储到用户定义的结构体中
- * 
+ * 黄页搜索结果页中需要的四个字段，各自独立地取第一次出现的内容
+ */
+enum company_field {
+    COMPANY_NAME,
+    COMPANY_CATEGORY,
+    COMPANY_ADDRESS,
+    COMPANY_WEBSITE,
+    COMPANY_FIELD_COUNT
+};
+
+static const struct {
+    const char *start;
+    const char *end;
+} company_markers[COMPANY_FIELD_COUNT] = {
+    [COMPANY_NAME]     = { "<h3>", "</h3>" },
+    [COMPANY_CATEGORY] = { "<span class=\"item-category\">", "</span>" },
+    [COMPANY_ADDRESS]  = { "<span class=\"value\">", "</span>" },
+    [COMPANY_WEBSITE]  = { "<div class=\"item-web\">", "</div>" },
+};
+
+struct company_stream {
+    struct html_capture fields[COMPANY_FIELD_COUNT];
+};
+
+/**
+ * CURL写回调函数：把数据同时喂给四个字段提取器，全部取到后返回0中止传输
+ *
  * @param ptr 指向接收到的数据的指针
  * @param size 每个数据元素的大小（字节数）
  * @param nmemb 数据元素的数量
- * @param userdata 指向用户数据的指针，这里应该是semak_mule_response结构体
+ * @param userdata 指向 company_stream 的指针
  * 
- * @return 返回实际处理的数据大小（字节数），如果处理失败返回0
+ * @return 返回实际处理的数据大小（字节数），字段已全部取到时返回0
  */
 static size_t write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
     size_t total = size * nmemb;
-    struct memory *resp = (struct memory *)userdata;
+    struct company_stream *st = (struct company_stream *)userdata;
+    bool all_done = true;
 
-    // 重新分配内存以容纳新接收的数据
-    char *new_data = realloc(resp -> data, resp -> size + total + 1);
+    for (int i = 0; i < COMPANY_FIELD_COUNT; i++) {
+        html_capture_feed(&st -> fields[i], (const char *) ptr, total);
 
-    if (!new_data) {
-        fprintf(stderr, "realloc failed\n");
-        return 0;
+        if (!html_capture_done(&st -> fields[i])) all_done = false;
     }
 
-    resp -> data = new_data;
-
-    // 将新数据复制到已分配的内存空间中
-    memcpy(&(resp -> data[resp -> size]), ptr, total);
-    
-    resp -> size += total;
-    resp -> data[resp -> size] = '\0';
-    
-    return total;
+    return all_done ? 0 : total;
 }
 
-static char *extract_between(const char *src, const char *start, const char *end) {
-    char *p1 = strstr(src, start);
- 
-    if (!p1) return NULL;
-    p1 += strlen(start);
- 
-    char *p2 = strstr(p1, end);
-    if (!p2) return NULL;
+static void company_stream_free(struct company_stream *st) {
+    for (int i = 0; i < COMPANY_FIELD_COUNT; i++) html_capture_free(&st -> fields[i]);
+}
 
-    size_t len = p2 - p1;
-    char *out = malloc(len + 1);
- 
-    strncpy(out, p1, len);
- 
-    out[len] = '\0';
- 
-    return out;
+static char *take_field(struct company_stream *st, enum company_field f) {
+    char *v = html_capture_take_text(&st -> fields[f]);
+    return v ? v : strdup("");
 }
 
 int company_search(const char *keyword, struct company_entry **results, size_t *count) {
     CURL *curl;
     CURLcode res;
     
-    struct memory chunk = {0};
+    struct company_stream st;
+
+    for (int i = 0; i < COMPANY_FIELD_COUNT; i++) {
+        html_capture_init(&st.fields[i], company_markers[i].start, company_markers[i].end, false, COMPANY_FIELD_MAX);
+    }
 
-    curl = curl_easy_init();
+    curl = curl_pool_acquire();
     char url[512];
     
+    // 拿不到句柄也算一次失败的上游请求（不计耗时）
     if (!curl) {
-        fprintf(stderr, "CURL init failed\n");
+        metrics_upstream_begin(METRICS_SRC_COMPANY);
+        metrics_upstream_end(METRICS_SRC_COMPANY, NULL, false);
+        company_stream_free(&st);
         return -1;
     }
 
-    snprintf(url, sizeof(url), "https://malaysiayp.com/?s=%s&location-address=&a=true", keyword);
+    snprintf(url, sizeof(url), "%s/?s=%s&location-address=&a=true", upstream_url("MO_COMPANY_URL", COMPANY_URL), keyword);
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
+    // 写回调在字段取齐后主动中止，curl 会报 CURLE_WRITE_ERROR，这种情况视为成功
+    struct upstream_call call = {
+        .source = METRICS_SRC_COMPANY, .url = url,
+        .write = write_callback, .write_data = &st, .abort_ok = true,
+    };
 
-    res = curl_easy_perform(curl);
+    res = upstream_perform(curl, &call);
+
+    curl_pool_release(curl);
  
-    if (res != CURLE_OK) {
-        fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-        curl_easy_cleanup(curl);
+    // 失败已由 upstream_perform 计入 mo_upstream_errors_total
+    if (res != CURLE_OK && res != CURLE_WRITE_ERROR) {
+        company_stream_free(&st);
         return -1;
     }
 
-    curl_easy_cleanup(curl);
+    *results = malloc(sizeof(struct company_entry));
 
-    char *name = extract_between(chunk.data, "<h3>", "</h3>");
-    char *category = extract_between(chunk.data, "<span class=\"item-category\">", "</span>");
-    char *address = extract_between(chunk.data, "<span class=\"value\">", "</span>");
-    char *website = extract_between(chunk.data, "<div class=\"item-web\">", "</div>");
+    if (!*results) {
+        company_stream_free(&st);
+        return -1;
+    }
 
-    *results = malloc(sizeof(struct company_entry));
-    (*results)[0].name = name ? name : strdup("");
-    (*results)[0].category = category ? category : strdup("");
-    (*results)[0].address = address ? address : strdup("");
-    (*results)[0].website = website ? website : strdup("");
+    (*results)[0].name = take_field(&st, COMPANY_NAME);
+    (*results)[0].category = take_field(&st, COMPANY_CATEGORY);
+    (*results)[0].address = take_field(&st, COMPANY_ADDRESS);
+    (*results)[0].website = take_field(&st, COMPANY_WEBSITE);
     (*results)[0].source = strdup("MalaysiaYP");
  
     *count = 1;
 
-    free(chunk.data);
+    company_stream_free(&st);
  
     return 0;
 }
 
+/**
+ * 追加一个 "键": "值" 字段；值先复制进响应的 arena 再转义，结果数组可以在响应发出前释放
+ *
+ * 字段经 html_capture_take_text 解码过实体，可能含有真正的引号和反斜杠，必须转义。
+ */
+static int add_field(struct response_builder *out, const char *key, const char *value) {
+    char *copy = arena_strdup(out -> arena, value ? value : "");
+
+    if (!copy) {
+        out -> failed = true;
+        return -1;
+    }
+
+    response_builder_add_str(out, key);
+
+    return response_builder_add_json_string(out, copy);
+}
+
+/**
+ * 把黄页搜索结果写成 JSON 数组（?comp= 的响应正文）
+ *
+ * @param results 搜索结果
+ * @param count 结果数
+ * @param out 响应构造器，其 arena 不能为 NULL
+ * @return 0表示成功，-1表示内存不足
+ */
+int company_results_to_json(const struct company_entry *results, size_t count, struct response_builder *out) {
+    if (!out -> arena) return -1;
+
+    response_builder_add_str(out, "[\n");
+
+    for (size_t i = 0; i < count; i++) {
+        add_field(out, "  {\n    \"name\": ", results[i].name);
+        add_field(out, ",\n    \"category\": ", results[i].category);
+        add_field(out, ",\n    \"address\": ", results[i].address);
+        add_field(out, ",\n    \"website\": ", results[i].website);
+        add_field(out, ",\n    \"source\": ", results[i].source);
+        response_builder_add_str(out, i < count - 1 ? "\n  },\n" : "\n  }\n");
+    }
+
+    return response_builder_add_str(out, "]\n");
+}
+
 void company_free_results(struct company_entry *results, size_t count) {
     for (size_t i = 0; i < count; i++) {
         free(results[i].name);
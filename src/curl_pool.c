@@ -0,0 +1,201 @@
+/**
+ * @file curl_pool.c
+ * @brief 进程级 libcurl 句柄池
+ *
+ * 所有抓取模块都从这里借用 CURL 句柄，用完归还而不是销毁。
+ * 句柄之间通过同一个 CURLSH 共享 DNS 缓存和 TLS 会话缓存，新连接可以做 TLS 会话恢复。
+ *
+ * 连接缓存不放进 CURLSH：libcurl 不支持多个线程上同时运行的传输共享连接缓存。
+ * 连接复用来自两处：异步请求都在上游事件循环的同一个 multi 里执行，共用它的连接缓存；
+ * 同步请求的句柄各自保留自己的连接缓存（curl_easy_reset 不会断开连接），
+ * 每个线程优先拿回自己上次归还的句柄，对同一个政府站点的重复查询仍然复用已建立的 TCP/TLS 连接。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <curl/curl.h>
+
+#include "../include/curl_pool.h"
+
+static CURLSH *share = NULL;
+static pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static CURL *idle[CURL_POOL_MAX_IDLE];
+static size_t idle_count = 0;
+
+// 每个线程留一个自己的句柄（连同它的连接缓存），线程退出时由析构函数销毁
+static pthread_key_t thread_handle;
+
+static struct curl_pool_stats stats;
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void) handle; (void) access; (void) userptr;
+    pthread_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+    (void) handle; (void) userptr;
+    pthread_mutex_unlock(&share_locks[data]);
+}
+
+static void thread_handle_free(void *curl) {
+    curl_easy_cleanup((CURL *) curl);
+}
+
+/**
+ * 给句柄套上池子的公共默认选项
+ * curl_easy_reset 会清掉所有选项（包括 CURLOPT_SHARE），所以每次借出前都要重新设置
+ */
+static void apply_defaults(CURL *curl) {
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+}
+
+/**
+ * 初始化句柄池（进程启动时调用一次，且须在创建任何线程之前）
+ *
+ * @return 0表示成功，-1表示失败
+ */
+int curl_pool_init(void) {
+    if (share) return 0;
+
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) return -1;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&share_locks[i], NULL);
+    }
+
+    share = curl_share_init();
+
+    if (!share || pthread_key_create(&thread_handle, thread_handle_free) != 0) {
+        if (share) curl_share_cleanup(share);
+
+        share = NULL;
+        curl_global_cleanup();
+        return -1;
+    }
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    return 0;
+}
+
+/**
+ * 销毁句柄池及共享缓存（进程退出前、其他用过句柄池的线程都退出之后调用）
+ */
+void curl_pool_cleanup(void) {
+    if (!share) return;
+
+    CURL *own = pthread_getspecific(thread_handle);
+
+    if (own) {
+        pthread_setspecific(thread_handle, NULL);
+        curl_easy_cleanup(own);
+    }
+
+    pthread_key_delete(thread_handle);
+
+    pthread_mutex_lock(&pool_lock);
+
+    while (idle_count > 0) {
+        curl_easy_cleanup(idle[--idle_count]);
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    curl_share_cleanup(share);
+    share = NULL;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&share_locks[i]);
+    }
+
+    curl_global_cleanup();
+}
+
+/**
+ * 借出一个已设置好共享缓存的 CURL 句柄
+ *
+ * @return CURL 句柄，用完必须调用 curl_pool_release 归还；失败返回 NULL
+ */
+CURL *curl_pool_acquire(void) {
+    CURL *curl = pthread_getspecific(thread_handle);
+
+    if (curl) pthread_setspecific(thread_handle, NULL);
+
+    pthread_mutex_lock(&pool_lock);
+
+    stats.acquired++;
+
+    if (curl) {
+        stats.recycled++;
+    } else if (idle_count > 0) {
+        curl = idle[--idle_count];
+        stats.recycled++;
+    } else {
+        stats.created++;
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    if (!curl) curl = curl_easy_init();
+    if (curl) apply_defaults(curl);
+
+    return curl;
+}
+
+/**
+ * 归还句柄
+ *
+ * 归还时统计上一次传输是否复用了已有连接，然后重置句柄选项：本线程还没有留句柄时留给本线程，
+ * 否则放回空闲栈，空闲栈满了才真正销毁。句柄的连接缓存随句柄保留，销毁句柄会断开它的连接。
+ *
+ * @param curl 通过 curl_pool_acquire 借出的句柄
+ */
+void curl_pool_release(CURL *curl) {
+    if (!curl) return;
+
+    long connects = 0;
+    long code = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+
+    curl_easy_reset(curl);
+
+    pthread_mutex_lock(&pool_lock);
+
+    if (connects > 0) stats.conn_new++;
+    else if (code > 0) stats.conn_reused++;
+
+    if (!pthread_getspecific(thread_handle) && pthread_setspecific(thread_handle, curl) == 0) {
+        curl = NULL;
+    } else if (idle_count < CURL_POOL_MAX_IDLE) {
+        idle[idle_count++] = curl;
+        curl = NULL;
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    if (curl) curl_easy_cleanup(curl);
+}
+
+/**
+ * 读取句柄池的复用计数
+ *
+ * @param out 输出的统计快照
+ */
+void curl_pool_get_stats(struct curl_pool_stats *out) {
+    if (!out) return;
+
+    pthread_mutex_lock(&pool_lock);
+    *out = stats;
+    pthread_mutex_unlock(&pool_lock);
+}
@@ -1,110 +1,79 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
 #include <curl/curl.h>
 #include <unistd.h>
+#include <microhttpd.h>
 
 #include "../include/memory.h"
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
 #include "../include/ecourt.h"
+#include "../include/singleflight.h"
+#include "../include/json_path.h"
+#include "../include/judgment_store.h"
+#include "../include/stream_buffer.h"
 
 #define BASE_URL "https://efs.kehakiman.gov.my"
 #define SEARCH_ENDPOINT "/EJudgmentWeb/Search"
 
-/**
- * CURL写回调函数，用于接收HTTP响应数据并存储到动态分配的内存中
- * @param contents 指向接收到的数据块的指针
- * @param size 每个数据元素的大小（字节数）
- * @param nmemb 数据元素的数量
- * @param userp 指向用户自定义数据结构的指针（这里是struct memory）
- * @return 返回实际处理的数据大小，如果失败返回0
- */
-static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    struct memory *mem = (struct memory *)userp;
-    
-    char *ptr = realloc(mem -> data, mem -> size + realsize + 1);
-
-    if(!ptr) return 0;
-
-    mem -> data = ptr;
-    
-    memcpy(&(mem -> data[mem -> size]), contents, realsize);
-    
-    mem -> size += realsize;
-    mem -> data[mem -> size] = 0;
-    
-    return realsize;
-}
+// single-flight 的数据源名称；以完整请求体为键，条件完全相同的并发搜索只访问一次上游
+#define SEARCH_FLIGHT "ejudgment"
 
 static char* send_post_with_retry(const char* url, const char* post_data, int maxRetries, int delay_ms) {
     CURL *curl;
     CURLcode res;
 
     int attempts = 0;
-    struct memory chunk;
-    
-    chunk.data = malloc(1);
-    chunk.size = 0;
+    struct memory chunk = {0};
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl = curl_easy_init();
+    curl = curl_pool_acquire();
 
-    if (!curl) {
-        free(chunk.data);
-        return NULL;
-    }
+    if (!curl) return NULL;
 
     while (attempts < maxRetries) {
-        chunk.size = 0;
-    
-        res = curl_easy_setopt(curl, CURLOPT_URL, url);
-    
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
+        struct upstream_call call = {
+            .source = METRICS_SRC_EJUDGMENT, .url = url, .post = post_data,
+            .write = memory_write_callback, .write_data = &chunk,
+        };
+
+        memory_attach_curl(curl, &chunk);
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
 
-        res = curl_easy_perform(curl);
+        res = upstream_perform(curl, &call);
 
         if (res == CURLE_OK) {
             break; 
         } else {
-            fprintf(stderr, "Request Failed (Retry %d/%d): %s\n", attempts+1, maxRetries, curl_easy_strerror(res));
+            // 失败已由 upstream_perform 计入 mo_upstream_errors_total，这里只记重试
             attempts++;
             
             if (attempts < maxRetries) {
+                metrics_upstream_retry(METRICS_SRC_EJUDGMENT);
                 usleep(delay_ms * 1000);
             } 
 
-            free(chunk.data);
-            chunk.data = NULL;
+            // 失败的半截响应不要，缓冲区回池，下次重试重新分配
+            memory_release(&chunk);
         }
     }
 
-    curl_easy_cleanup(curl);
-    curl_global_cleanup();
+    curl_pool_release(curl);
+
+    if (attempts >= maxRetries) return NULL;
     
-    return chunk.data;
+    return memory_detach(&chunk);
 }
 
-EJudgmentResponse* ejudgment_search(
-    const char* search,
-    const char* jurisdictionType,
-    const char* courtCategory,
-    const char* court,
-    const char* judgeName,
-    const char* caseType,
-    const char* dateOfAPFrom,
-    const char* dateOfAPTo,
-    const char* dateOfResultFrom,
-    const char* dateOfResultTo,
-    int currPage,
-    const char* ordering,
-    int maxRetries,
-    int delayBetweenRetries
-) {
-    char post_body[MAX_RESULT_LEN];
-    snprintf(post_body, sizeof(post_body),
+/**
+ * 按查询条件构造 eJudgment 搜索接口的 JSON 请求体
+ */
+static void build_post_body(const EJudgmentQuery *q, char *post_body, size_t len) {
+    snprintf(post_body, len,
         "{"
             "\"Param\":{"
                 "\"Search\":\"%s\","
@@ -121,35 +90,649 @@ EJudgmentResponse* ejudgment_search(
                 "\"Ordering\":\"%s\""
             "}"
         "}",
-        search,
-        jurisdictionType,
-        courtCategory,
-        court,
-        judgeName,
-        caseType,
-        dateOfAPFrom ? dateOfAPFrom : "",
-        dateOfAPTo ? dateOfAPTo : "",
-        dateOfResultFrom ? dateOfResultFrom : "",
-        dateOfResultTo ? dateOfResultTo : "",
-        currPage,
-        ordering
+        q -> search,
+        q -> jurisdictionType,
+        q -> courtCategory,
+        q -> court,
+        q -> judgeName,
+        q -> caseType,
+        q -> dateOfAPFrom ? q -> dateOfAPFrom : "",
+        q -> dateOfAPTo ? q -> dateOfAPTo : "",
+        q -> dateOfResultFrom ? q -> dateOfResultFrom : "",
+        q -> dateOfResultTo ? q -> dateOfResultTo : "",
+        q -> currPage,
+        q -> ordering
     );
+}
+
+/**
+ * 从上游响应中读出总记录数（TotalRecord），读不到时为 -1
+ */
+static int total_records(const char *json) {
+    long total;
+
+    if (json && json_path_int(json, strlen(json), "TotalRecord", &total) == 0) return (int) total;
+
+    return -1;
+}
+
+/**
+ * 同步搜索的实际上游调用（singleflight_do 的 load 函数）
+ */
+struct search_sync_args {
+    const char *url;
+    const char *post_body;
+    int max_retries;
+    int delay_ms;
+};
+
+static int search_sync_load(void *arg, char **data, size_t *size) {
+    struct search_sync_args *a = (struct search_sync_args *) arg;
+
+    *data = send_post_with_retry(a -> url, a -> post_body, a -> max_retries, a -> delay_ms);
+    *size = *data ? strlen(*data) : 0;
+
+    return *data ? 0 : -1;
+}
+
+EJudgmentResponse* ejudgment_search(
+    const char* search,
+    const char* jurisdictionType,
+    const char* courtCategory,
+    const char* court,
+    const char* judgeName,
+    const char* caseType,
+    const char* dateOfAPFrom,
+    const char* dateOfAPTo,
+    const char* dateOfResultFrom,
+    const char* dateOfResultTo,
+    int currPage,
+    const char* ordering,
+    int maxRetries,
+    int delayBetweenRetries
+) {
+    const EJudgmentQuery query = {
+        search, jurisdictionType, courtCategory, court, judgeName, caseType,
+        dateOfAPFrom, dateOfAPTo, dateOfResultFrom, dateOfResultTo,
+        currPage, ordering
+    };
+
+    char post_body[MAX_RESULT_LEN];
+    build_post_body(&query, post_body, sizeof(post_body));
 
     char url[512];
-    snprintf(url, sizeof(url), "%s%s", BASE_URL, SEARCH_ENDPOINT);
+    snprintf(url, sizeof(url), "%s%s", upstream_url("MO_EJUDGMENT_URL", BASE_URL), SEARCH_ENDPOINT);
 
-    char* raw_response = send_post_with_retry(url, post_body, maxRetries, delayBetweenRetries);
+    struct search_sync_args args = { url, post_body, maxRetries, delayBetweenRetries };
+    char *raw_response = NULL;
+    size_t raw_size = 0;
 
-    if (!raw_response) return NULL;
+    if (singleflight_do(SEARCH_FLIGHT, post_body, search_sync_load, &args, &raw_response, &raw_size) != 0) return NULL;
 
     EJudgmentResponse* resp = malloc(sizeof(EJudgmentResponse));
 
     resp -> raw_json = raw_response;
-    resp -> total_results = -1;
+    resp -> total_results = total_records(raw_response);
     
     return resp;
 }
 
+/**
+ * 异步搜索的上下文（跨多次重试保持）
+ */
+struct ejudgment_async {
+    struct memory chunk;
+    char *url;
+    char *post;
+    char *flight_key;
+    int attempts;
+    int max_retries;
+    int delay_ms;
+    ejudgment_done_fn done;
+    void *userdata;
+};
+
+static void ejudgment_async_done(CURL *curl, CURLcode res, void *userdata);
+
+/**
+ * 提交（或重试时重新提交）一次异步搜索
+ *
+ * @return 0表示已入队，-1表示失败
+ */
+static int ejudgment_async_submit(CURL *curl, struct ejudgment_async *ctx, long delay_ms) {
+    struct upstream_call call = {
+        .source = METRICS_SRC_EJUDGMENT, .url = ctx -> url, .post = ctx -> post,
+        .write = memory_write_callback, .write_data = &ctx -> chunk,
+    };
+
+    return upstream_submit_delayed(curl, &call, delay_ms, ejudgment_async_done, ctx);
+}
+
+static void ejudgment_async_free(struct ejudgment_async *ctx) {
+    free(ctx -> url);
+    free(ctx -> post);
+    free(ctx -> flight_key);
+    free(ctx);
+}
+
+static void ejudgment_async_done(CURL *curl, CURLcode res, void *userdata) {
+    struct ejudgment_async *ctx = (struct ejudgment_async *) userdata;
+
+    if (res != CURLE_OK) {
+        memory_release(&ctx -> chunk);
+
+        // 同一个句柄原样重新排队，退避由事件循环的延迟队列完成，不占用任何线程；
+        // 失败已由上游事件循环计入 mo_upstream_errors_total，这里只记重试
+        if (++ctx -> attempts < ctx -> max_retries && ejudgment_async_submit(curl, ctx, ctx -> delay_ms) == 0) {
+            metrics_upstream_retry(METRICS_SRC_EJUDGMENT);
+            return;
+        }
+
+        curl_pool_release(curl);
+
+        if (ctx -> flight_key) singleflight_complete(SEARCH_FLIGHT, ctx -> flight_key, -1, NULL, 0);
+
+        ctx -> done(NULL, ctx -> userdata);
+
+        ejudgment_async_free(ctx);
+
+        return;
+    }
+
+    curl_pool_release(curl);
+
+    if (ctx -> flight_key) {
+        singleflight_complete(SEARCH_FLIGHT, ctx -> flight_key, 0, ctx -> chunk.data ? ctx -> chunk.data : "", ctx -> chunk.size);
+    }
+
+    EJudgmentResponse* resp = malloc(sizeof(EJudgmentResponse));
+
+    if (resp) {
+        resp -> raw_json = memory_detach(&ctx -> chunk);
+        resp -> total_results = total_records(resp -> raw_json);
+    } else {
+        memory_release(&ctx -> chunk);
+    }
+
+    ctx -> done(resp, ctx -> userdata);
+    ejudgment_async_free(ctx);
+}
+
+/**
+ * 被合并的异步搜索：等待 leader 完成
+ */
+struct search_follower {
+    ejudgment_done_fn done;
+    void *userdata;
+};
+
+static void search_follower_done(int status, const char *data, size_t size, void *userdata) {
+    struct search_follower *f = (struct search_follower *) userdata;
+    EJudgmentResponse *resp = NULL;
+
+    if (status == 0 && data) {
+        resp = malloc(sizeof(EJudgmentResponse));
+
+        if (resp) {
+            resp -> raw_json = malloc(size + 1);
+
+            if (resp -> raw_json) {
+                memcpy(resp -> raw_json, data, size);
+                resp -> raw_json[size] = '\0';
+                resp -> total_results = total_records(resp -> raw_json);
+            } else {
+                free(resp);
+                resp = NULL;
+            }
+        }
+    }
+
+    f -> done(resp, f -> userdata);
+
+    free(f);
+}
+
+/**
+ * 异步搜索 eJudgment（通过上游事件循环执行，不阻塞调用线程）
+ *
+ * 失败时按 delayBetweenRetries 毫秒延迟重试，最多 maxRetries 次。
+ * 完成回调在事件循环线程中执行，resp 为 NULL 表示全部重试均失败；
+ * 非 NULL 时所有权转交给回调方，需调用 ejudgment_response_free 释放。
+ * 条件完全相同的进行中搜索会被合并，只访问一次上游。
+ *
+ * @param query 查询条件（内部会复制请求体，调用后即可释放）
+ * @param maxRetries 最大尝试次数
+ * @param delayBetweenRetries 重试间隔（毫秒）
+ * @param done 完成回调
+ * @param userdata 回调参数
+ * @return 0表示已提交，-1表示提交失败（此时不会回调）
+ */
+int ejudgment_search_async(const EJudgmentQuery *query, int maxRetries, int delayBetweenRetries, ejudgment_done_fn done, void *userdata) {
+    if (!query || !done) return -1;
+
+    char post_body[MAX_RESULT_LEN];
+    char url[512];
+
+    build_post_body(query, post_body, sizeof(post_body));
+    snprintf(url, sizeof(url), "%s%s", upstream_url("MO_EJUDGMENT_URL", BASE_URL), SEARCH_ENDPOINT);
+
+    struct search_follower *follower = malloc(sizeof(*follower));
+
+    if (!follower) return -1;
+
+    follower -> done = done;
+    follower -> userdata = userdata;
+
+    int role = singleflight_join(SEARCH_FLIGHT, post_body, search_follower_done, follower);
+
+    if (role == 0) return 0;
+
+    free(follower);
+
+    struct ejudgment_async *ctx = calloc(1, sizeof(*ctx));
+    CURL *curl = curl_pool_acquire();
+
+    if (ctx) {
+        ctx -> url = strdup(url);
+        ctx -> post = strdup(post_body);
+
+        if (role == 1) ctx -> flight_key = strdup(post_body);
+    }
+
+    if (!ctx || !curl || !ctx -> url || !ctx -> post || (role == 1 && !ctx -> flight_key)) {
+        if (ctx) ejudgment_async_free(ctx);
+
+        curl_pool_release(curl);
+
+        if (role == 1) singleflight_complete(SEARCH_FLIGHT, post_body, -1, NULL, 0);
+
+        return -1;
+    }
+
+    ctx -> max_retries = maxRetries > 0 ? maxRetries : 1;
+    ctx -> delay_ms = delayBetweenRetries;
+    ctx -> done = done;
+    ctx -> userdata = userdata;
+
+    memory_attach_curl(curl, &ctx -> chunk);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
+
+    if (ejudgment_async_submit(curl, ctx, 0) != 0) {
+        curl_pool_release(curl);
+        ejudgment_async_free(ctx);
+
+        if (role == 1) singleflight_complete(SEARCH_FLIGHT, post_body, -1, NULL, 0);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * ====================================================================
+ * 分页搜索
+ * ====================================================================
+ */
+
+struct paged_page {
+    struct ejudgment_paged *job;
+    int page;
+};
+
+/**
+ * 分页搜索：第 1 页给出总页数，其余页通过上游事件循环并发抓取（最多 EJUDGMENT_PAGE_CONCURRENCY 页在途），
+ * 每页到达后把其 Data 数组里的记录原样拼进输出，由 MHD 回调响应边到边发。总耗时约等于最慢的一页。
+ * 没有新记录可发时读取函数挂起连接，下一页到达时恢复。
+ *
+ * 引用计数：调用方（之后是 MHD 响应）持有一份，每个在途的页各持有一份。
+ */
+struct ejudgment_paged {
+    pthread_mutex_t lock;
+
+    EJudgmentQuery query;
+    char *strings;
+    int max_pages;
+    int max_retries;
+    int delay_ms;
+
+    ejudgment_paged_ready_fn ready;
+    void *userdata;
+
+    int total_pages;
+    int next_page;
+    int inflight;
+    int fetched;
+    size_t refs;
+    bool any_cases;
+    bool cancelled;
+    bool finished;
+
+    struct memory failed;
+    struct stream_buffer out;
+
+    struct timespec started;
+    struct paged_page pages[EJUDGMENT_MAX_PAGES];
+};
+
+static void paged_page_done(EJudgmentResponse *resp, void *userdata);
+
+/**
+ * 把查询条件里的字符串复制进一块内存，分页请求在调用方返回之后仍要用到
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+static int paged_copy_query(struct ejudgment_paged *job, const EJudgmentQuery *q) {
+    const char *src[] = {
+        q -> search, q -> jurisdictionType, q -> courtCategory, q -> court, q -> judgeName, q -> caseType,
+        q -> dateOfAPFrom, q -> dateOfAPTo, q -> dateOfResultFrom, q -> dateOfResultTo, q -> ordering
+    };
+    const char **dst[] = {
+        &job -> query.search, &job -> query.jurisdictionType, &job -> query.courtCategory, &job -> query.court,
+        &job -> query.judgeName, &job -> query.caseType, &job -> query.dateOfAPFrom, &job -> query.dateOfAPTo,
+        &job -> query.dateOfResultFrom, &job -> query.dateOfResultTo, &job -> query.ordering
+    };
+    size_t total = 0;
+
+    for (size_t i = 0; i < sizeof(src) / sizeof(src[0]); i++) total += src[i] ? strlen(src[i]) + 1 : 0;
+
+    job -> strings = malloc(total ? total : 1);
+
+    if (!job -> strings) return -1;
+
+    char *p = job -> strings;
+
+    for (size_t i = 0; i < sizeof(src) / sizeof(src[0]); i++) {
+        if (!src[i]) {
+            *dst[i] = NULL;
+            continue;
+        }
+
+        size_t len = strlen(src[i]) + 1;
+
+        memcpy(p, src[i], len);
+        *dst[i] = p;
+        p += len;
+    }
+
+    return 0;
+}
+
+static void paged_destroy(struct ejudgment_paged *job) {
+    free(job -> strings);
+    memory_release(&job -> failed);
+    stream_buffer_release(&job -> out);
+
+    pthread_mutex_destroy(&job -> lock);
+
+    free(job);
+}
+
+static void paged_release(struct ejudgment_paged *job) {
+    pthread_mutex_lock(&job -> lock);
+    bool last = --job -> refs == 0;
+    pthread_mutex_unlock(&job -> lock);
+
+    if (last) paged_destroy(job);
+}
+
+static int paged_submit(struct ejudgment_paged *job, int page) {
+    EJudgmentQuery q = job -> query;
+    struct paged_page *pg = &job -> pages[page - 1];
+
+    q.currPage = page;
+    pg -> job = job;
+    pg -> page = page;
+
+    return ejudgment_search_async(&q, job -> max_retries, job -> delay_ms, paged_page_done, pg);
+}
+
+static void paged_add_failed(struct ejudgment_paged *job, int page) {
+    char num[16];
+    int n = snprintf(num, sizeof(num), "%s%d", job -> failed.size ? "," : "", page);
+
+    memory_append(&job -> failed, num, (size_t) n);
+}
+
+/**
+ * 所有页都已结束（或已取消且没有在途的页）时写出结尾；需持有锁，之后由调用方唤醒读取方
+ */
+static void paged_finish_locked(struct ejudgment_paged *job) {
+    if (job -> finished || job -> inflight > 0) return;
+    if (!job -> cancelled && job -> next_page <= job -> total_pages) return;
+
+    struct timespec now;
+    char tail[128];
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int n = snprintf(tail, sizeof(tail), "%s],\"pages_fetched\":%d,\"failed_pages\":[", job -> any_cases ? "\n" : "", job -> fetched);
+
+    memory_append(&job -> out.data, tail, (size_t) n);
+    memory_append(&job -> out.data, job -> failed.data ? job -> failed.data : "", job -> failed.size);
+
+    n = snprintf(tail, sizeof(tail), "],\"elapsed_ms\":%ld}\n",
+        (now.tv_sec - job -> started.tv_sec) * 1000L + (now.tv_nsec - job -> started.tv_nsec) / 1000000L);
+
+    memory_append(&job -> out.data, tail, (size_t) n);
+
+    job -> finished = true;
+}
+
+/**
+ * 在并发上限内提交后续页
+ */
+static void paged_pump(struct ejudgment_paged *job) {
+    for (;;) {
+        pthread_mutex_lock(&job -> lock);
+
+        if (job -> cancelled || job -> next_page > job -> total_pages || job -> inflight >= EJUDGMENT_PAGE_CONCURRENCY) {
+            pthread_mutex_unlock(&job -> lock);
+            return;
+        }
+
+        int page = job -> next_page++;
+
+        job -> inflight++;
+        job -> refs++;
+
+        pthread_mutex_unlock(&job -> lock);
+
+        if (paged_submit(job, page) == 0) continue;
+
+        // 调用方仍持有引用，这里的计数不会降到 0
+        pthread_mutex_lock(&job -> lock);
+        job -> inflight--;
+        job -> refs--;
+        paged_add_failed(job, page);
+        paged_finish_locked(job);
+        stream_buffer_wake(&job -> out);
+        pthread_mutex_unlock(&job -> lock);
+    }
+}
+
+/**
+ * 把一页 Data 数组里的记录（去掉外层方括号）接到输出的 cases 数组中；需持有锁
+ */
+static void paged_append_cases(struct ejudgment_paged *job, const char *json, size_t len) {
+    const char *data;
+    size_t dlen;
+
+    if (json_path_find(json, len, "Data", &data, &dlen) != 0 || dlen < 2 || data[0] != '[') return;
+
+    data++;
+    dlen -= 2;
+
+    while (dlen > 0 && (*data == ' ' || *data == '\t' || *data == '\r' || *data == '\n')) data++, dlen--;
+    while (dlen > 0 && (data[dlen - 1] == ' ' || data[dlen - 1] == '\t' || data[dlen - 1] == '\r' || data[dlen - 1] == '\n')) dlen--;
+
+    if (dlen == 0) return;
+
+    memory_append(&job -> out.data, job -> any_cases ? ",\n" : "\n", job -> any_cases ? 2 : 1);
+    memory_append(&job -> out.data, data, dlen);
+
+    job -> any_cases = true;
+}
+
+/**
+ * 单页完成回调（在上游事件循环线程中执行）
+ */
+static void paged_page_done(EJudgmentResponse *resp, void *userdata) {
+    struct paged_page *pg = (struct paged_page *) userdata;
+    struct ejudgment_paged *job = pg -> job;
+    bool first = pg -> page == 1;
+    const char *json = resp ? resp -> raw_json : NULL;
+    size_t len = json ? strlen(json) : 0;
+    bool ok = json && json_path_valid(json, len);
+
+    pthread_mutex_lock(&job -> lock);
+
+    job -> inflight--;
+
+    if (first && ok) {
+        long pages = 1;
+        char head[160];
+
+        json_path_int(json, len, "TotalPage", &pages);
+
+        job -> total_pages = pages < 1 ? 1 : pages > job -> max_pages ? job -> max_pages : (int) pages;
+
+        int n = snprintf(head, sizeof(head), "{\"total_results\":%d,\"total_pages\":%ld,\"pages\":%d,\"cases\":[",
+            total_records(json), pages, job -> total_pages);
+
+        memory_append(&job -> out.data, head, (size_t) n);
+    }
+
+    if (ok) {
+        paged_append_cases(job, json, len);
+        job -> fetched++;
+    } else if (first) {
+        job -> cancelled = true;
+    } else {
+        paged_add_failed(job, pg -> page);
+    }
+
+    if (job -> total_pages > 0) paged_finish_locked(job);
+
+    stream_buffer_wake(&job -> out);
+    pthread_mutex_unlock(&job -> lock);
+
+    // 抓到的页交给判决镜像的入库线程（未打开时直接释放），写盘不占用事件循环
+    if (ok) {
+        judgment_store_ingest_async(resp -> raw_json, len);
+        resp -> raw_json = NULL;
+    }
+
+    ejudgment_response_free(resp);
+
+    // 第 1 页失败时整个搜索失败，调用方拿不到句柄，它的那份引用在这里释放
+    if (first) {
+        job -> ready(ok ? job : NULL, job -> userdata);
+
+        if (!ok) paged_release(job);
+    }
+
+    if (ok) paged_pump(job);
+
+    paged_release(job);
+}
+
+/**
+ * 分页搜索 eJudgment：先取第 1 页，再按总页数并发抓取其余页（最多 maxPages 页）
+ *
+ * 第 1 页结束后在事件循环线程中调用 ready：paged 为 NULL 表示第 1 页失败；
+ * 否则调用方获得句柄，先用 ejudgment_paged_attach 绑定连接，再交给 MHD_create_response_from_callback
+ *（读取函数 ejudgment_paged_send_chunk，释放函数 ejudgment_paged_free），或直接调用 ejudgment_paged_free。
+ *
+ * 输出为 title 加一个 JSON 对象：total_results、total_pages、pages（实际抓取的页数），
+ * cases 为各页记录按到达顺序合并的数组，最后是 pages_fetched、failed_pages 和 elapsed_ms。
+ *
+ * @param query 查询条件（内部会复制，调用后即可释放；currPage 被忽略）
+ * @param maxPages 最多抓取的页数，超过 EJUDGMENT_MAX_PAGES 时按其截断
+ * @param maxRetries 每页最大尝试次数
+ * @param delayBetweenRetries 重试间隔（毫秒）
+ * @param title 输出开头的标题，可为 NULL
+ * @param ready 第 1 页完成回调
+ * @param userdata 回调参数
+ * @return 0表示已提交，-1表示提交失败（此时不会回调）
+ */
+int ejudgment_search_paged(const EJudgmentQuery *query, int maxPages, int maxRetries, int delayBetweenRetries, const char *title, ejudgment_paged_ready_fn ready, void *userdata) {
+    if (!query || !ready) return -1;
+
+    struct ejudgment_paged *job = calloc(1, sizeof(*job));
+
+    if (!job) return -1;
+
+    pthread_mutex_init(&job -> lock, NULL);
+
+    if (paged_copy_query(job, query) != 0 || (title && memory_append(&job -> out.data, title, strlen(title)) != 0)) {
+        paged_destroy(job);
+        return -1;
+    }
+
+    job -> max_pages = maxPages < 1 ? 1 : maxPages > EJUDGMENT_MAX_PAGES ? EJUDGMENT_MAX_PAGES : maxPages;
+    job -> max_retries = maxRetries;
+    job -> delay_ms = delayBetweenRetries;
+    job -> ready = ready;
+    job -> userdata = userdata;
+
+    // 调用方一份，第 1 页一份；总页数在第 1 页返回前为 0，不会提交后续页
+    job -> refs = 2;
+    job -> inflight = 1;
+    job -> next_page = 2;
+
+    clock_gettime(CLOCK_MONOTONIC, &job -> started);
+
+    if (paged_submit(job, 1) != 0) {
+        paged_destroy(job);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * 绑定结果要写回的连接：没有记录可发时读取函数挂起它，下一页到达时恢复
+ */
+void ejudgment_paged_attach(struct ejudgment_paged *paged, struct MHD_Connection *connection) {
+    pthread_mutex_lock(&paged -> lock);
+    stream_buffer_attach(&paged -> out, connection);
+    pthread_mutex_unlock(&paged -> lock);
+}
+
+/**
+ * MHD 回调响应的读取函数：有已到达的记录就立即发出，否则挂起连接等下一页
+ */
+ssize_t ejudgment_paged_send_chunk(void *cls, uint64_t pos, char *buf, size_t max) {
+    struct ejudgment_paged *job = (struct ejudgment_paged *) cls;
+
+    (void) pos;
+
+    pthread_mutex_lock(&job -> lock);
+
+    ssize_t n = stream_buffer_read(&job -> out, job -> finished, buf, max);
+
+    pthread_mutex_unlock(&job -> lock);
+
+    return n;
+}
+
+/**
+ * 释放调用方持有的分页搜索：不再提交新的页，在途的页结束后由最后一个持有者释放
+ */
+void ejudgment_paged_free(void *cls) {
+    struct ejudgment_paged *job = (struct ejudgment_paged *) cls;
+
+    if (!job) return;
+
+    pthread_mutex_lock(&job -> lock);
+    job -> cancelled = true;
+    stream_buffer_detach(&job -> out);
+    pthread_mutex_unlock(&job -> lock);
+
+    paged_release(job);
+}
+
 void ejudgment_response_free(EJudgmentResponse* resp) {
     if (!resp) return;
     if (resp -> raw_json) free(resp -> raw_json);
@@ -159,6 +742,6 @@ void ejudgment_response_free(EJudgmentResponse* resp) {
 
 char* ecourt_open_document(const char* documentId) {
     char* url = malloc(512);
-    snprintf(url, 512, "https://efs.kehakiman.gov.my/EFSWeb/DocDownloader.aspx?DocumentID=%s&Inline=true", documentId);
+    snprintf(url, 512, "%s/EFSWeb/DocDownloader.aspx?DocumentID=%s&Inline=true", upstream_url("MO_EJUDGMENT_URL", BASE_URL), documentId);
     return url;
 }
\ No newline at end of file
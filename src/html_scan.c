@@ -0,0 +1,401 @@
+/**
+ * @file html_scan.c
+ * @brief 各爬虫共用的 HTML 扫描工具
+ *
+ * - html_scan_find：子串查找，SSE2 下一次比较 16 个位置的首尾字节，只对候选位置做完整比较
+ * - html_scan_fields：一次遍历块内所有 '<'，同时提取多个 "起始标记 ... 结束标记" 字段
+ * - html_scan_attr：在标签内取属性值
+ * - html_decode_entities / html_to_text：实体解码、去标签转纯文本
+ * - html_scan_record：累计解析字节数和耗时，用于统计吞吐量（MB/s）
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../include/html_scan.h"
+
+static uint64_t stat_bytes;
+static uint64_t stat_nanos;
+static uint64_t stat_calls;
+
+static const char *find_scalar(const char *hay, size_t len, const char *needle, size_t nlen) {
+    const char *p = hay;
+    const char *end = hay + len - nlen + 1;
+
+    while (p < end) {
+        p = memchr(p, needle[0], (size_t) (end - p));
+
+        if (!p) return NULL;
+        if (memcmp(p + 1, needle + 1, nlen - 1) == 0) return p;
+
+        p++;
+    }
+
+    return NULL;
+}
+
+/**
+ * 在 [hay, hay + len) 中查找 needle
+ *
+ * @param hay 被查找的数据（不要求以 '\0' 结尾）
+ * @param len 数据长度
+ * @param needle 要查找的字节串
+ * @param nlen 字节串长度
+ * @return 第一次出现的位置，找不到返回 NULL
+ */
+const char *html_scan_find(const char *hay, size_t len, const char *needle, size_t nlen) {
+    if (!hay || !needle || nlen == 0 || len < nlen) return NULL;
+    if (nlen == 1) return memchr(hay, needle[0], len);
+
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+
+    // 首字节与末字节同时命中的位置才可能是匹配，中间部分再用 memcmp 确认
+    for (; i + nlen - 1 + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (hay + i + nlen - 1));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+
+            if (memcmp(hay + i + bit + 1, needle + 1, nlen - 2) == 0) return hay + i + bit;
+
+            mask &= mask - 1;
+        }
+    }
+
+    return i < len ? find_scalar(hay + i, len - i, needle, nlen) : NULL;
+#else
+    return find_scalar(hay, len, needle, nlen);
+#endif
+}
+
+/**
+ * 单次遍历提取多个字段：每个字段取其起始标记第一次出现后、结束标记之前的内容
+ *
+ * 起始标记必须以 '<' 开头，遍历只在 '<' 处停下比较，未找到的字段输出空字符串。
+ * 最多 HTML_SCAN_MAX_FIELDS 个字段。
+ * 字段内容会做实体解码并去掉首尾空白。
+ *
+ * @param html 数据
+ * @param len 数据长度
+ * @param fields 字段列表
+ * @param n 字段数
+ * @return 成功提取的字段数
+ */
+size_t html_scan_fields(const char *html, size_t len, struct html_field *fields, size_t n) {
+    size_t found = 0;
+    size_t slen[HTML_SCAN_MAX_FIELDS];
+    bool done[HTML_SCAN_MAX_FIELDS];
+
+    if (n > HTML_SCAN_MAX_FIELDS) n = HTML_SCAN_MAX_FIELDS;
+
+    for (size_t i = 0; i < n; i++) {
+        slen[i] = strlen(fields[i].start);
+        done[i] = false;
+
+        if (fields[i].out_len) fields[i].out[0] = '\0';
+    }
+
+    const char *p = html;
+    const char *end = html + len;
+
+    while (found < n && p < end && (p = memchr(p, '<', (size_t) (end - p))) != NULL) {
+        for (size_t i = 0; i < n; i++) {
+            if (done[i] || (size_t) (end - p) < slen[i] || memcmp(p, fields[i].start, slen[i]) != 0) continue;
+
+            const char *value = p + slen[i];
+            const char *stop = html_scan_find(value, (size_t) (end - value), fields[i].stop, strlen(fields[i].stop));
+
+            done[i] = true;
+
+            if (!stop) continue;
+
+            while (value < stop && isspace((unsigned char) *value)) value++;
+            while (stop > value && isspace((unsigned char) stop[-1])) stop--;
+
+            html_decode_entities(value, (size_t) (stop - value), fields[i].out, fields[i].out_len);
+            found++;
+        }
+
+        p++;
+    }
+
+    return found;
+}
+
+/**
+ * 在标签内查找属性值，如 html_scan_attr("<img src=\"a.jpg\">", end, "src", &len)
+ *
+ * @param tag 标签起始位置（'<'）
+ * @param end 数据结束位置
+ * @param attr 属性名
+ * @param value_len 输出属性值长度
+ * @return 属性值起始位置（不含引号），找不到返回 NULL
+ */
+const char *html_scan_attr(const char *tag, const char *end, const char *attr, size_t *value_len) {
+    const char *close = memchr(tag, '>', (size_t) (end - tag));
+    size_t alen = strlen(attr);
+
+    if (!close) close = end;
+
+    for (const char *p = tag; p + alen < close; p++) {
+        if (!isspace((unsigned char) *p) || strncasecmp(p + 1, attr, alen) != 0) continue;
+
+        const char *q = p + 1 + alen;
+
+        while (q < close && isspace((unsigned char) *q)) q++;
+
+        if (q >= close || *q != '=') continue;
+
+        q++;
+
+        while (q < close && isspace((unsigned char) *q)) q++;
+
+        char quote = (q < close && (*q == '"' || *q == '\'')) ? *q++ : 0;
+        const char *v = q;
+
+        while (q < close && (quote ? *q != quote : !isspace((unsigned char) *q))) q++;
+
+        *value_len = (size_t) (q - v);
+
+        return v;
+    }
+
+    return NULL;
+}
+
+static size_t put_utf8(unsigned long cp, char *out, size_t room) {
+    char buf[4];
+    size_t n;
+
+    if (cp < 0x80) { buf[0] = (char) cp; n = 1; }
+    else if (cp < 0x800) { buf[0] = (char) (0xC0 | (cp >> 6)); buf[1] = (char) (0x80 | (cp & 0x3F)); n = 2; }
+    else if (cp < 0x10000) { buf[0] = (char) (0xE0 | (cp >> 12)); buf[1] = (char) (0x80 | ((cp >> 6) & 0x3F)); buf[2] = (char) (0x80 | (cp & 0x3F)); n = 3; }
+    else { buf[0] = (char) (0xF0 | (cp >> 18)); buf[1] = (char) (0x80 | ((cp >> 12) & 0x3F)); buf[2] = (char) (0x80 | ((cp >> 6) & 0x3F)); buf[3] = (char) (0x80 | (cp & 0x3F)); n = 4; }
+
+    if (n > room) return 0;
+
+    memcpy(out, buf, n);
+
+    return n;
+}
+
+/**
+ * 解码一个实体（p 指向 '&'）
+ *
+ * @return 实体长度（含 '&' 和 ';'），不是可识别的实体时返回 0
+ */
+static size_t decode_entity(const char *p, const char *end, unsigned long *cp) {
+    static const struct { const char *name; unsigned long cp; } named[] = {
+        { "amp", '&' }, { "lt", '<' }, { "gt", '>' }, { "quot", '"' }, { "apos", '\'' }, { "nbsp", ' ' }
+    };
+
+    const char *semi = memchr(p, ';', (size_t) (end - p) < 12 ? (size_t) (end - p) : 12);
+
+    if (!semi) return 0;
+
+    const char *name = p + 1;
+    size_t nlen = (size_t) (semi - name);
+
+    if (nlen > 1 && name[0] == '#') {
+        char *stop;
+        unsigned long v = (name[1] == 'x' || name[1] == 'X') ? strtoul(name + 2, &stop, 16) : strtoul(name + 1, &stop, 10);
+
+        if (stop != semi || v == 0 || v > 0x10FFFF) return 0;
+
+        *cp = v;
+
+        return nlen + 2;
+    }
+
+    for (size_t i = 0; i < sizeof(named) / sizeof(named[0]); i++) {
+        if (strlen(named[i].name) == nlen && memcmp(name, named[i].name, nlen) == 0) {
+            *cp = named[i].cp;
+            return nlen + 2;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * 解码 HTML 实体（&amp; &lt; &#39; &#x4E2D; 等），无法识别的原样保留
+ *
+ * @param src 输入
+ * @param len 输入长度
+ * @param out 输出缓冲区（总是以 '\0' 结尾，超长截断）
+ * @param out_len 输出缓冲区大小
+ * @return 输出长度
+ */
+size_t html_decode_entities(const char *src, size_t len, char *out, size_t out_len) {
+    size_t n = 0;
+    const char *end = src + len;
+
+    if (out_len == 0) return 0;
+
+    for (const char *p = src; p < end && n + 1 < out_len;) {
+        const char *amp = memchr(p, '&', (size_t) (end - p));
+        size_t plain = (size_t) ((amp ? amp : end) - p);
+
+        if (plain > out_len - 1 - n) plain = out_len - 1 - n;
+
+        memcpy(out + n, p, plain);
+        n += plain;
+        p += plain;
+
+        if (!amp || p != amp || n + 1 >= out_len) break;
+
+        unsigned long cp;
+        size_t elen = decode_entity(p, end, &cp);
+        size_t w = elen ? put_utf8(cp, out + n, out_len - 1 - n) : 0;
+
+        if (elen && w) {
+            n += w;
+            p += elen;
+        } else {
+            out[n++] = *p++;
+        }
+    }
+
+    out[n] = '\0';
+
+    return n;
+}
+
+/**
+ * 判断标签是否产生换行（块级元素或 <br>），</td> </th> 产生制表符
+ */
+static char tag_separator(const char *tag, const char *close) {
+    static const char *breaks[] = { "br", "p", "div", "li", "tr", "h1", "h2", "h3", "h4", "h5", "h6", "ul", "ol", "table" };
+    const char *name = tag + 1;
+
+    if (name < close && *name == '/') name++;
+
+    size_t nlen = 0;
+
+    while (name + nlen < close && isalnum((unsigned char) name[nlen])) nlen++;
+
+    if ((nlen == 2 && strncasecmp(name, "td", 2) == 0) || (nlen == 2 && strncasecmp(name, "th", 2) == 0)) {
+        return tag[1] == '/' ? '\t' : 0;
+    }
+
+    for (size_t i = 0; i < sizeof(breaks) / sizeof(breaks[0]); i++) {
+        if (strlen(breaks[i]) == nlen && strncasecmp(name, breaks[i], nlen) == 0) return '\n';
+    }
+
+    return 0;
+}
+
+/**
+ * 把 HTML 片段转换为纯文本：去标签、解码实体、合并空白；块级元素变为换行，单元格之间为制表符
+ *
+ * @param src 输入
+ * @param len 输入长度
+ * @param out 输出缓冲区（以 '\0' 结尾，超长截断）
+ * @param out_len 输出缓冲区大小
+ * @return 输出长度
+ */
+size_t html_to_text(const char *src, size_t len, char *out, size_t out_len) {
+    size_t n = 0;
+    const char *end = src + len;
+    bool space = false;
+
+    if (out_len == 0) return 0;
+
+    for (const char *p = src; p < end && n + 1 < out_len;) {
+        if (*p == '<') {
+            const char *close = memchr(p, '>', (size_t) (end - p));
+
+            if (!close) break;
+
+            char sep = tag_separator(p, close);
+
+            if (sep) {
+                while (n > 0 && out[n - 1] == ' ') n--;
+
+                if (n > 0 && out[n - 1] == '\t' && sep == '\n') out[n - 1] = '\n';
+                else if (n > 0 && out[n - 1] != '\n' && out[n - 1] != sep) out[n++] = sep;
+
+                space = false;
+            }
+
+            p = close + 1;
+            continue;
+        }
+
+        unsigned long cp = (unsigned char) *p;
+        size_t elen = *p == '&' ? decode_entity(p, end, &cp) : 0;
+
+        p += elen ? elen : 1;
+
+        // &nbsp; 解码为空格，与普通空白一起合并
+        if (cp < 0x80 && isspace((int) cp)) {
+            space = true;
+            continue;
+        }
+
+        if (space && n > 0 && out[n - 1] != '\n' && out[n - 1] != '\t') {
+            out[n++] = ' ';
+
+            if (n + 1 >= out_len) break;
+        }
+
+        space = false;
+
+        if (!elen) {
+            out[n++] = (char) cp;
+        } else {
+            size_t w = put_utf8(cp, out + n, out_len - 1 - n);
+
+            if (!w) break;
+
+            n += w;
+        }
+    }
+
+    while (n > 0 && isspace((unsigned char) out[n - 1])) n--;
+
+    out[n] = '\0';
+
+    return n;
+}
+
+/**
+ * 记录一次解析处理的字节数与耗时
+ *
+ * @param bytes 本次处理的字节数
+ * @param started 开始时间（CLOCK_MONOTONIC）
+ */
+void html_scan_record(size_t bytes, const struct timespec *started) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t ns = (int64_t) (now.tv_sec - started -> tv_sec) * 1000000000LL + (now.tv_nsec - started -> tv_nsec);
+
+    __atomic_fetch_add(&stat_bytes, (uint64_t) bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat_nanos, (uint64_t) (ns > 0 ? ns : 0), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat_calls, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * 读取累计的解析字节数与耗时（吞吐量 = bytes / nanos * 1000 MB/s）
+ */
+void html_scan_get_stats(struct html_scan_stats *out) {
+    if (!out) return;
+
+    out -> bytes = __atomic_load_n(&stat_bytes, __ATOMIC_RELAXED);
+    out -> nanos = __atomic_load_n(&stat_nanos, __ATOMIC_RELAXED);
+    out -> calls = __atomic_load_n(&stat_calls, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,331 @@
+/**
+ * @file html_stream.c
+ * @brief 在 curl 写回调里边收边解析的 HTML 匹配器
+ *
+ * 所有匹配器都按字节推进状态（KMP），因此标记被拆在两个数据块之间也能正确识别，
+ * 不需要先把整页缓存下来；没有跨块部分匹配时改用 html_scan_find 整段查找：
+ * - html_matcher：在数据流中查找固定字符串
+ * - html_capture：提取 "起始标记 [跳过到 '>'] 内容 结束标记" 之间的内容，找到即停止
+ * - html_block：按起始标记把数据流切成记录块，每凑齐一块就回调一次（只缓存当前块）
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/html_stream.h"
+#include "../include/html_scan.h"
+
+/**
+ * 初始化匹配器（预计算 KMP 失配表）
+ *
+ * @param m 匹配器
+ * @param pattern 要查找的字符串，长度不超过 HTML_MATCHER_MAX - 1
+ * @return 0表示成功，-1表示字符串为空或过长
+ */
+int html_matcher_init(struct html_matcher *m, const char *pattern) {
+    size_t len = pattern ? strlen(pattern) : 0;
+
+    if (len == 0 || len >= HTML_MATCHER_MAX) return -1;
+
+    memcpy(m -> pattern, pattern, len + 1);
+
+    m -> len = len;
+    m -> state = 0;
+    m -> fail[0] = 0;
+
+    for (size_t i = 1, k = 0; i < len; i++) {
+        while (k > 0 && pattern[i] != pattern[k]) k = m -> fail[k - 1];
+
+        if (pattern[i] == pattern[k]) k++;
+
+        m -> fail[i] = k;
+    }
+
+    return 0;
+}
+
+/**
+ * 推进匹配器
+ *
+ * @param m 匹配器
+ * @param data 新到达的数据
+ * @param len 数据长度
+ * @param matched 输出是否在本段数据中完成了一次匹配
+ * @return 匹配成功时为匹配结束位置（之后第一个字节的下标），否则为 len
+ */
+size_t html_matcher_feed(struct html_matcher *m, const char *data, size_t len, bool *matched) {
+    size_t k = m -> state;
+    size_t i = 0;
+
+    *matched = false;
+
+    // 没有跨块的部分匹配时直接用 SIMD 查找；找不到的话只有末尾不足一个标记长的字节可能是下一块匹配的前缀
+    if (k == 0 && len >= m -> len) {
+        const char *hit = html_scan_find(data, len, m -> pattern, m -> len);
+
+        if (hit) {
+            *matched = true;
+            return (size_t) (hit - data) + m -> len;
+        }
+
+        i = len - (m -> len - 1);
+    }
+
+    for (; i < len; i++) {
+        while (k > 0 && data[i] != m -> pattern[k]) k = m -> fail[k - 1];
+
+        if (data[i] == m -> pattern[k]) k++;
+
+        if (k == m -> len) {
+            m -> state = 0;
+            *matched = true;
+            return i + 1;
+        }
+    }
+
+    m -> state = k;
+
+    return len;
+}
+
+static int append(struct memory *mem, const char *data, size_t len, size_t max) {
+    if (max && mem -> size + len > max) len = max > mem -> size ? max - mem -> size : 0;
+    if (len == 0) return 0;
+
+    return memory_append(mem, data, len);
+}
+
+/**
+ * 初始化内容提取器
+ *
+ * @param c 提取器
+ * @param start 起始标记
+ * @param end 结束标记
+ * @param skip_tag 起始标记之后是否先跳过到 '>'（起始标记只是标签开头时使用）
+ * @param max 最多保留的内容字节数，0 表示不限
+ * @return 0表示成功，-1表示标记无效
+ */
+int html_capture_init(struct html_capture *c, const char *start, const char *end, bool skip_tag, size_t max) {
+    memset(c, 0, sizeof(*c));
+
+    if (html_matcher_init(&c -> start, start) != 0 || html_matcher_init(&c -> end, end) != 0) return -1;
+
+    c -> skip_tag = skip_tag;
+    c -> max = max;
+    c -> phase = HTML_CAPTURE_SEEK;
+
+    return 0;
+}
+
+/**
+ * 把新数据喂给提取器
+ *
+ * 内容阶段的每个字节都先记下来，结束标记完整匹配后再把它从末尾去掉，
+ * 这样结束标记的前缀跨块出现又失配时也不会丢字节。
+ *
+ * @param c 提取器
+ * @param data 新到达的数据
+ * @param len 数据长度
+ * @return 本次消费的字节数（提取完成后剩余数据不再消费）
+ */
+size_t html_capture_feed(struct html_capture *c, const char *data, size_t len) {
+    size_t pos = 0;
+    struct timespec started;
+
+    if (c -> phase == HTML_CAPTURE_DONE) return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    while (pos < len && c -> phase != HTML_CAPTURE_DONE) {
+        bool matched;
+
+        switch (c -> phase) {
+            case HTML_CAPTURE_SEEK:
+                pos += html_matcher_feed(&c -> start, data + pos, len - pos, &matched);
+
+                if (matched) c -> phase = c -> skip_tag ? HTML_CAPTURE_TAG : HTML_CAPTURE_BODY;
+                break;
+
+            case HTML_CAPTURE_TAG: {
+                const char *gt = memchr(data + pos, '>', len - pos);
+
+                if (!gt) {
+                    pos = len;
+                    break;
+                }
+
+                pos = (size_t) (gt - data) + 1;
+                c -> phase = HTML_CAPTURE_BODY;
+                break;
+            }
+
+            case HTML_CAPTURE_BODY: {
+                size_t used = html_matcher_feed(&c -> end, data + pos, len - pos, &matched);
+
+                // 内容上限只约束保留的字节；结束标记仍需完整识别，所以多留出标记长度
+                if (append(&c -> value, data + pos, used, c -> max ? c -> max + c -> end.len : 0) != 0) {
+                    pos = len;
+                    break;
+                }
+
+                pos += used;
+
+                if (matched) {
+                    size_t keep = c -> value.size >= c -> end.len ? c -> value.size - c -> end.len : 0;
+
+                    if (c -> max && keep > c -> max) keep = c -> max;
+
+                    if (c -> value.data) c -> value.data[keep] = '\0';
+
+                    c -> value.size = keep;
+                    c -> phase = HTML_CAPTURE_DONE;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    html_scan_record(pos, &started);
+
+    return pos;
+}
+
+bool html_capture_done(const struct html_capture *c) {
+    return c -> phase == HTML_CAPTURE_DONE;
+}
+
+/**
+ * 取走提取到的内容
+ *
+ * @param c 提取器
+ * @return 内容字符串（调用者负责 free），尚未提取完成时返回 NULL
+ */
+char *html_capture_take(struct html_capture *c) {
+    if (c -> phase != HTML_CAPTURE_DONE) return NULL;
+
+    return memory_detach(&c -> value);
+}
+
+/**
+ * 取走提取到的内容，并解码实体、去掉首尾空白
+ *
+ * @param c 提取器
+ * @return 文本（调用者负责 free），尚未提取完成时返回 NULL
+ */
+char *html_capture_take_text(struct html_capture *c) {
+    char *raw = html_capture_take(c);
+
+    if (!raw) return NULL;
+
+    size_t len = strlen(raw);
+    char *out = malloc(len + 1);
+
+    if (!out) return raw;
+
+    const char *p = raw;
+
+    while (len > 0 && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) { p++; len--; }
+    while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t' || p[len - 1] == '\r' || p[len - 1] == '\n')) len--;
+
+    html_decode_entities(p, len, out, len + 1);
+    free(raw);
+
+    return out;
+}
+
+void html_capture_free(struct html_capture *c) {
+    memory_release(&c -> value);
+}
+
+/**
+ * 初始化记录分块器
+ *
+ * @param b 分块器
+ * @param start 每条记录的起始标记（包含在回调的块内容中）
+ * @param max 单块最多缓存的字节数，超出部分丢弃
+ * @param on_block 每凑齐一块时的回调
+ * @param userdata 回调参数
+ * @return 0表示成功，-1表示标记无效
+ */
+int html_block_init(struct html_block *b, const char *start, size_t max, html_block_fn on_block, void *userdata) {
+    memset(b, 0, sizeof(*b));
+
+    if (html_matcher_init(&b -> start, start) != 0) return -1;
+
+    b -> max = max;
+    b -> on_block = on_block;
+    b -> userdata = userdata;
+
+    return 0;
+}
+
+static void emit_block(struct html_block *b, bool strip_marker) {
+    size_t len = b -> block.size;
+
+    // 新记录的起始标记已经追加到了上一块末尾，回调前去掉
+    if (strip_marker && !b -> truncated) len = len >= b -> start.len ? len - b -> start.len : 0;
+
+    if (b -> block.data) {
+        b -> block.data[len] = '\0';
+        b -> on_block(b -> block.data, len, b -> userdata);
+    }
+
+    b -> block.size = 0;
+    b -> truncated = false;
+}
+
+/**
+ * 把新数据喂给分块器
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+int html_block_feed(struct html_block *b, const char *data, size_t len) {
+    size_t pos = 0;
+    struct timespec started;
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    while (pos < len) {
+        bool matched;
+        size_t used = html_matcher_feed(&b -> start, data + pos, len - pos, &matched);
+
+        if (b -> in_block) {
+            size_t before = b -> block.size;
+
+            if (append(&b -> block, data + pos, used, b -> max) != 0) return -1;
+            if (b -> block.size - before < used) b -> truncated = true;
+        }
+
+        pos += used;
+
+        if (!matched) continue;
+
+        if (b -> in_block) emit_block(b, true);
+
+        b -> in_block = true;
+
+        if (append(&b -> block, b -> start.pattern, b -> start.len, b -> max) != 0) return -1;
+    }
+
+    html_scan_record(len, &started);
+
+    return 0;
+}
+
+/**
+ * 数据流结束：把最后一块交给回调
+ */
+void html_block_finish(struct html_block *b) {
+    if (b -> in_block) emit_block(b, false);
+
+    b -> in_block = false;
+}
+
+void html_block_free(struct html_block *b) {
+    memory_release(&b -> block);
+}
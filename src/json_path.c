@@ -0,0 +1,295 @@
+/**
+ * @file json_path.c
+ * @brief 按路径直接从 JSON 原文中取值，不建树、不分配内存
+ *
+ * 只需要一两个字段时，完整解析再序列化太浪费：这里沿着路径逐层扫描，
+ * 不相干的值只做括号和字符串匹配后跳过。路径语法：
+ *
+ *     count
+ *     table_data[0][1]
+ *     data.items[2].name
+ *
+ * 键名按原始字节比较（不处理键名里的转义）。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/json_path.h"
+
+struct cursor {
+    const char *p;
+    const char *end;
+};
+
+static void skip_ws(struct cursor *c) {
+    while (c -> p < c -> end && (*c -> p == ' ' || *c -> p == '\t' || *c -> p == '\n' || *c -> p == '\r')) c -> p++;
+}
+
+/**
+ * 跳过一个字符串（c -> p 指向开头的引号）
+ */
+static int skip_string(struct cursor *c) {
+    if (c -> p >= c -> end || *c -> p != '"') return -1;
+
+    c -> p++;
+
+    while (c -> p < c -> end) {
+        const char *q = memchr(c -> p, '"', (size_t) (c -> end - c -> p));
+
+        if (!q) return -1;
+
+        // 引号前连续反斜杠为奇数个时是转义的引号
+        size_t slashes = 0;
+
+        while (q - slashes > c -> p && q[-(long) slashes - 1] == '\\') slashes++;
+
+        c -> p = q + 1;
+
+        if (slashes % 2 == 0) return 0;
+    }
+
+    return -1;
+}
+
+static int skip_value(struct cursor *c, int depth);
+
+static int skip_container(struct cursor *c, int depth, char close) {
+    if (depth >= JSON_PATH_MAX_DEPTH) return -1;
+
+    c -> p++;
+    skip_ws(c);
+
+    if (c -> p < c -> end && *c -> p == close) {
+        c -> p++;
+        return 0;
+    }
+
+    for (;;) {
+        if (close == '}') {
+            if (skip_string(c) != 0) return -1;
+
+            skip_ws(c);
+
+            if (c -> p >= c -> end || *c -> p != ':') return -1;
+
+            c -> p++;
+        }
+
+        if (skip_value(c, depth + 1) != 0) return -1;
+
+        skip_ws(c);
+
+        if (c -> p >= c -> end) return -1;
+
+        if (*c -> p == ',') {
+            c -> p++;
+            skip_ws(c);
+            continue;
+        }
+
+        if (*c -> p != close) return -1;
+
+        c -> p++;
+
+        return 0;
+    }
+}
+
+/**
+ * 跳过任意一个值（前导空白会被跳过）
+ */
+static int skip_value(struct cursor *c, int depth) {
+    skip_ws(c);
+
+    if (c -> p >= c -> end) return -1;
+
+    switch (*c -> p) {
+        case '"': return skip_string(c);
+        case '{': return skip_container(c, depth, '}');
+        case '[': return skip_container(c, depth, ']');
+        default: break;
+    }
+
+    // 数字和 true/false/null：读到分隔符为止
+    const char *start = c -> p;
+
+    while (c -> p < c -> end && strchr(",]} \t\r\n", *c -> p) == NULL) c -> p++;
+
+    if (c -> p == start) return -1;
+
+    char ch = *start;
+
+    if (ch == 't' || ch == 'f' || ch == 'n') {
+        size_t n = (size_t) (c -> p - start);
+
+        if (!((n == 4 && memcmp(start, "true", 4) == 0) ||
+              (n == 5 && memcmp(start, "false", 5) == 0) ||
+              (n == 4 && memcmp(start, "null", 4) == 0))) return -1;
+    } else if (ch != '-' && (ch < '0' || ch > '9')) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * 检查是否为一个结构完整的 JSON 值（括号配对、字符串闭合，尾部只有空白）
+ */
+bool json_path_valid(const char *json, size_t len) {
+    struct cursor c = { json, json + len };
+
+    if (!json || skip_value(&c, 0) != 0) return false;
+
+    skip_ws(&c);
+
+    return c.p == c.end;
+}
+
+/**
+ * 在对象中定位键（c -> p 指向 '{'），成功时 c -> p 指向对应的值
+ */
+static int enter_key(struct cursor *c, const char *key, size_t key_len) {
+    if (c -> p >= c -> end || *c -> p != '{') return -1;
+
+    c -> p++;
+    skip_ws(c);
+
+    while (c -> p < c -> end && *c -> p == '"') {
+        const char *name = c -> p + 1;
+
+        if (skip_string(c) != 0) return -1;
+
+        size_t name_len = (size_t) (c -> p - 1 - name);
+
+        skip_ws(c);
+
+        if (c -> p >= c -> end || *c -> p != ':') return -1;
+
+        c -> p++;
+        skip_ws(c);
+
+        if (name_len == key_len && memcmp(name, key, key_len) == 0) return 0;
+
+        if (skip_value(c, 1) != 0) return -1;
+
+        skip_ws(c);
+
+        if (c -> p < c -> end && *c -> p == ',') {
+            c -> p++;
+            skip_ws(c);
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * 在数组中定位下标（c -> p 指向 '['），成功时 c -> p 指向对应的元素
+ */
+static int enter_index(struct cursor *c, long index) {
+    if (c -> p >= c -> end || *c -> p != '[') return -1;
+
+    c -> p++;
+    skip_ws(c);
+
+    if (c -> p < c -> end && *c -> p == ']') return -1;
+
+    for (long i = 0; c -> p < c -> end; i++) {
+        if (i == index) return 0;
+
+        if (skip_value(c, 1) != 0) return -1;
+
+        skip_ws(c);
+
+        if (c -> p >= c -> end || *c -> p != ',') return -1;
+
+        c -> p++;
+        skip_ws(c);
+    }
+
+    return -1;
+}
+
+/**
+ * 按路径定位一个值
+ *
+ * @param json JSON 原文
+ * @param len 原文长度
+ * @param path 路径，如 "table_data[0][1]"
+ * @param value 输出值在原文中的起始位置（字符串包含两侧引号）
+ * @param value_len 输出值的长度
+ * @return 0表示找到，-1表示路径不存在或原文结构错误
+ */
+int json_path_find(const char *json, size_t len, const char *path, const char **value, size_t *value_len) {
+    if (!json || !path) return -1;
+
+    struct cursor c = { json, json + len };
+
+    skip_ws(&c);
+
+    const char *s = path;
+
+    while (*s) {
+        if (*s == '[') {
+            char *stop;
+            long index = strtol(s + 1, &stop, 10);
+
+            if (stop == s + 1 || *stop != ']' || index < 0) return -1;
+            if (enter_index(&c, index) != 0) return -1;
+
+            s = stop + 1;
+        } else {
+            if (*s == '.') s++;
+
+            size_t key_len = strcspn(s, ".[");
+
+            if (key_len == 0 || enter_key(&c, s, key_len) != 0) return -1;
+
+            s += key_len;
+        }
+    }
+
+    const char *start = c.p;
+
+    if (skip_value(&c, 0) != 0) return -1;
+
+    *value = start;
+    *value_len = (size_t) (c.p - start);
+
+    return 0;
+}
+
+/**
+ * 按路径取整数值：数字直接转换，字符串则取其中的数字（上游有时把数字写成字符串）
+ *
+ * @return 0表示成功，-1表示路径不存在或不是数字
+ */
+int json_path_int(const char *json, size_t len, const char *path, long *out) {
+    const char *v;
+    size_t n;
+
+    if (json_path_find(json, len, path, &v, &n) != 0) return -1;
+
+    if (n >= 2 && v[0] == '"') {
+        v++;
+        n -= 2;
+    }
+
+    char buf[32];
+
+    if (n == 0 || n >= sizeof(buf)) return -1;
+
+    memcpy(buf, v, n);
+    buf[n] = '\0';
+
+    char *stop;
+    double d = strtod(buf, &stop);
+
+    if (stop == buf) return -1;
+
+    *out = (long) d;
+
+    return 0;
+}
@@ -0,0 +1,1385 @@
+/**
+ * @file judgment_store.c
+ * @brief eCourt 判决的本地镜像：磁盘存储、内存倒排索引和后台增量同步
+ *
+ * 判决记录原样（上游 Data 数组里的一个对象）追加写入一个 NDJSON 文件，每行一条，文件本身就是存储，
+ * 可以直接用 grep/jq 查看。内存里只保留每条记录在文件中的偏移、长度和判决日期，以及倒排索引：
+ * 当事人、案号、法官和法院字段切成词（ASCII 字母数字转小写，UTF-8 字节原样保留），
+ * 每个词对应一个递增的记录号列表。查询时对各词的列表求交，按判决日期从新到旧取前若干条，
+ * 再按偏移从文件读出原文（热数据都在页缓存里）。
+ *
+ * 记录的来源有两个：后台线程按 DATE_OF_AP_DESC 从第 1 页往后翻，读到比同步水位更旧的记录就停，
+ * 只拉取水位之后的新判决；线上 ?name= 查询抓到的每一页也顺手入库，
+ * 这些页由上游事件循环放进入库队列，写盘和建索引在单独的入库线程里做，不占用事件循环。
+ * 同一判决以 DocumentId（没有时用案号）去重，先到的为准。
+ *
+ * 同步水位是上一次完整同步时看到的最新判决日期：比它新的判决都已经同步过。它只由同步推进，
+ * 线上查询入库的判决再新也不会动它（否则两次同步之间会留下空档），保存在镜像文件旁的 <path>.sync 里。
+ *
+ * 启动时逐行读入文件重建索引；进程崩溃留下的半行会被截掉。
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/judgment_store.h"
+#include "../include/json_path.h"
+#include "../include/memory.h"
+#include "../include/ecourt.h"
+
+// 上游是马来西亚时间（UTC+8），/Date(ms)/ 格式的日期按当地日期计
+#define STORE_TZ_OFFSET (8 * 3600)
+
+// 用作去重键的字段值最多取这么多字节
+#define STORE_KEY_MAX 256
+
+struct store_record {
+    uint64_t offset;
+    uint32_t len;
+    uint32_t date;
+};
+
+struct posting_list {
+    uint32_t *ids;
+    uint32_t count;
+    uint32_t cap;
+};
+
+struct str_entry {
+    uint64_t hash;
+    size_t off;
+    uint32_t len;
+};
+
+/**
+ * 字符串到编号的开放寻址哈希表，字符串本身放在 pool 里；词表和去重键表共用
+ */
+struct str_table {
+    uint32_t *slots;
+    size_t mask;
+    struct str_entry *entries;
+    size_t count;
+    size_t cap;
+    struct memory pool;
+};
+
+/**
+ * 按字段名别名取值；上游不同时期的字段名不完全一致，按顺序取第一个存在的
+ */
+static const char *const KEY_FIELDS[] = { "DocumentId", "DocumentID", "DocId", "Id", "ID", "CaseNo", "CaseNumber", "NoKes", NULL };
+static const char *const DATE_FIELDS[] = { "DateOfAP", "DateOfAp", "APDate", "DateOfResult", NULL };
+
+// 入倒排索引的字段：当事人、案号、法官、法院
+static const char *const INDEX_FIELDS[] = {
+    "Parties", "PartyName", "CaseTitle", "Title", "Pihak",
+    "CaseNo", "CaseNumber", "NoKes",
+    "JudgeName", "Judge", "Hakim",
+    "Court", "CourtName", "Mahkamah",
+    NULL
+};
+
+static pthread_rwlock_t store_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static int store_fd = -1;
+static uint64_t store_size = 0;
+
+static struct store_record *records = NULL;
+static size_t record_count = 0;
+static size_t record_cap = 0;
+
+static struct str_table tokens;
+static struct posting_list *postings = NULL;
+static size_t postings_cap = 0;
+
+static struct str_table keys;
+
+static uint32_t watermark = 0;
+static uint32_t sync_mark = 0;
+static char *sync_path = NULL;
+static time_t last_sync = 0;
+
+static unsigned long syncs = 0;
+static unsigned long synced = 0;
+static unsigned long ingested = 0;
+static unsigned long searches = 0;
+static unsigned long local_hits = 0;
+
+static uint64_t hash_bytes(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/**
+ * 保证数组容量至少为 need 个元素，按倍数增长
+ *
+ * @return 0表示成功，-1表示内存不足（原数组不变）
+ */
+static int grow_array(void **arr, size_t *cap, size_t need, size_t elem) {
+    if (need <= *cap) return 0;
+
+    size_t n = *cap ? *cap * 2 : 64;
+
+    while (n < need) n *= 2;
+
+    void *p = realloc(*arr, n * elem);
+
+    if (!p) return -1;
+
+    *arr = p;
+    *cap = n;
+
+    return 0;
+}
+
+/**
+ * ====================================================================
+ * 字符串表
+ * ====================================================================
+ */
+
+static void str_table_free(struct str_table *t) {
+    free(t -> slots);
+    free(t -> entries);
+    memory_release(&t -> pool);
+    memset(t, 0, sizeof(*t));
+}
+
+static const char *str_at(const struct str_table *t, size_t index) {
+    return t -> pool.data + t -> entries[index].off;
+}
+
+/**
+ * @return 字符串的编号，不存在时返回 -1
+ */
+static long str_table_find(const struct str_table *t, const char *s, size_t len, uint64_t hash) {
+    if (!t -> slots) return -1;
+
+    for (size_t h = (size_t) hash & t -> mask;; h = (h + 1) & t -> mask) {
+        uint32_t slot = t -> slots[h];
+
+        if (slot == 0) return -1;
+
+        const struct str_entry *e = &t -> entries[slot - 1];
+
+        if (e -> hash == hash && e -> len == len && memcmp(str_at(t, slot - 1), s, len) == 0) return (long) slot - 1;
+    }
+}
+
+static int str_table_rehash(struct str_table *t, size_t nslots) {
+    uint32_t *slots = calloc(nslots, sizeof(uint32_t));
+
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < t -> count; i++) {
+        size_t h = (size_t) t -> entries[i].hash & (nslots - 1);
+
+        while (slots[h]) h = (h + 1) & (nslots - 1);
+
+        slots[h] = (uint32_t) i + 1;
+    }
+
+    free(t -> slots);
+    t -> slots = slots;
+    t -> mask = nslots - 1;
+
+    return 0;
+}
+
+/**
+ * 查找字符串，不存在时加入
+ *
+ * @param added 输出：是否为新加入的字符串
+ * @return 字符串的编号，内存不足时返回 -1
+ */
+static long str_table_intern(struct str_table *t, const char *s, size_t len, bool *added) {
+    uint64_t hash = hash_bytes(s, len);
+    long found = str_table_find(t, s, len, hash);
+
+    *added = false;
+
+    if (found >= 0) return found;
+
+    // 装载因子保持在 1/2 以下
+    if ((t -> count + 1) * 2 > (t -> slots ? t -> mask + 1 : 0) && str_table_rehash(t, t -> slots ? (t -> mask + 1) * 2 : 1024) != 0) return -1;
+    if (grow_array((void **) &t -> entries, &t -> cap, t -> count + 1, sizeof(struct str_entry)) != 0) return -1;
+
+    size_t off = t -> pool.size;
+
+    if (memory_append(&t -> pool, s, len) != 0 || memory_append(&t -> pool, "", 1) != 0) return -1;
+
+    t -> entries[t -> count] = (struct str_entry) { hash, off, (uint32_t) len };
+
+    size_t h = (size_t) hash & t -> mask;
+
+    while (t -> slots[h]) h = (h + 1) & t -> mask;
+
+    t -> slots[h] = (uint32_t) t -> count + 1;
+    *added = true;
+
+    return (long) t -> count++;
+}
+
+/**
+ * ====================================================================
+ * 切词与字段解析
+ * ====================================================================
+ */
+
+/**
+ * 从 *sp 开始取下一个词：ASCII 字母数字转小写，非 ASCII 字节（UTF-8 的马来文/中文姓名）原样保留，
+ * 其余字符都是分隔符；JSON 转义序列（\n、\u00e9 等）也当作分隔符
+ *
+ * @param out 输出缓冲，至少 JUDGMENT_TOKEN_MAX 字节，超长部分截断
+ * @return 词的长度，0 表示没有更多的词
+ */
+static size_t next_token(const char **sp, const char *end, char *out) {
+    const char *s = *sp;
+    size_t n = 0;
+
+    while (s < end) {
+        unsigned char c = (unsigned char) *s;
+
+        if (c == '\\') {
+            if (n) break;
+
+            s += (s + 1 < end && s[1] == 'u') ? 6 : 2;
+            continue;
+        }
+
+        bool word = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+
+        if (!word) {
+            s++;
+
+            if (n) break;
+            continue;
+        }
+
+        if (n < JUDGMENT_TOKEN_MAX) out[n++] = (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : (char) c;
+
+        s++;
+    }
+
+    *sp = s > end ? end : s;
+
+    return n;
+}
+
+/**
+ * 按别名列表取记录中第一个存在的字段值（原始 JSON，字符串带引号）
+ */
+static int find_field(const char *obj, size_t len, const char *const *names, const char **value, size_t *value_len) {
+    for (size_t i = 0; names[i]; i++) {
+        if (json_path_find(obj, len, names[i], value, value_len) == 0 && !(*value_len == 4 && memcmp(*value, "null", 4) == 0)) return 0;
+    }
+
+    return -1;
+}
+
+static bool parse_digits(const char *s, size_t n, unsigned int *out) {
+    unsigned int v = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+
+        v = v * 10 + (unsigned int) (s[i] - '0');
+    }
+
+    *out = v;
+
+    return true;
+}
+
+/**
+ * 把判决日期转换成 YYYYMMDD 整数，便于比较；支持 /Date(ms)/、YYYY-MM-DD... 和 DD/MM/YYYY
+ *
+ * @return 日期，无法识别时返回 0
+ */
+static uint32_t parse_date(const char *v, size_t len) {
+    if (len >= 2 && v[0] == '"') v++, len -= 2;
+
+    const char *ms = memmem(v, len, "Date(", 5);
+
+    if (ms) {
+        time_t t = (time_t) (strtoll(ms + 5, NULL, 10) / 1000) + STORE_TZ_OFFSET;
+        struct tm tm;
+
+        if (!gmtime_r(&t, &tm)) return 0;
+
+        return (uint32_t) ((tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday);
+    }
+
+    unsigned int y, m, d;
+
+    if (len < 10) return 0;
+
+    if (v[4] == '-' && parse_digits(v, 4, &y) && parse_digits(v + 5, 2, &m) && parse_digits(v + 8, 2, &d)) {
+    } else if ((v[2] == '/' || v[2] == '-' || v[2] == '.') && v[5] == v[2] && parse_digits(v, 2, &d) && parse_digits(v + 3, 2, &m) && parse_digits(v + 6, 4, &y)) {
+    } else {
+        return 0;
+    }
+
+    if (m < 1 || m > 12 || d < 1 || d > 31) return 0;
+
+    return y * 10000 + m * 100 + d;
+}
+
+static uint32_t record_date(const char *obj, size_t len) {
+    const char *v;
+    size_t vlen;
+
+    return find_field(obj, len, DATE_FIELDS, &v, &vlen) == 0 ? parse_date(v, vlen) : 0;
+}
+
+/**
+ * 去重键：DocumentId 或案号的原始值；都没有时用整条记录
+ */
+static void record_key(const char *obj, size_t len, const char **key, size_t *key_len) {
+    if (find_field(obj, len, KEY_FIELDS, key, key_len) == 0) {
+        if (*key_len > STORE_KEY_MAX) *key_len = STORE_KEY_MAX;
+        return;
+    }
+
+    *key = obj;
+    *key_len = len;
+}
+
+/**
+ * 从 p 开始跳过一个 JSON 值（输入已经通过 json_path_valid 校验），返回其后的位置
+ */
+static const char *value_end(const char *p, const char *end) {
+    int depth = 0;
+
+    while (p < end) {
+        char c = *p++;
+
+        if (c == '"') {
+            while (p < end && *p != '"') p += (*p == '\\') ? 2 : 1;
+
+            p++;
+
+            if (depth == 0) return p;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth <= 0) return depth == 0 ? p : p - 1;
+        } else if (depth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+            return p - 1;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * ====================================================================
+ * 索引
+ * ====================================================================
+ */
+
+static int add_posting(const char *tok, size_t len, uint32_t id) {
+    bool added;
+
+    if (grow_array((void **) &postings, &postings_cap, tokens.count + 1, sizeof(struct posting_list)) != 0) return -1;
+
+    long t = str_table_intern(&tokens, tok, len, &added);
+
+    if (t < 0) return -1;
+
+    struct posting_list *pl = &postings[t];
+
+    if (added) memset(pl, 0, sizeof(*pl));
+
+    // 同一条记录里重复出现的词只记一次；记录号递增，只需看最后一个
+    if (pl -> count && pl -> ids[pl -> count - 1] == id) return 0;
+
+    if (pl -> count == pl -> cap) {
+        uint32_t cap = pl -> cap ? pl -> cap * 2 : 4;
+        uint32_t *ids = realloc(pl -> ids, cap * sizeof(uint32_t));
+
+        if (!ids) return -1;
+
+        pl -> ids = ids;
+        pl -> cap = cap;
+    }
+
+    pl -> ids[pl -> count++] = id;
+
+    return 0;
+}
+
+/**
+ * 把一条已落盘的记录加入索引；需持有写锁
+ *
+ * @param obj 记录原文
+ * @param offset 记录在文件中的偏移
+ * @return 1表示已加入，0表示已存在（去重），-1表示内存不足
+ */
+static int index_record(const char *obj, size_t len, uint64_t offset) {
+    const char *key;
+    size_t key_len;
+    bool added;
+
+    record_key(obj, len, &key, &key_len);
+
+    if (str_table_intern(&keys, key, key_len, &added) < 0) return -1;
+    if (!added) return 0;
+    if (grow_array((void **) &records, &record_cap, record_count + 1, sizeof(struct store_record)) != 0) return -1;
+
+    uint32_t id = (uint32_t) record_count;
+    uint32_t date = record_date(obj, len);
+
+    records[record_count++] = (struct store_record) { offset, (uint32_t) len, date };
+
+    if (date > watermark) watermark = date;
+
+    for (size_t i = 0; INDEX_FIELDS[i]; i++) {
+        const char *v;
+        size_t vlen;
+
+        if (json_path_find(obj, len, INDEX_FIELDS[i], &v, &vlen) != 0) continue;
+
+        const char *p = v;
+        const char *end = v + vlen;
+        char tok[JUDGMENT_TOKEN_MAX];
+        size_t n;
+
+        while ((n = next_token(&p, end, tok)) > 0) {
+            if (n >= 2 && add_posting(tok, n, id) != 0) return -1;
+        }
+    }
+
+    return 1;
+}
+
+static void store_free_locked(void) {
+    for (size_t i = 0; i < tokens.count; i++) free(postings[i].ids);
+
+    free(postings);
+    free(records);
+    str_table_free(&tokens);
+    str_table_free(&keys);
+
+    postings = NULL;
+    postings_cap = 0;
+    records = NULL;
+    record_count = 0;
+    record_cap = 0;
+    watermark = 0;
+    sync_mark = 0;
+
+    free(sync_path);
+    sync_path = NULL;
+
+    if (store_fd >= 0) close(store_fd);
+
+    __atomic_store_n(&store_fd, -1, __ATOMIC_RELAXED);
+    store_size = 0;
+}
+
+/**
+ * ====================================================================
+ * 打开与写入
+ * ====================================================================
+ */
+
+static int ingest_start(void);
+
+static void ingest_stop(void);
+
+/**
+ * 读入 <path>.sync 里保存的同步水位；文件不存在或内容无效时水位为 0（下次同步从头回填）
+ */
+static void load_sync_mark(const char *path) {
+    size_t n = strlen(path);
+    char *sp = malloc(n + sizeof(".sync"));
+
+    if (!sp) return;
+
+    memcpy(sp, path, n);
+    memcpy(sp + n, ".sync", sizeof(".sync"));
+
+    unsigned int mark = 0;
+    FILE *f = fopen(sp, "r");
+
+    if (f) {
+        if (fscanf(f, "%8u", &mark) != 1) mark = 0;
+
+        fclose(f);
+    }
+
+    pthread_rwlock_wrlock(&store_lock);
+
+    free(sync_path);
+    sync_path = sp;
+    sync_mark = mark;
+
+    pthread_rwlock_unlock(&store_lock);
+}
+
+/**
+ * 推进并保存同步水位（先写临时文件再改名，不会留下半截内容）；需持有写锁
+ */
+static void save_sync_mark_locked(uint32_t mark) {
+    if (mark <= sync_mark) return;
+
+    sync_mark = mark;
+
+    if (!sync_path) return;
+
+    char tmp[4096];
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", sync_path) >= (int) sizeof(tmp)) return;
+
+    FILE *f = fopen(tmp, "w");
+
+    if (!f) return;
+
+    bool ok = fprintf(f, "%08u\n", mark) > 0;
+
+    ok = fflush(f) == 0 && fdatasync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmp, sync_path) != 0) unlink(tmp);
+}
+
+/**
+ * 打开（不存在时创建）判决镜像文件并重建内存索引
+ *
+ * @param path NDJSON 文件路径
+ * @return 0表示成功，-1表示失败（errno 有效）
+ */
+int judgment_store_open(const char *path) {
+    judgment_store_close();
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+
+    if (fd < 0) return -1;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    const char *map = NULL;
+
+    if (size > 0) {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+
+        madvise((void *) map, size, MADV_SEQUENTIAL);
+    }
+
+    pthread_rwlock_wrlock(&store_lock);
+
+    __atomic_store_n(&store_fd, fd, __ATOMIC_RELAXED);
+
+    const char *p = map;
+    const char *end = map ? map + size : NULL;
+    size_t skipped = 0;
+    int rc = 0;
+
+    while (p && p < end) {
+        const char *nl = memchr(p, '\n', (size_t) (end - p));
+
+        // 没有换行的最后一行是写到一半的记录
+        if (!nl) break;
+
+        size_t len = (size_t) (nl - p);
+
+        if (len > 0 && p[0] == '{' && json_path_valid(p, len)) {
+            if (index_record(p, len, (uint64_t) (p - map)) < 0) {
+                rc = -1;
+                break;
+            }
+        } else if (len > 0) {
+            skipped++;
+        }
+
+        p = nl + 1;
+    }
+
+    store_size = p ? (uint64_t) (p - map) : 0;
+
+    if (rc == 0 && store_size < size) {
+        fprintf(stderr, "[判决镜像] 截掉文件末尾不完整的 %zu 字节\n", size - (size_t) store_size);
+
+        if (ftruncate(fd, (off_t) store_size) != 0) rc = -1;
+    }
+
+    if (skipped) fprintf(stderr, "[判决镜像] 跳过 %zu 行无法解析的记录\n", skipped);
+
+    if (rc != 0) {
+        int saved = errno ? errno : ENOMEM;
+
+        store_free_locked();
+        errno = saved;
+    }
+
+    pthread_rwlock_unlock(&store_lock);
+
+    if (map) munmap((void *) map, size);
+
+    if (rc == 0) load_sync_mark(path);
+
+    if (rc == 0 && ingest_start() != 0) {
+        judgment_store_close();
+        return -1;
+    }
+
+    return rc;
+}
+
+/**
+ * 关闭镜像：先等入库线程把已排队的页写完，再落盘并释放索引
+ */
+void judgment_store_close(void) {
+    ingest_stop();
+
+    pthread_rwlock_wrlock(&store_lock);
+
+    if (store_fd >= 0) fdatasync(store_fd);
+
+    store_free_locked();
+
+    pthread_rwlock_unlock(&store_lock);
+}
+
+bool judgment_store_loaded(void) {
+    return __atomic_load_n(&store_fd, __ATOMIC_RELAXED) >= 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+
+        data += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+struct ingest_item {
+    size_t start;
+    size_t len;
+    size_t key_off;
+    size_t key_len;
+};
+
+/**
+ * 把一页上游响应（{"Data":[...]} 或直接是数组）里的判决存入镜像，已存在的跳过
+ *
+ * 新记录先整批追加写入文件，写成功后才加入索引，文件和索引不会不一致。
+ *
+ * @param json 上游响应原文
+ * @param len 长度
+ * @param oldest 输出：本页最早的判决日期（YYYYMMDD，无法识别为 0），可为 NULL
+ * @param latest 输出：本页最新的判决日期，可为 NULL
+ * @return 新存入的判决数，-1表示镜像未打开、输入无效或写入失败
+ */
+static int judgment_store_ingest_range(const char *json, size_t len, uint32_t *oldest, uint32_t *latest) {
+    const char *data = json;
+    size_t dlen = len;
+
+    if (oldest) *oldest = 0;
+    if (latest) *latest = 0;
+
+    if (!judgment_store_loaded() || !json || !json_path_valid(json, len)) return -1;
+
+    while (dlen > 0 && (*data == ' ' || *data == '\t' || *data == '\r' || *data == '\n')) data++, dlen--;
+
+    if (dlen == 0 || (*data != '[' && (json_path_find(json, len, "Data", &data, &dlen) != 0 || *data != '['))) return -1;
+
+    struct ingest_item items[64];
+    size_t count = 0;
+    size_t cap = sizeof(items) / sizeof(items[0]);
+    struct ingest_item *list = items;
+    struct memory batch = {0};
+    int added = 0;
+    int rc = 0;
+
+    pthread_rwlock_wrlock(&store_lock);
+
+    if (store_fd < 0) {
+        pthread_rwlock_unlock(&store_lock);
+        return -1;
+    }
+
+    const char *p = data + 1;
+    const char *end = data + dlen - 1;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == ',')) p++;
+
+        if (p >= end) break;
+
+        const char *obj = p;
+
+        p = value_end(p, end);
+
+        if (*obj != '{') continue;
+
+        if (count == cap) {
+            struct ingest_item *grown = malloc(cap * 2 * sizeof(*grown));
+
+            if (!grown) {
+                rc = -1;
+                break;
+            }
+
+            memcpy(grown, list, count * sizeof(*grown));
+
+            if (list != items) free(list);
+
+            list = grown;
+            cap *= 2;
+        }
+
+        // 一行一条：记录里字符串外的换行换成空格（JSON 字符串内不会出现原始换行）；
+        // 去重键也从换行后的副本里取，和重启后从文件读到的一致
+        struct ingest_item it = { batch.size, (size_t) (p - obj), 0, 0 };
+
+        if (memory_reserve(&batch, batch.size + it.len + 1) != 0) {
+            rc = -1;
+            break;
+        }
+
+        char *copy = batch.data + it.start;
+
+        for (size_t i = 0; i < it.len; i++) copy[i] = (obj[i] == '\n' || obj[i] == '\r') ? ' ' : obj[i];
+
+        uint32_t date = record_date(copy, it.len);
+        const char *key;
+
+        if (oldest && date && (*oldest == 0 || date < *oldest)) *oldest = date;
+        if (latest && date > *latest) *latest = date;
+
+        record_key(copy, it.len, &key, &it.key_len);
+        it.key_off = (size_t) (key - batch.data);
+
+        bool dup = str_table_find(&keys, key, it.key_len, hash_bytes(key, it.key_len)) >= 0;
+
+        // 同一页里重复出现的判决
+        for (size_t i = 0; i < count && !dup; i++) {
+            dup = list[i].key_len == it.key_len && memcmp(batch.data + list[i].key_off, key, it.key_len) == 0;
+        }
+
+        if (dup) continue;
+
+        copy[it.len] = '\n';
+        batch.size += it.len + 1;
+        list[count++] = it;
+    }
+
+    if (rc == 0 && count > 0) {
+        if (write_all(store_fd, batch.data, batch.size) != 0) {
+            fprintf(stderr, "[判决镜像] 写入失败: %s\n", strerror(errno));
+
+            // 半截写入截掉，保证文件里每行都是完整记录
+            if (ftruncate(store_fd, (off_t) store_size) != 0) perror("[判决镜像] ftruncate");
+
+            rc = -1;
+        } else {
+            for (size_t i = 0; i < count && rc == 0; i++) {
+                int r = index_record(batch.data + list[i].start, list[i].len, store_size + list[i].start);
+
+                if (r < 0) rc = -1;
+                else added += r;
+            }
+
+            store_size += batch.size;
+        }
+    }
+
+    pthread_rwlock_unlock(&store_lock);
+
+    if (list != items) free(list);
+
+    memory_release(&batch);
+
+    if (added) __atomic_fetch_add(&ingested, (unsigned long) added, __ATOMIC_RELAXED);
+
+    return rc == 0 ? added : -1;
+}
+
+/**
+ * 把一页上游响应里的判决存入镜像，已存在的跳过；不会推进同步水位
+ *
+ * @param json 上游响应原文
+ * @param len 长度
+ * @param oldest 输出：本页最早的判决日期（YYYYMMDD，无法识别为 0），可为 NULL
+ * @return 新存入的判决数，-1表示镜像未打开、输入无效或写入失败
+ */
+int judgment_store_ingest(const char *json, size_t len, uint32_t *oldest) {
+    return judgment_store_ingest_range(json, len, oldest, NULL);
+}
+
+/**
+ * ====================================================================
+ * 入库队列
+ * ====================================================================
+ */
+
+struct ingest_page {
+    struct ingest_page *next;
+    char *json;
+    size_t len;
+};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t ingest_thread;
+static bool ingest_running = false;
+static struct ingest_page *queue_head = NULL;
+static struct ingest_page *queue_tail = NULL;
+static size_t queue_depth = 0;
+static unsigned long ingest_dropped = 0;
+
+/**
+ * 入库线程：每次取走整条队列逐页入库；停止时先把已排队的页处理完
+ */
+static void *ingest_loop(void *arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&queue_lock);
+
+    for (;;) {
+        while (!queue_head && ingest_running) pthread_cond_wait(&queue_wake, &queue_lock);
+
+        struct ingest_page *page = queue_head;
+
+        if (!page) break;
+
+        queue_head = NULL;
+        queue_tail = NULL;
+        queue_depth = 0;
+
+        pthread_mutex_unlock(&queue_lock);
+
+        while (page) {
+            struct ingest_page *next = page -> next;
+
+            judgment_store_ingest(page -> json, page -> len, NULL);
+
+            free(page -> json);
+            free(page);
+            page = next;
+        }
+
+        pthread_mutex_lock(&queue_lock);
+    }
+
+    pthread_mutex_unlock(&queue_lock);
+
+    return NULL;
+}
+
+static int ingest_start(void) {
+    pthread_mutex_lock(&queue_lock);
+
+    ingest_running = true;
+
+    if (pthread_create(&ingest_thread, NULL, ingest_loop, NULL) != 0) ingest_running = false;
+
+    bool ok = ingest_running;
+
+    pthread_mutex_unlock(&queue_lock);
+
+    return ok ? 0 : -1;
+}
+
+static void ingest_stop(void) {
+    pthread_mutex_lock(&queue_lock);
+
+    if (!ingest_running) {
+        pthread_mutex_unlock(&queue_lock);
+        return;
+    }
+
+    ingest_running = false;
+    pthread_cond_signal(&queue_wake);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(ingest_thread, NULL);
+}
+
+/**
+ * 把一页上游响应交给入库线程（供上游事件循环等不能阻塞的线程使用）
+ *
+ * 队列里已有 JUDGMENT_INGEST_QUEUE_MAX 页时丢弃这一页并计数，镜像之后由增量同步补齐。
+ *
+ * @param json 上游响应原文（malloc 分配），无论成功与否所有权都转交给这里
+ * @param len 长度
+ * @return 0表示已排队，-1表示镜像未打开、队列已满或内存不足（json 已释放）
+ */
+int judgment_store_ingest_async(char *json, size_t len) {
+    struct ingest_page *page = json ? malloc(sizeof(*page)) : NULL;
+
+    pthread_mutex_lock(&queue_lock);
+
+    if (!page || !ingest_running || queue_depth >= JUDGMENT_INGEST_QUEUE_MAX) {
+        if (ingest_running) ingest_dropped++;
+
+        pthread_mutex_unlock(&queue_lock);
+
+        free(page);
+        free(json);
+
+        return -1;
+    }
+
+    page -> next = NULL;
+    page -> json = json;
+    page -> len = len;
+
+    if (queue_tail) queue_tail -> next = page;
+    else queue_head = page;
+
+    queue_tail = page;
+    queue_depth++;
+
+    pthread_cond_signal(&queue_wake);
+    pthread_mutex_unlock(&queue_lock);
+
+    return 0;
+}
+
+/**
+ * ====================================================================
+ * 查询
+ * ====================================================================
+ */
+
+static const uint32_t *lower_bound(const uint32_t *p, const uint32_t *end, uint32_t v) {
+    size_t n = (size_t) (end - p);
+
+    while (n > 0) {
+        size_t half = n / 2;
+
+        if (p[half] < v) {
+            p += half + 1;
+            n -= half + 1;
+        } else {
+            n = half;
+        }
+    }
+
+    return p;
+}
+
+static int compare_lists(const void *a, const void *b) {
+    const struct posting_list *x = *(const struct posting_list *const *) a;
+    const struct posting_list *y = *(const struct posting_list *const *) b;
+
+    return (x -> count > y -> count) - (x -> count < y -> count);
+}
+
+/**
+ * 结果排序：判决日期从新到旧，同一天的后入库的在前；查询期间持有读锁，records 不会变
+ */
+static bool ranks_before(uint32_t x, uint32_t y) {
+    if (records[x].date != records[y].date) return records[x].date > records[y].date;
+
+    return x > y;
+}
+
+static int compare_hits(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return ranks_before(x, y) ? -1 : ranks_before(y, x) ? 1 : 0;
+}
+
+/**
+ * 把一条命中放进最多 max 条的堆，堆顶是其中排名最靠后的；"法院" 这类宽泛的词可能命中整个镜像，
+ * 只保留排名最前的 max 条，不必对全部命中排序
+ */
+static void heap_offer(uint32_t *heap, size_t *n, size_t max, uint32_t id) {
+    size_t i;
+
+    if (*n < max) {
+        for (i = (*n)++; i > 0 && ranks_before(heap[(i - 1) / 2], id); i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+
+        heap[i] = id;
+        return;
+    }
+
+    if (!ranks_before(id, heap[0])) return;
+
+    for (i = 0;;) {
+        size_t c = 2 * i + 1;
+
+        if (c >= *n) break;
+        if (c + 1 < *n && ranks_before(heap[c], heap[c + 1])) c++;
+        if (!ranks_before(id, heap[c])) break;
+
+        heap[i] = heap[c];
+        i = c;
+    }
+
+    heap[i] = id;
+}
+
+/**
+ * 在本地镜像中查询判决：查询词切词后每个词（至少 2 个字符）都要在当事人、案号、法官或法院中出现
+ *
+ * @param query 查询词，大小写和标点不影响结果
+ * @param max 最多返回的判决数
+ * @param returned 输出：返回的判决数
+ * @param total 输出：命中的判决总数
+ * @param len 输出：返回字符串的长度
+ * @return 以 "\n" 开头、",\n" 分隔的判决原文（可直接放进 JSON 数组），需 free；
+ *         没有命中、镜像未打开或内存不足时返回 NULL
+ */
+char *judgment_store_search(const char *query, size_t max, size_t *returned, size_t *total, size_t *len) {
+    char words[JUDGMENT_QUERY_MAX_TOKENS][JUDGMENT_TOKEN_MAX];
+    size_t word_len[JUDGMENT_QUERY_MAX_TOKENS];
+    size_t nwords = 0;
+
+    *returned = 0;
+    *total = 0;
+    *len = 0;
+
+    if (!query || max == 0 || !judgment_store_loaded()) return NULL;
+
+    const char *p = query;
+    const char *qend = query + strlen(query);
+    size_t n;
+
+    while (nwords < JUDGMENT_QUERY_MAX_TOKENS && (n = next_token(&p, qend, words[nwords])) > 0) {
+        if (n < 2) continue;
+
+        bool seen = false;
+
+        for (size_t i = 0; i < nwords && !seen; i++) seen = word_len[i] == n && memcmp(words[i], words[nwords], n) == 0;
+
+        if (!seen) word_len[nwords++] = n;
+    }
+
+    if (nwords == 0) return NULL;
+
+    __atomic_fetch_add(&searches, 1, __ATOMIC_RELAXED);
+
+    const struct posting_list *lists[JUDGMENT_QUERY_MAX_TOKENS];
+    uint32_t *hits = NULL;
+    size_t nhits = 0;
+    char *out = NULL;
+
+    pthread_rwlock_rdlock(&store_lock);
+
+    for (size_t i = 0; i < nwords; i++) {
+        long t = store_fd >= 0 ? str_table_find(&tokens, words[i], word_len[i], hash_bytes(words[i], word_len[i])) : -1;
+
+        if (t < 0) goto done;
+
+        lists[i] = &postings[t];
+    }
+
+    // 从最短的列表出发，在其余列表里二分查找；各列表都递增，查找起点随之前移
+    qsort(lists, nwords, sizeof(lists[0]), compare_lists);
+
+    const uint32_t *cursor[JUDGMENT_QUERY_MAX_TOKENS];
+
+    for (size_t i = 0; i < nwords; i++) cursor[i] = lists[i] -> ids;
+
+    size_t nheap = 0;
+
+    hits = malloc((lists[0] -> count < max ? lists[0] -> count : max) * sizeof(uint32_t));
+
+    if (!hits) goto done;
+
+    for (uint32_t k = 0; k < lists[0] -> count; k++) {
+        uint32_t id = lists[0] -> ids[k];
+        bool all = true;
+
+        for (size_t i = 1; i < nwords && all; i++) {
+            const uint32_t *lend = lists[i] -> ids + lists[i] -> count;
+
+            cursor[i] = lower_bound(cursor[i], lend, id);
+            all = cursor[i] < lend && *cursor[i] == id;
+        }
+
+        if (all) {
+            heap_offer(hits, &nheap, max, id);
+            nhits++;
+        }
+    }
+
+    if (nhits == 0) goto done;
+
+    qsort(hits, nheap, sizeof(uint32_t), compare_hits);
+
+    size_t take = nheap;
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < take; i++) bytes += records[hits[i]].len + 2;
+
+    out = malloc(bytes + 1);
+
+    if (!out) goto done;
+
+    char *o = out;
+
+    for (size_t i = 0; i < take; i++) {
+        const struct store_record *r = &records[hits[i]];
+
+        if (i) *o++ = ',';
+
+        *o++ = '\n';
+
+        if (pread(store_fd, o, r -> len, (off_t) r -> offset) != (ssize_t) r -> len) {
+            free(out);
+            out = NULL;
+            goto done;
+        }
+
+        o += r -> len;
+    }
+
+    *o = '\0';
+    *returned = take;
+    *total = nhits;
+    *len = (size_t) (o - out);
+
+    __atomic_fetch_add(&local_hits, 1, __ATOMIC_RELAXED);
+
+done:
+    pthread_rwlock_unlock(&store_lock);
+
+    free(hits);
+
+    return out;
+}
+
+/**
+ * ====================================================================
+ * 增量同步
+ * ====================================================================
+ */
+
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sync_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t sync_thread;
+static bool sync_running = false;
+static bool sync_stopping = false;
+static int sync_interval = JUDGMENT_SYNC_INTERVAL;
+
+/**
+ * 执行一次增量同步：按判决日期从新到旧翻页，读到比同步水位更旧的判决时停止
+ *
+ * 镜像为空（没有水位）时一直翻到 JUDGMENT_SYNC_MAX_PAGES 页，即首次回填。
+ * 有水位时不受页数上限约束，一直翻到水位为止：积压再多也要补齐中间的空档，
+ * 否则每次都在上限处停下，水位永远推进不了。
+ * 水位当天的判决可能在上次同步之后才发布，所以要翻到严格更旧的日期才停。
+ * 只有翻到了水位（或上游已经没有更多页）时才把水位推进到本次看到的最新日期；
+ * 中途失败或退出时水位不动，下次从头再翻（已入库的判决按 DocumentId 或案号去重）。
+ * 在后台线程或测试中调用，会阻塞在上游请求上。
+ *
+ * @return 新存入的判决数，-1表示镜像未打开或上游请求失败
+ */
+int judgment_store_sync_once(void) {
+    if (!judgment_store_loaded()) return -1;
+
+    pthread_rwlock_rdlock(&store_lock);
+    uint32_t mark = sync_mark;
+    pthread_rwlock_unlock(&store_lock);
+
+    int added = 0;
+    bool failed = false;
+    bool covered = false;
+    uint32_t newest = 0;
+
+    for (int page = 1; mark || page <= JUDGMENT_SYNC_MAX_PAGES; page++) {
+        EJudgmentResponse *resp = ejudgment_search(
+            "", "ALL", "", "", "", "", NULL, NULL, NULL, NULL, page, "DATE_OF_AP_DESC", 3, 3000
+        );
+
+        if (!resp || !resp -> raw_json) {
+            ejudgment_response_free(resp);
+            failed = true;
+            break;
+        }
+
+        size_t len = strlen(resp -> raw_json);
+        uint32_t oldest = 0;
+        uint32_t latest = 0;
+        long pages = 1;
+        int n = judgment_store_ingest_range(resp -> raw_json, len, &oldest, &latest);
+
+        json_path_int(resp -> raw_json, len, "TotalPage", &pages);
+        ejudgment_response_free(resp);
+
+        if (n < 0) {
+            failed = true;
+            break;
+        }
+
+        added += n;
+
+        if (latest > newest) newest = latest;
+
+        // 空页说明上游已经没有更早的判决了，同样算翻到底
+        if (page >= pages || !latest || (mark && oldest && oldest < mark)) {
+            covered = true;
+            break;
+        }
+
+        // 退出时不必等剩下的页
+        if (__atomic_load_n(&sync_stopping, __ATOMIC_RELAXED)) break;
+    }
+
+    // 首次回填按设计只翻到页数上限，翻完也算同步过
+    if (!failed && !mark && !__atomic_load_n(&sync_stopping, __ATOMIC_RELAXED)) covered = true;
+
+    pthread_rwlock_wrlock(&store_lock);
+
+    if (store_fd >= 0) {
+        fdatasync(store_fd);
+
+        if (covered) save_sync_mark_locked(newest);
+    }
+
+    pthread_rwlock_unlock(&store_lock);
+
+    __atomic_fetch_add(&syncs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&synced, (unsigned long) added, __ATOMIC_RELAXED);
+
+    if (!failed) __atomic_store_n(&last_sync, time(NULL), __ATOMIC_RELAXED);
+
+    return failed ? -1 : added;
+}
+
+static void *sync_loop(void *arg) {
+    (void) arg;
+
+    time_t due = 0;
+
+    pthread_mutex_lock(&sync_lock);
+
+    while (sync_running) {
+        time_t now = time(NULL);
+
+        if (now < due) {
+            struct timespec ts = { .tv_sec = due, .tv_nsec = 0 };
+            pthread_cond_timedwait(&sync_wake, &sync_lock, &ts);
+            continue;
+        }
+
+        pthread_mutex_unlock(&sync_lock);
+
+        int added = judgment_store_sync_once();
+
+        if (added < 0) fprintf(stderr, "[判决镜像] 增量同步失败，%d 秒后重试\n", JUDGMENT_SYNC_RETRY_SECONDS);
+
+        pthread_mutex_lock(&sync_lock);
+
+        due = time(NULL) + (added < 0 ? JUDGMENT_SYNC_RETRY_SECONDS : sync_interval);
+    }
+
+    pthread_mutex_unlock(&sync_lock);
+
+    return NULL;
+}
+
+/**
+ * 启动后台增量同步线程（第一次同步立即在后台开始）
+ *
+ * @param interval 同步间隔（秒），<= 0 时不启动
+ * @return 0表示成功（或未启用），-1表示镜像未打开或线程创建失败
+ */
+int judgment_store_sync_start(int interval) {
+    if (interval <= 0) return 0;
+    if (!judgment_store_loaded()) return -1;
+
+    pthread_mutex_lock(&sync_lock);
+
+    if (sync_running) {
+        pthread_mutex_unlock(&sync_lock);
+        return 0;
+    }
+
+    sync_interval = interval;
+    sync_running = true;
+    __atomic_store_n(&sync_stopping, false, __ATOMIC_RELAXED);
+
+    if (pthread_create(&sync_thread, NULL, sync_loop, NULL) != 0) {
+        sync_running = false;
+        pthread_mutex_unlock(&sync_lock);
+        return -1;
+    }
+
+    pthread_mutex_unlock(&sync_lock);
+
+    return 0;
+}
+
+/**
+ * 停止后台同步线程；正在进行的同步翻完当前页后结束
+ */
+void judgment_store_sync_stop(void) {
+    pthread_mutex_lock(&sync_lock);
+
+    if (!sync_running) {
+        pthread_mutex_unlock(&sync_lock);
+        return;
+    }
+
+    sync_running = false;
+    __atomic_store_n(&sync_stopping, true, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&sync_wake);
+    pthread_mutex_unlock(&sync_lock);
+
+    pthread_join(sync_thread, NULL);
+}
+
+void judgment_store_get_stats(struct judgment_store_stats *out) {
+    pthread_rwlock_rdlock(&store_lock);
+
+    out -> judgments = record_count;
+    out -> tokens = tokens.count;
+    out -> file_bytes = (size_t) store_size;
+    out -> watermark = watermark;
+    out -> sync_watermark = sync_mark;
+
+    pthread_rwlock_unlock(&store_lock);
+
+    out -> last_sync = __atomic_load_n(&last_sync, __ATOMIC_RELAXED);
+    out -> syncs = __atomic_load_n(&syncs, __ATOMIC_RELAXED);
+    out -> synced = __atomic_load_n(&synced, __ATOMIC_RELAXED);
+    out -> ingested = __atomic_load_n(&ingested, __ATOMIC_RELAXED);
+    out -> searches = __atomic_load_n(&searches, __ATOMIC_RELAXED);
+    out -> local_hits = __atomic_load_n(&local_hits, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&queue_lock);
+
+    out -> ingest_queued = queue_depth;
+    out -> ingest_dropped = ingest_dropped;
+
+    pthread_mutex_unlock(&queue_lock);
+}
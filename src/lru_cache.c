@@ -0,0 +1,276 @@
+/**
+ * @file lru_cache.c
+ * @brief 线程安全的 LRU + TTL 内存缓存
+ *
+ * 键为字符串，值为任意字节串（存取时都会复制一份）。
+ * 哈希表负责 O(1) 查找，双向链表维护最近使用顺序：
+ * 超出容量时淘汰最久未用的条目，读取时发现过期的条目直接丢弃。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../include/lru_cache.h"
+
+struct lru_entry {
+    char *key;
+    void *value;
+    size_t len;
+    time_t expires_at;
+    uint32_t hash;
+    struct lru_entry *hnext;
+    struct lru_entry *prev;
+    struct lru_entry *next;
+};
+
+struct lru_cache {
+    pthread_mutex_t lock;
+    struct lru_entry **buckets;
+    size_t nbuckets;
+    struct lru_entry *head;
+    struct lru_entry *tail;
+    struct lru_cache_stats stats;
+};
+
+static uint32_t hash_key(const char *s) {
+    uint32_t h = 2166136261u;
+
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static time_t now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static void list_unlink(struct lru_cache *cache, struct lru_entry *e) {
+    if (e -> prev) e -> prev -> next = e -> next;
+    else cache -> head = e -> next;
+
+    if (e -> next) e -> next -> prev = e -> prev;
+    else cache -> tail = e -> prev;
+
+    e -> prev = e -> next = NULL;
+}
+
+static void list_push_front(struct lru_cache *cache, struct lru_entry *e) {
+    e -> prev = NULL;
+    e -> next = cache -> head;
+
+    if (cache -> head) cache -> head -> prev = e;
+    else cache -> tail = e;
+
+    cache -> head = e;
+}
+
+static struct lru_entry **find_slot(struct lru_cache *cache, const char *key, uint32_t hash) {
+    struct lru_entry **pp = &cache -> buckets[hash & (cache -> nbuckets - 1)];
+
+    while (*pp && ((*pp) -> hash != hash || strcmp((*pp) -> key, key) != 0)) pp = &(*pp) -> hnext;
+
+    return pp;
+}
+
+/**
+ * 从哈希表和链表中删除条目并释放（持锁调用）
+ */
+static void remove_entry(struct lru_cache *cache, struct lru_entry *e) {
+    struct lru_entry **pp = find_slot(cache, e -> key, e -> hash);
+
+    if (*pp) *pp = e -> hnext;
+
+    list_unlink(cache, e);
+
+    free(e -> key);
+    free(e -> value);
+    free(e);
+
+    cache -> stats.size--;
+}
+
+/**
+ * 创建缓存
+ *
+ * @param capacity 最大条目数
+ * @return 缓存句柄，失败返回 NULL
+ */
+struct lru_cache *lru_cache_new(size_t capacity) {
+    if (capacity == 0) return NULL;
+
+    struct lru_cache *cache = calloc(1, sizeof(*cache));
+
+    if (!cache) return NULL;
+
+    cache -> nbuckets = 16;
+    while (cache -> nbuckets < capacity) cache -> nbuckets <<= 1;
+
+    cache -> buckets = calloc(cache -> nbuckets, sizeof(struct lru_entry *));
+
+    if (!cache -> buckets) {
+        free(cache);
+        return NULL;
+    }
+
+    cache -> stats.capacity = capacity;
+    pthread_mutex_init(&cache -> lock, NULL);
+
+    return cache;
+}
+
+/**
+ * 销毁缓存及其全部条目
+ */
+void lru_cache_free(struct lru_cache *cache) {
+    if (!cache) return;
+
+    struct lru_entry *e = cache -> head;
+
+    while (e) {
+        struct lru_entry *next = e -> next;
+
+        free(e -> key);
+        free(e -> value);
+        free(e);
+
+        e = next;
+    }
+
+    pthread_mutex_destroy(&cache -> lock);
+    free(cache -> buckets);
+    free(cache);
+}
+
+/**
+ * 读取缓存
+ *
+ * @param cache 缓存
+ * @param key 键
+ * @param value 命中时输出值的副本（调用者负责 free）
+ * @param len 命中时输出值的长度
+ * @return 1表示命中，0表示未命中或已过期
+ */
+int lru_cache_get(struct lru_cache *cache, const char *key, void **value, size_t *len) {
+    if (!cache || !key) return 0;
+
+    pthread_mutex_lock(&cache -> lock);
+
+    struct lru_entry *e = *find_slot(cache, key, hash_key(key));
+
+    if (e && e -> expires_at <= now_seconds()) {
+        remove_entry(cache, e);
+        cache -> stats.expirations++;
+        e = NULL;
+    }
+
+    if (!e) {
+        cache -> stats.misses++;
+        pthread_mutex_unlock(&cache -> lock);
+        return 0;
+    }
+
+    void *copy = malloc(e -> len ? e -> len : 1);
+
+    if (!copy) {
+        cache -> stats.misses++;
+        pthread_mutex_unlock(&cache -> lock);
+        return 0;
+    }
+
+    memcpy(copy, e -> value, e -> len);
+
+    *value = copy;
+    *len = e -> len;
+
+    list_unlink(cache, e);
+    list_push_front(cache, e);
+
+    cache -> stats.hits++;
+
+    pthread_mutex_unlock(&cache -> lock);
+
+    return 1;
+}
+
+/**
+ * 写入缓存（已存在则覆盖），超出容量时淘汰最久未用的条目
+ *
+ * @param cache 缓存
+ * @param key 键
+ * @param value 值（会被复制）
+ * @param len 值长度
+ * @param ttl_seconds 有效期（秒），<=0 时不写入
+ * @return 0表示成功，-1表示失败
+ */
+int lru_cache_put(struct lru_cache *cache, const char *key, const void *value, size_t len, int ttl_seconds) {
+    if (!cache || !key || ttl_seconds <= 0) return -1;
+
+    struct lru_entry *fresh = calloc(1, sizeof(*fresh));
+
+    if (!fresh) return -1;
+
+    fresh -> key = strdup(key);
+    fresh -> value = malloc(len ? len : 1);
+
+    if (!fresh -> key || !fresh -> value) {
+        free(fresh -> key);
+        free(fresh -> value);
+        free(fresh);
+        return -1;
+    }
+
+    memcpy(fresh -> value, value, len);
+
+    fresh -> len = len;
+    fresh -> hash = hash_key(key);
+    fresh -> expires_at = now_seconds() + ttl_seconds;
+
+    pthread_mutex_lock(&cache -> lock);
+
+    struct lru_entry *old = *find_slot(cache, key, fresh -> hash);
+
+    if (old) remove_entry(cache, old);
+
+    while (cache -> stats.size >= cache -> stats.capacity && cache -> tail) {
+        remove_entry(cache, cache -> tail);
+        cache -> stats.evictions++;
+    }
+
+    struct lru_entry **bucket = &cache -> buckets[fresh -> hash & (cache -> nbuckets - 1)];
+
+    fresh -> hnext = *bucket;
+    *bucket = fresh;
+
+    list_push_front(cache, fresh);
+
+    cache -> stats.size++;
+    cache -> stats.inserts++;
+
+    pthread_mutex_unlock(&cache -> lock);
+
+    return 0;
+}
+
+/**
+ * 读取命中/未命中/淘汰计数
+ */
+void lru_cache_get_stats(struct lru_cache *cache, struct lru_cache_stats *out) {
+    if (!out) return;
+
+    memset(out, 0, sizeof(*out));
+
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache -> lock);
+    *out = cache -> stats;
+    pthread_mutex_unlock(&cache -> lock);
+}
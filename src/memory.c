@@ -0,0 +1,226 @@
+/**
+ * @file memory.c
+ * @brief 所有上游请求共用的可增长缓冲区
+ *
+ * - 容量按 2 倍增长，一个大页面只需要 O(log n) 次 realloc
+ * - 响应头带 Content-Length 时，在第一个数据块到达前一次性分配到位
+ * - 内部用完即弃的缓冲区通过 memory_release 回到缓冲池，下一个请求直接复用
+ *
+ * 缓冲区始终以 '\0' 结尾，data 可以直接当字符串用；
+ * memory_detach 交出的指针与普通 malloc 的内存一样用 free 释放。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <curl/curl.h>
+
+#include "../include/memory.h"
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct memory pool[MEMORY_POOL_SIZE];
+static size_t pool_count = 0;
+static struct memory_stats stats;
+
+#define STAT_INC(field) __atomic_fetch_add(&stats.field, 1, __ATOMIC_RELAXED)
+
+/**
+ * 从缓冲池取一个容量不小于 need 的缓冲区
+ */
+static int pool_take(struct memory *mem, size_t need) {
+    int found = 0;
+
+    pthread_mutex_lock(&pool_lock);
+
+    for (size_t i = 0; i < pool_count; i++) {
+        if (pool[i].cap < need) continue;
+
+        *mem = pool[i];
+        pool[i] = pool[--pool_count];
+        found = 1;
+
+        break;
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    if (found) {
+        mem -> size = 0;
+        mem -> data[0] = '\0';
+
+        STAT_INC(pool_hits);
+    }
+
+    return found;
+}
+
+/**
+ * 确保缓冲区至少能容纳 need 字节（含结尾 '\0'）
+ *
+ * @param mem 缓冲区
+ * @param need 需要的总容量
+ * @return 0表示成功，-1表示内存不足
+ */
+int memory_reserve(struct memory *mem, size_t need) {
+    if (need <= mem -> cap) return 0;
+
+    if (!mem -> data && pool_take(mem, need)) return 0;
+
+    size_t cap = mem -> cap ? mem -> cap : 256;
+
+    while (cap < need) cap *= 2;
+
+    char *p = realloc(mem -> data, cap);
+
+    if (!p) return -1;
+
+    if (mem -> data) {
+        STAT_INC(reallocs);
+    } else {
+        STAT_INC(mallocs);
+        p[0] = '\0';
+    }
+
+    mem -> data = p;
+    mem -> cap = cap;
+
+    return 0;
+}
+
+/**
+ * 追加数据并保持 '\0' 结尾
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+int memory_append(struct memory *mem, const void *data, size_t len) {
+    if (memory_reserve(mem, mem -> size + len + 1) != 0) return -1;
+
+    if (len) memcpy(mem -> data + mem -> size, data, len);
+
+    mem -> size += len;
+    mem -> data[mem -> size] = '\0';
+
+    STAT_INC(appends);
+
+    return 0;
+}
+
+/**
+ * 交出缓冲区内容（调用者负责 free），缓冲区本身清空
+ *
+ * @return 以 '\0' 结尾的数据，从未写入过时返回空字符串
+ */
+char *memory_detach(struct memory *mem) {
+    char *data = mem -> data;
+
+    if (!data) data = calloc(1, 1);
+
+    mem -> data = NULL;
+    mem -> size = 0;
+    mem -> cap = 0;
+
+    return data;
+}
+
+/**
+ * 释放缓冲区：容量合适的放回缓冲池，其余直接 free
+ */
+void memory_release(struct memory *mem) {
+    if (!mem || !mem -> data) return;
+
+    int pooled = 0;
+
+    if (mem -> cap <= MEMORY_POOL_MAX_CAP) {
+        pthread_mutex_lock(&pool_lock);
+
+        if (pool_count < MEMORY_POOL_SIZE) {
+            pool[pool_count++] = *mem;
+            pooled = 1;
+        }
+
+        pthread_mutex_unlock(&pool_lock);
+    }
+
+    if (pooled) STAT_INC(pool_returns);
+    else free(mem -> data);
+
+    mem -> data = NULL;
+    mem -> size = 0;
+    mem -> cap = 0;
+}
+
+/**
+ * CURL写回调函数，所有需要完整响应体的请求共用
+ * @param contents 指向接收到的数据的指针
+ * @param size 每个数据元素的大小
+ * @param nmemb 数据元素的数量
+ * @param userp 指向 struct memory 的指针
+ * @return 返回实际处理的数据大小，如果失败返回0
+ */
+size_t memory_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+
+    return memory_append((struct memory *) userp, contents, realsize) == 0 ? realsize : 0;
+}
+
+/**
+ * CURL头回调函数：看到 Content-Length 时按长度预分配
+ */
+size_t memory_header_callback(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t len = size * nitems;
+    static const char name[] = "content-length:";
+    const size_t nlen = sizeof(name) - 1;
+
+    if (len > nlen && strncasecmp(buffer, name, nlen) == 0) {
+        struct memory *mem = (struct memory *) userp;
+        unsigned long long cl = strtoull(buffer + nlen, NULL, 10);
+
+        if (cl > 0 && cl <= MEMORY_PRESIZE_MAX && mem -> size + cl + 1 > mem -> cap) {
+            if (memory_reserve(mem, mem -> size + (size_t) cl + 1) == 0) STAT_INC(presized);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * 把缓冲区挂到 curl 句柄上（写回调 + 用于预分配的头回调）
+ *
+ * @param curl CURL 句柄
+ * @param mem 接收响应体的缓冲区
+ */
+void memory_attach_curl(void *curl, struct memory *mem) {
+    curl_easy_setopt((CURL *) curl, CURLOPT_WRITEFUNCTION, memory_write_callback);
+    curl_easy_setopt((CURL *) curl, CURLOPT_WRITEDATA, (void *) mem);
+    curl_easy_setopt((CURL *) curl, CURLOPT_HEADERFUNCTION, memory_header_callback);
+    curl_easy_setopt((CURL *) curl, CURLOPT_HEADERDATA, (void *) mem);
+}
+
+/**
+ * 释放缓冲池中的全部缓冲区（进程退出时调用）
+ */
+void memory_pool_cleanup(void) {
+    pthread_mutex_lock(&pool_lock);
+
+    for (size_t i = 0; i < pool_count; i++) free(pool[i].data);
+
+    pool_count = 0;
+
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/**
+ * 读取分配计数
+ */
+void memory_get_stats(struct memory_stats *out) {
+    if (!out) return;
+
+    out -> mallocs = __atomic_load_n(&stats.mallocs, __ATOMIC_RELAXED);
+    out -> reallocs = __atomic_load_n(&stats.reallocs, __ATOMIC_RELAXED);
+    out -> pool_hits = __atomic_load_n(&stats.pool_hits, __ATOMIC_RELAXED);
+    out -> pool_returns = __atomic_load_n(&stats.pool_returns, __ATOMIC_RELAXED);
+    out -> presized = __atomic_load_n(&stats.presized, __ATOMIC_RELAXED);
+    out -> appends = __atomic_load_n(&stats.appends, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,345 @@
+/**
+ * @file metrics.c
+ * @brief Prometheus 指标：按接口的请求计数与延迟直方图、按上游来源的 curl 分阶段耗时
+ *
+ * 所有计数器都按线程分片：每个线程第一次记录时分到一个固定分片，之后只对自己的分片做
+ * relaxed 原子加，热路径上不会有多个线程争同一条缓存行；/metrics 导出时再把各分片求和。
+ * 在途数量（gauge）也按分片增减，开始和结束落在不同分片时求和结果依然正确。
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/metrics.h"
+
+// 直方图桶上限（微秒），最后再加一个 +Inf 桶
+static const long bucket_bounds_us[] = {
+    5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000
+};
+
+#define BUCKETS (sizeof(bucket_bounds_us) / sizeof(bucket_bounds_us[0]) + 1)
+
+// 响应状态按 1xx..5xx 分类
+#define STATUS_CLASSES 5
+
+enum metrics_phase {
+    PHASE_DNS,
+    PHASE_CONNECT,
+    PHASE_TLS,
+    PHASE_TTFB,
+    PHASE_TOTAL,
+    PHASE_COUNT
+};
+
+struct histogram {
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+};
+
+struct shard {
+    uint64_t requests[METRICS_EP_COUNT][STATUS_CLASSES];
+    int64_t requests_in_flight[METRICS_EP_COUNT];
+    struct histogram request_latency[METRICS_EP_COUNT];
+
+    uint64_t upstream_requests[METRICS_SRC_COUNT];
+    uint64_t upstream_errors[METRICS_SRC_COUNT];
+    uint64_t upstream_retries[METRICS_SRC_COUNT];
+    int64_t upstream_in_flight[METRICS_SRC_COUNT];
+    struct histogram upstream_phase[METRICS_SRC_COUNT][PHASE_COUNT];
+} __attribute__((aligned(64)));
+
+static struct shard shards[METRICS_SHARDS];
+static unsigned int next_shard = 0;
+static __thread struct shard *my_shard = NULL;
+
+static const char *endpoint_names[METRICS_EP_COUNT] = {
+    "q", "id", "name", "ssm", "comp", "social", "batch", "metrics", "other"
+};
+
+static const char *source_names[METRICS_SRC_COUNT] = {
+    "semakmule", "sspi", "ejudgment", "rmp", "sprm", "company", "social"
+};
+
+static const char *phase_names[PHASE_COUNT] = {
+    "dns", "connect", "tls", "ttfb", "total"
+};
+
+static struct shard *shard_get(void) {
+    if (!my_shard) {
+        unsigned int idx = __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED);
+
+        my_shard = &shards[idx % METRICS_SHARDS];
+    }
+
+    return my_shard;
+}
+
+static void counter_add(uint64_t *c, uint64_t v) {
+    __atomic_fetch_add(c, v, __ATOMIC_RELAXED);
+}
+
+static void gauge_add(int64_t *g, int64_t v) {
+    __atomic_fetch_add(g, v, __ATOMIC_RELAXED);
+}
+
+static void histogram_observe(struct histogram *h, long us) {
+    size_t i = 0;
+
+    if (us < 0) us = 0;
+
+    while (i < BUCKETS - 1 && us > bucket_bounds_us[i]) i++;
+
+    counter_add(&h -> buckets[i], 1);
+    counter_add(&h -> count, 1);
+    counter_add(&h -> sum_us, (uint64_t) us);
+}
+
+const char *metrics_source_name(enum metrics_source src) {
+    return (unsigned) src < METRICS_SRC_COUNT ? source_names[src] : "unknown";
+}
+
+/**
+ * 记录一次请求开始（在途数量 +1）
+ *
+ * @param ep 请求所属接口
+ */
+void metrics_request_begin(enum metrics_endpoint ep) {
+    if ((unsigned) ep >= METRICS_EP_COUNT) return;
+
+    gauge_add(&shard_get() -> requests_in_flight[ep], 1);
+}
+
+/**
+ * 记录一次请求结束
+ *
+ * @param ep 请求所属接口（须与 metrics_request_begin 相同）
+ * @param status 响应状态码，0 表示没有发出响应
+ * @param latency_us 请求耗时（微秒）
+ */
+void metrics_request_end(enum metrics_endpoint ep, unsigned int status, long latency_us) {
+    struct shard *s = shard_get();
+
+    if ((unsigned) ep >= METRICS_EP_COUNT) return;
+
+    unsigned int cls = status / 100;
+
+    // 没有发出响应（客户端提前断开等）计为 5xx
+    if (cls < 1 || cls > STATUS_CLASSES) cls = 5;
+
+    gauge_add(&s -> requests_in_flight[ep], -1);
+    counter_add(&s -> requests[ep][cls - 1], 1);
+    histogram_observe(&s -> request_latency[ep], latency_us);
+}
+
+/**
+ * 记录一次上游请求开始（在途数量 +1）
+ *
+ * @param src 上游来源
+ */
+void metrics_upstream_begin(enum metrics_source src) {
+    if ((unsigned) src >= METRICS_SRC_COUNT) return;
+
+    gauge_add(&shard_get() -> upstream_in_flight[src], 1);
+}
+
+/**
+ * 记录一次上游请求结束，并从 curl 句柄读取分阶段耗时
+ *
+ * 各阶段按 curl 的累计时间点求差：DNS、TCP 连接、TLS 握手、首字节等待（握手完成到首字节）和总耗时。
+ * 复用连接时前三个阶段为 0，同样计入直方图。
+ *
+ * @param src 上游来源（须与 metrics_upstream_begin 相同）
+ * @param curl 完成传输的句柄，为 NULL 时（提交失败）只计错误不计耗时
+ * @param ok 本次请求是否成功（由调用者判断，主动中止的流式解析也可以算成功）
+ */
+void metrics_upstream_end(enum metrics_source src, CURL *curl, bool ok) {
+    struct shard *s = shard_get();
+
+    if ((unsigned) src >= METRICS_SRC_COUNT) return;
+
+    gauge_add(&s -> upstream_in_flight[src], -1);
+    counter_add(&s -> upstream_requests[src], 1);
+
+    if (!ok) counter_add(&s -> upstream_errors[src], 1);
+    if (!curl) return;
+
+    curl_off_t dns = 0, connect = 0, tls = 0, ttfb = 0, total = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+    // 明文请求没有 TLS 阶段，APPCONNECT 为 0
+    curl_off_t handshake = tls > 0 ? tls : connect;
+
+    histogram_observe(&s -> upstream_phase[src][PHASE_DNS], (long) dns);
+    histogram_observe(&s -> upstream_phase[src][PHASE_CONNECT], (long) (connect > dns ? connect - dns : 0));
+    histogram_observe(&s -> upstream_phase[src][PHASE_TLS], (long) (tls > connect ? tls - connect : 0));
+    histogram_observe(&s -> upstream_phase[src][PHASE_TTFB], (long) (ttfb > handshake ? ttfb - handshake : 0));
+    histogram_observe(&s -> upstream_phase[src][PHASE_TOTAL], (long) total);
+}
+
+/**
+ * 记录一次失败后的重试（失败本身已由 metrics_upstream_end 计入错误数）
+ *
+ * @param src 上游来源
+ */
+void metrics_upstream_retry(enum metrics_source src) {
+    if ((unsigned) src >= METRICS_SRC_COUNT) return;
+
+    counter_add(&shard_get() -> upstream_retries[src], 1);
+}
+
+static uint64_t sum_counter(size_t offset) {
+    uint64_t total = 0;
+
+    for (int i = 0; i < METRICS_SHARDS; i++) {
+        total += __atomic_load_n((uint64_t *) ((char *) &shards[i] + offset), __ATOMIC_RELAXED);
+    }
+
+    return total;
+}
+
+static int64_t sum_gauge(size_t offset) {
+    int64_t total = 0;
+
+    for (int i = 0; i < METRICS_SHARDS; i++) {
+        total += __atomic_load_n((int64_t *) ((char *) &shards[i] + offset), __ATOMIC_RELAXED);
+    }
+
+    return total;
+}
+
+static int emit(struct memory *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static int emit(struct memory *out, const char *fmt, ...) {
+    char line[512];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    if (n < 0) return -1;
+    if ((size_t) n >= sizeof(line)) n = sizeof(line) - 1;
+
+    return memory_append(out, line, (size_t) n);
+}
+
+static int emit_histogram(struct memory *out, const char *name, const char *labels, size_t offset) {
+    uint64_t cumulative = 0;
+    int rc = 0;
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+        cumulative += sum_counter(offset + offsetof(struct histogram, buckets) + i * sizeof(uint64_t));
+
+        if (i < BUCKETS - 1) {
+            rc |= emit(out, "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels,
+                       bucket_bounds_us[i] / 1e6, (unsigned long long) cumulative);
+        } else {
+            rc |= emit(out, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels, (unsigned long long) cumulative);
+        }
+    }
+
+    rc |= emit(out, "%s_sum{%s} %.6f\n", name, labels,
+               sum_counter(offset + offsetof(struct histogram, sum_us)) / 1e6);
+    rc |= emit(out, "%s_count{%s} %llu\n", name, labels,
+               (unsigned long long) sum_counter(offset + offsetof(struct histogram, count)));
+
+    return rc;
+}
+
+/**
+ * 以 Prometheus 文本格式（0.0.4）导出全部指标
+ *
+ * @param out 输出缓冲区，内容追加在末尾
+ * @return 0表示成功，-1表示内存不足
+ */
+int metrics_render(struct memory *out) {
+    char labels[96];
+    int rc = 0;
+
+    rc |= emit(out, "# HELP mo_http_requests_total HTTP requests by endpoint and status class.\n");
+    rc |= emit(out, "# TYPE mo_http_requests_total counter\n");
+
+    for (int ep = 0; ep < METRICS_EP_COUNT; ep++) {
+        for (int cls = 0; cls < STATUS_CLASSES; cls++) {
+            uint64_t v = sum_counter(offsetof(struct shard, requests) + (ep * STATUS_CLASSES + cls) * sizeof(uint64_t));
+
+            if (v == 0) continue;
+
+            rc |= emit(out, "mo_http_requests_total{endpoint=\"%s\",code=\"%dxx\"} %llu\n",
+                       endpoint_names[ep], cls + 1, (unsigned long long) v);
+        }
+    }
+
+    rc |= emit(out, "# HELP mo_http_requests_in_flight HTTP requests currently being served.\n");
+    rc |= emit(out, "# TYPE mo_http_requests_in_flight gauge\n");
+
+    for (int ep = 0; ep < METRICS_EP_COUNT; ep++) {
+        rc |= emit(out, "mo_http_requests_in_flight{endpoint=\"%s\"} %lld\n", endpoint_names[ep],
+                   (long long) sum_gauge(offsetof(struct shard, requests_in_flight) + ep * sizeof(int64_t)));
+    }
+
+    rc |= emit(out, "# HELP mo_http_request_duration_seconds HTTP request latency by endpoint.\n");
+    rc |= emit(out, "# TYPE mo_http_request_duration_seconds histogram\n");
+
+    for (int ep = 0; ep < METRICS_EP_COUNT; ep++) {
+        snprintf(labels, sizeof(labels), "endpoint=\"%s\"", endpoint_names[ep]);
+
+        rc |= emit_histogram(out, "mo_http_request_duration_seconds", labels,
+                             offsetof(struct shard, request_latency) + ep * sizeof(struct histogram));
+    }
+
+    rc |= emit(out, "# HELP mo_upstream_requests_total Upstream requests by source.\n");
+    rc |= emit(out, "# TYPE mo_upstream_requests_total counter\n");
+
+    for (int src = 0; src < METRICS_SRC_COUNT; src++) {
+        rc |= emit(out, "mo_upstream_requests_total{source=\"%s\"} %llu\n", source_names[src],
+                   (unsigned long long) sum_counter(offsetof(struct shard, upstream_requests) + src * sizeof(uint64_t)));
+    }
+
+    rc |= emit(out, "# HELP mo_upstream_errors_total Failed upstream requests by source.\n");
+    rc |= emit(out, "# TYPE mo_upstream_errors_total counter\n");
+
+    for (int src = 0; src < METRICS_SRC_COUNT; src++) {
+        rc |= emit(out, "mo_upstream_errors_total{source=\"%s\"} %llu\n", source_names[src],
+                   (unsigned long long) sum_counter(offsetof(struct shard, upstream_errors) + src * sizeof(uint64_t)));
+    }
+
+    rc |= emit(out, "# HELP mo_upstream_retries_total Upstream requests retried after a failure, by source.\n");
+    rc |= emit(out, "# TYPE mo_upstream_retries_total counter\n");
+
+    for (int src = 0; src < METRICS_SRC_COUNT; src++) {
+        rc |= emit(out, "mo_upstream_retries_total{source=\"%s\"} %llu\n", source_names[src],
+                   (unsigned long long) sum_counter(offsetof(struct shard, upstream_retries) + src * sizeof(uint64_t)));
+    }
+
+    rc |= emit(out, "# HELP mo_upstream_in_flight Upstream requests currently in progress.\n");
+    rc |= emit(out, "# TYPE mo_upstream_in_flight gauge\n");
+
+    for (int src = 0; src < METRICS_SRC_COUNT; src++) {
+        rc |= emit(out, "mo_upstream_in_flight{source=\"%s\"} %lld\n", source_names[src],
+                   (long long) sum_gauge(offsetof(struct shard, upstream_in_flight) + src * sizeof(int64_t)));
+    }
+
+    rc |= emit(out, "# HELP mo_upstream_phase_seconds Upstream curl timing by source and phase.\n");
+    rc |= emit(out, "# TYPE mo_upstream_phase_seconds histogram\n");
+
+    for (int src = 0; src < METRICS_SRC_COUNT; src++) {
+        for (int ph = 0; ph < PHASE_COUNT; ph++) {
+            snprintf(labels, sizeof(labels), "source=\"%s\",phase=\"%s\"", source_names[src], phase_names[ph]);
+
+            rc |= emit_histogram(out, "mo_upstream_phase_seconds", labels,
+                                 offsetof(struct shard, upstream_phase) + (src * PHASE_COUNT + ph) * sizeof(struct histogram));
+        }
+    }
+
+    return rc ? -1 : 0;
+}
@@ -1,75 +1,358 @@
+/**
+ * @file mykad.c
+ * @brief 马来西亚身份证（MyKad）号码解码
+ *
+ * 号码格式为 YYMMDD-PB-###G：出生日期、出生地代码、流水号，最后一位奇数为男、偶数为女。
+ *
+ * mykad_decode_batch 一次解码一批号码，结果按列写进调用者提供的 mykad_batch，
+ * 供离线筛查大批号码使用：每个号码放进一个 16 字节的槽，SSE2 下一条比较指令校验 12 位数字，
+ * 再用一次乘加把相邻两位合成 YY/MM/DD/PB 等两位数；出生地和每月天数都查编译期常量表，
+ * 整个过程没有堆分配，也没有字符串比较。
+ *
+ * 世纪按"出生日期不能晚于今天"推断：20YY 年的日期还没到就算 19YY 年。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "../include/mykad.h"
 #include "../include/memory.h"
+#include "../include/arena.h"
+
+#define STATE(code, st, label)  [code] = { MYKAD_PLACE_STATE, st, label }
+#define COUNTRY(code, label)    [code] = { MYKAD_PLACE_COUNTRY, 0, label }
+#define REGION(code, label)     [code] = { MYKAD_PLACE_REGION, 0, label }
 
 /**
- * 解析马来西亚身份证号码信息
- * @param ic_no 输入的身份证号码字符串，应为12位数字
- * @return 返回包含解析信息的JSON字符串，需要调用者释放内存；
- *         如果输入无效或内存分配失败，返回错误信息JSON字符串
+ * 国民登记局（JPN）出生地代码表
+ *
+ * 01-16 为州属本身，21-59 为各州属的补充代码，60-93 为出生国家或地区，98/99 为无国籍和难民；
+ * 表中没有的代码（00、17-20、69、70、73、80、81、94-97）视为无效。
+ */
+static const struct mykad_place places[100] = {
+    STATE(1, 1, "Johor"),
+    STATE(2, 2, "Kedah"),
+    STATE(3, 3, "Kelantan"),
+    STATE(4, 4, "Malacca"),
+    STATE(5, 5, "Negeri Sembilan"),
+    STATE(6, 6, "Pahang"),
+    STATE(7, 7, "Penang"),
+    STATE(8, 8, "Perak"),
+    STATE(9, 9, "Perlis"),
+    STATE(10, 10, "Selangor"),
+    STATE(11, 11, "Terengganu"),
+    STATE(12, 12, "Sabah"),
+    STATE(13, 13, "Sarawak"),
+    STATE(14, 14, "Kuala Lumpur Federal Territory"),
+    STATE(15, 15, "Labuan Federal Territory"),
+    STATE(16, 16, "Putrajaya Federal Territory"),
+
+    STATE(21, 1, "Johor"), STATE(22, 1, "Johor"), STATE(23, 1, "Johor"), STATE(24, 1, "Johor"),
+    STATE(25, 2, "Kedah"), STATE(26, 2, "Kedah"), STATE(27, 2, "Kedah"),
+    STATE(28, 3, "Kelantan"), STATE(29, 3, "Kelantan"),
+    STATE(30, 4, "Malacca"),
+    STATE(31, 5, "Negeri Sembilan"), STATE(59, 5, "Negeri Sembilan"),
+    STATE(32, 6, "Pahang"), STATE(33, 6, "Pahang"),
+    STATE(34, 7, "Penang"), STATE(35, 7, "Penang"),
+    STATE(36, 8, "Perak"), STATE(37, 8, "Perak"), STATE(38, 8, "Perak"), STATE(39, 8, "Perak"),
+    STATE(40, 9, "Perlis"),
+    STATE(41, 10, "Selangor"), STATE(42, 10, "Selangor"), STATE(43, 10, "Selangor"), STATE(44, 10, "Selangor"),
+    STATE(45, 11, "Terengganu"), STATE(46, 11, "Terengganu"),
+    STATE(47, 12, "Sabah"), STATE(48, 12, "Sabah"), STATE(49, 12, "Sabah"),
+    STATE(50, 13, "Sarawak"), STATE(51, 13, "Sarawak"), STATE(52, 13, "Sarawak"), STATE(53, 13, "Sarawak"),
+    STATE(54, 14, "Kuala Lumpur Federal Territory"), STATE(55, 14, "Kuala Lumpur Federal Territory"),
+    STATE(56, 14, "Kuala Lumpur Federal Territory"), STATE(57, 14, "Kuala Lumpur Federal Territory"),
+    STATE(58, 15, "Labuan Federal Territory"),
+
+    COUNTRY(60, "Brunei"),
+    COUNTRY(61, "Indonesia"),
+    COUNTRY(62, "Cambodia"),
+    COUNTRY(63, "Laos"),
+    COUNTRY(64, "Myanmar"),
+    COUNTRY(65, "Philippines"),
+    COUNTRY(66, "Singapore"),
+    COUNTRY(67, "Thailand"),
+    COUNTRY(68, "Vietnam"),
+    REGION(71, "Outside Malaysia (before 2001)"),
+    REGION(72, "Outside Malaysia (before 2001)"),
+    COUNTRY(74, "China"),
+    COUNTRY(75, "India"),
+    COUNTRY(76, "Pakistan"),
+    COUNTRY(77, "Saudi Arabia"),
+    COUNTRY(78, "Sri Lanka"),
+    COUNTRY(79, "Bangladesh"),
+    REGION(82, "Unknown State"),
+    REGION(83, "Asia Pacific"),
+    REGION(84, "South America"),
+    REGION(85, "Africa"),
+    REGION(86, "Europe"),
+    REGION(87, "United Kingdom and Ireland"),
+    REGION(88, "Middle East"),
+    REGION(89, "Far East"),
+    REGION(90, "Caribbean"),
+    REGION(91, "North America"),
+    REGION(92, "Central Asia and Eastern Europe"),
+    REGION(93, "Other Countries"),
+    REGION(98, "Stateless"),
+    REGION(99, "Refugee"),
+};
+
+#undef STATE
+#undef COUNTRY
+#undef REGION
+
+static const uint8_t month_days[13] = { 0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+/**
+ * 出生地代码对应的地点
+ *
+ * @param code 出生地代码（0..99）
+ * @return 地点；代码无效时 kind 为 MYKAD_PLACE_UNKNOWN、name 为 NULL
+ */
+const struct mykad_place *mykad_place(uint8_t code) {
+    static const struct mykad_place unknown = { MYKAD_PLACE_UNKNOWN, 0, NULL };
+
+    return code < 100 ? &places[code] : &unknown;
+}
+
+/**
+ * 今天的日期（YYYYMMDD），每个线程每小时最多调用一次 localtime_r
+ */
+static long current_date(void) {
+    static __thread time_t cached_hour = -1;
+    static __thread long cached_date = 0;
+
+    time_t now = time(NULL);
+
+    if (now / 3600 != cached_hour) {
+        struct tm tm;
+
+        localtime_r(&now, &tm);
+
+        cached_hour = now / 3600;
+        cached_date = (tm.tm_year + 1900) * 10000L + (tm.tm_mon + 1) * 100L + tm.tm_mday;
+    }
+
+    return cached_date;
+}
+
+/**
+ * 把号码放进 16 字节的槽：12 位连写或 YYMMDD-PB-#### 两种写法，其余长度不接受
+ *
+ * @return true 表示长度和分隔符符合格式（数字本身由调用方校验）
+ */
+static bool load_lane(const char *ic_no, char lane[16]) {
+    size_t len = ic_no ? strnlen(ic_no, 15) : 0;
+
+    memset(lane, 0, 16);
+
+    if (len == 12) {
+        memcpy(lane, ic_no, 12);
+        return true;
+    }
+
+    if (len == 14 && ic_no[6] == '-' && ic_no[9] == '-') {
+        memcpy(lane, ic_no, 6);
+        memcpy(lane + 6, ic_no + 7, 2);
+        memcpy(lane + 8, ic_no + 10, 4);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * 校验槽内前 12 字节都是数字，并把相邻两位合成 6 个两位数：YY MM DD PB ## ##
+ *
+ * @return true 表示 12 位都是数字
  */
-char* mykad_check(const char *ic_no) {
-    if (!ic_no || strlen(ic_no) < 12) return strdup("{\"error\": \"Invalid IC number\"}");
+static bool decode_lane(const char lane[16], int pairs[6]) {
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_loadu_si128((const __m128i *) lane);
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
 
-    char birth_year[] = { ic_no[0], ic_no[1], '\0' };
-    char birth_month[] = { ic_no[2], ic_no[3], '\0' };
-    char birth_day[] = { ic_no[4], ic_no[5], '\0' };
-    char identifier[] = { ic_no[8], ic_no[9], ic_no[10], ic_no[11], '\0' };
+    // 减去 '0' 后按无符号比较不超过 9 才是数字（小于 '0' 的字节会回绕成大数）
+    __m128i ok = _mm_cmpeq_epi8(_mm_subs_epu8(d, _mm_set1_epi8(9)), zero);
 
-    char* province_name = mykad_get_birth_province(ic_no);
-    char birthday[11];
-    
-    snprintf(birthday, sizeof(birthday), "19%s-%s-%s", birth_year, birth_month, birth_day);
+    if ((_mm_movemask_epi8(ok) & 0x0FFF) != 0x0FFF) return false;
 
-    char* result = malloc(256);
+    const __m128i weights = _mm_setr_epi16(10, 1, 10, 1, 10, 1, 10, 1);
+    int32_t lo[4], hi[4];
 
-    if (!result) {
-        free(province_name);
-        return strdup("{\"error\": \"Memory allocation failed\"}");
+    _mm_storeu_si128((__m128i *) lo, _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), weights));
+    _mm_storeu_si128((__m128i *) hi, _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), weights));
+
+    pairs[0] = lo[0];
+    pairs[1] = lo[1];
+    pairs[2] = lo[2];
+    pairs[3] = lo[3];
+    pairs[4] = hi[0];
+    pairs[5] = hi[1];
+#else
+    for (int i = 0; i < 12; i++) {
+        if (lane[i] < '0' || lane[i] > '9') return false;
     }
 
-    snprintf(result, 256,
-             "{\"birthday\": \"%s\", \"province\": \"%s\", \"identifier\": \"%s\"}",
-             birthday, province_name, identifier);
+    for (int i = 0; i < 6; i++) pairs[i] = (lane[2 * i] - '0') * 10 + (lane[2 * i + 1] - '0');
+#endif
 
-    free(province_name);
-    
-    return result;
+    return true;
 }
 
 /**
- * 根据身份证号码中的省份代码获取对应的出生省份名称。
+ * 分配一个能容纳 capacity 个号码的输出（所有列放在同一块内存里）
  *
- * @param birth_provinc 未使用参数（保留以符合接口定义）
- * @return 返回指向省份名称的字符串指针。若身份证号码无效或内存分配失败，
- *         则返回错误提示字符串；否则返回动态分配的省份名称字符串，调用者需负责释放内存。
+ * @return 0表示成功，-1表示内存不足
  */
-char* mykad_get_birth_province(const char *ic_no) {
-    if (ic_no == NULL || strlen(ic_no) < 8)  return strdup("Invalid");
-
-    char province_code[] = { ic_no[6], ic_no[7], '\0' };
-    char *province = malloc(32);
-    if (!province) return strdup("Memory error");
-
-    strcpy(province, "Unknown State");
-
-    if (strcmp(province_code, "01") == 0) strcpy(province, "Johor");
-    if (strcmp(province_code, "02") == 0) strcpy(province, "Kedah");
-    if (strcmp(province_code, "03") == 0) strcpy(province, "Kelantan");
-    if (strcmp(province_code, "04") == 0) strcpy(province, "Malacca");
-    if (strcmp(province_code, "05") == 0) strcpy(province, "Negeri Sembilan");
-    if (strcmp(province_code, "06") == 0) strcpy(province, "Pahang");
-    if (strcmp(province_code, "07") == 0) strcpy(province, "Penang");
-    if (strcmp(province_code, "08") == 0) strcpy(province, "Perak");
-    if (strcmp(province_code, "09") == 0) strcpy(province, "Perlis");
-    if (strcmp(province_code, "10") == 0) strcpy(province, "Selangor");
-    if (strcmp(province_code, "11") == 0) strcpy(province, "Terengganu");
-    if (strcmp(province_code, "12") == 0) strcpy(province, "Sabah");
-    if (strcmp(province_code, "13") == 0) strcpy(province, "Sarawak");
-    if (strcmp(province_code, "14") == 0) strcpy(province, "Kuala Lumpur Federal Territory");
-    if (strcmp(province_code, "15") == 0) strcpy(province, "Labuan Federal Territory");
-    if (strcmp(province_code, "16") == 0) strcpy(province, "Putrajaya Federal Territory");
-
-    return province;
-}
\ No newline at end of file
+int mykad_batch_init(struct mykad_batch *batch, size_t capacity) {
+    size_t per = sizeof(uint32_t) + sizeof(uint16_t) + 3 * sizeof(uint8_t);
+    char *block = malloc(capacity ? capacity * per : per);
+
+    if (!block) return -1;
+
+    batch -> capacity = capacity;
+    batch -> birth = (uint32_t *) block;
+    batch -> serial = (uint16_t *) (block + capacity * sizeof(uint32_t));
+    batch -> place = (uint8_t *) (block + capacity * (sizeof(uint32_t) + sizeof(uint16_t)));
+    batch -> gender = batch -> place + capacity;
+    batch -> flags = batch -> gender + capacity;
+
+    return 0;
+}
+
+/**
+ * 释放 mykad_batch_init 分配的输出
+ */
+void mykad_batch_free(struct mykad_batch *batch) {
+    if (!batch) return;
+
+    free(batch -> birth);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * 批量解码身份证号码
+ *
+ * 每个号码接受 12 位连写或 YYMMDD-PB-#### 写法。数字不合法的号码只有 flags 有意义（为 0）；
+ * 日期不存在（如 2 月 30 日）时清除 MYKAD_DATE_OK，出生地代码不在 JPN 表中时清除 MYKAD_PLACE_OK，
+ * 其余字段照常填写。
+ *
+ * @param ic_nos 号码数组
+ * @param n 号码个数，超过 out -> capacity 的部分不处理
+ * @param today 推断世纪用的当前日期（YYYYMMDD），0 表示取本地时间
+ * @param out 输出
+ * @return 三项校验全部通过的号码个数
+ */
+size_t mykad_decode_batch(const char *const *ic_nos, size_t n, long today, struct mykad_batch *out) {
+    size_t valid = 0;
+
+    if (!ic_nos || !out) return 0;
+    if (n > out -> capacity) n = out -> capacity;
+    if (today <= 0) today = current_date();
+
+    for (size_t i = 0; i < n; i++) {
+        char lane[16];
+        int p[6];
+
+        if (!load_lane(ic_nos[i], lane) || !decode_lane(lane, p)) {
+            out -> birth[i] = 0;
+            out -> serial[i] = 0;
+            out -> place[i] = 0;
+            out -> gender[i] = MYKAD_GENDER_UNKNOWN;
+            out -> flags[i] = 0;
+            continue;
+        }
+
+        int month = p[1];
+        int day = p[2];
+        long year = 2000 + p[0];
+
+        if (year * 10000 + month * 100 + day > today) year -= 100;
+
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        bool date_ok = month >= 1 && month <= 12 && day >= 1 && day <= month_days[month] &&
+            (month != 2 || day <= 28 || leap);
+        uint8_t flags = MYKAD_DIGITS_OK;
+
+        if (date_ok) flags |= MYKAD_DATE_OK;
+        if (places[p[3]].kind != MYKAD_PLACE_UNKNOWN) flags |= MYKAD_PLACE_OK;
+
+        out -> birth[i] = (uint32_t) (year * 10000 + month * 100 + day);
+        out -> serial[i] = (uint16_t) (p[4] * 100 + p[5]);
+        out -> place[i] = (uint8_t) p[3];
+        out -> gender[i] = (p[5] & 1) ? MYKAD_GENDER_MALE : MYKAD_GENDER_FEMALE;
+        out -> flags[i] = flags;
+
+        if (flags == MYKAD_VALID) valid++;
+    }
+
+    return valid;
+}
+
+static const char *place_kind_name(uint8_t kind) {
+    switch (kind) {
+        case MYKAD_PLACE_STATE: return "state";
+        case MYKAD_PLACE_COUNTRY: return "country";
+        case MYKAD_PLACE_REGION: return "region";
+        default: return "unknown";
+    }
+}
+
+/**
+ * 解析马来西亚身份证号码信息
+ * @param ic_no 输入的身份证号码字符串，12位数字或 YYMMDD-PB-#### 写法
+ * @param arena 结果所在的内存池；为 NULL 时结果由调用者 free
+ * @return 返回包含解析信息的JSON字符串，日期不存在时 birthday 为 null；
+ *         如果输入无效，返回错误信息JSON字符串；内存不足时返回 NULL
+ */
+char* mykad_check(const char *ic_no, struct arena *arena) {
+    uint32_t birth;
+    uint16_t serial;
+    uint8_t place, gender, flags;
+    struct mykad_batch one = { 1, &birth, &serial, &place, &gender, &flags };
+
+    mykad_decode_batch(&ic_no, 1, 0, &one);
+
+    if (!(flags & MYKAD_DIGITS_OK)) return arena_strdup(arena, "{\"error\": \"Invalid IC number\"}");
+
+    const struct mykad_place *pl = mykad_place(place);
+    char birthday[16] = "null";
+
+    if (flags & MYKAD_DATE_OK) {
+        snprintf(birthday, sizeof(birthday), "\"%04u-%02u-%02u\"", birth / 10000, birth / 100 % 100, birth % 100);
+    }
+
+    return arena_sprintf(arena,
+             "{\"birthday\": %s, \"province\": \"%s\", \"place_code\": \"%02u\", \"place_type\": \"%s\", "
+             "\"gender\": \"%s\", \"identifier\": \"%04u\", \"valid\": %s}",
+             birthday, pl -> name ? pl -> name : "Unknown State", place, place_kind_name(pl -> kind),
+             gender == MYKAD_GENDER_MALE ? "male" : "female", serial,
+             flags == MYKAD_VALID ? "true" : "false");
+}
+
+/**
+ * 根据身份证号码中的出生地代码获取对应的出生州属或国家名称。
+ *
+ * @param ic_no 身份证号码（12 位连写或 YYMMDD-PB-####，只看出生地代码 PB）
+ * @param arena 结果所在的内存池；为 NULL 时结果由调用者 free
+ * @return 返回地点名称字符串，代码不在表中时为 "Unknown State"，号码格式不对则返回 "Invalid"；内存不足时返回 NULL
+ */
+char* mykad_get_birth_province(const char *ic_no, struct arena *arena) {
+    char lane[16];
+
+    if (!load_lane(ic_no, lane)) return arena_strdup(arena, "Invalid");
+
+    if (lane[6] < '0' || lane[6] > '9' || lane[7] < '0' || lane[7] > '9') return arena_strdup(arena, "Unknown State");
+
+    const struct mykad_place *pl = mykad_place((uint8_t) ((lane[6] - '0') * 10 + (lane[7] - '0')));
+
+    return arena_strdup(arena, pl -> name ? pl -> name : "Unknown State");
+}
@@ -17,10 +17,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <curl/curl.h>
 
 #include "../include/pdrm.h"
 #include "../include/memory.h"
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
+#include "../include/lru_cache.h"
+#include "../include/singleflight.h"
+#include "../include/json_path.h"
 
 
 #define ORIGIN "https://semakmule.rmp.gov.my/"
@@ -34,96 +41,237 @@
 */
 #define PUBLIC_KEY "j3j389#nklala2"  
 
+// single-flight 的数据源名称；同一请求体（由规范化号码生成）的并发查询共享一次上游调用
+#define MULE_FLIGHT "semakmule"
+
 /**
- * CURL写回调函数，用于接收HTTP响应数据并存储到用户定义的结构体中
- * 
- * @param ptr 指向接收到的数据的指针
- * @param size 每个数据元素的大小（字节数）
- * @param nmemb 数据元素的数量
- * @param userdata 指向用户数据的指针，这里应该是semak_mule_response结构体
- * 
- * @return 返回实际处理的数据大小（字节数），如果处理失败返回0
+ * 为一次 Semak Mule 查询配置 CURL 句柄（同步与异步两条路径共用）
+ *
+ * 地址和请求体由 upstream_call 设置，这里只负责请求头和超时。
+ *
+ * @param curl 待配置的句柄
+ * @param body 接收响应体的缓冲区
+ * @param headers 输出的请求头链表，传输结束后需调用 curl_slist_free_all 释放
+ * @return 0表示成功，-1表示失败
  */
-static size_t write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
-    size_t total = size * nmemb;
-    struct semak_mule_response *resp = (struct semak_mule_response *)userdata;
-
-    // 重新分配内存以容纳新接收的数据
-    char *new_data = realloc(resp -> data, resp -> size + total + 1);
+static int mule_prepare(CURL *curl, struct memory *body, struct curl_slist **headers) {
+    char api_key[128];
 
-    if (!new_data) {
-        fprintf(stderr, "realloc failed\n");
-        return 0;
+    if (snprintf(api_key, sizeof(api_key), "apikey: %s", PUBLIC_KEY) >= (int)sizeof(api_key)) {
+        fprintf(stderr, "[ERR] api_key truncated!\n");
+        return -1;
     }
 
-    resp -> data = new_data;
+    struct curl_slist *h = NULL;
 
-    // 将新数据复制到已分配的内存空间中
-    memcpy(&(resp -> data[resp -> size]), ptr, total);
-    
-    resp -> size += total;
-    resp -> data[resp -> size] = '\0';
-    
-    return total;
+    h = curl_slist_append(h, "Accept: */*");
+    h = curl_slist_append(h, "Accept-Language: zh-CN,zh;q=0.9");
+    h = curl_slist_append(h, "Connection: keep-alive");
+    h = curl_slist_append(h, "Content-Type: application/json");
+    h = curl_slist_append(h, "Origin: https://semakmule.rmp.gov.my");
+    h = curl_slist_append(h, "Referer: https://semakmule.rmp.gov.my/");
+    h = curl_slist_append(h, "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/123.0.0.0 Safari/537.36 QQBrowser/19.5.5.207");
+    h = curl_slist_append(h, api_key);
+    h = curl_slist_append(h, "sec-ch-ua: \"Chromium\";v=\"123\", \"Not:A-Brand\";v=\"8\"");
+    h = curl_slist_append(h, "sec-ch-ua-mobile: ?0");
+    h = curl_slist_append(h, "sec-ch-ua-platform: \"macOS\"");
+    h = curl_slist_append(h, "Cookie: ");
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
+
+    memory_attach_curl(curl, body);
+
+    *headers = h;
+
+    return 0;
 }
 
-int pdrm_semak_mule(const char *url, const char *json_payload, struct semak_mule_response *resp) {
-    if (!url || !json_payload || !resp) return -1;
+/**
+ * 同步查询的实际上游调用（singleflight_do 的 load 函数）
+ */
+struct mule_sync_args {
+    const char *url;
+    const char *json_payload;
+};
+
+static int mule_sync_load(void *arg, char **data, size_t *size) {
+    struct mule_sync_args *a = (struct mule_sync_args *) arg;
+    struct memory body = {0};
+    struct curl_slist *headers = NULL;
 
-    CURL *curl;
-    CURLcode res;
+    CURL *curl = curl_pool_acquire();
     
-    char api_key[128];
+    if (!curl) return -1;
 
-    if (snprintf(api_key, sizeof(api_key), "apikey: %s", PUBLIC_KEY) >= (int)sizeof(api_key)) {
-        fprintf(stderr, "[ERR] api_key truncated!\n");
+    if (mule_prepare(curl, &body, &headers) != 0) {
+        curl_pool_release(curl);
         return -1;
     }
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    struct upstream_call call = {
+        .source = METRICS_SRC_SEMAKMULE, .url = a -> url, .post = a -> json_payload,
+        .write = memory_write_callback, .write_data = &body,
+    };
 
-    curl = curl_easy_init();
-    
-    if (!curl) return -1;
+    CURLcode res = upstream_perform(curl, &call);
 
-    resp -> data = malloc(1);
-    resp -> size = 0;
+    curl_slist_free_all(headers);
+    curl_pool_release(curl);
 
-    if (!resp->data) {
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
+    if (res != CURLE_OK) {
+        memory_release(&body);
         return -1;
     }
 
-    struct curl_slist *headers = NULL;
+    *size = body.size;
+    *data = memory_detach(&body);
 
-    headers = curl_slist_append(headers, "Accept: */*");
-    headers = curl_slist_append(headers, "Accept-Language: zh-CN,zh;q=0.9");
-    headers = curl_slist_append(headers, "Connection: keep-alive");
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, "Origin: https://semakmule.rmp.gov.my");
-    headers = curl_slist_append(headers, "Referer: https://semakmule.rmp.gov.my/");
-    headers = curl_slist_append(headers, "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/123.0.0.0 Safari/537.36 QQBrowser/19.5.5.207");
-    headers = curl_slist_append(headers, api_key);
-    headers = curl_slist_append(headers, "sec-ch-ua: \"Chromium\";v=\"123\", \"Not:A-Brand\";v=\"8\"");
-    headers = curl_slist_append(headers, "sec-ch-ua-mobile: ?0");
-    headers = curl_slist_append(headers, "sec-ch-ua-platform: \"macOS\"");
-    headers = curl_slist_append(headers, "Cookie: ");
+    return 0;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload);
+int pdrm_semak_mule(const char *url, const char *json_payload, struct semak_mule_response *resp) {
+    if (!url || !json_payload || !resp) return -1;
 
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)resp);
+    struct mule_sync_args args = { url, json_payload };
 
-    res = curl_easy_perform(curl);
+    return singleflight_do(MULE_FLIGHT, json_payload, mule_sync_load, &args, &resp -> data, &resp -> size);
+}
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-    curl_global_cleanup();
+/**
+ * 异步查询的上下文
+ */
+struct mule_async {
+    struct memory body;
+    struct curl_slist *headers;
+    char *flight_key;
+    pdrm_mule_done_fn done;
+    void *userdata;
+};
+
+static void mule_async_done(CURL *curl, CURLcode res, void *userdata) {
+    struct mule_async *ctx = (struct mule_async *) userdata;
+    int status = res == CURLE_OK ? 0 : -1;
+    struct semak_mule_response resp = {0};
+
+    curl_slist_free_all(ctx -> headers);
+    curl_pool_release(curl);
+
+    // 先把结果分发给合并进来的其他请求，再交给自己的回调（回调会接管 resp）
+    if (ctx -> flight_key) {
+        singleflight_complete(MULE_FLIGHT, ctx -> flight_key, status, ctx -> body.data, ctx -> body.size);
+        free(ctx -> flight_key);
+    }
+
+    resp.size = ctx -> body.size;
+    resp.data = memory_detach(&ctx -> body);
 
-    return (res == CURLE_OK) ? 0 : -1;
+    ctx -> done(status, &resp, ctx -> userdata);
+
+    free(ctx);
+}
+
+/**
+ * 被合并的异步查询：等待 leader 完成
+ */
+struct mule_follower {
+    pdrm_mule_done_fn done;
+    void *userdata;
+};
+
+static void mule_follower_done(int status, const char *data, size_t size, void *userdata) {
+    struct mule_follower *f = (struct mule_follower *) userdata;
+    struct semak_mule_response resp = {0};
+
+    if (status == 0 && data) {
+        resp.data = malloc(size + 1);
+
+        if (resp.data) {
+            memcpy(resp.data, data, size);
+            resp.data[size] = '\0';
+            resp.size = size;
+        } else {
+            status = -1;
+        }
+    } else {
+        status = -1;
+    }
+
+    f -> done(status, &resp, f -> userdata);
+
+    free(f);
+}
+
+/**
+ * 异步查询 Semak Mule（通过上游事件循环执行，不阻塞调用线程）
+ *
+ * 完成回调在事件循环线程中执行，resp 中的数据所有权转交给回调方，
+ * 回调方用完后需调用 pdrm_semak_mule_response_free 释放。
+ * 与正在进行中的相同请求会被合并，只访问一次上游，每个调用方各得一份结果。
+ *
+ * @param url API 地址
+ * @param json_payload 请求体（内部会复制）
+ * @param done 完成回调，status 为 0 表示成功
+ * @param userdata 回调参数
+ * @return 0表示已提交，-1表示提交失败（此时不会回调）
+ */
+int pdrm_semak_mule_async(const char *url, const char *json_payload, pdrm_mule_done_fn done, void *userdata) {
+    if (!url || !json_payload || !done) return -1;
+
+    struct mule_follower *follower = malloc(sizeof(*follower));
+
+    if (!follower) return -1;
+
+    follower -> done = done;
+    follower -> userdata = userdata;
+
+    int role = singleflight_join(MULE_FLIGHT, json_payload, mule_follower_done, follower);
+
+    if (role == 0) return 0;
+
+    free(follower);
+
+    struct mule_async *ctx = calloc(1, sizeof(*ctx));
+    CURL *curl = curl_pool_acquire();
+
+    if (ctx && role == 1) ctx -> flight_key = strdup(json_payload);
+
+    if (!ctx || !curl || (role == 1 && !ctx -> flight_key) ||
+        mule_prepare(curl, &ctx -> body, &ctx -> headers) != 0) {
+        if (ctx) {
+            memory_release(&ctx -> body);
+            free(ctx -> flight_key);
+        }
+
+        free(ctx);
+        curl_pool_release(curl);
+
+        if (role == 1) singleflight_complete(MULE_FLIGHT, json_payload, -1, NULL, 0);
+
+        return -1;
+    }
+
+    ctx -> done = done;
+    ctx -> userdata = userdata;
+
+    struct upstream_call call = {
+        .source = METRICS_SRC_SEMAKMULE, .url = url, .post = json_payload,
+        .write = memory_write_callback, .write_data = &ctx -> body,
+    };
+
+    if (upstream_submit(curl, &call, mule_async_done, ctx) != 0) {
+        curl_slist_free_all(ctx -> headers);
+        memory_release(&ctx -> body);
+        curl_pool_release(curl);
+        free(ctx -> flight_key);
+        free(ctx);
+
+        if (role == 1) singleflight_complete(MULE_FLIGHT, json_payload, -1, NULL, 0);
+
+        return -1;
+    }
+
+    return 0;
 }
 
 
@@ -146,4 +294,259 @@ void pdrm_semak_mule_response_free(struct semak_mule_response *resp) {
         resp -> data = NULL;
         resp -> size = 0;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * 结果缓存（键为规范化后的号码），未初始化时所有缓存操作都是空操作
+ */
+static struct lru_cache *mule_cache = NULL;
+static int mule_cache_ttl = PDRM_CACHE_TTL;
+static int mule_cache_negative_ttl = PDRM_CACHE_NEGATIVE_TTL;
+
+/**
+ * 缓存中存放的定长头部，后面紧跟原始 JSON
+ */
+struct mule_cache_header {
+    int count;
+    int reported;
+};
+
+/**
+ * 规范化电话号码/银行账号：只保留数字，"012-345 6789" 与 "0123456789" 视为同一个号码
+ *
+ * @param input 用户输入
+ * @param out 输出缓冲区
+ * @param out_len 缓冲区大小
+ * @return 规范化后的长度，0 表示输入中没有数字或缓冲区不足
+ */
+size_t pdrm_mule_normalise(const char *input, char *out, size_t out_len) {
+    size_t n = 0;
+
+    if (!input || !out || out_len == 0) return 0;
+
+    for (const char *p = input; *p; p++) {
+        if (!isdigit((unsigned char) *p)) continue;
+
+        if (n + 1 >= out_len) {
+            out[0] = '\0';
+            return 0;
+        }
+
+        out[n++] = *p;
+    }
+
+    out[n] = '\0';
+
+    return n;
+}
+
+/**
+ * 构造 Semak Mule 查询请求体（电话号码和银行账号两个字段填同一个号码）
+ *
+ * @param number 规范化后的号码
+ * @param buf 输出缓冲区
+ * @param len 缓冲区大小
+ * @return 0表示成功，-1表示缓冲区不足
+ */
+int pdrm_mule_build_payload(const char *number, char *buf, size_t len) {
+    int n = snprintf(buf, len,
+                     "{\"data\":{\"category\":\"telefon\",\"bankAccount\":\"%s\","
+                     "\"telNo\":\"%s\",\"companyName\":\"\",\"captcha\":\"\"}}",
+                     number, number);
+
+    return (n < 0 || (size_t) n >= len) ? -1 : 0;
+}
+
+/**
+ * 同步查询一个号码：先查结果缓存，未命中再访问上游并写回缓存
+ *
+ * @param query 用户输入的号码（内部会规范化）
+ * @param out 输出结果，用完需调用 pdrm_mule_result_free
+ * @param cached 可为 NULL，输出结果是否来自缓存
+ * @return 0表示成功，-1表示上游失败，-2表示响应无法解析
+ */
+int pdrm_mule_lookup(const char *query, struct pdrm_mule_result *out, bool *cached) {
+    char key[64];
+    char payload[512];
+
+    if (cached) *cached = false;
+
+    pdrm_mule_normalise(query, key, sizeof(key));
+
+    if (pdrm_mule_cache_get(key, out)) {
+        if (cached) *cached = true;
+        return 0;
+    }
+
+    if (pdrm_mule_build_payload(key[0] ? key : query, payload, sizeof(payload)) != 0) return -1;
+
+    struct semak_mule_response resp = {0};
+
+    if (pdrm_semak_mule(upstream_url("MO_SEMAKMULE_URL", PDRM_MULE_URL), payload, &resp) != 0) {
+        pdrm_semak_mule_response_free(&resp);
+        return -1;
+    }
+
+    int rc = pdrm_parse_mule_result(&resp, out);
+
+    pdrm_semak_mule_response_free(&resp);
+
+    if (rc != 0) return -2;
+
+    pdrm_mule_cache_put(key, out);
+
+    return 0;
+}
+
+/**
+ * 解析 Semak Mule 响应，提取查询次数和报案数
+ *
+ * 只按路径取 count 和 table_data[0][1] 两个字段，不建树；
+ * 原始响应体直接转交给 out -> raw，不做复制。
+ *
+ * @param resp 上游响应，成功时其数据转交给 out（resp 被清空）
+ * @param out 输出结果，用完需调用 pdrm_mule_result_free
+ * @return 0表示成功，-1表示响应不是合法 JSON
+ */
+int pdrm_parse_mule_result(struct semak_mule_response *resp, struct pdrm_mule_result *out) {
+    if (!resp || !resp -> data || !out) return -1;
+
+    memset(out, 0, sizeof(*out));
+
+    if (!json_path_valid(resp -> data, resp -> size)) return -1;
+
+    long count = 0, reported = 0;
+
+    if (json_path_int(resp -> data, resp -> size, "count", &count) == 0) out -> count = (int) count;
+    if (json_path_int(resp -> data, resp -> size, "table_data[0][1]", &reported) == 0) out -> reported = (int) reported;
+
+    out -> raw = resp -> data;
+    out -> raw_size = resp -> size;
+
+    resp -> data = NULL;
+    resp -> size = 0;
+
+    return 0;
+}
+
+/**
+ * 释放解析结果
+ */
+void pdrm_mule_result_free(struct pdrm_mule_result *res) {
+    if (!res) return;
+
+    free(res -> raw);
+
+    res -> raw = NULL;
+    res -> raw_size = 0;
+}
+
+/**
+ * 初始化结果缓存
+ *
+ * @param capacity 最多缓存的号码数，0 表示关闭缓存
+ * @param ttl 有人报案的结果缓存秒数
+ * @param negative_ttl 无人报案（"未找到"）的结果缓存秒数，0 表示不缓存此类结果
+ * @return 0表示成功，-1表示失败
+ */
+int pdrm_mule_cache_init(size_t capacity, int ttl, int negative_ttl) {
+    if (mule_cache) return 0;
+    if (capacity == 0) return 0;
+
+    mule_cache = lru_cache_new(capacity);
+
+    if (!mule_cache) return -1;
+
+    mule_cache_ttl = ttl;
+    mule_cache_negative_ttl = negative_ttl;
+
+    return 0;
+}
+
+/**
+ * 释放结果缓存
+ */
+void pdrm_mule_cache_cleanup(void) {
+    lru_cache_free(mule_cache);
+    mule_cache = NULL;
+}
+
+/**
+ * 查询缓存
+ *
+ * @param key 规范化后的号码（见 pdrm_mule_normalise）
+ * @param out 命中时输出结果，用完需调用 pdrm_mule_result_free
+ * @return 1表示命中，0表示未命中
+ */
+int pdrm_mule_cache_get(const char *key, struct pdrm_mule_result *out) {
+    void *blob = NULL;
+    size_t len = 0;
+
+    if (!key || !*key || !out) return 0;
+    if (!lru_cache_get(mule_cache, key, &blob, &len)) return 0;
+
+    struct mule_cache_header hdr;
+
+    if (len < sizeof(hdr)) {
+        free(blob);
+        return 0;
+    }
+
+    memcpy(&hdr, blob, sizeof(hdr));
+
+    size_t raw_size = len - sizeof(hdr);
+
+    // 原地挪动，省一次分配
+    memmove(blob, (char *) blob + sizeof(hdr), raw_size);
+
+    char *raw = realloc(blob, raw_size + 1);
+
+    if (!raw) {
+        free(blob);
+        return 0;
+    }
+
+    raw[raw_size] = '\0';
+
+    out -> count = hdr.count;
+    out -> reported = hdr.reported;
+    out -> raw = raw;
+    out -> raw_size = raw_size;
+
+    return 1;
+}
+
+/**
+ * 写入缓存；无人报案的结果按 negative_ttl 缓存
+ *
+ * @param key 规范化后的号码
+ * @param res 解析结果（会被复制）
+ */
+void pdrm_mule_cache_put(const char *key, const struct pdrm_mule_result *res) {
+    if (!mule_cache || !key || !*key || !res) return;
+
+    int ttl = res -> reported > 0 ? mule_cache_ttl : mule_cache_negative_ttl;
+
+    if (ttl <= 0) return;
+
+    struct mule_cache_header hdr = { res -> count, res -> reported };
+    size_t len = sizeof(hdr) + res -> raw_size;
+    char *blob = malloc(len);
+
+    if (!blob) return;
+
+    memcpy(blob, &hdr, sizeof(hdr));
+
+    if (res -> raw_size) memcpy(blob + sizeof(hdr), res -> raw, res -> raw_size);
+
+    lru_cache_put(mule_cache, key, blob, len, ttl);
+
+    free(blob);
+}
+
+/**
+ * 读取缓存命中/未命中/淘汰计数
+ */
+void pdrm_mule_cache_get_stats(struct lru_cache_stats *out) {
+    lru_cache_get_stats(mule_cache, out);
+}
@@ -0,0 +1,262 @@
+/**
+ * @file response.c
+ * @brief 分段响应构造器
+ *
+ * 段有三种来源：
+ * - 借用：字符串常量、请求 arena 里的数据，只记录指针
+ * - 格式化：printf 结果写进请求 arena，同样只记录指针
+ * - 接管：上游响应体等堆内存，随 MHD 响应对象一起释放
+ *
+ * 最终通过 MHD_create_response_from_iovec 交出去，MHD 直接从各段发送，
+ * 正文长度没有固定上限。arena 中的段在 request_completed 之前一直有效，
+ * 而 MHD 在此之前已经发送完毕，所以借用是安全的。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "../include/response.h"
+#include "../include/arena.h"
+
+struct response_owned {
+    struct response_owned *next;
+    void (*free_fn)(void *);
+    void *owner;
+};
+
+static void free_owned(struct response_owned *o) {
+    while (o) {
+        struct response_owned *next = o -> next;
+
+        if (o -> free_fn) o -> free_fn(o -> owner);
+
+        free(o);
+        o = next;
+    }
+}
+
+/**
+ * MHD 销毁响应对象时回调：释放所有接管的内存
+ */
+static void release_owned(void *cls) {
+    free_owned((struct response_owned *) cls);
+}
+
+/**
+ * 初始化构造器
+ *
+ * @param b 构造器
+ * @param arena 格式化段所在的内存池，需要活到响应发送完毕；NULL 时格式化段改为由响应接管
+ */
+void response_builder_init(struct response_builder *b, struct arena *arena) {
+    memset(b, 0, sizeof(*b));
+    b -> arena = arena;
+}
+
+/**
+ * 追加一段借用的数据（必须在响应发送完之前保持有效）
+ *
+ * @return 0表示成功，-1表示内存不足（之后 finish 会失败）
+ */
+int response_builder_add(struct response_builder *b, const void *data, size_t len) {
+    if (b -> failed) return -1;
+    if (len == 0) return 0;
+
+    if (b -> count == b -> cap) {
+        size_t cap = b -> cap ? b -> cap * 2 : 16;
+        struct MHD_IoVec *iov = realloc(b -> iov, cap * sizeof(*iov));
+
+        if (!iov) {
+            b -> failed = true;
+            return -1;
+        }
+
+        b -> iov = iov;
+        b -> cap = cap;
+    }
+
+    b -> iov[b -> count].iov_base = data;
+    b -> iov[b -> count].iov_len = len;
+    b -> count++;
+    b -> total += len;
+
+    return 0;
+}
+
+int response_builder_add_str(struct response_builder *b, const char *s) {
+    return s ? response_builder_add(b, s, strlen(s)) : 0;
+}
+
+/**
+ * 追加一个带引号的 JSON 字符串
+ *
+ * 不需要转义时直接借用 s（同样必须在响应发送完之前保持有效），否则把转义后的副本写进 arena。
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+int response_builder_add_json_string(struct response_builder *b, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    size_t len = strlen(s);
+    size_t extra = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c == '"' || c == '\\') extra += 1;
+        else if (c < 0x20) extra += 5;
+    }
+
+    if (extra == 0) {
+        response_builder_add(b, "\"", 1);
+        response_builder_add(b, s, len);
+
+        return response_builder_add(b, "\"", 1);
+    }
+
+    if (b -> failed) return -1;
+
+    char *p = arena_alloc(b -> arena, len + extra + 2);
+
+    if (!p) {
+        b -> failed = true;
+        return -1;
+    }
+
+    char *o = p;
+
+    *o++ = '"';
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c == '"' || c == '\\') {
+            *o++ = '\\';
+            *o++ = (char) c;
+        } else if (c < 0x20) {
+            memcpy(o, "\\u00", 4);
+            o[4] = hex[c >> 4];
+            o[5] = hex[c & 15];
+            o += 6;
+        } else {
+            *o++ = (char) c;
+        }
+    }
+
+    *o++ = '"';
+
+    if (!b -> arena) return response_builder_adopt(b, p, (size_t) (o - p), free, p);
+
+    return response_builder_add(b, p, (size_t) (o - p));
+}
+
+/**
+ * 追加一段格式化文本
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+int response_builder_printf(struct response_builder *b, const char *fmt, ...) {
+    if (b -> failed) return -1;
+
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    char *p = n >= 0 ? arena_alloc(b -> arena, (size_t) n + 1) : NULL;
+
+    if (!p) {
+        b -> failed = true;
+        return -1;
+    }
+
+    va_start(ap, fmt);
+    vsnprintf(p, (size_t) n + 1, fmt, ap);
+    va_end(ap);
+
+    if (!b -> arena) return response_builder_adopt(b, p, (size_t) n, free, p);
+
+    return response_builder_add(b, p, (size_t) n);
+}
+
+/**
+ * 追加一段数据并接管其所有者：响应对象销毁时调用 free_fn(owner)
+ *
+ * 即使追加失败，owner 也已经被接管，调用方不得再释放。
+ *
+ * @param data 段起始地址（位于 owner 内）
+ * @param len 段长度
+ * @param free_fn 释放函数
+ * @param owner 传给 free_fn 的指针
+ * @return 0表示成功，-1表示内存不足
+ */
+int response_builder_adopt(struct response_builder *b, const void *data, size_t len, void (*free_fn)(void *), void *owner) {
+    struct response_owned *o = malloc(sizeof(*o));
+
+    if (!o) {
+        if (free_fn) free_fn(owner);
+
+        b -> failed = true;
+        return -1;
+    }
+
+    o -> free_fn = free_fn;
+    o -> owner = owner;
+    o -> next = b -> owned;
+    b -> owned = o;
+
+    return response_builder_add(b, data, len);
+}
+
+/**
+ * 生成 MHD 响应对象；构造器随即被清空
+ *
+ * @return 响应对象，任何一步内存不足时返回 NULL（接管的内存已释放）
+ */
+struct MHD_Response *response_builder_finish(struct response_builder *b) {
+    struct MHD_Response *r = NULL;
+
+    if (!b -> failed) {
+        // MHD 会复制 iovec 数组本身，段数据在 release_owned 之前保持有效即可
+        r = MHD_create_response_from_iovec(b -> count ? b -> iov : NULL, (unsigned int) b -> count,
+                                           release_owned, b -> owned);
+    }
+
+    if (!r) free_owned(b -> owned);
+
+    free(b -> iov);
+    memset(b, 0, sizeof(*b));
+
+    return r;
+}
+
+/**
+ * 生成响应并入队
+ *
+ * @param b 构造器
+ * @param connection 当前连接
+ * @param status HTTP 状态码
+ * @return MHD 处理结果
+ */
+enum MHD_Result response_builder_send(struct response_builder *b, struct MHD_Connection *connection, unsigned int status) {
+    struct MHD_Response *r = response_builder_finish(b);
+
+    if (!r) return MHD_NO;
+
+    enum MHD_Result ret = MHD_queue_response(connection, status, r);
+
+    MHD_destroy_response(r);
+
+    return ret;
+}
+
+/**
+ * 放弃构造：释放接管的内存
+ */
+void response_builder_discard(struct response_builder *b) {
+    free_owned(b -> owned);
+    free(b -> iov);
+    memset(b, 0, sizeof(*b));
+}
@@ -2,43 +2,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <ctype.h>
 #include <curl/curl.h>
 
 #include "../include/rmp_wanted.h"
 #include "../include/sspi.h"
 #include "../include/mykad.h"
 #include "../include/memory.h"
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
+#include "../include/snapshot.h"
+#include "../include/html_stream.h"
+#include "../include/html_scan.h"
 
 #ifndef PDRM_WANTED__LIST
 #define PDRM_WANTED__LIST "https://www.rmp.gov.my/orang-dikehendaki"
 #endif
 
+// 每条通缉记录的起始标记，以及单条记录最多缓存的字节数
+#define WANTED_BLOCK_MARKER "<div class=\"wanted-person\">"
+#define WANTED_BLOCK_MAX (16 * 1024)
 
-/**
- * CURL写回调函数，用于接收HTTP响应数据并存储到动态分配的内存中
- * @param contents 指向接收到的数据块的指针
- * @param size 每个数据元素的大小（字节数）
- * @param nmemb 数据元素的数量
- * @param userp 指向用户自定义数据结构的指针（这里是struct memory）
- * @return 返回实际处理的数据大小，如果失败返回0
- */
-static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    struct memory *mem = (struct memory *)userp;
-    
-    char *ptr = realloc(mem -> data, mem -> size + realsize + 1);
-
-    if(!ptr) return 0;
-
-    mem -> data = ptr;
-    
-    memcpy(&(mem -> data[mem -> size]), contents, realsize);
-    
-    mem -> size += realsize;
-    mem -> data[mem -> size] = 0;
-    
-    return realsize;
-}
 
 /**
  * 从指定URL获取HTML内容
@@ -51,32 +36,29 @@ char* rmp_fetch_wanted_html(const char* url) {
 
     struct memory chunk = {0};
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl = curl_easy_init();
+    curl = curl_pool_acquire();
     
-    if(curl) {
-        chunk.data = malloc(1);
-        chunk.size = 0;
-    
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
+    if(!curl) return NULL;
 
-        res = curl_easy_perform(curl);
-    
-        if(res != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-            free(chunk.data);
-    
-            chunk.data = NULL;
-        }
-    
-        curl_easy_cleanup(curl);
+    struct upstream_call call = {
+        .source = METRICS_SRC_RMP, .url = url,
+        .write = memory_write_callback, .write_data = &chunk,
+    };
+
+    memory_attach_curl(curl, &chunk);
+
+    res = upstream_perform(curl, &call);
+
+    curl_pool_release(curl);
+
+    // 失败已由 upstream_perform 计入 mo_upstream_errors_total
+    if(res != CURLE_OK) {
+        memory_release(&chunk);
+
+        return NULL;
     }
     
-    curl_global_cleanup();
-    
-    return chunk.data;
+    return memory_detach(&chunk);
 }
 
 /**
@@ -92,6 +74,103 @@ void rmp_free_html(char* html) {
     if(html) free(html);
 }
 
+/**
+ * 在 [start, end) 范围内查找身份证号码（12 位数字，允许 YYMMDD-PB-###G 形式的连字符）
+ *
+ * @param start 查找起点
+ * @param end 查找终点（NULL 表示直到字符串结束）
+ * @param out 输出缓冲区，找不到时写入空字符串
+ * @param out_len 输出缓冲区大小
+ */
+static void extract_ic(const char *start, const char *end, char *out, size_t out_len) {
+    out[0] = '\0';
+
+    for (const char *p = start; *p && (!end || p < end); p++) {
+        if (!isdigit((unsigned char) *p) || (p > start && isdigit((unsigned char) p[-1]))) continue;
+
+        char digits[13];
+        size_t n = 0;
+        const char *q = p;
+
+        while (*q && (!end || q < end) && n < 13) {
+            if (isdigit((unsigned char) *q)) digits[n++] = *q;
+            else if (*q != '-') break;
+
+            q++;
+        }
+
+        if (n == 12 && !isdigit((unsigned char) *q) && out_len > 12) {
+            memcpy(out, digits, 12);
+            out[12] = '\0';
+            return;
+        }
+    }
+}
+
+/**
+ * 流式解析的累积结果
+ */
+struct wanted_stream {
+    struct html_block blocks;
+    WantedPerson *list;
+    int count;
+    int cap;
+};
+
+/**
+ * 一个 wanted-person 块到齐：提取姓名、年龄、照片和身份证号
+ */
+static void on_wanted_block(const char *block, size_t len, void *userdata) {
+    struct wanted_stream *st = (struct wanted_stream *) userdata;
+
+    if (st -> count == st -> cap) {
+        int ncap = st -> cap ? st -> cap * 2 : 32;
+        WantedPerson *list = realloc(st -> list, (size_t) ncap * sizeof(WantedPerson));
+
+        if (!list) return;
+
+        st -> list = list;
+        st -> cap = ncap;
+    }
+
+    WantedPerson *wp = &st -> list[st -> count++];
+
+    // 三个字段在块内一次遍历取出
+    struct html_field fields[] = {
+        { "<h3>", "</h3>", wp -> name, sizeof(wp -> name) },
+        { "<span class=\"age\">", "</span>", wp -> age, sizeof(wp -> age) },
+        { "<img src=\"", "\"", wp -> photo_url, sizeof(wp -> photo_url) },
+    };
+
+    html_scan_fields(block, len, fields, sizeof(fields) / sizeof(fields[0]));
+    extract_ic(block, NULL, wp -> ic, sizeof(wp -> ic));
+}
+
+static int wanted_stream_init(struct wanted_stream *st) {
+    memset(st, 0, sizeof(*st));
+
+    return html_block_init(&st -> blocks, WANTED_BLOCK_MARKER, WANTED_BLOCK_MAX, on_wanted_block, st);
+}
+
+/**
+ * 结束解析并交出结果
+ */
+static int wanted_stream_finish(struct wanted_stream *st, WantedPerson **list) {
+    html_block_finish(&st -> blocks);
+    html_block_free(&st -> blocks);
+
+    *list = st -> list;
+
+    return st -> count;
+}
+
+static size_t wanted_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    struct wanted_stream *st = (struct wanted_stream *) userp;
+
+    return html_block_feed(&st -> blocks, (const char *) contents, realsize) == 0 ? realsize : 0;
+}
+
 /**
  * 从HTML内容中解析通缉人员列表
  * 
@@ -102,54 +181,225 @@ void rmp_free_html(char* html) {
  * 
  * 该函数会解析HTML中所有class为"wanted-person"的div元素，
  * 提取其中的姓名、年龄和照片URL信息，并动态分配内存存储这些信息。
+ * 与 rmp_stream_wanted_list 共用同一个流式解析器。
  */
 int rmp_parse_wanted_list(const char* html, WantedPerson** list) {
-    int count = 0;
+    struct wanted_stream st;
+
     *list = NULL;
-    const char* ptr = html;
-    
-    while((ptr = strstr(ptr, "<div class=\"wanted-person\">")) != NULL) {
-        *list = realloc(*list, (count+1) * sizeof(WantedPerson));
-    
-        if(!*list) return count;
 
-        WantedPerson* wp = &(*list)[count];
+    if (!html || wanted_stream_init(&st) != 0) return 0;
 
-        const char* name_start = strstr(ptr, "<h3>");
-        const char* name_end = strstr(ptr, "</h3>");
-    
-        if(name_start && name_end && name_end > name_start) {
-            size_t len = name_end - (name_start+4);
-    
-            strncpy(wp -> name, name_start+4, len < MAX_NAME_LEN-1 ? len : MAX_NAME_LEN-1);
-            wp -> name[len < MAX_NAME_LEN-1 ? len : MAX_NAME_LEN-1] = '\0';
-        } else wp -> name[0] = '\0';
-
-        const char* age_start = strstr(ptr, "<span class=\"age\">");
-        const char* age_end = strstr(ptr, "</span>");
-        
-        if(age_start && age_end && age_end > age_start) {
-            size_t len = age_end - (age_start+19);
-        
-            strncpy(wp -> age, age_start+19, len < MAX_AGE_LEN-1 ? len : MAX_AGE_LEN-1);
-            wp -> age[len < MAX_AGE_LEN-1 ? len : MAX_AGE_LEN-1] = '\0';
-        } else wp -> age[0] = '\0';
-
-        const char* photo_start = strstr(ptr, "<img src=\"");
-        const char* photo_end = strstr(photo_start ? photo_start+10 : NULL, "\"");
-        
-        if(photo_start && photo_end && photo_end > photo_start) {
-            size_t len = photo_end - (photo_start+10);
-        
-            strncpy(wp -> photo_url, photo_start+10, len < MAX_PHOTO_LEN-1 ? len : MAX_PHOTO_LEN-1);
-            wp -> photo_url[len < MAX_PHOTO_LEN-1 ? len : MAX_PHOTO_LEN-1] = '\0';
-        } else wp -> photo_url[0] = '\0';
-
-        count++;
-        ptr = name_end;
+    html_block_feed(&st.blocks, html, strlen(html));
+
+    return wanted_stream_finish(&st, list);
+}
+
+/**
+ * 下载并解析通缉名单：边接收边按 wanted-person 块解析，只缓存当前块而不是整页
+ *
+ * @param url 名单页面地址
+ * @param list 输出的通缉人员数组（调用者负责 free）
+ * @return 解析到的人数，下载失败返回 -1
+ */
+int rmp_stream_wanted_list(const char *url, WantedPerson **list) {
+    struct wanted_stream st;
+
+    *list = NULL;
+
+    if (wanted_stream_init(&st) != 0) return -1;
+
+    CURL *curl = curl_pool_acquire();
+
+    if (!curl) {
+        html_block_free(&st.blocks);
+        return -1;
+    }
+
+    struct upstream_call call = {
+        .source = METRICS_SRC_RMP, .url = url,
+        .write = wanted_write_callback, .write_data = &st,
+    };
+
+    CURLcode res = upstream_perform(curl, &call);
+
+    curl_pool_release(curl);
+
+    if (res != CURLE_OK) {
+        html_block_free(&st.blocks);
+        free(st.list);
+
+        return -1;
+    }
+
+    return wanted_stream_finish(&st, list);
+}
+
+/**
+ * 通缉名单索引中的一条键：规范化后的姓名或身份证号 → persons 下标
+ */
+struct wanted_key {
+    char key[MAX_NAME_LEN];
+    size_t idx;
+};
+
+/**
+ * 一份通缉名单快照：原始记录 + 按姓名、身份证号排序的两个索引
+ */
+struct wanted_index {
+    WantedPerson *persons;
+    size_t count;
+    struct wanted_key *by_name;
+    size_t name_count;
+    struct wanted_key *by_ic;
+    size_t ic_count;
+};
+
+static struct snapshot_source wanted_source;
+
+/**
+ * 规范化查询键：只保留字母数字并转为大写，忽略空格、连字符和标点
+ */
+static void normalise_key(const char *src, char *out, size_t out_len) {
+    size_t n = 0;
+
+    for (; src && *src && n + 1 < out_len; src++) {
+        if (isalnum((unsigned char) *src)) out[n++] = (char) toupper((unsigned char) *src);
+    }
+
+    out[n] = '\0';
+}
+
+static int compare_key(const void *a, const void *b) {
+    return strcmp(((const struct wanted_key *) a) -> key, ((const struct wanted_key *) b) -> key);
+}
+
+static void wanted_index_free(void *data) {
+    struct wanted_index *index = (struct wanted_index *) data;
+
+    if (!index) return;
+
+    free(index -> persons);
+    free(index -> by_name);
+    free(index -> by_ic);
+    free(index);
+}
+
+/**
+ * 快照加载函数：流式下载并解析通缉名单，建立排序索引
+ *
+ * @param ctx 名单 URL
+ * @return 新的 wanted_index，下载失败返回 NULL
+ */
+static void *wanted_index_load(void *ctx) {
+    WantedPerson *persons = NULL;
+    int count = rmp_stream_wanted_list((const char *) ctx, &persons);
+
+    if (count < 0) return NULL;
+
+    struct wanted_index *index = calloc(1, sizeof(*index));
+
+    if (!index) {
+        free(persons);
+        return NULL;
+    }
+
+    index -> persons = persons;
+
+    index -> count = count > 0 ? (size_t) count : 0;
+
+    if (index -> count > 0) {
+        index -> by_name = calloc(index -> count, sizeof(struct wanted_key));
+        index -> by_ic = calloc(index -> count, sizeof(struct wanted_key));
+
+        if (!index -> by_name || !index -> by_ic) {
+            wanted_index_free(index);
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < index -> count; i++) {
+        const WantedPerson *wp = &index -> persons[i];
+        struct wanted_key *k = &index -> by_name[index -> name_count];
+
+        normalise_key(wp -> name, k -> key, sizeof(k -> key));
+
+        if (k -> key[0]) {
+            k -> idx = i;
+            index -> name_count++;
+        }
+
+        if (wp -> ic[0]) {
+            k = &index -> by_ic[index -> ic_count++];
+
+            normalise_key(wp -> ic, k -> key, sizeof(k -> key));
+            k -> idx = i;
+        }
+    }
+
+    qsort(index -> by_name, index -> name_count, sizeof(struct wanted_key), compare_key);
+    qsort(index -> by_ic, index -> ic_count, sizeof(struct wanted_key), compare_key);
+
+    return index;
+}
+
+/**
+ * 启动通缉名单的后台刷新索引
+ *
+ * @param ttl 快照有效期（秒），<=0 时使用 RMP_WANTED_TTL
+ * @param stale_while_revalidate 过期后是否继续返回旧快照并在后台刷新
+ * @return 0表示成功，-1表示失败
+ */
+int rmp_wanted_index_start(int ttl, bool stale_while_revalidate) {
+    wanted_source.name = "RMP Wanted";
+    wanted_source.load = wanted_index_load;
+    wanted_source.free_fn = wanted_index_free;
+    wanted_source.ctx = (void *) upstream_url("MO_WANTED_URL", PDRM_WANTED__LIST);
+    wanted_source.ttl = ttl > 0 ? ttl : RMP_WANTED_TTL;
+    wanted_source.stale_while_revalidate = stale_while_revalidate;
+
+    return snapshot_start(&wanted_source);
+}
+
+/**
+ * 停止通缉名单索引的后台刷新并释放快照
+ */
+void rmp_wanted_index_stop(void) {
+    snapshot_stop(&wanted_source);
+}
+
+/**
+ * 在内存索引中查找通缉人员（不产生任何网络请求）
+ *
+ * 查询先按规范化后的身份证号匹配，再按规范化后的姓名匹配，均为二分查找。
+ *
+ * @param query 身份证号或姓名
+ * @param out 命中时写入该人员的信息（可为 NULL）
+ * @return 1表示命中，0表示未命中，-1表示索引尚不可用
+ */
+int rmp_wanted_lookup(const char *query, WantedPerson *out) {
+    struct wanted_key needle;
+    normalise_key(query, needle.key, sizeof(needle.key));
+
+    if (!needle.key[0]) return 0;
+
+    struct snapshot_ref *ref = snapshot_acquire(&wanted_source);
+    const struct wanted_index *index = snapshot_data(ref);
+
+    if (!index) {
+        snapshot_release(&wanted_source, ref);
+        return -1;
     }
 
-    return count;
+    const struct wanted_key *hit = bsearch(&needle, index -> by_ic, index -> ic_count, sizeof(struct wanted_key), compare_key);
+
+    if (!hit) hit = bsearch(&needle, index -> by_name, index -> name_count, sizeof(struct wanted_key), compare_key);
+
+    if (hit && out) *out = index -> persons[hit -> idx];
+
+    snapshot_release(&wanted_source, ref);
+
+    return hit ? 1 : 0;
 }
 
 /**
@@ -168,31 +418,10 @@ char* handle_id_request(const char* id) {
         return msg;
     }
 
-    char *mykad_json = mykad_check(id);
-
-    WantedPerson *wanted_list = NULL;
-
-    char *html = rmp_fetch_wanted_html(PDRM_WANTED__LIST);
-    int wanted_count = 0;
-    bool is_wanted = false;
+    char *mykad_json = mykad_check(id, NULL);
 
     WantedPerson wp = {0};
-
-    if(html) {
-        wanted_count = rmp_parse_wanted_list(html, &wanted_list);
-
-        for(int i=0; i<wanted_count; i++) {
-            
-            if(strstr(wanted_list[i].name, id)) {
-                is_wanted = true;
-                wp = wanted_list[i];
-
-                break;
-            }
-        }
-        rmp_free_html(html);
-        if(wanted_list) free(wanted_list);
-    }
+    bool is_wanted = rmp_wanted_lookup(id, &wp) == 1;
 
     size_t buf_len = 1024 + (mykad_json ? strlen(mykad_json) : 0);
     char *result_buf = malloc(buf_len);
@@ -0,0 +1,277 @@
+/**
+ * @file singleflight.c
+ * @brief 相同上游请求的合并（single-flight）
+ *
+ * 以 (数据源, 规范化后的查询) 为键：同一时刻只有第一个调用方（leader）真正访问上游，
+ * 其余并发调用方（follower）挂在同一个 flight 上，等 leader 完成后各自拿到一份结果副本。
+ * flight 在完成的瞬间即被移除，之后到来的请求会重新发起上游调用，
+ * 因此这里只合并"正在进行"的请求，不承担缓存职责。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "../include/singleflight.h"
+
+#define SINGLEFLIGHT_BUCKETS 256
+
+struct flight_waiter {
+    singleflight_fn fn;
+    void *userdata;
+    struct flight_waiter *next;
+};
+
+struct flight {
+    char *source;
+    char *key;
+    uint32_t hash;
+    struct flight_waiter *waiters;
+    struct flight *next;
+};
+
+static pthread_mutex_t flights_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct flight *flights[SINGLEFLIGHT_BUCKETS];
+static struct singleflight_stats stats;
+
+static uint32_t hash_key(const char *source, const char *key) {
+    uint32_t h = 2166136261u;
+
+    for (const char *p = source; *p; p++) h = (h ^ (unsigned char) *p) * 16777619u;
+
+    h = (h ^ 0xff) * 16777619u;
+
+    for (const char *p = key; *p; p++) h = (h ^ (unsigned char) *p) * 16777619u;
+
+    return h;
+}
+
+static struct flight **find_flight(const char *source, const char *key, uint32_t hash) {
+    struct flight **pp = &flights[hash % SINGLEFLIGHT_BUCKETS];
+
+    while (*pp) {
+        struct flight *f = *pp;
+
+        if (f -> hash == hash && strcmp(f -> source, source) == 0 && strcmp(f -> key, key) == 0) break;
+
+        pp = &f -> next;
+    }
+
+    return pp;
+}
+
+/**
+ * 加入一次上游请求
+ *
+ * 返回 1 时调用方成为 leader，必须自行访问上游并在结束后（无论成败）调用 singleflight_complete；
+ * 返回 0 时调用方成为 follower，leader 完成后会在 leader 的线程中调用 fn。
+ *
+ * @param source 数据源名称
+ * @param key 规范化后的查询
+ * @param fn follower 的完成回调，data 只在回调期间有效
+ * @param userdata 回调参数
+ * @return 1表示leader，0表示follower，-1表示失败（调用方应直接访问上游，不参与合并）
+ */
+int singleflight_join(const char *source, const char *key, singleflight_fn fn, void *userdata) {
+    if (!source || !key || !fn) return -1;
+
+    uint32_t hash = hash_key(source, key);
+
+    pthread_mutex_lock(&flights_lock);
+
+    struct flight **pp = find_flight(source, key, hash);
+
+    if (*pp) {
+        struct flight_waiter *w = malloc(sizeof(*w));
+
+        if (!w) {
+            pthread_mutex_unlock(&flights_lock);
+            return -1;
+        }
+
+        w -> fn = fn;
+        w -> userdata = userdata;
+        w -> next = (*pp) -> waiters;
+        (*pp) -> waiters = w;
+
+        stats.followers++;
+
+        pthread_mutex_unlock(&flights_lock);
+
+        return 0;
+    }
+
+    struct flight *f = calloc(1, sizeof(*f));
+
+    if (f) {
+        f -> source = strdup(source);
+        f -> key = strdup(key);
+    }
+
+    if (!f || !f -> source || !f -> key) {
+        if (f) {
+            free(f -> source);
+            free(f -> key);
+        }
+
+        free(f);
+        pthread_mutex_unlock(&flights_lock);
+
+        return -1;
+    }
+
+    f -> hash = hash;
+    *pp = f;
+
+    stats.leaders++;
+    stats.in_flight++;
+
+    pthread_mutex_unlock(&flights_lock);
+
+    return 1;
+}
+
+/**
+ * leader 完成上游请求：移除 flight 并把结果分发给所有 follower
+ *
+ * @param source 数据源名称
+ * @param key 规范化后的查询
+ * @param status 上游请求结果，0 表示成功
+ * @param data 响应数据（follower 各自复制，调用方保留所有权）
+ * @param size 响应长度
+ */
+void singleflight_complete(const char *source, const char *key, int status, const char *data, size_t size) {
+    if (!source || !key) return;
+
+    pthread_mutex_lock(&flights_lock);
+
+    struct flight **pp = find_flight(source, key, hash_key(source, key));
+    struct flight *f = *pp;
+
+    if (f) {
+        *pp = f -> next;
+        stats.in_flight--;
+    }
+
+    pthread_mutex_unlock(&flights_lock);
+
+    if (!f) return;
+
+    // 回调在锁外执行：follower 可能立刻为同一个键发起新的请求
+    struct flight_waiter *w = f -> waiters;
+
+    while (w) {
+        struct flight_waiter *next = w -> next;
+
+        w -> fn(status, data, size, w -> userdata);
+        free(w);
+
+        w = next;
+    }
+
+    free(f -> source);
+    free(f -> key);
+    free(f);
+}
+
+/**
+ * 同步调用方阻塞等待 leader 结果时使用的等待点
+ */
+struct flight_wait {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool done;
+    int status;
+    char *data;
+    size_t size;
+};
+
+static void wait_done(int status, const char *data, size_t size, void *userdata) {
+    struct flight_wait *w = (struct flight_wait *) userdata;
+    char *copy = NULL;
+
+    if (status == 0 && !data) status = -1;
+
+    if (status == 0) {
+        copy = malloc(size + 1);
+
+        if (copy) {
+            memcpy(copy, data, size);
+            copy[size] = '\0';
+        } else {
+            status = -1;
+        }
+    }
+
+    pthread_mutex_lock(&w -> lock);
+
+    w -> status = status;
+    w -> data = copy;
+    w -> size = copy ? size : 0;
+    w -> done = true;
+
+    pthread_cond_signal(&w -> cond);
+    pthread_mutex_unlock(&w -> lock);
+}
+
+/**
+ * 同步版本：leader 调用 load 访问上游，follower 阻塞等待 leader 的结果
+ *
+ * @param source 数据源名称
+ * @param key 规范化后的查询
+ * @param load 实际访问上游的函数，成功返回 0 并输出 malloc 分配的数据
+ * @param arg load 的参数
+ * @param data 成功时输出结果（以 '\0' 结尾，调用方负责 free）
+ * @param size 成功时输出结果长度
+ * @return load 的返回值（follower 拿到的是 leader 的返回值）
+ */
+int singleflight_do(const char *source, const char *key, singleflight_load_fn load, void *arg, char **data, size_t *size) {
+    struct flight_wait w = { .done = false, .status = -1, .data = NULL, .size = 0 };
+
+    *data = NULL;
+    *size = 0;
+
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.cond, NULL);
+
+    int role = singleflight_join(source, key, wait_done, &w);
+
+    if (role != 0) {
+        int status = load(arg, data, size);
+
+        if (role == 1) singleflight_complete(source, key, status, status == 0 ? *data : NULL, status == 0 ? *size : 0);
+
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.lock);
+
+        return status;
+    }
+
+    pthread_mutex_lock(&w.lock);
+
+    while (!w.done) pthread_cond_wait(&w.cond, &w.lock);
+
+    pthread_mutex_unlock(&w.lock);
+
+    pthread_cond_destroy(&w.cond);
+    pthread_mutex_destroy(&w.lock);
+
+    *data = w.data;
+    *size = w.size;
+
+    return w.status;
+}
+
+/**
+ * 读取合并统计：leaders 为真正访问上游的次数，followers 为被合并掉的请求数
+ */
+void singleflight_get_stats(struct singleflight_stats *out) {
+    if (!out) return;
+
+    pthread_mutex_lock(&flights_lock);
+    *out = stats;
+    pthread_mutex_unlock(&flights_lock);
+}
@@ -0,0 +1,236 @@
+/**
+ * @file snapshot.c
+ * @brief 后台定时刷新的只读数据快照
+ *
+ * 适用于"整份公开名单下载下来、建好索引、反复查询"的数据源（RMP 通缉名单、SPRM 名单等）。
+ * 一个后台线程按 TTL 重新加载数据，新快照建好后在锁内原子替换旧快照；
+ * 查询方通过引用计数持有快照，替换时不会被打断，最后一个持有者释放时才真正销毁。
+ *
+ * stale_while_revalidate 打开时，过期快照照常返回并在后台触发刷新，
+ * 上游宕机也不会阻塞查询；关闭时，查询方会等待一次刷新结束，拿不到新数据就返回 NULL。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/snapshot.h"
+
+struct snapshot_ref {
+    void *data;
+    int refs;
+};
+
+/**
+ * 在持锁状态下减少引用计数
+ *
+ * @return 计数归零时返回需要释放的快照，否则返回 NULL
+ */
+static struct snapshot_ref *unref_locked(struct snapshot_ref *ref) {
+    if (!ref) return NULL;
+
+    return (--ref -> refs == 0) ? ref : NULL;
+}
+
+static void destroy_ref(struct snapshot_source *src, struct snapshot_ref *ref) {
+    if (!ref) return;
+
+    if (src -> free_fn) src -> free_fn(ref -> data);
+
+    free(ref);
+}
+
+static bool expired_locked(const struct snapshot_source *src, time_t now) {
+    return !src -> current || now - src -> loaded_at >= src -> ttl;
+}
+
+/**
+ * 后台刷新线程：到期或被请求时调用 load 重建快照，失败按 SNAPSHOT_RETRY_SECONDS 退避
+ */
+static void *refresh_loop(void *arg) {
+    struct snapshot_source *src = (struct snapshot_source *) arg;
+
+    pthread_mutex_lock(&src -> lock);
+
+    while (src -> running) {
+        time_t now = time(NULL);
+        time_t due = src -> current ? src -> loaded_at + src -> ttl : now;
+
+        if (src -> refresh_requested && due > now) due = now;
+        if (due < src -> next_retry) due = src -> next_retry;
+
+        if (now < due) {
+            struct timespec ts = { .tv_sec = due, .tv_nsec = 0 };
+            pthread_cond_timedwait(&src -> wake, &src -> lock, &ts);
+            continue;
+        }
+
+        src -> refresh_requested = false;
+        pthread_mutex_unlock(&src -> lock);
+
+        void *data = src -> load(src -> ctx);
+        struct snapshot_ref *fresh = NULL;
+
+        if (data) {
+            fresh = malloc(sizeof(*fresh));
+
+            if (fresh) {
+                fresh -> data = data;
+                fresh -> refs = 1;
+            } else if (src -> free_fn) {
+                src -> free_fn(data);
+            }
+        }
+
+        pthread_mutex_lock(&src -> lock);
+
+        struct snapshot_ref *old = NULL;
+
+        if (fresh) {
+            old = unref_locked(src -> current);
+            src -> current = fresh;
+            src -> loaded_at = time(NULL);
+            src -> next_retry = 0;
+        } else {
+            fprintf(stderr, "[%s] 快照刷新失败，%d 秒后重试\n", src -> name, SNAPSHOT_RETRY_SECONDS);
+            src -> next_retry = time(NULL) + SNAPSHOT_RETRY_SECONDS;
+        }
+
+        src -> generation++;
+        pthread_cond_broadcast(&src -> loaded);
+
+        if (old) {
+            pthread_mutex_unlock(&src -> lock);
+            destroy_ref(src, old);
+            pthread_mutex_lock(&src -> lock);
+        }
+    }
+
+    pthread_mutex_unlock(&src -> lock);
+
+    return NULL;
+}
+
+/**
+ * 启动数据源的后台刷新线程（首次加载也在后台进行，不阻塞调用方）
+ *
+ * @param src 已填好 name/load/free_fn/ctx/ttl/stale_while_revalidate 的数据源
+ * @return 0表示成功，-1表示失败
+ */
+int snapshot_start(struct snapshot_source *src) {
+    if (!src || !src -> load || src -> running) return -1;
+
+    pthread_mutex_init(&src -> lock, NULL);
+    pthread_cond_init(&src -> wake, NULL);
+    pthread_cond_init(&src -> loaded, NULL);
+
+    src -> current = NULL;
+    src -> loaded_at = 0;
+    src -> next_retry = 0;
+    src -> generation = 0;
+    src -> refresh_requested = true;
+    src -> running = true;
+
+    if (pthread_create(&src -> thread, NULL, refresh_loop, src) != 0) {
+        src -> running = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * 停止后台线程并释放数据源持有的快照
+ * 调用前应保证没有查询方仍持有快照引用
+ */
+void snapshot_stop(struct snapshot_source *src) {
+    if (!src || !src -> running) return;
+
+    pthread_mutex_lock(&src -> lock);
+    src -> running = false;
+    pthread_cond_broadcast(&src -> wake);
+    pthread_mutex_unlock(&src -> lock);
+
+    pthread_join(src -> thread, NULL);
+
+    destroy_ref(src, unref_locked(src -> current));
+    src -> current = NULL;
+
+    pthread_cond_destroy(&src -> loaded);
+    pthread_cond_destroy(&src -> wake);
+    pthread_mutex_destroy(&src -> lock);
+}
+
+/**
+ * 获取当前快照的引用
+ *
+ * @param src 数据源
+ * @return 快照引用，用完必须调用 snapshot_release；
+ *         尚无可用快照（或严格模式下刷新失败）时返回 NULL
+ */
+struct snapshot_ref *snapshot_acquire(struct snapshot_source *src) {
+    if (!src || !src -> running) return NULL;
+
+    pthread_mutex_lock(&src -> lock);
+
+    time_t now = time(NULL);
+
+    if (expired_locked(src, now)) {
+        src -> refresh_requested = true;
+        pthread_cond_signal(&src -> wake);
+
+        if (!src -> stale_while_revalidate) {
+            unsigned long gen = src -> generation;
+            struct timespec ts = { .tv_sec = now + SNAPSHOT_WAIT_SECONDS, .tv_nsec = 0 };
+
+            while (src -> generation == gen) {
+                if (pthread_cond_timedwait(&src -> loaded, &src -> lock, &ts) != 0) break;
+            }
+
+            if (expired_locked(src, time(NULL))) {
+                pthread_mutex_unlock(&src -> lock);
+                return NULL;
+            }
+        }
+    }
+
+    struct snapshot_ref *ref = src -> current;
+
+    if (ref) ref -> refs++;
+
+    pthread_mutex_unlock(&src -> lock);
+
+    return ref;
+}
+
+/**
+ * 取出快照引用中的数据
+ */
+const void *snapshot_data(const struct snapshot_ref *ref) {
+    return ref ? ref -> data : NULL;
+}
+
+/**
+ * 释放 snapshot_acquire 得到的引用
+ */
+void snapshot_release(struct snapshot_source *src, struct snapshot_ref *ref) {
+    if (!src || !ref) return;
+
+    pthread_mutex_lock(&src -> lock);
+    struct snapshot_ref *dead = unref_locked(ref);
+    pthread_mutex_unlock(&src -> lock);
+
+    destroy_ref(src, dead);
+}
+
+/**
+ * 请求后台线程尽快刷新一次（不等待结果）
+ */
+void snapshot_refresh(struct snapshot_source *src) {
+    if (!src || !src -> running) return;
+
+    pthread_mutex_lock(&src -> lock);
+    src -> refresh_requested = true;
+    pthread_cond_signal(&src -> wake);
+    pthread_mutex_unlock(&src -> lock);
+}
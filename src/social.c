@@ -3,59 +3,90 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
+#include <pthread.h>
 #include <curl/curl.h>
 
+#include <microhttpd.h>
+
 #include "../include/memory.h"
 #include "../include/social.h"
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
+#include "../include/stream_buffer.h"
 
-#define MHD_CONTENT_READER_END_WITHOUT_FLUSH 0
-#define MHD_CONTENT_READER_END_OF_STREAM 0
+#define SOCIAL_USER_AGENT "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/58.0.3029.110 Safari/537.36"
 
 /**
- * CURL写回调函数，用于接收HTTP响应数据并存储到用户定义的结构体中
- * 
- * @param ptr 指向接收到的数据的指针
- * @param size 每个数据元素的大小（字节数）
- * @param nmemb 数据元素的数量
- * @param userdata 指向用户数据的指针，这里应该是semak_mule_response结构体
- * 
- * @return 返回实际处理的数据大小（字节数），如果处理失败返回0
+ * 一次用户名扫描：探测全部交给上游事件循环，结果按完成顺序写入待发送缓冲区
+ *
+ * 引用计数：MHD 响应持有一份，每个在途的探测各持有一份。
  */
-static size_t write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
-    size_t total = size * nmemb;
-    struct memory *resp = (struct memory *)userdata;
+struct social_state {
+    pthread_mutex_t lock;
+    char *username;
+    size_t max_concurrency;
+    size_t max_per_host;
+    size_t next_target;
+    size_t started;
+    unsigned char *target_started;
+    size_t in_flight;
+    size_t refs;
+    bool cancelled;
+    struct social_probe *probes;
+    struct stream_buffer out;
+};
 
-    // 重新分配内存以容纳新接收的数据
-    char *new_data = realloc(resp -> data, resp -> size + total + 1);
+/**
+ * 单个探测任务的私有数据，作为完成回调的参数
+ */
+struct social_probe {
+    struct social_state *state;
+    size_t target;
+    char url[512];
+    struct memory chunk;
+    long status;
+    struct social_probe *prev;
+    struct social_probe *next;
+};
 
-    if (!new_data) {
-        fprintf(stderr, "realloc failed\n");
-        return 0;
-    }
+static void probe_done(CURL *curl, CURLcode res, void *userdata);
 
-    resp -> data = new_data;
+/**
+ * 从在飞链表中摘除探测任务并释放；需持有锁
+ */
+static void release_probe(struct social_state *state, struct social_probe *probe) {
+    if (probe -> prev) probe -> prev -> next = probe -> next;
+    else state -> probes = probe -> next;
 
-    // 将新数据复制到已分配的内存空间中
-    memcpy(&(resp -> data[resp -> size]), ptr, total);
-    
-    resp -> size += total;
-    resp -> data[resp -> size] = '\0';
-    
-    return total;
+    if (probe -> next) probe -> next -> prev = probe -> prev;
+
+    memory_release(&probe -> chunk);
+    free(probe);
+}
+
+static void state_destroy(struct social_state *state) {
+    stream_buffer_release(&state -> out);
+    pthread_mutex_destroy(&state -> lock);
+
+    free(state -> target_started);
+    free(state -> username);
+    free(state);
 }
 
 /**
  * 初始化CURL库
  * 
  * 该函数用于在程序启动时初始化CURL库，为后续的HTTP请求做准备。
- * 它会初始化所有的CURL功能，包括所有支持的协议和SSL功能。
+ * 它会初始化所有的CURL功能，包括所有支持的协议和SSL功能，并建立共享的句柄池。
  * 这个函数应该在程序开始时调用，并且在程序生命周期内只调用一次。
  * 
  * @note 这个函数不是线程安全的，应该在创建任何线程之前调用
  * @note 调用此函数后，必须在程序结束前调用cleanup_curl()进行清理
  */
 void init_curl() {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    curl_pool_init();
 }
 
 /**
@@ -69,44 +100,281 @@ void init_curl() {
  * @note 调用此函数后，如果还需要使用CURL，需要重新调用init_curl()
  */
 void cleanup_curl() {
-    curl_global_cleanup();
+    curl_pool_cleanup();
+}
+
+/**
+ * 为一次用户名探测配置 CURL 句柄（同步与并发两条路径共用）
+ *
+ * @param curl 待配置的 CURL 句柄
+ * @param url 已展开的目标地址
+ * @param chunk 接收响应体的缓冲区
+ */
+static void setup_probe(CURL *curl, const char *url, struct memory *chunk) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 3L);
+    memory_attach_curl(curl, chunk);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, SOCIAL_USER_AGENT);
+}
+
+/**
+ * 生成探测地址；设置了 MO_SOCIAL_URL 时所有目标都改为 "<base>/<目标下标>/<用户名>"，便于本地模拟
+ */
+static void probe_url(char *out, size_t len, const SocialTarget *target, const char *username) {
+    const char *base = upstream_url("MO_SOCIAL_URL", NULL);
+
+    if (base) snprintf(out, len, "%s/%zu/%s", base, (size_t) (target - targets), username);
+    else snprintf(out, len, target -> url_template, username);
+}
+
+/**
+ * 把一行结果追加到待发送缓冲区并唤醒读取方；需持有锁
+ */
+static void queue_line(struct social_state *state, const char *line, size_t len) {
+    stream_buffer_append(&state -> out, line, len);
+}
+
+/**
+ * 把一次探测的结果写入待发送缓冲区；需持有锁
+ *
+ * @param res 传输结果
+ */
+static void report_probe(struct social_state *state, const struct social_probe *probe, CURLcode res) {
+    const SocialTarget *target = &targets[probe -> target];
+    char line[768];
+    int n;
+
+    if (res == CURLE_OK && probe -> status == 200 && probe -> chunk.data && strstr(probe -> chunk.data, state -> username) != NULL) {
+        n = snprintf(line, sizeof(line), "[+] %s: username exists at %s\n", target -> name, probe -> url);
+    } else {
+        n = snprintf(line, sizeof(line), "[-] %s: username not found\n", target -> name);
+    }
+
+    if (n > (int) sizeof(line) - 1) n = sizeof(line) - 1;
+    queue_line(state, line, (size_t) n);
+}
+
+/**
+ * 取地址中的主机部分（"://" 之后到下一个 '/' 之前）
+ */
+static const char *url_host(const char *url, size_t *len) {
+    const char *p = strstr(url, "://");
+
+    p = p ? p + 3 : url;
+    *len = strcspn(p, "/?#");
+
+    return p;
+}
+
+/**
+ * 同一主机当前在飞的探测数；需持有锁
+ */
+static size_t host_in_flight(const struct social_state *state, const char *url) {
+    size_t len, n = 0;
+    const char *host = url_host(url, &len);
+
+    for (const struct social_probe *p = state -> probes; p; p = p -> next) {
+        size_t plen;
+        const char *phost = url_host(p -> url, &plen);
+
+        if (plen == len && strncasecmp(phost, host, len) == 0) n++;
+    }
+
+    return n;
+}
+
+/**
+ * 全部探测都已结束（或已取消且没有在飞的探测）
+ */
+static bool scan_finished(const struct social_state *state) {
+    return state -> in_flight == 0 && (state -> cancelled || state -> started >= targets_count);
+}
+
+/**
+ * 在并发上限内尽量多地把新的探测交给上游事件循环；需持有锁
+ *
+ * 总并发不超过 max_concurrency，同一主机不超过 max_per_host，
+ * 主机已满的目标先跳过，等该主机有探测完成后再提交。
+ */
+static void submit_probes(struct social_state *state) {
+    char url[512];
+
+    while (!state -> cancelled && state -> in_flight < state -> max_concurrency && state -> started < targets_count) {
+        size_t idx = targets_count;
+
+        while (state -> next_target < targets_count && state -> target_started[state -> next_target]) state -> next_target++;
+
+        for (size_t i = state -> next_target; i < targets_count; i++) {
+            if (state -> target_started[i]) continue;
+
+            probe_url(url, sizeof(url), &targets[i], state -> username);
+
+            if (host_in_flight(state, url) < state -> max_per_host) {
+                idx = i;
+                break;
+            }
+        }
+
+        // 剩下的目标所在主机都已满，等在飞的探测完成时再来
+        if (idx == targets_count) break;
+
+        state -> target_started[idx] = 1;
+        state -> started++;
+
+        struct social_probe *probe = calloc(1, sizeof(*probe));
+        CURL *curl = curl_pool_acquire();
+
+        if (probe && curl) {
+            probe -> state = state;
+            probe -> target = idx;
+            snprintf(probe -> url, sizeof(probe -> url), "%s", url);
+
+            setup_probe(curl, probe -> url, &probe -> chunk);
+        }
+
+        struct upstream_call call = {
+            .source = METRICS_SRC_SOCIAL, .url = url,
+            .write = memory_write_callback, .write_data = probe ? &probe -> chunk : NULL, .status_out = probe ? &probe -> status : NULL,
+        };
+
+        if (!probe || !curl || upstream_submit(curl, &call, probe_done, probe) != 0) {
+            free(probe);
+            curl_pool_release(curl);
+
+            char line[256];
+            int n = snprintf(line, sizeof(line), "[!] %s: probe could not be started\n", targets[idx].name);
+            queue_line(state, line, (size_t) n);
+
+            continue;
+        }
+
+        probe -> next = state -> probes;
+
+        if (state -> probes) state -> probes -> prev = probe;
+        state -> probes = probe;
+
+        state -> in_flight++;
+        state -> refs++;
+    }
+
+    if (scan_finished(state)) stream_buffer_wake(&state -> out);
+}
+
+/**
+ * 单个探测完成回调（在上游事件循环线程中执行）：写出结果，补上下一个探测
+ */
+static void probe_done(CURL *curl, CURLcode res, void *userdata) {
+    struct social_probe *probe = (struct social_probe *) userdata;
+    struct social_state *state = probe -> state;
+
+    curl_pool_release(curl);
+
+    pthread_mutex_lock(&state -> lock);
+
+    if (!state -> cancelled) report_probe(state, probe, res);
+
+    release_probe(state, probe);
+    state -> in_flight--;
+
+    submit_probes(state);
+
+    bool last = --state -> refs == 0;
+
+    pthread_mutex_unlock(&state -> lock);
+
+    if (last) state_destroy(state);
+}
+
+/**
+ * 创建一次用户名扫描并立即开始探测
+ *
+ * 所有目标通过上游事件循环并发探测，
+ * 同时在飞的请求数不超过 max_concurrency，同一主机的请求数不超过 max_per_host。
+ *
+ * @param username 要扫描的用户名（内部会复制一份）
+ * @param connection 结果要写回的连接，没有数据可发时读取函数会挂起它
+ * @param max_concurrency 并发上限，0 表示使用 SOCIAL_MAX_CONCURRENCY
+ * @param max_per_host 单主机并发上限，0 表示使用 SOCIAL_MAX_PER_HOST
+ * @return 新的扫描状态，失败返回 NULL；需通过 social_state_free 释放
+ */
+struct social_state *social_state_new(const char *username, struct MHD_Connection *connection, size_t max_concurrency, size_t max_per_host) {
+    if (!username) return NULL;
+
+    struct social_state *state = calloc(1, sizeof(*state));
+
+    if (!state) return NULL;
+
+    pthread_mutex_init(&state -> lock, NULL);
+
+    state -> username = strdup(username);
+    state -> target_started = calloc(targets_count ? targets_count : 1, 1);
+    state -> max_concurrency = max_concurrency ? max_concurrency : SOCIAL_MAX_CONCURRENCY;
+    state -> max_per_host = max_per_host ? max_per_host : SOCIAL_MAX_PER_HOST;
+    state -> refs = 1;
+
+    if (!state -> username || !state -> target_started) {
+        state_destroy(state);
+        return NULL;
+    }
+
+    stream_buffer_attach(&state -> out, connection);
+
+    pthread_mutex_lock(&state -> lock);
+    submit_probes(state);
+    pthread_mutex_unlock(&state -> lock);
+
+    return state;
+}
+
+/**
+ * 释放调用方持有的扫描状态（可直接作为 MHD 的释放回调）
+ *
+ * 不再提交新的探测，在飞的探测结束后由最后一个持有者释放。
+ *
+ * @param cls 指向 social_state 的指针
+ */
+void social_state_free(void *cls) {
+    struct social_state *state = (struct social_state *) cls;
+
+    if (!state) return;
+
+    pthread_mutex_lock(&state -> lock);
+
+    state -> cancelled = true;
+    stream_buffer_detach(&state -> out);
+
+    bool last = --state -> refs == 0;
+
+    pthread_mutex_unlock(&state -> lock);
+
+    if (last) state_destroy(state);
 }
 
 /**
  * HTTP响应数据分块发送回调函数
  * 
- * 该函数用于处理HTTP响应数据的分块发送。它会逐个检查社交媒体目标，
- * 并生成对应的用户名检查结果。每次调用会处理一个社交媒体平台的检查结果。
+ * 所有社交媒体目标在上游事件循环上并发探测，哪个先完成就先把哪个结果写回客户端，
+ * 因此整轮扫描耗时约等于最慢的一批探测，而不是所有探测耗时之和。
+ * 暂时没有结果可发时挂起连接，由探测完成回调恢复，不占用 MHD 线程。
  * 
  * @param cls 指向用户自定义数据的指针，这里是social_state结构体
  * @param pos 当前数据块的位置（未使用）
  * @param buf 用于存储要发送的数据的缓冲区
  * @param max 缓冲区的最大大小
  * 
- * @return 返回写入缓冲区的字节数，如果没有更多数据返回MHD_CONTENT_READER_END_OF_STREAM
- * 
- * @note 这个函数会被HTTP服务器框架重复调用，直到所有目标都被检查完毕
+ * @return 返回写入缓冲区的字节数（挂起时为 0），如果没有更多数据返回MHD_CONTENT_READER_END_OF_STREAM
  */
 ssize_t callback_send_chunk(void *cls, uint64_t pos, char *buf, size_t max) {
     struct social_state *state = (struct social_state *)cls;
 
-    if (state -> current_target >= targets_count) return MHD_CONTENT_READER_END_OF_STREAM;
-    
-    size_t n = 0;
+    (void) pos;
 
-    char url[512];
-    snprintf(url, sizeof(url), targets[state -> current_target].url_template, state -> username);
+    pthread_mutex_lock(&state -> lock);
 
-    int found = check_username(&targets[state -> current_target], state -> username);
+    ssize_t n = stream_buffer_read(&state -> out, scan_finished(state), buf, max);
 
-    if (found) {
-        n = snprintf(buf, max, "[+] %s: username exists at %s\n", targets[state -> current_target].name, url);
-    } else {
-        n = snprintf(buf, max, "[-] %s: username not found\n", targets[state -> current_target].name);
-    }
+    pthread_mutex_unlock(&state -> lock);
 
-    state -> current_target++;
-    
     return n;
 }
 
@@ -132,35 +400,26 @@ int check_username(const SocialTarget *target, const char *username) {
     struct memory chunk = {0};
     int found = 0;
 
-    curl = curl_easy_init();
+    curl = curl_pool_acquire();
 
     if(curl) {
         char full_url[512];
-        snprintf(full_url, sizeof(full_url), target->url_template, username);
-
-        curl_easy_setopt(curl, CURLOPT_URL, full_url);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 3L);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/58.0.3029.110 Safari/537.36");
-
-        res = curl_easy_perform(curl);
-        if(res != CURLE_OK) {
-            fprintf(stderr, "[%s] curl error: %s\n", target -> name, curl_easy_strerror(res));
-        } else {
-            long status;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
-
-            if(status == 200 && strstr(chunk.data, username) != NULL) {
-                printf("[+] %s: username exists at %s\n", target -> name, full_url);
-                found = 1;
-            } else {
-                printf("[-] %s: username not found\n", target -> name);
-            }
-        }
+        probe_url(full_url, sizeof(full_url), target, username);
+
+        setup_probe(curl, full_url, &chunk);
+
+        struct upstream_call call = {
+            .source = METRICS_SRC_SOCIAL, .url = full_url,
+            .write = memory_write_callback, .write_data = &chunk,
+        };
+
+        res = upstream_perform(curl, &call);
+
+        // 结果通过返回值给出，失败计入 mo_upstream_errors_total；逐条打印在并发探测时会成为瓶颈
+        if (res == CURLE_OK) found = call.status == 200 && chunk.data && strstr(chunk.data, username) != NULL;
 
-        curl_easy_cleanup(curl);
-        free(chunk.data);
+        curl_pool_release(curl);
+        memory_release(&chunk);
     }
 
     return found;
@@ -1,44 +1,22 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <ctype.h>
 #include <curl/curl.h>
-#include <regex.h>
+#include <strings.h>
+#include <stddef.h>
+#include <time.h>
 
 #include "../include/sprm.h"
 #include "../include/memory.h"
-
-/**
- * CURL写回调函数，用于接收HTTP响应数据并存储到用户定义的结构体中
- * 
- * @param ptr 指向接收到的数据的指针
- * @param size 每个数据元素的大小（字节数）
- * @param nmemb 数据元素的数量
- * @param userdata 指向用户数据的指针，这里应该是semak_mule_response结构体
- * 
- * @return 返回实际处理的数据大小（字节数），如果处理失败返回0
- */
-static size_t write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
-    size_t total = size * nmemb;
-    struct memory *resp = (struct memory *)userdata;
-
-    // 重新分配内存以容纳新接收的数据
-    char *new_data = realloc(resp -> data, resp -> size + total + 1);
-
-    if (!new_data) {
-        fprintf(stderr, "realloc failed\n");
-        return 0;
-    }
-
-    resp -> data = new_data;
-
-    // 将新数据复制到已分配的内存空间中
-    memcpy(&(resp -> data[resp -> size]), ptr, total);
-    
-    resp -> size += total;
-    resp -> data[resp -> size] = '\0';
-    
-    return total;
-}
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
+#include "../include/snapshot.h"
+#include "../include/html_scan.h"
 
 /**
  * 通过HTTP请求获取指定URL的HTML内容
@@ -50,36 +28,168 @@ char *sprm_fetch_html(const char *url) {
 
     CURL *curl;
     CURLcode res;
-    struct memory chunk;
-
-    chunk.data = malloc(1);
-    chunk.size = 0;
+    struct memory chunk = {0};
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+    curl = curl_pool_acquire();
     
     if (!curl) return NULL;
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
+    struct upstream_call call = {
+        .source = METRICS_SRC_SPRM, .url = url,
+        .write = memory_write_callback, .write_data = &chunk,
+    };
+
+    memory_attach_curl(curl, &chunk);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 
-    res = curl_easy_perform(curl);
+    res = upstream_perform(curl, &call);
 
-    curl_easy_cleanup(curl);
-    curl_global_cleanup();
+    curl_pool_release(curl);
 
     if (res != CURLE_OK) {
-        free(chunk.data);
+        memory_release(&chunk);
         return NULL;
     }
 
-    return chunk.data;
+    return memory_detach(&chunk);
+}
+
+/**
+ * 每条记录的起始标记，以及块内纯文本的最大长度
+ */
+#define PESALAH_MARKER "<div class=\"col-md-3 div-pesalah\""
+#define PESALAH_TEXT_MAX 8192
+
+/**
+ * 记录块内的字段标签（去掉非字母数字并转小写后比较）→ 字段
+ */
+static const struct {
+    const char *label;
+    size_t offset;
+    size_t size;
+} pesalah_labels[] = {
+    { "nama",            offsetof(Pesalah, name),     sizeof(((Pesalah *) 0) -> name) },
+    { "nokp",            offsetof(Pesalah, ic),       sizeof(((Pesalah *) 0) -> ic) },
+    { "nokadpengenalan", offsetof(Pesalah, ic),       sizeof(((Pesalah *) 0) -> ic) },
+    { "kadpengenalan",   offsetof(Pesalah, ic),       sizeof(((Pesalah *) 0) -> ic) },
+    { "mykad",           offsetof(Pesalah, ic),       sizeof(((Pesalah *) 0) -> ic) },
+    { "negeri",          offsetof(Pesalah, state),    sizeof(((Pesalah *) 0) -> state) },
+    { "majikan",         offsetof(Pesalah, employer), sizeof(((Pesalah *) 0) -> employer) },
+    { "agensi",          offsetof(Pesalah, employer), sizeof(((Pesalah *) 0) -> employer) },
+    { "jabatan",         offsetof(Pesalah, employer), sizeof(((Pesalah *) 0) -> employer) },
+    { "jawatan",         offsetof(Pesalah, position), sizeof(((Pesalah *) 0) -> position) },
+    { "nokes",           offsetof(Pesalah, case_no),  sizeof(((Pesalah *) 0) -> case_no) },
+    { "nomborkes",       offsetof(Pesalah, case_no),  sizeof(((Pesalah *) 0) -> case_no) },
+    { "pertuduhan",      offsetof(Pesalah, charge),   sizeof(((Pesalah *) 0) -> charge) },
+    { "kesalahan",       offsetof(Pesalah, charge),   sizeof(((Pesalah *) 0) -> charge) },
+    { "seksyen",         offsetof(Pesalah, law),      sizeof(((Pesalah *) 0) -> law) },
+    { "akta",            offsetof(Pesalah, law),      sizeof(((Pesalah *) 0) -> law) },
+    { "peruntukan",      offsetof(Pesalah, law),      sizeof(((Pesalah *) 0) -> law) },
+    { "hukuman",         offsetof(Pesalah, sentence), sizeof(((Pesalah *) 0) -> sentence) },
+};
+
+/**
+ * 块结束位置：起始标记之后第一个 "</div>" 紧跟（可有空白）另一个 "</div>" 的地方
+ */
+static const char *pesalah_block_end(const char *p, const char *end) {
+    static const char close[] = "</div>";
+    const size_t clen = sizeof(close) - 1;
+
+    while ((p = html_scan_find(p, (size_t) (end - p), close, clen)) != NULL) {
+        const char *q = p + clen;
+
+        while (q < end && isspace((unsigned char) *q)) q++;
+
+        if ((size_t) (end - q) >= clen && memcmp(q, close, clen) == 0) return q + clen;
+
+        p += clen;
+    }
+
+    return NULL;
+}
+
+/**
+ * 在块内字段表中查找标签
+ *
+ * @return pesalah_labels 下标，不是已知标签返回 -1
+ */
+static int find_label(const char *label, size_t len) {
+    char key[32];
+    size_t n = 0;
+
+    for (size_t i = 0; i < len && n + 1 < sizeof(key); i++) {
+        if (isalnum((unsigned char) label[i])) key[n++] = (char) tolower((unsigned char) label[i]);
+    }
+
+    key[n] = '\0';
+
+    for (size_t i = 0; i < sizeof(pesalah_labels) / sizeof(pesalah_labels[0]); i++) {
+        if (strcmp(key, pesalah_labels[i].label) == 0) return (int) i;
+    }
+
+    return -1;
+}
+
+static void set_field(Pesalah *p, int label, const char *value, size_t len) {
+    char *dst = (char *) p + pesalah_labels[label].offset;
+    size_t size = pesalah_labels[label].size;
+
+    // 同一字段出现多次时保留第一次
+    if (dst[0] || len == 0) return;
+    if (len > size - 1) len = size - 1;
+
+    memcpy(dst, value, len);
+    dst[len] = '\0';
+}
+
+/**
+ * 从块的纯文本中按 "标签: 值" 或 "标签<TAB>值" 提取字段；值为空时取下一行
+ */
+static void parse_pesalah_text(Pesalah *p, const char *text) {
+    int pending = -1;
+
+    for (const char *line = text; *line;) {
+        const char *eol = strchr(line, '\n');
+        size_t len = eol ? (size_t) (eol - line) : strlen(line);
+        const char *sep = NULL;
+
+        for (size_t i = 0; i < len; i++) {
+            if (line[i] == ':' || line[i] == '\t') {
+                sep = line + i;
+                break;
+            }
+        }
+
+        if (pending >= 0 && len > 0) {
+            set_field(p, pending, line, len);
+            pending = -1;
+        } else if (sep) {
+            int label = find_label(line, (size_t) (sep - line));
+            const char *value = sep + 1;
+            size_t vlen = len - (size_t) (value - line);
+
+            while (vlen > 0 && (*value == ' ' || *value == '\t' || *value == ':')) { value++; vlen--; }
+
+            if (label >= 0) {
+                if (vlen > 0) set_field(p, label, value, vlen);
+                else pending = label;
+            }
+        } else if (!p -> law[0] && (strncasecmp(line, "Seksyen ", 8) == 0 || strncasecmp(line, "Akta ", 5) == 0)) {
+            // 没有标签的 "Seksyen 165 Kanun Keseksaan" 整行就是法律条文
+            set_field(p, find_label("seksyen", 7), line, len);
+        }
+
+        if (!eol) break;
+
+        line = eol + 1;
+    }
 }
 
 /**
  * 从HTML字符串中解析违规者信息列表
+ *
+ * 用 html_scan 逐块定位记录，块内转为纯文本后按标签提取各字段，不再使用正则。
+ *
  * @param html 包含违规者信息的HTML字符串
  * @return 返回解析得到的违规者列表结构体
  */
@@ -88,38 +198,57 @@ PesalahList sprm_parse_html(const char *html) {
 
     if (!html) return plist;
 
-    const char *pattern = "<div class=\"col-md-3 div-pesalah\".*?</div>\\s*</div>";
-    
-    regex_t regex;
-    regcomp(&regex, pattern, REG_ICASE | REG_NEWLINE | REG_EXTENDED);
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
 
-    regmatch_t match[1];
+    size_t html_len = strlen(html);
+    const char *end = html + html_len;
+    const size_t mlen = sizeof(PESALAH_MARKER) - 1;
     const char *cursor = html;
+    size_t cap = 0;
+    char *text = malloc(PESALAH_TEXT_MAX);
+
+    if (!text) return plist;
 
-    while (regexec(&regex, cursor, 1, match, 0) == 0) {
-        size_t len = match[0].rm_eo - match[0].rm_so;
-        char *block = strndup(cursor + match[0].rm_so, len);
+    while ((cursor = html_scan_find(cursor, (size_t) (end - cursor), PESALAH_MARKER, mlen)) != NULL) {
+        const char *block_end = pesalah_block_end(cursor + mlen, end);
+
+        if (!block_end) break;
+
+        if (plist.count == cap) {
+            size_t ncap = cap ? cap * 2 : 64;
+            Pesalah *list = realloc(plist.list, ncap * sizeof(Pesalah));
+
+            if (!list) break;
+
+            plist.list = list;
+            cap = ncap;
+        }
 
-        plist.list = realloc(plist.list, sizeof(Pesalah) * (plist.count + 1));
         Pesalah *p = &plist.list[plist.count];
     
         memset(p, 0, sizeof(Pesalah));
 
-        char *img = strstr(block, "<img src=\"");
+        const char *img = html_scan_find(cursor, (size_t) (block_end - cursor), "<img", 4);
+        size_t src_len = 0;
+        const char *src = img ? html_scan_attr(img, block_end, "src", &src_len) : NULL;
 
-        if (img) sscanf(img, "<img src=\"%511[^\"]", p->image_url);
+        if (src) html_decode_entities(src, src_len, p -> image_url, sizeof(p -> image_url));
 
-        if (strstr(block, "Seksyen 165")) {
-            strncpy(p->law, "Seksyen 165 Kanun Keseksaan", sizeof(p->law) - 1);
-        }
+        html_to_text(cursor, (size_t) (block_end - cursor), text, PESALAH_TEXT_MAX);
+        parse_pesalah_text(p, text);
 
-        free(block);
+        if (!p -> law[0] && strstr(text, "Seksyen 165")) {
+            strncpy(p -> law, "Seksyen 165 Kanun Keseksaan", sizeof(p -> law) - 1);
+        }
 
         plist.count++;
-        cursor += match[0].rm_eo;
+        cursor = block_end;
     }
 
-    regfree(&regex);
+    free(text);
+    html_scan_record(html_len, &started);
+
     return plist;
 }
 
@@ -176,44 +305,92 @@ PesalahList sprm_search(const PesalahList *plist, const char *keyword) {
     return results;
 }
 
+/**
+ * 追加一个带引号、已转义的 JSON 字符串
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+static int append_json_string(struct memory *out, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    size_t len = strlen(s);
+
+    // 最坏情况每个字节转义成 \u00XX
+    if (memory_reserve(out, out -> size + len * 6 + 3) != 0) return -1;
+
+    char *p = out -> data + out -> size;
+
+    *p++ = '"';
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char) c;
+        } else if (c < 0x20) {
+            *p++ = '\\';
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 15];
+        } else {
+            *p++ = (char) c;
+        }
+    }
+
+    *p++ = '"';
+    *p = '\0';
+
+    out -> size = (size_t) (p - out -> data);
+
+    return 0;
+}
+
 /**
  * 将PesalahList结构体转换为JSON格式字符串
+ *
+ * 输出写进可增长的缓冲区，字段值都经过 JSON 转义，名单再长、字段里有引号也不会截断或写坏。
+ *
  * @param plist 指向PesalahList结构体的指针，包含要转换的数据列表
- * @return 返回动态分配的JSON格式字符串，调用者需要负责释放内存
+ * @return 返回动态分配的JSON格式字符串，调用者需要负责释放内存；内存不足时返回 NULL
  */
 static char *sprm_list_to_json(const PesalahList *plist) {
-    size_t offset = 0;
-    size_t bufsize = 1024;
+    struct memory out = {0};
+    int rc = memory_append(&out, "[", 1);
+
+    for (size_t i = 0; rc == 0 && i < plist -> count; i++) {
+        const Pesalah *p = &plist -> list[i];
+        const char *fields[][2] = {
+            { "name", p -> name }, { "ic", p -> ic }, { "state", p -> state },
+            { "employer", p -> employer }, { "position", p -> position }, { "case_no", p -> case_no },
+            { "charge", p -> charge }, { "law", p -> law }, { "sentence", p -> sentence },
+            { "image_url", p -> image_url },
+        };
+
+        rc = memory_append(&out, i > 0 ? ",{" : "{", i > 0 ? 2 : 1);
+
+        for (size_t f = 0; rc == 0 && f < sizeof(fields) / sizeof(fields[0]); f++) {
+            if (f > 0) rc = memory_append(&out, ",", 1);
+
+            // 键名都是固定的标识符，不需要转义
+            if (rc == 0) rc = memory_append(&out, "\"", 1);
+            if (rc == 0) rc = memory_append(&out, fields[f][0], strlen(fields[f][0]));
+            if (rc == 0) rc = memory_append(&out, "\":", 2);
+            if (rc == 0) rc = append_json_string(&out, fields[f][1]);
+        }
 
-    char entry[2048];
-    char *json = malloc(bufsize);
-    
-    offset += snprintf(json + offset, bufsize - offset, "[");
+        if (rc == 0) rc = memory_append(&out, "}", 1);
+    }
 
-    for (size_t i = 0; i < plist -> count; i++) {
-        Pesalah *p = &plist -> list[i];
-    
-        snprintf(entry, sizeof(entry),
-            "{\"name\":\"%s\",\"ic\":\"%s\",\"state\":\"%s\",\"employer\":\"%s\","
-            "\"position\":\"%s\",\"case_no\":\"%s\",\"charge\":\"%s\",\"law\":\"%s\","
-            "\"sentence\":\"%s\",\"image_url\":\"%s\"}",
-            p -> name, p -> ic, p -> state, p -> employer,
-            p -> position, p -> case_no, p -> charge, p -> law,
-            p -> sentence, p -> image_url
-        );
-
-        size_t need = strlen(entry) + 2;
-
-        if (offset + need >= bufsize) {
-            bufsize *= 2;
-            json = realloc(json, bufsize);
-        }
+    if (rc == 0) rc = memory_append(&out, "]", 1);
 
-        offset += snprintf(json + offset, bufsize - offset, "%s%s", (i>0?",":""), entry);
+    if (rc != 0) {
+        memory_release(&out);
+        return NULL;
     }
 
-    snprintf(json + offset, bufsize - offset, "]");
-    return json;
+    return memory_detach(&out);
 }
 
 /**
@@ -226,7 +403,7 @@ static char *sprm_list_to_json(const PesalahList *plist) {
  *               调用者需要负责释放返回字符串的内存
  */
 char *sprm_run(void) {
-    char *html = sprm_fetch_html(SPRM_URL);
+    char *html = sprm_fetch_html(upstream_url("MO_SPRM_URL", SPRM_URL));
 
     if (!html) return strdup("{\"error\":\"Failed to fetch SPRM data\"}");
 
@@ -235,6 +412,408 @@ char *sprm_run(void) {
 
     char *json = sprm_list_to_json(&list);
     sprm_free_list(&list);
- 
+
+    if (!json) return strdup("{\"error\":\"Out of memory\"}");
+
     return json;
-}
\ No newline at end of file
+}
+
+/**
+ * SPRM 名单索引中每条记录的字段（列）编号
+ */
+enum sprm_field {
+    SPRM_F_NAME,
+    SPRM_F_IC,
+    SPRM_F_STATE,
+    SPRM_F_EMPLOYER,
+    SPRM_F_POSITION,
+    SPRM_F_CASE_NO,
+    SPRM_F_CHARGE,
+    SPRM_F_LAW,
+    SPRM_F_SENTENCE,
+    SPRM_F_IMAGE_URL,
+    SPRM_FIELD_COUNT
+};
+
+/**
+ * 一份 SPRM 名单快照（列式存储）
+ *
+ * 所有字符串集中放在一张字符串表里，每一列只是一个 uint32 偏移数组；
+ * ic_slots 是身份证号的开放寻址哈希表（值为行号+1，0 表示空槽）；
+ * 姓名按小写三元组 (trigram) 建倒排表，tri_keys 有序，tri_start/tri_rows 为 CSR 形式的倒排链。
+ */
+struct sprm_index {
+    size_t count;
+    char *strings;
+    uint32_t *column[SPRM_FIELD_COUNT];
+
+    uint32_t *ic_slots;
+    size_t ic_cap;
+
+    uint32_t *tri_keys;
+    uint32_t *tri_start;
+    uint32_t *tri_rows;
+    size_t tri_count;
+};
+
+static struct snapshot_source sprm_source;
+
+static const char *row_field(const struct sprm_index *index, size_t row, enum sprm_field f) {
+    return index -> strings + index -> column[f][row];
+}
+
+/**
+ * 把身份证号规范化为纯数字
+ *
+ * @return 写入的数字个数
+ */
+static size_t normalise_ic(const char *src, char *out, size_t out_len) {
+    size_t n = 0;
+
+    for (; src && *src && n + 1 < out_len; src++) {
+        if (isdigit((unsigned char) *src)) out[n++] = *src;
+    }
+
+    out[n] = '\0';
+
+    return n;
+}
+
+static uint32_t hash_str(const char *s) {
+    uint32_t h = 2166136261u;
+
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static uint32_t trigram_at(const char *s) {
+    return ((uint32_t) (unsigned char) tolower((unsigned char) s[0]) << 16) |
+           ((uint32_t) (unsigned char) tolower((unsigned char) s[1]) << 8) |
+            (uint32_t) (unsigned char) tolower((unsigned char) s[2]);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void sprm_index_free(void *data) {
+    struct sprm_index *index = (struct sprm_index *) data;
+
+    if (!index) return;
+
+    free(index -> strings);
+
+    for (int f = 0; f < SPRM_FIELD_COUNT; f++) free(index -> column[f]);
+
+    free(index -> ic_slots);
+    free(index -> tri_keys);
+    free(index -> tri_start);
+    free(index -> tri_rows);
+    free(index);
+}
+
+/**
+ * 把解析出的名单转换为列式存储并建立身份证哈希表和姓名三元组倒排表
+ */
+static struct sprm_index *sprm_index_build(const PesalahList *plist) {
+    struct sprm_index *index = calloc(1, sizeof(*index));
+
+    if (!index) return NULL;
+
+    index -> count = plist -> count;
+
+    // 字符串表：先算总长度，再一次性分配
+    size_t total = 1;
+
+    for (size_t i = 0; i < plist -> count; i++) {
+        const Pesalah *p = &plist -> list[i];
+        const char *fields[SPRM_FIELD_COUNT] = {
+            p -> name, p -> ic, p -> state, p -> employer, p -> position,
+            p -> case_no, p -> charge, p -> law, p -> sentence, p -> image_url
+        };
+
+        for (int f = 0; f < SPRM_FIELD_COUNT; f++) total += strlen(fields[f]) + 1;
+    }
+
+    index -> ic_cap = 16;
+    while (index -> ic_cap < plist -> count * 2) index -> ic_cap <<= 1;
+
+    index -> strings = malloc(total);
+    index -> ic_slots = calloc(index -> ic_cap, sizeof(uint32_t));
+
+    bool ok = index -> strings && index -> ic_slots;
+
+    for (int f = 0; f < SPRM_FIELD_COUNT; f++) {
+        index -> column[f] = malloc(sizeof(uint32_t) * (plist -> count ? plist -> count : 1));
+        ok = ok && index -> column[f];
+    }
+
+    size_t pair_cap = 64, pair_count = 0;
+    uint64_t *pairs = ok ? malloc(sizeof(uint64_t) * pair_cap) : NULL;
+
+    if (!pairs) {
+        sprm_index_free(index);
+        return NULL;
+    }
+
+    size_t off = 0;
+    index -> strings[off++] = '\0';
+
+    for (size_t i = 0; i < plist -> count; i++) {
+        const Pesalah *p = &plist -> list[i];
+        const char *fields[SPRM_FIELD_COUNT] = {
+            p -> name, p -> ic, p -> state, p -> employer, p -> position,
+            p -> case_no, p -> charge, p -> law, p -> sentence, p -> image_url
+        };
+
+        for (int f = 0; f < SPRM_FIELD_COUNT; f++) {
+            size_t len = strlen(fields[f]);
+
+            index -> column[f][i] = len ? (uint32_t) off : 0;
+
+            if (len) {
+                memcpy(index -> strings + off, fields[f], len + 1);
+                off += len + 1;
+            }
+        }
+
+        // 身份证号哈希（线性探测）
+        char ic[32];
+
+        if (normalise_ic(p -> ic, ic, sizeof(ic)) > 0) {
+            size_t mask = index -> ic_cap - 1;
+            size_t slot = hash_str(ic) & mask;
+
+            while (index -> ic_slots[slot]) slot = (slot + 1) & mask;
+
+            index -> ic_slots[slot] = (uint32_t) i + 1;
+        }
+
+        // 姓名三元组：(trigram << 32 | row)，排序去重后即为倒排表
+        size_t name_len = strlen(p -> name);
+
+        for (size_t j = 0; j + 3 <= name_len; j++) {
+            if (pair_count == pair_cap) {
+                uint64_t *grown = realloc(pairs, sizeof(uint64_t) * pair_cap * 2);
+
+                if (!grown) break;
+
+                pairs = grown;
+                pair_cap *= 2;
+            }
+
+            pairs[pair_count++] = ((uint64_t) trigram_at(p -> name + j) << 32) | (uint64_t) i;
+        }
+    }
+
+    qsort(pairs, pair_count, sizeof(uint64_t), compare_u64);
+
+    index -> tri_keys = malloc(sizeof(uint32_t) * (pair_count + 1));
+    index -> tri_start = malloc(sizeof(uint32_t) * (pair_count + 1));
+    index -> tri_rows = malloc(sizeof(uint32_t) * (pair_count + 1));
+
+    if (!index -> tri_keys || !index -> tri_start || !index -> tri_rows) {
+        free(pairs);
+        sprm_index_free(index);
+        return NULL;
+    }
+
+    size_t rows = 0;
+
+    for (size_t j = 0; j < pair_count; j++) {
+        if (j > 0 && pairs[j] == pairs[j - 1]) continue;
+
+        uint32_t key = (uint32_t) (pairs[j] >> 32);
+
+        if (index -> tri_count == 0 || index -> tri_keys[index -> tri_count - 1] != key) {
+            index -> tri_keys[index -> tri_count] = key;
+            index -> tri_start[index -> tri_count] = (uint32_t) rows;
+            index -> tri_count++;
+        }
+
+        index -> tri_rows[rows++] = (uint32_t) pairs[j];
+    }
+
+    index -> tri_start[index -> tri_count] = (uint32_t) rows;
+
+    free(pairs);
+
+    return index;
+}
+
+/**
+ * 快照加载函数：下载、解析 SPRM 名单并建立索引
+ *
+ * @param ctx 名单 URL
+ * @return 新的 sprm_index，下载失败返回 NULL
+ */
+static void *sprm_index_load(void *ctx) {
+    char *html = sprm_fetch_html((const char *) ctx);
+
+    if (!html) return NULL;
+
+    PesalahList list = sprm_parse_html(html);
+    free(html);
+
+    struct sprm_index *index = sprm_index_build(&list);
+    sprm_free_list(&list);
+
+    return index;
+}
+
+/**
+ * 启动 SPRM 名单的后台刷新索引
+ *
+ * @param ttl 快照有效期（秒），<=0 时使用 SPRM_TTL
+ * @param stale_while_revalidate 过期后是否继续返回旧快照并在后台刷新
+ * @return 0表示成功，-1表示失败
+ */
+int sprm_index_start(int ttl, bool stale_while_revalidate) {
+    sprm_source.name = "SPRM";
+    sprm_source.load = sprm_index_load;
+    sprm_source.free_fn = sprm_index_free;
+    sprm_source.ctx = (void *) upstream_url("MO_SPRM_URL", SPRM_URL);
+    sprm_source.ttl = ttl > 0 ? ttl : SPRM_TTL;
+    sprm_source.stale_while_revalidate = stale_while_revalidate;
+
+    return snapshot_start(&sprm_source);
+}
+
+/**
+ * 停止 SPRM 名单索引的后台刷新并释放快照
+ */
+void sprm_index_stop(void) {
+    snapshot_stop(&sprm_source);
+}
+
+/**
+ * 把索引中的一行还原为 Pesalah 结构追加到结果列表
+ */
+static void append_row(const struct sprm_index *index, size_t row, PesalahList *out) {
+    Pesalah *grown = realloc(out -> list, sizeof(Pesalah) * (out -> count + 1));
+
+    if (!grown) return;
+
+    out -> list = grown;
+
+    Pesalah *p = &out -> list[out -> count++];
+    memset(p, 0, sizeof(*p));
+
+    struct { char *dst; size_t len; enum sprm_field f; } cols[] = {
+        { p -> name, sizeof(p -> name), SPRM_F_NAME },
+        { p -> ic, sizeof(p -> ic), SPRM_F_IC },
+        { p -> state, sizeof(p -> state), SPRM_F_STATE },
+        { p -> employer, sizeof(p -> employer), SPRM_F_EMPLOYER },
+        { p -> position, sizeof(p -> position), SPRM_F_POSITION },
+        { p -> case_no, sizeof(p -> case_no), SPRM_F_CASE_NO },
+        { p -> charge, sizeof(p -> charge), SPRM_F_CHARGE },
+        { p -> law, sizeof(p -> law), SPRM_F_LAW },
+        { p -> sentence, sizeof(p -> sentence), SPRM_F_SENTENCE },
+        { p -> image_url, sizeof(p -> image_url), SPRM_F_IMAGE_URL },
+    };
+
+    for (size_t i = 0; i < sizeof(cols) / sizeof(cols[0]); i++) {
+        strncpy(cols[i].dst, row_field(index, row, cols[i].f), cols[i].len - 1);
+    }
+}
+
+static const uint32_t *trigram_postings(const struct sprm_index *index, uint32_t key, size_t *len) {
+    size_t lo = 0, hi = index -> tri_count;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+
+        if (index -> tri_keys[mid] < key) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo == index -> tri_count || index -> tri_keys[lo] != key) {
+        *len = 0;
+        return NULL;
+    }
+
+    *len = index -> tri_start[lo + 1] - index -> tri_start[lo];
+
+    return index -> tri_rows + index -> tri_start[lo];
+}
+
+/**
+ * 在内存索引中搜索 SPRM 名单（不产生任何网络请求）
+ *
+ * 关键词是完整身份证号时走哈希表精确匹配；否则按姓名子串匹配：
+ * 取关键词所有三元组中倒排链最短的一条作为候选集，再逐个用 strcasestr 校验。
+ * 少于 3 个字符的关键词退回到线性扫描姓名列。
+ *
+ * @param keyword 身份证号或姓名片段
+ * @param out 匹配到的记录（需调用 sprm_free_list 释放）
+ * @return 匹配条数，索引尚不可用时返回 -1
+ */
+int sprm_index_search(const char *keyword, PesalahList *out) {
+    out -> list = NULL;
+    out -> count = 0;
+
+    if (!keyword || !*keyword) return 0;
+
+    struct snapshot_ref *ref = snapshot_acquire(&sprm_source);
+    const struct sprm_index *index = snapshot_data(ref);
+
+    if (!index) {
+        snapshot_release(&sprm_source, ref);
+        return -1;
+    }
+
+    char ic[32];
+    size_t klen = strlen(keyword);
+
+    if (normalise_ic(keyword, ic, sizeof(ic)) == 12) {
+        size_t mask = index -> ic_cap - 1;
+        size_t slot = hash_str(ic) & mask;
+
+        while (index -> ic_slots[slot]) {
+            size_t row = index -> ic_slots[slot] - 1;
+            char row_ic[32];
+
+            normalise_ic(row_field(index, row, SPRM_F_IC), row_ic, sizeof(row_ic));
+
+            if (strcmp(row_ic, ic) == 0) append_row(index, row, out);
+
+            slot = (slot + 1) & mask;
+        }
+    } else if (klen >= 3) {
+        const uint32_t *best = NULL;
+        size_t best_len = 0;
+
+        for (size_t j = 0; j + 3 <= klen; j++) {
+            size_t len;
+            const uint32_t *postings = trigram_postings(index, trigram_at(keyword + j), &len);
+
+            if (!postings) {
+                best = NULL;
+                best_len = 0;
+                break;
+            }
+
+            if (!best || len < best_len) {
+                best = postings;
+                best_len = len;
+            }
+        }
+
+        for (size_t j = 0; j < best_len; j++) {
+            if (strcasestr(row_field(index, best[j], SPRM_F_NAME), keyword)) append_row(index, best[j], out);
+        }
+    } else {
+        for (size_t row = 0; row < index -> count; row++) {
+            if (strcasestr(row_field(index, row, SPRM_F_NAME), keyword)) append_row(index, row, out);
+        }
+    }
+
+    snapshot_release(&sprm_source, ref);
+
+    return (int) out -> count;
+}
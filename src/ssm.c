@@ -3,6 +3,55 @@
 #include <ctype.h>
 
 #include "../include/ssm.h"
+#include "../include/arena.h"
+
+/**
+ * 实体类型代码（注册号第 5、6 位）→ 描述，表中没有的代码为 NULL
+ */
+static const char *const entity_names[100] = {
+    [1] = "Local Company",
+    [2] = "Foreign Company",
+    [3] = "Business Entity",
+    [4] = "Local Limited Liability Partnership (LLP)",
+    [5] = "Foreign Limited Liability Partnership (LLP)",
+    [6] = "Local Liability Partnership for Professional Practice",
+};
+
+/**
+ * 从任意写法的 SSM 号码中取出前 12 位数字并拆出年份和实体类型（不分配内存）
+ *
+ * @param ssm_number 输入的号码，可以包含非数字字符，不要求以 '\0' 结尾
+ * @param len 输入长度
+ * @param out 输出
+ * @return true 表示至少有 12 位数字
+ */
+bool ssm_decode(const char *ssm_number, size_t len, struct ssm_info *out) {
+    int j = 0;
+
+    for (size_t i = 0; i < len && j < 12; i++) {
+        if (isdigit((unsigned char) ssm_number[i])) out -> digits[j++] = ssm_number[i];
+    }
+
+    out -> digits[j] = '\0';
+
+    if (j != 12) return false;
+
+    const char *d = out -> digits;
+
+    out -> year = (uint16_t) ((d[0] - '0') * 1000 + (d[1] - '0') * 100 + (d[2] - '0') * 10 + (d[3] - '0'));
+    out -> entity = (uint8_t) ((d[4] - '0') * 10 + (d[5] - '0'));
+
+    return true;
+}
+
+/**
+ * 实体类型代码对应的描述
+ *
+ * @return 描述字符串（静态，无需释放），未知代码返回 NULL
+ */
+const char *ssm_entity_name(uint8_t entity) {
+    return entity < 100 ? entity_names[entity] : NULL;
+}
 
 /**
  * 获取SSM格式化字符串
@@ -10,61 +59,36 @@
  * 该函数接收一个SSM号码字符串，提取其中的数字字符并格式化为12位数字字符串
  * 
  * @param ssm_number 输入的SSM号码字符串，可以包含非数字字符
- * @return 成功时返回12位数字组成的字符串（需要调用者释放内存），失败时返回NULL
+ * @param arena 结果所在的内存池；为 NULL 时结果由调用者 free
+ * @return 成功时返回12位数字组成的字符串，失败时返回NULL
  */
-char* get_ssm_format(const char *ssm_number) {
+char* get_ssm_format(const char *ssm_number, struct arena *arena) {
     if (ssm_number == NULL) return NULL;
 
-    char *normalized = malloc(13);
-    int j = 0;
-
-    for (int i = 0; ssm_number[i] != '\0'; i++) {
-        if (isdigit((unsigned char) ssm_number[i])) {
-            if (j < 12) normalized[j++] = ssm_number[i];
-        }
-    }
+    struct ssm_info info;
 
-    normalized[j] = '\0';
+    if (!ssm_decode(ssm_number, strlen(ssm_number), &info)) return NULL;
 
-    if (j != 12) {
-        free(normalized);
-        return NULL;
-    }
-
-    return normalized;
+    return arena_strdup(arena, info.digits);
 }
 
 /**
  * 根据SSM编号获取实体代码对应的描述
  * @param ssm_number SSM编号字符串，应为12位长度
- * @return 返回实体代码对应的描述字符串，需要调用者释放内存；
+ * @param arena 结果所在的内存池；为 NULL 时结果由调用者 free
+ * @return 返回实体代码对应的描述字符串；
  *         如果SSM编号无效或未找到匹配的实体代码，返回相应的错误描述
  */
-char* ssm_get_entity_code(const char *ssm_number) {
+char* ssm_get_entity_code(const char *ssm_number, struct arena *arena) {
     if (ssm_number == NULL || strlen(ssm_number) != 12) {
-        return strdup("Invalid SSM number");
+        return arena_strdup(arena, "Invalid SSM number");
     }
 
-    char entity_code[3];
-    
-    entity_code[0] = ssm_number[4];
-    entity_code[1] = ssm_number[5];
-    entity_code[2] = '\0';
-
-    struct { const char *code; const char *desc; } mapping[] = {
-        {"01", "Local Company"},
-        {"02", "Foreign Company"},
-        {"03", "Business Entity"},
-        {"04", "Local Limited Liability Partnership (LLP)"},
-        {"05", "Foreign Limited Liability Partnership (LLP)"},
-        {"06", "Local Liability Partnership for Professional Practice"}
-    };
-
-    for (int i = 0; i < sizeof(mapping) / sizeof(mapping[0]); i++) {
-        if (strcmp(entity_code, mapping[i].code) == 0) {
-            return strdup(mapping[i].desc); 
-        }
+    const char *name = NULL;
+
+    if (isdigit((unsigned char) ssm_number[4]) && isdigit((unsigned char) ssm_number[5])) {
+        name = ssm_entity_name((uint8_t) ((ssm_number[4] - '0') * 10 + (ssm_number[5] - '0')));
     }
 
-    return strdup("Unknown Entity");
+    return arena_strdup(arena, name ? name : "Unknown Entity");
 }
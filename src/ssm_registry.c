@@ -0,0 +1,1027 @@
+/**
+ * @file ssm_registry.c
+ * @brief 本地 SSM 注册库
+ *
+ * SSM 的注册资料导出（CSV）先用 `mo ssm-import` 转换成一个紧凑的二进制文件，
+ * 查询所需的索引在转换时就建好写进文件，服务启动时只需要 mmap 并校验文件头，几乎不花时间。
+ *
+ * 文件由以下几节组成，整数按本机字节序，每节按 8 字节对齐：
+ * - 文件头 struct reg_header
+ * - 记录 struct reg_record[count]，按规范化后的公司名排序，字符串字段都是字符串区里的偏移
+ * - 注册号哈希表 uint32[hash_slots]：开放寻址，值为记录下标 + 1，0 表示空槽；新旧注册号都入表
+ * - 三元组索引 uint32[TRI_COUNT + 1]：每个三元组在倒排表中的起点
+ * - 倒排表 uint32[postings_count]：包含该三元组的记录下标，递增
+ * - 字符串区：'\0' 结尾的字符串，偏移 0 固定是空串
+ *
+ * 公司名规范化为只含大写字母、数字和单个空格，三元组取自规范化后的名称，字母表只有 37 个字符，
+ * 所以三元组可以直接编号，不需要再查表。名称查询先按前缀二分查找，结果不够再用三元组求交后逐个核对子串。
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/ssm_registry.h"
+#include "../include/memory.h"
+
+#define REG_MAGIC "MOSSMR1\n"
+#define REG_VERSION 1
+#define REG_ENDIAN 0x01020304u
+
+// 三元组字母表：空格、0-9、A-Z
+#define TRI_ALPHABET 37
+#define TRI_COUNT (TRI_ALPHABET * TRI_ALPHABET * TRI_ALPHABET)
+
+// 规范化后的注册号最长字节数
+#define REG_NUMBER_MAX 32
+
+// CSV 每行最多解析的列数
+#define CSV_MAX_FIELDS 64
+
+struct reg_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t count;
+    uint32_t hash_slots;
+    uint64_t records_off;
+    uint64_t hash_off;
+    uint64_t tri_off;
+    uint64_t postings_off;
+    uint64_t postings_count;
+    uint64_t strings_off;
+    uint64_t strings_len;
+    uint64_t file_size;
+};
+
+struct reg_record {
+    uint32_t number;
+    uint32_t old_number;
+    uint32_t name;
+    uint32_t norm;
+    uint32_t norm_len;
+    uint32_t status;
+    uint32_t type;
+};
+
+// 已加载的注册库，启动时映射，之后只读，查询无需加锁
+static const char *reg_map = NULL;
+static size_t reg_size = 0;
+static const struct reg_header *reg_hdr = NULL;
+static const struct reg_record *reg_records = NULL;
+static const uint32_t *reg_hash = NULL;
+static const uint32_t *reg_tri = NULL;
+static const uint32_t *reg_postings = NULL;
+static const char *reg_strings = NULL;
+
+static unsigned long lookups = 0;
+static unsigned long searches = 0;
+
+static uint64_t hash_bytes(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/**
+ * 三元组字母表中的编号；规范化后的名称只会出现这 37 个字符
+ */
+static unsigned int tri_code(unsigned char c) {
+    if (c >= '0' && c <= '9') return 1 + (unsigned int) (c - '0');
+    if (c >= 'A' && c <= 'Z') return 11 + (unsigned int) (c - 'A');
+
+    return 0;
+}
+
+static unsigned int tri_id(const char *s) {
+    return (tri_code((unsigned char) s[0]) * TRI_ALPHABET + tri_code((unsigned char) s[1])) * TRI_ALPHABET + tri_code((unsigned char) s[2]);
+}
+
+/**
+ * 规范化公司名：字母转大写，数字保留，其余字符连续出现时合并成一个空格，去掉首尾空格
+ *
+ * @param out 输出缓冲，写入后以 '\0' 结尾，需至少 cap + 1 字节
+ * @return 规范化后的长度（超过 cap 的部分丢弃）
+ */
+static size_t normalize_name(const char *s, size_t len, char *out, size_t cap) {
+    size_t n = 0;
+    bool gap = false;
+
+    for (size_t i = 0; i < len && n < cap; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c >= 'a' && c <= 'z') c = (unsigned char) (c - 'a' + 'A');
+
+        if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            if (gap && n > 0 && n < cap - 1) out[n++] = ' ';
+
+            out[n++] = (char) c;
+            gap = false;
+        } else {
+            gap = true;
+        }
+    }
+
+    out[n] = '\0';
+
+    return n;
+}
+
+/**
+ * 规范化注册号：只保留字母和数字并转大写，"1234567-A" 和 "1234567a" 视为同一个号码
+ *
+ * @return 规范化后的长度，超过 cap 时返回 0
+ */
+static size_t normalize_number(const char *s, size_t len, char *out, size_t cap) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c >= 'a' && c <= 'z') c = (unsigned char) (c - 'a' + 'A');
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) continue;
+        if (n == cap) return 0;
+
+        out[n++] = (char) c;
+    }
+
+    out[n < cap ? n : cap - 1] = '\0';
+
+    return n < cap ? n : 0;
+}
+
+static const char *str_at(uint32_t off) {
+    return off < reg_hdr -> strings_len ? reg_strings + off : "";
+}
+
+static void fill_company(uint32_t rec, struct ssm_company *out) {
+    const struct reg_record *r = &reg_records[rec];
+
+    out -> number = str_at(r -> number);
+    out -> old_number = str_at(r -> old_number);
+    out -> name = str_at(r -> name);
+    out -> status = str_at(r -> status);
+    out -> type = str_at(r -> type);
+}
+
+/**
+ * 记录的规范化名称；长度越界（文件损坏）时当作空串
+ */
+static const char *norm_at(uint32_t rec, size_t *len) {
+    const struct reg_record *r = &reg_records[rec];
+
+    if ((uint64_t) r -> norm + r -> norm_len >= reg_hdr -> strings_len) {
+        *len = 0;
+        return "";
+    }
+
+    *len = r -> norm_len;
+
+    return reg_strings + r -> norm;
+}
+
+/**
+ * ====================================================================
+ * 查询
+ * ====================================================================
+ */
+
+/**
+ * 按注册号查询，新旧格式的号码都可以
+ *
+ * @param number 注册号，分隔符和大小写不影响结果
+ * @param out 查到的公司
+ * @return 0表示找到，-1表示没有这个号码或注册库未加载
+ */
+int ssm_registry_lookup(const char *number, struct ssm_company *out) {
+    char key[REG_NUMBER_MAX + 1];
+
+    if (!reg_map || !number) return -1;
+
+    size_t len = normalize_number(number, strlen(number), key, sizeof(key));
+
+    if (len == 0) return -1;
+
+    __atomic_fetch_add(&lookups, 1, __ATOMIC_RELAXED);
+
+    uint32_t mask = reg_hdr -> hash_slots - 1;
+    uint32_t h = (uint32_t) hash_bytes(key, len) & mask;
+
+    for (uint32_t probe = 0; probe <= mask; probe++, h = (h + 1) & mask) {
+        uint32_t slot = reg_hash[h];
+
+        if (slot == 0) return -1;
+        if (slot > reg_hdr -> count) continue;
+
+        const struct reg_record *r = &reg_records[slot - 1];
+
+        if (strcmp(str_at(r -> number), key) == 0 || strcmp(str_at(r -> old_number), key) == 0) {
+            fill_company(slot - 1, out);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * 在递增的倒排表 [p, end) 中找第一个 >= v 的位置
+ */
+static const uint32_t *lower_bound(const uint32_t *p, const uint32_t *end, uint32_t v) {
+    size_t n = (size_t) (end - p);
+
+    while (n > 0) {
+        size_t half = n / 2;
+
+        if (p[half] < v) {
+            p += half + 1;
+            n -= half + 1;
+        } else {
+            n = half;
+        }
+    }
+
+    return p;
+}
+
+/**
+ * 按公司名查询：先返回以查询词开头的公司，不够 max 家再补上名称中包含查询词的公司，各自按名称排序
+ *
+ * @param name 查询词，大小写和标点不影响结果
+ * @param out 输出数组，至少 max 项
+ * @param max 最多返回的公司数
+ * @return 返回的公司数
+ */
+size_t ssm_registry_search(const char *name, struct ssm_company *out, size_t max) {
+    char q[SSM_REGISTRY_QUERY_MAX + 1];
+
+    if (!reg_map || !name || max == 0) return 0;
+
+    size_t qlen = normalize_name(name, strlen(name), q, SSM_REGISTRY_QUERY_MAX);
+
+    if (qlen == 0) return 0;
+
+    __atomic_fetch_add(&searches, 1, __ATOMIC_RELAXED);
+
+    uint32_t count = reg_hdr -> count;
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    size_t n = 0;
+    size_t len;
+
+    // 记录按规范化名称排序，前缀匹配的公司是连续的一段
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(norm_at(mid, &len), q) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (uint32_t i = lo; i < count && n < max; i++) {
+        const char *s = norm_at(i, &len);
+
+        if (len < qlen || memcmp(s, q, qlen) != 0) break;
+
+        fill_company(i, &out[n++]);
+    }
+
+    if (n == max || qlen < 3) return n;
+
+    // 子串匹配：查询词的每个三元组取一条倒排表，从最短的一条出发在其余各条里二分求交
+    const uint32_t *begin[SSM_REGISTRY_QUERY_MAX];
+    const uint32_t *end[SSM_REGISTRY_QUERY_MAX];
+    unsigned int ids[SSM_REGISTRY_QUERY_MAX];
+    size_t lists = 0;
+    size_t shortest = 0;
+
+    for (size_t i = 0; i + 3 <= qlen; i++) {
+        unsigned int id = tri_id(q + i);
+        bool seen = false;
+
+        for (size_t k = 0; k < lists && !seen; k++) seen = ids[k] == id;
+
+        if (seen) continue;
+
+        uint32_t from = reg_tri[id];
+        uint32_t to = reg_tri[id + 1];
+
+        if (from >= to || to > reg_hdr -> postings_count) return n;
+
+        ids[lists] = id;
+        begin[lists] = reg_postings + from;
+        end[lists] = reg_postings + to;
+
+        if (lists == 0 || to - from < (size_t) (end[shortest] - begin[shortest])) shortest = lists;
+
+        lists++;
+    }
+
+    for (const uint32_t *p = begin[shortest]; p < end[shortest] && n < max; p++) {
+        uint32_t rec = *p;
+        bool all = true;
+
+        for (size_t k = 0; k < lists && all; k++) {
+            if (k == shortest) continue;
+
+            begin[k] = lower_bound(begin[k], end[k], rec);
+
+            if (begin[k] == end[k]) return n;
+
+            all = *begin[k] == rec;
+        }
+
+        if (!all || rec >= count) continue;
+
+        const char *s = norm_at(rec, &len);
+
+        // 前缀匹配的公司上面已经全部返回过了
+        if (len >= qlen && memcmp(s, q, qlen) == 0) continue;
+        if (!memmem(s, len, q, qlen)) continue;
+
+        fill_company(rec, &out[n++]);
+    }
+
+    return n;
+}
+
+/**
+ * ====================================================================
+ * 加载
+ * ====================================================================
+ */
+
+static bool section_ok(uint64_t off, uint64_t count, uint64_t elem, uint64_t size) {
+    return off % 4 == 0 && off <= size && count <= (size - off) / elem;
+}
+
+/**
+ * 映射并校验注册库文件，替换已加载的注册库；只应在开始处理请求之前调用
+ *
+ * @param path ssm-import 生成的文件
+ * @return 0表示成功，-1表示文件无法读取或格式不对
+ */
+int ssm_registry_open(const char *path) {
+    ssm_registry_close();
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) return -1;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct reg_header)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (map == MAP_FAILED) return -1;
+
+    const struct reg_header *h = (const struct reg_header *) map;
+
+    bool ok = memcmp(h -> magic, REG_MAGIC, sizeof(h -> magic)) == 0
+        && h -> version == REG_VERSION
+        && h -> endian == REG_ENDIAN
+        && h -> file_size == size
+        && h -> hash_slots > 0 && (h -> hash_slots & (h -> hash_slots - 1)) == 0
+        && section_ok(h -> records_off, h -> count, sizeof(struct reg_record), size)
+        && section_ok(h -> hash_off, h -> hash_slots, sizeof(uint32_t), size)
+        && section_ok(h -> tri_off, TRI_COUNT + 1, sizeof(uint32_t), size)
+        && section_ok(h -> postings_off, h -> postings_count, sizeof(uint32_t), size)
+        && section_ok(h -> strings_off, h -> strings_len, 1, size)
+        && h -> strings_len > 0
+        && ((const char *) map)[h -> strings_off + h -> strings_len - 1] == '\0'
+        && ((const uint32_t *) ((const char *) map + h -> tri_off))[TRI_COUNT] == h -> postings_count;
+
+    if (!ok) {
+        munmap(map, size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // 查询是随机访问，关掉预读
+    madvise(map, size, MADV_RANDOM);
+
+    reg_map = map;
+    reg_size = size;
+    reg_hdr = h;
+    reg_records = (const struct reg_record *) (reg_map + h -> records_off);
+    reg_hash = (const uint32_t *) (reg_map + h -> hash_off);
+    reg_tri = (const uint32_t *) (reg_map + h -> tri_off);
+    reg_postings = (const uint32_t *) (reg_map + h -> postings_off);
+    reg_strings = reg_map + h -> strings_off;
+
+    return 0;
+}
+
+void ssm_registry_close(void) {
+    if (reg_map) munmap((void *) reg_map, reg_size);
+
+    reg_map = NULL;
+    reg_size = 0;
+    reg_hdr = NULL;
+}
+
+bool ssm_registry_loaded(void) {
+    return reg_map != NULL;
+}
+
+void ssm_registry_get_stats(struct ssm_registry_stats *out) {
+    out -> companies = reg_hdr ? reg_hdr -> count : 0;
+    out -> file_bytes = reg_size;
+    out -> lookups = __atomic_load_n(&lookups, __ATOMIC_RELAXED);
+    out -> searches = __atomic_load_n(&searches, __ATOMIC_RELAXED);
+}
+
+/**
+ * ====================================================================
+ * 导入
+ * ====================================================================
+ */
+
+enum reg_column {
+    COL_NUMBER,
+    COL_OLD_NUMBER,
+    COL_NAME,
+    COL_STATUS,
+    COL_TYPE,
+    COL_MAX
+};
+
+// 表头规范化（小写、非字母数字变成 '_'）后识别的列名
+static const struct {
+    const char *name;
+    enum reg_column col;
+} header_names[] = {
+    { "registration_no", COL_NUMBER },
+    { "registration_number", COL_NUMBER },
+    { "new_registration_no", COL_NUMBER },
+    { "reg_no", COL_NUMBER },
+    { "company_no", COL_NUMBER },
+    { "ssm", COL_NUMBER },
+    { "old_registration_no", COL_OLD_NUMBER },
+    { "old_registration_number", COL_OLD_NUMBER },
+    { "old_reg_no", COL_OLD_NUMBER },
+    { "name", COL_NAME },
+    { "company_name", COL_NAME },
+    { "entity_name", COL_NAME },
+    { "status", COL_STATUS },
+    { "company_status", COL_STATUS },
+    { "entity_status", COL_STATUS },
+    { "type", COL_TYPE },
+    { "company_type", COL_TYPE },
+    { "entity_type", COL_TYPE },
+};
+
+struct csv_field {
+    const char *p;
+    size_t len;
+    bool quoted;
+};
+
+/**
+ * 解析一行 CSV（支持引号、引号内的逗号和换行、"" 转义）
+ *
+ * @param n 输出的字段数，超过 max 的字段丢弃
+ * @return 下一行的起点
+ */
+static const char *csv_row(const char *p, const char *end, struct csv_field *fields, size_t max, size_t *n) {
+    *n = 0;
+
+    for (;;) {
+        struct csv_field f = { p, 0, false };
+
+        if (p < end && *p == '"') {
+            f.p = ++p;
+            f.quoted = true;
+
+            while (p < end && !(*p == '"' && (p + 1 == end || p[1] != '"'))) p += *p == '"' ? 2 : 1;
+
+            f.len = (size_t) ((p < end ? p : end) - f.p);
+
+            if (p < end) p++;
+
+            // 收尾引号之后到分隔符之间的内容忽略
+            while (p < end && *p != ',' && *p != '\n') p++;
+        } else {
+            while (p < end && *p != ',' && *p != '\n') p++;
+
+            f.len = (size_t) (p - f.p);
+
+            if (f.len > 0 && f.p[f.len - 1] == '\r') f.len--;
+        }
+
+        if (*n < max) fields[(*n)++] = f;
+
+        if (p >= end) return end;
+        if (*p++ == '\n') return p;
+    }
+}
+
+/**
+ * 把字段原样（去掉首尾空白、还原 "" 转义）追加到字符串区
+ *
+ * @return 字符串偏移，空字段返回 0（固定的空串）
+ */
+static uint32_t pool_add_field(struct memory *pool, const struct csv_field *f) {
+    const char *s = f -> p;
+    size_t len = f -> len;
+
+    while (len > 0 && (*s == ' ' || *s == '\t')) s++, len--;
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t' || s[len - 1] == '\r')) len--;
+
+    if (len == 0 || memory_reserve(pool, pool -> size + len + 1) != 0) return 0;
+
+    uint32_t off = (uint32_t) pool -> size;
+    char *out = pool -> data + off;
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        out[n++] = s[i];
+
+        if (f -> quoted && s[i] == '"' && i + 1 < len && s[i + 1] == '"') i++;
+    }
+
+    out[n] = '\0';
+    pool -> size += n + 1;
+
+    return off;
+}
+
+/**
+ * 追加字段并与已有的取值去重；状态、类型这类取值很少的列用它，字符串区里每个取值只存一份
+ */
+static uint32_t pool_add_interned(struct memory *pool, const struct csv_field *f, uint32_t *seen, size_t *nseen, size_t max) {
+    uint32_t off = pool_add_field(pool, f);
+
+    if (off == 0) return 0;
+
+    for (size_t i = 0; i < *nseen; i++) {
+        if (strcmp(pool -> data + seen[i], pool -> data + off) == 0) {
+            pool -> size = off;
+            return seen[i];
+        }
+    }
+
+    if (*nseen < max) seen[(*nseen)++] = off;
+
+    return off;
+}
+
+/**
+ * 追加规范化后的字段
+ *
+ * @param len 输出规范化后的长度
+ * @return 字符串偏移，规范化后为空时返回 0
+ */
+static uint32_t pool_add_normalized(struct memory *pool, const struct csv_field *f, bool number, size_t *len) {
+    *len = 0;
+
+    if (memory_reserve(pool, pool -> size + f -> len + 1) != 0) return 0;
+
+    uint32_t off = (uint32_t) pool -> size;
+    char *out = pool -> data + off;
+
+    *len = number ? normalize_number(f -> p, f -> len, out, REG_NUMBER_MAX + 1) : normalize_name(f -> p, f -> len, out, f -> len);
+
+    if (*len == 0) return 0;
+
+    pool -> size += *len + 1;
+
+    return off;
+}
+
+static void header_key(const struct csv_field *f, char *out, size_t cap) {
+    size_t n = 0;
+    const char *s = f -> p;
+    size_t len = f -> len;
+
+    // 跳过 UTF-8 BOM
+    if (len >= 3 && memcmp(s, "\xEF\xBB\xBF", 3) == 0) s += 3, len -= 3;
+
+    for (size_t i = 0; i < len && n + 1 < cap; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c >= 'A' && c <= 'Z') c = (unsigned char) (c - 'A' + 'a');
+
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) out[n++] = (char) c;
+        else if (n > 0 && out[n - 1] != '_') out[n++] = '_';
+    }
+
+    while (n > 0 && out[n - 1] == '_') n--;
+
+    out[n] = '\0';
+}
+
+static const char *sort_strings = NULL;
+
+static int compare_records(const void *a, const void *b) {
+    const struct reg_record *x = (const struct reg_record *) a;
+    const struct reg_record *y = (const struct reg_record *) b;
+    int c = strcmp(sort_strings + x -> norm, sort_strings + y -> norm);
+
+    return c ? c : strcmp(sort_strings + x -> number, sort_strings + y -> number);
+}
+
+/**
+ * 同一个注册号出现多次时以文件中最后一行为准：按行序过一遍哈希表，被后面的行取代的记录删掉
+ *
+ * @return 去重后的记录数
+ */
+static size_t dedupe_records(struct reg_record *recs, size_t n, const char *strings, uint32_t *hash, uint32_t mask) {
+    for (uint32_t i = 0; i < n; i++) {
+        const char *k = strings + recs[i].number;
+        uint32_t h = (uint32_t) hash_bytes(k, strlen(k)) & mask;
+
+        while (hash[h] && strcmp(strings + recs[hash[h] - 1].number, k) != 0) h = (h + 1) & mask;
+
+        if (hash[h]) recs[hash[h] - 1].number = 0;
+
+        hash[h] = i + 1;
+    }
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (recs[i].number) recs[kept++] = recs[i];
+    }
+
+    memset(hash, 0, ((size_t) mask + 1) * sizeof(*hash));
+
+    return kept;
+}
+
+static void hash_insert(uint32_t *hash, uint32_t mask, const struct reg_record *recs, const char *strings, uint32_t key, uint32_t rec) {
+    const char *k = strings + key;
+    uint32_t h = (uint32_t) hash_bytes(k, strlen(k)) & mask;
+
+    while (hash[h]) {
+        const struct reg_record *r = &recs[hash[h] - 1];
+
+        // 旧注册号与别的记录重复时保留先入表的记录
+        if (strcmp(strings + r -> number, k) == 0 || strcmp(strings + r -> old_number, k) == 0) return;
+
+        h = (h + 1) & mask;
+    }
+
+    hash[h] = rec + 1;
+}
+
+static int write_section(FILE *fp, const void *data, size_t len, uint64_t *off) {
+    static const char pad[8] = {0};
+
+    if (len && fwrite(data, 1, len, fp) != len) return -1;
+
+    *off += len;
+
+    size_t extra = (size_t) ((8 - *off % 8) % 8);
+
+    if (extra && fwrite(pad, 1, extra, fp) != extra) return -1;
+
+    *off += extra;
+
+    return 0;
+}
+
+static uint64_t align8(uint64_t v) {
+    return (v + 7) & ~(uint64_t) 7;
+}
+
+/**
+ * 把 SSM 注册资料 CSV 转换成注册库文件
+ *
+ * 第一行必须是表头，至少包含注册号列（registration_no 等）和公司名列（name / company_name 等），
+ * 可选旧注册号、状态、类型列。先写临时文件再改名，正在使用旧文件的进程不受影响。
+ *
+ * @param csv_path 输入 CSV
+ * @param out_path 输出的注册库文件
+ * @param count 输出导入的公司数，可为 NULL
+ * @return 0表示成功，-1表示失败（原因已打印到标准错误）
+ */
+int ssm_registry_import(const char *csv_path, const char *out_path, size_t *count) {
+    int fd = open(csv_path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "[ssm-import] 无法打开 %s: %s\n", csv_path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "[ssm-import] %s 为空\n", csv_path);
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "[ssm-import] 无法映射 %s: %s\n", csv_path, strerror(errno));
+        return -1;
+    }
+
+    madvise((void *) data, size, MADV_SEQUENTIAL);
+
+    const char *p = data;
+    const char *end = data + size;
+    struct csv_field fields[CSV_MAX_FIELDS];
+    size_t nf;
+    int cols[COL_MAX];
+
+    for (int i = 0; i < COL_MAX; i++) cols[i] = -1;
+
+    p = csv_row(p, end, fields, CSV_MAX_FIELDS, &nf);
+
+    for (size_t i = 0; i < nf; i++) {
+        char key[64];
+
+        header_key(&fields[i], key, sizeof(key));
+
+        for (size_t k = 0; k < sizeof(header_names) / sizeof(header_names[0]); k++) {
+            if (strcmp(key, header_names[k].name) == 0 && cols[header_names[k].col] < 0) cols[header_names[k].col] = (int) i;
+        }
+    }
+
+    if (cols[COL_NUMBER] < 0 || cols[COL_NAME] < 0) {
+        fprintf(stderr, "[ssm-import] 表头缺少注册号列 (registration_no) 或公司名列 (company_name)\n");
+        munmap((void *) data, size);
+        return -1;
+    }
+
+    struct memory pool = {0};
+    struct reg_record *recs = NULL;
+    size_t nrecs = 0;
+    size_t cap = 0;
+    size_t keys = 0;
+    uint32_t interned[64];
+    size_t ninterned = 0;
+    int rc = -1;
+
+    uint32_t *hash = NULL;
+    uint32_t *tri = NULL;
+    uint32_t *last = NULL;
+    uint32_t *postings = NULL;
+    uint64_t npostings = 0;
+    FILE *fp = NULL;
+    char *tmp_path = NULL;
+
+    // 偏移 0 是所有空字段共用的空串
+    if (memory_append(&pool, "", 1) != 0) goto done;
+    pool.size = 1;
+
+    while (p < end) {
+        p = csv_row(p, end, fields, CSV_MAX_FIELDS, &nf);
+
+        if ((size_t) cols[COL_NUMBER] >= nf || (size_t) cols[COL_NAME] >= nf) continue;
+
+        if (nrecs == cap) {
+            size_t ncap = cap ? cap * 2 : 4096;
+            struct reg_record *r = realloc(recs, ncap * sizeof(*r));
+
+            if (!r) goto done;
+
+            recs = r;
+            cap = ncap;
+        }
+
+        struct reg_record *r = &recs[nrecs];
+        size_t len;
+        uint32_t mark = (uint32_t) pool.size;
+
+        memset(r, 0, sizeof(*r));
+
+        r -> number = pool_add_normalized(&pool, &fields[cols[COL_NUMBER]], true, &len);
+        r -> name = pool_add_field(&pool, &fields[cols[COL_NAME]]);
+        r -> norm = pool_add_normalized(&pool, &fields[cols[COL_NAME]], false, &len);
+        r -> norm_len = (uint32_t) len;
+
+        // 没有注册号或公司名的行跳过，已经写进字符串区的内容一并回退
+        if (r -> number == 0 || r -> norm == 0) {
+            pool.size = mark;
+            continue;
+        }
+
+        if (cols[COL_OLD_NUMBER] >= 0 && (size_t) cols[COL_OLD_NUMBER] < nf) {
+            r -> old_number = pool_add_normalized(&pool, &fields[cols[COL_OLD_NUMBER]], true, &len);
+        }
+
+        if (cols[COL_STATUS] >= 0 && (size_t) cols[COL_STATUS] < nf) {
+            r -> status = pool_add_interned(&pool, &fields[cols[COL_STATUS]], interned, &ninterned, 64);
+        }
+
+        if (cols[COL_TYPE] >= 0 && (size_t) cols[COL_TYPE] < nf) {
+            r -> type = pool_add_interned(&pool, &fields[cols[COL_TYPE]], interned, &ninterned, 64);
+        }
+
+        if (pool.size >= UINT32_MAX || nrecs >= UINT32_MAX - 1) {
+            fprintf(stderr, "[ssm-import] 输入过大\n");
+            goto done;
+        }
+
+        keys += r -> old_number ? 2 : 1;
+        nrecs++;
+    }
+
+    if (nrecs == 0) {
+        fprintf(stderr, "[ssm-import] 没有可导入的记录\n");
+        goto done;
+    }
+
+    // 注册号哈希表，负载不超过 1/2
+    uint32_t slots = 16;
+
+    while (slots < keys * 2) slots *= 2;
+
+    hash = calloc(slots, sizeof(*hash));
+    tri = calloc(TRI_COUNT + 1, sizeof(*tri));
+    last = malloc(TRI_COUNT * sizeof(*last));
+
+    if (!hash || !tri || !last) goto done;
+
+    nrecs = dedupe_records(recs, nrecs, pool.data, hash, slots - 1);
+
+    sort_strings = pool.data;
+    qsort(recs, nrecs, sizeof(*recs), compare_records);
+
+    for (uint32_t i = 0; i < nrecs; i++) {
+        hash_insert(hash, slots - 1, recs, pool.data, recs[i].number, i);
+        if (recs[i].old_number) hash_insert(hash, slots - 1, recs, pool.data, recs[i].old_number, i);
+    }
+
+    // 三元组倒排表：第一遍计数，第二遍按记录顺序填充，倒排表天然递增；同一记录里重复的三元组只计一次
+    memset(last, 0xff, TRI_COUNT * sizeof(*last));
+
+    for (uint32_t i = 0; i < nrecs; i++) {
+        const char *s = pool.data + recs[i].norm;
+
+        for (uint32_t j = 0; j + 3 <= recs[i].norm_len; j++) {
+            unsigned int id = tri_id(s + j);
+
+            if (last[id] == i) continue;
+
+            last[id] = i;
+            tri[id]++;
+            npostings++;
+        }
+    }
+
+    if (npostings >= UINT32_MAX) {
+        fprintf(stderr, "[ssm-import] 输入过大\n");
+        goto done;
+    }
+
+    uint32_t sum = 0;
+
+    for (unsigned int id = 0; id < TRI_COUNT; id++) {
+        uint32_t c = tri[id];
+
+        tri[id] = sum;
+        sum += c;
+    }
+
+    tri[TRI_COUNT] = sum;
+
+    postings = malloc((npostings ? npostings : 1) * sizeof(*postings));
+
+    if (!postings) goto done;
+
+    // 第二遍借用 last 作为每个三元组的写入游标
+    memcpy(last, tri, TRI_COUNT * sizeof(*last));
+
+    for (uint32_t i = 0; i < nrecs; i++) {
+        const char *s = pool.data + recs[i].norm;
+
+        for (uint32_t j = 0; j + 3 <= recs[i].norm_len; j++) {
+            unsigned int id = tri_id(s + j);
+
+            if (last[id] > tri[id] && postings[last[id] - 1] == i) continue;
+
+            postings[last[id]++] = i;
+        }
+    }
+
+    struct reg_header h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, REG_MAGIC, sizeof(h.magic));
+    h.version = REG_VERSION;
+    h.endian = REG_ENDIAN;
+    h.count = (uint32_t) nrecs;
+    h.hash_slots = slots;
+    h.records_off = align8(sizeof(h));
+    h.hash_off = align8(h.records_off + nrecs * sizeof(*recs));
+    h.tri_off = align8(h.hash_off + (uint64_t) slots * sizeof(*hash));
+    h.postings_off = align8(h.tri_off + (TRI_COUNT + 1) * sizeof(*tri));
+    h.postings_count = npostings;
+    h.strings_off = align8(h.postings_off + npostings * sizeof(*postings));
+    h.strings_len = pool.size;
+    h.file_size = align8(h.strings_off + pool.size);
+
+    size_t plen = strlen(out_path);
+
+    tmp_path = malloc(plen + 5);
+
+    if (!tmp_path) goto done;
+
+    memcpy(tmp_path, out_path, plen);
+    memcpy(tmp_path + plen, ".tmp", 5);
+
+    fp = fopen(tmp_path, "wb");
+
+    if (!fp) {
+        fprintf(stderr, "[ssm-import] 无法写入 %s: %s\n", tmp_path, strerror(errno));
+        goto done;
+    }
+
+    uint64_t off = 0;
+
+    if (write_section(fp, &h, sizeof(h), &off) != 0
+        || write_section(fp, recs, nrecs * sizeof(*recs), &off) != 0
+        || write_section(fp, hash, (size_t) slots * sizeof(*hash), &off) != 0
+        || write_section(fp, tri, (TRI_COUNT + 1) * sizeof(*tri), &off) != 0
+        || write_section(fp, postings, npostings * sizeof(*postings), &off) != 0
+        || write_section(fp, pool.data, pool.size, &off) != 0) {
+        fprintf(stderr, "[ssm-import] 写入 %s 失败: %s\n", tmp_path, strerror(errno));
+        goto done;
+    }
+
+    int closed = fclose(fp);
+
+    fp = NULL;
+
+    if (closed != 0 || rename(tmp_path, out_path) != 0) {
+        fprintf(stderr, "[ssm-import] 无法生成 %s: %s\n", out_path, strerror(errno));
+        goto done;
+    }
+
+    if (count) *count = nrecs;
+
+    rc = 0;
+
+done:
+    if (fp) fclose(fp);
+    if (rc != 0 && tmp_path) unlink(tmp_path);
+
+    free(tmp_path);
+    free(postings);
+    free(last);
+    free(tri);
+    free(hash);
+    free(recs);
+    memory_release(&pool);
+    munmap((void *) data, size);
+
+    return rc;
+}
+
+/**
+ * mo ssm-import 子命令入口
+ *
+ * @param argc 参数个数（argv[0] 为 "ssm-import"）
+ * @param argv 参数数组
+ * @return 进程退出码
+ */
+int ssm_registry_main(int argc, char **argv) {
+    if (argc != 3 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        printf("用法: mo ssm-import <注册资料.csv> <输出文件>\n");
+        printf("  CSV 第一行为表头，需包含 registration_no 和 company_name 列，\n");
+        printf("  可选 old_registration_no、status、type 列；之后用 mo --ssm-registry <输出文件> 加载\n");
+        return argc == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    struct timespec t0, t1;
+    size_t count = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    if (ssm_registry_import(argv[1], argv[2], &count) != 0) return EXIT_FAILURE;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    fprintf(stderr, "[ssm-import] 已导入 %zu 家公司到 %s，用时 %.2f s\n",
+        count, argv[2], (double) (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+    return EXIT_SUCCESS;
+}
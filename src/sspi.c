@@ -1,54 +1,89 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
 #include <curl/curl.h>
 
 #include "../include/sspi.h"
 #include "../include/memory.h"
+#include "../include/curl_pool.h"
+#include "../include/metrics.h"
+#include "../include/upstream.h"
+#include "../include/singleflight.h"
+#include "../include/html_stream.h"
 
 #define SSPI_URL "https://sspi.imi.gov.my/sspi/index.php?page=sspi/bm"
 
+// 状态文本最多保留的字节数
+#define SSPI_STATUS_MAX 256
+
+// 规范化后的身份证号码最大长度（含结尾 '\0'）
+#define SSPI_IC_MAX 32
+
+/**
+ * 流式解析状态：只关心 lblStatuscode 这一个 span，拿到后立即中止传输
+ */
+struct sspi_stream {
+    struct html_capture status;
+};
+
 /**
- * CURL写回调函数，用于将接收到的数据写入内存缓冲区
+ * CURL写回调函数：边接收边查找状态 span，不缓存整页
  * @param contents 指向接收到的数据的指针
  * @param size 每个数据元素的大小
  * @param nmemb 数据元素的数量
- * @param userp 指向用户自定义数据结构的指针（这里是一个memory结构体）
- * @return 返回实际处理的数据大小，如果失败返回0
+ * @param userp 指向 sspi_stream 的指针
+ * @return 返回实际处理的数据大小；状态已取到时返回0让curl中止传输
  */
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     size_t realsize = size * nmemb;
-    struct memory *mem = (struct memory *)userp;
+    struct sspi_stream *st = (struct sspi_stream *)userp;
 
-    // 重新分配内存以容纳新数据
-    char *ptr = realloc(mem -> data, mem -> size + realsize + 1);
+    html_capture_feed(&st -> status, (const char *) contents, realsize);
 
-    if (!ptr) return 0;
-    
-    mem -> data = ptr;
+    return html_capture_done(&st -> status) ? 0 : realsize;
+}
 
-    // 将新数据复制到内存缓冲区
-    memcpy(&(mem -> data[mem -> size]), contents, realsize);
-    
-    mem -> size += realsize;
-    mem -> data[mem -> size] = 0;
+/**
+ * 规范化身份证号码：去掉连字符和空白，"900101-14-5678" 与 "900101145678" 是同一个查询
+ *
+ * 结果既是合并请求的键，也是提交给 SSPI 的 txtIcNo。
+ *
+ * @return 0表示成功，-1表示号码为空或过长
+ */
+static int normalise_ic(const char *ic_no, char *out, size_t out_len) {
+    size_t n = 0;
+
+    for (const char *p = ic_no; *p; p++) {
+        if (*p == '-' || isspace((unsigned char) *p)) continue;
+        if (n + 1 >= out_len) return -1;
 
-    return realsize;
+        out[n++] = *p;
+    }
+
+    out[n] = '\0';
+
+    return n ? 0 : -1;
 }
 
 /**
- * 检查SSPI身份信息
- * @param ic_no 身份证号码字符串
- * @param resp 用于存储响应结果的结构体指针
+ * 向 SSPI 提交查询并取回状态文本（singleflight_do 的 load 函数）
+ * @param arg 规范化后的身份证号码
+ * @param data 成功时输出状态文本，页面中没有状态时为 "Unknown"
+ * @param size 成功时输出状态文本长度
  * @return 0表示成功，-1表示curl初始化失败，-2表示curl执行失败
  */
-int sspi_check(const char *ic_no, struct sspi_response *resp) {
+static int sspi_fetch(void *arg, char **data, size_t *size) {
+    const char *ic_no = (const char *) arg;
     CURL *curl;
     CURLcode res;
-    struct memory chunk = {0};
+    struct sspi_stream st;
 
-    // 初始化curl句柄 
-    curl = curl_easy_init();
+    if (html_capture_init(&st.status, "<span id=\"lblStatuscode\"", "</span>", true, SSPI_STATUS_MAX) != 0) return -1;
+
+    // 从句柄池借用curl句柄 
+    curl = curl_pool_acquire();
 
     if (!curl) return -1;
 
@@ -58,54 +93,208 @@ int sspi_check(const char *ic_no, struct sspi_response *resp) {
     snprintf(postfields, sizeof(postfields), "txtIcNo=%s&btnSemak=Semak", ic_no);
 
     // 设置curl选项 
-    curl_easy_setopt(curl, CURLOPT_URL, SSPI_URL);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postfields);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 20L);
+
+    // 执行HTTP请求；写回调主动中止时 curl 返回 CURLE_WRITE_ERROR，此时结果已经完整
+    struct upstream_call call = {
+        .source = METRICS_SRC_SSPI, .url = upstream_url("MO_SSPI_URL", SSPI_URL), .post = postfields,
+        .write = write_callback, .write_data = &st, .abort_ok = true,
+    };
+
+    res = upstream_perform(curl, &call);
 
-    // 执行HTTP请求 
-    res = curl_easy_perform(curl);
+    bool done = html_capture_done(&st.status);
 
-    if (res != CURLE_OK) {
-        curl_easy_cleanup(curl);
+    // 归还curl句柄 
+    curl_pool_release(curl);
+
+    if (res != CURLE_OK && !(res == CURLE_WRITE_ERROR && done)) {
+        html_capture_free(&st.status);
         return -2;
     }
 
-    resp -> raw_html = chunk.data;
+    *data = done ? html_capture_take_text(&st.status) : strdup("Unknown");
+    *size = *data ? strlen(*data) : 0;
 
-    // 解析HTML响应，提取状态码信息 
-    const char *needle = "<span id=\"lblStatuscode\"";
-    char *p = strstr(resp -> raw_html, needle);
-    
-    if (p) {
-        p = strchr(p, '>');
-    
-        if (p) {
-            p++;
+    html_capture_free(&st.status);
 
-            char *end = strstr(p, "</span>");
-    
-            if (end) {
-                size_t len = end - p;
-    
-                resp -> status = malloc(len + 1);
-                strncpy(resp->status, p, len);
-                resp -> status[len] = '\0';
-            }
+    return *data ? 0 : -1;
+}
+
+/**
+ * 检查SSPI身份信息
+ *
+ * 同一身份证号码（去掉连字符和空白后）的并发查询会被合并为一次上游请求。
+ * 响应边到边解析，拿到状态即中止传输，raw_html 不再保存整页内容（恒为 NULL）。
+ *
+ * @param ic_no 身份证号码字符串
+ * @param resp 用于存储响应结果的结构体指针
+ * @return 0表示成功，-1表示号码无效或curl初始化失败，-2表示curl执行失败
+ */
+int sspi_check(const char *ic_no, struct sspi_response *resp) {
+    size_t size = 0;
+    char ic[SSPI_IC_MAX];
+
+    resp -> raw_html = NULL;
+    resp -> status = NULL;
+
+    if (!ic_no || normalise_ic(ic_no, ic, sizeof(ic)) != 0) return -1;
+
+    return singleflight_do("sspi", ic, sspi_fetch, ic, &resp -> status, &size);
+}
+
+/**
+ * 异步查询的上下文
+ */
+struct sspi_async {
+    struct sspi_stream st;
+    char postfields[128];
+    char *flight_key;
+    sspi_done_fn done;
+    void *userdata;
+};
+
+static void sspi_async_done(CURL *curl, CURLcode res, void *userdata) {
+    struct sspi_async *ctx = (struct sspi_async *) userdata;
+    bool done = html_capture_done(&ctx -> st.status);
+    struct sspi_response resp = {0};
+    int status = 0;
+
+    curl_pool_release(curl);
+
+    if (res == CURLE_OPERATION_TIMEDOUT && !done) {
+        status = -3;
+    } else if (res != CURLE_OK && !(res == CURLE_WRITE_ERROR && done)) {
+        status = -2;
+    } else {
+        resp.status = done ? html_capture_take_text(&ctx -> st.status) : strdup("Unknown");
+
+        if (!resp.status) status = -1;
+    }
+
+    // 先把结果分发给合并进来的其他请求，再交给自己的回调（回调会接管 resp）
+    if (ctx -> flight_key) {
+        singleflight_complete("sspi", ctx -> flight_key, status, resp.status, resp.status ? strlen(resp.status) : 0);
+        free(ctx -> flight_key);
+    }
+
+    html_capture_free(&ctx -> st.status);
+
+    ctx -> done(status, &resp, ctx -> userdata);
+
+    free(ctx);
+}
+
+/**
+ * 被合并的异步查询：等待 leader 完成
+ */
+struct sspi_follower {
+    sspi_done_fn done;
+    void *userdata;
+};
+
+static void sspi_follower_done(int status, const char *data, size_t size, void *userdata) {
+    struct sspi_follower *f = (struct sspi_follower *) userdata;
+    struct sspi_response resp = {0};
+
+    if (status == 0 && data) {
+        resp.status = malloc(size + 1);
+
+        if (resp.status) {
+            memcpy(resp.status, data, size);
+            resp.status[size] = '\0';
+        } else {
+            status = -1;
         }
     }
 
-    // 如果未找到状态信息，则设置默认值 
-    if (!(resp -> status)) {
-        resp -> status = strdup("Unknown");
+    f -> done(status, &resp, f -> userdata);
+
+    free(f);
+}
+
+/**
+ * 异步检查SSPI身份信息（通过上游事件循环执行，不阻塞调用线程）
+ *
+ * 完成回调在事件循环线程中执行，resp -> status 的所有权转交给回调方，需调用 sspi_response_free 释放。
+ * 同一身份证号码（去掉连字符和空白后）进行中的查询（同步或异步）会被合并，只访问一次上游。
+ *
+ * 超时只对真正发起请求的 leader 生效：合并进来的调用方没有自己的计时器，与 leader 同时结束，
+ * 拿到的是 leader 的结果（超时时同样是 -3）。各调用方传入相同的 timeout_ms 时，
+ * 晚加入的调用方等待的时间只会比自己的期限更短；传入更短期限的调用方可能等到 leader 的期限才返回。
+ *
+ * @param ic_no 身份证号码（内部会复制）
+ * @param timeout_ms 整个请求的超时（毫秒），<= 0 时为 20 秒；合并进已有请求时不生效
+ * @param done 完成回调，status 为 0 表示成功，-1表示内存不足，-2表示上游失败，-3表示超时
+ * @param userdata 回调参数
+ * @return 0表示已提交，-1表示提交失败（此时不会回调）
+ */
+int sspi_check_async(const char *ic_no, long timeout_ms, sspi_done_fn done, void *userdata) {
+    char ic[SSPI_IC_MAX];
+
+    if (!ic_no || !done || normalise_ic(ic_no, ic, sizeof(ic)) != 0) return -1;
+
+    struct sspi_follower *follower = malloc(sizeof(*follower));
+
+    if (!follower) return -1;
+
+    follower -> done = done;
+    follower -> userdata = userdata;
+
+    int role = singleflight_join("sspi", ic, sspi_follower_done, follower);
+
+    if (role == 0) return 0;
+
+    free(follower);
+
+    struct sspi_async *ctx = calloc(1, sizeof(*ctx));
+    CURL *curl = curl_pool_acquire();
+    bool captured = ctx && html_capture_init(&ctx -> st.status, "<span id=\"lblStatuscode\"", "</span>", true, SSPI_STATUS_MAX) == 0;
+
+    if (captured && role == 1) ctx -> flight_key = strdup(ic);
+
+    if (!captured || !curl || (role == 1 && !ctx -> flight_key)) {
+        if (captured) html_capture_free(&ctx -> st.status);
+        if (ctx) free(ctx -> flight_key);
+
+        free(ctx);
+        curl_pool_release(curl);
+
+        if (role == 1) singleflight_complete("sspi", ic, -1, NULL, 0);
+
+        return -1;
+    }
+
+    ctx -> done = done;
+    ctx -> userdata = userdata;
+
+    snprintf(ctx -> postfields, sizeof(ctx -> postfields), "txtIcNo=%s&btnSemak=Semak", ic);
+
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms > 0 ? timeout_ms : 20000L);
+
+    struct upstream_call call = {
+        .source = METRICS_SRC_SSPI, .url = upstream_url("MO_SSPI_URL", SSPI_URL), .post = ctx -> postfields,
+        .write = write_callback, .write_data = &ctx -> st, .abort_ok = true,
+    };
+
+    if (upstream_submit(curl, &call, sspi_async_done, ctx) != 0) {
+        curl_pool_release(curl);
+        html_capture_free(&ctx -> st.status);
+
+        if (role == 1) singleflight_complete("sspi", ic, -1, NULL, 0);
+
+        free(ctx -> flight_key);
+        free(ctx);
+
+        return -1;
     }
 
-    // 清理curl资源 
-    curl_easy_cleanup(curl);
-    
     return 0;
 }
 
@@ -123,4 +312,7 @@ int sspi_check(const char *ic_no, struct sspi_response *resp) {
 void sspi_response_free(struct sspi_response *resp) {
     if (resp -> raw_html) free(resp -> raw_html);
     if (resp -> status) free(resp -> status);
+
+    resp -> raw_html = NULL;
+    resp -> status = NULL;
 }
\ No newline at end of file
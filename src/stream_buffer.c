@@ -0,0 +1,93 @@
+/**
+ * @file stream_buffer.c
+ * @brief 流式响应的待发送缓冲区与连接挂起/恢复
+ *
+ * 读取函数发现缓冲区为空且还没结束时，调用 MHD_suspend_connection 后返回 0，
+ * MHD 线程随即去服务其他连接；生产方追加数据或结束时调用 MHD_resume_connection，
+ * MHD 再次调用读取函数。挂起和恢复都在所属对象的锁内进行，不会错过唤醒。
+ *
+ * 连接在挂起期间不会被 MHD 关闭，因此只要 suspended 为真，connection 就一定有效；
+ * 响应释放时调用 stream_buffer_detach，此后的数据不再唤醒任何连接。
+ */
+
+#include <string.h>
+
+#include "../include/stream_buffer.h"
+
+/**
+ * 记下读取函数所在的连接（需在 MHD 第一次调用读取函数之前）
+ */
+void stream_buffer_attach(struct stream_buffer *sb, struct MHD_Connection *connection) {
+    sb -> connection = connection;
+}
+
+/**
+ * 响应已释放：之后不再恢复连接
+ */
+void stream_buffer_detach(struct stream_buffer *sb) {
+    sb -> connection = NULL;
+    sb -> suspended = false;
+}
+
+/**
+ * 恢复因等待数据而挂起的连接；生产方追加数据或流结束时调用
+ */
+void stream_buffer_wake(struct stream_buffer *sb) {
+    if (!sb -> suspended) return;
+
+    sb -> suspended = false;
+
+    if (sb -> connection) MHD_resume_connection(sb -> connection);
+}
+
+/**
+ * 追加一段待发送的数据并唤醒读取方
+ *
+ * @return 0表示成功，-1表示内存不足
+ */
+int stream_buffer_append(struct stream_buffer *sb, const void *data, size_t len) {
+    if (memory_append(&sb -> data, data, len) != 0) return -1;
+
+    stream_buffer_wake(sb);
+
+    return 0;
+}
+
+/**
+ * MHD 读取函数的公共部分：有数据就发，已结束就结束，否则挂起连接等数据
+ *
+ * @param finished 生产方是否已经写完全部数据
+ * @return 写入 buf 的字节数；挂起时返回 0；全部发完返回 MHD_CONTENT_READER_END_OF_STREAM
+ */
+ssize_t stream_buffer_read(struct stream_buffer *sb, bool finished, char *buf, size_t max) {
+    if (sb -> off < sb -> data.size) {
+        size_t n = sb -> data.size - sb -> off;
+
+        if (n > max) n = max;
+
+        memcpy(buf, sb -> data.data + sb -> off, n);
+        sb -> off += n;
+
+        if (sb -> off == sb -> data.size) {
+            sb -> data.size = 0;
+            sb -> off = 0;
+        }
+
+        return (ssize_t) n;
+    }
+
+    if (finished) return MHD_CONTENT_READER_END_OF_STREAM;
+
+    if (sb -> connection && !sb -> suspended) {
+        sb -> suspended = true;
+        MHD_suspend_connection(sb -> connection);
+    }
+
+    return 0;
+}
+
+void stream_buffer_release(struct stream_buffer *sb) {
+    memory_release(&sb -> data);
+
+    sb -> off = 0;
+}
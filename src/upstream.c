@@ -0,0 +1,432 @@
+/**
+ * @file upstream.c
+ * @brief 基于 curl multi 的上游请求事件循环
+ *
+ * 一个后台线程驱动一个 curl multi 句柄，负责所有异步上游请求。
+ * 调用方提交一个已配置好的 CURL 句柄和完成回调即可立即返回，
+ * 配合 MHD_suspend_connection / MHD_resume_connection，
+ * 少量 HTTP 线程就能同时挂起成千上万个等待上游响应的查询。
+ *
+ * 完成回调在事件循环线程中执行，必须尽快返回，不要在里面做阻塞操作。
+ *
+ * 同步请求走 upstream_perform。两条路径都在这里统一计量上游指标，
+ * 并在录制模式下把响应写入捕获文件、在回放模式下直接用捕获的响应代替网络请求。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <curl/curl.h>
+
+#include "../include/upstream.h"
+#include "../include/capture.h"
+#include "../include/memory.h"
+
+// 录制时夹在 curl 和调用方写回调之间，把收到的每一块数据另存一份
+struct upstream_tee {
+    upstream_write_fn write;
+    void *write_data;
+    struct memory copy;
+};
+
+struct upstream_req {
+    CURL *curl;
+    struct upstream_call call;
+    char *url;
+    char *post;
+    struct upstream_tee tee;
+    upstream_done_fn done;
+    void *userdata;
+    struct timespec ready_at;
+    struct upstream_req *next;
+};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct upstream_req *queue_head = NULL;
+static struct upstream_req *queue_tail = NULL;
+
+static CURLM *multi = NULL;
+static pthread_t loop_thread;
+static bool running = false;
+static size_t inflight = 0;
+static size_t inflight_max = UPSTREAM_MAX_INFLIGHT;
+
+static bool ready(const struct upstream_req *req, const struct timespec *now) {
+    return req -> ready_at.tv_sec < now -> tv_sec ||
+        (req -> ready_at.tv_sec == now -> tv_sec && req -> ready_at.tv_nsec <= now -> tv_nsec);
+}
+
+static long ms_until(const struct timespec *when, const struct timespec *now) {
+    return (when -> tv_sec - now -> tv_sec) * 1000L + (when -> tv_nsec - now -> tv_nsec) / 1000000L;
+}
+
+static size_t tee_write(void *contents, size_t size, size_t nmemb, void *userp) {
+    struct upstream_tee *tee = (struct upstream_tee *) userp;
+
+    // 写回调可能在拿够数据后中止传输，所以先存下整块再交给它，回放时才能走到同样的位置
+    memory_append(&tee -> copy, contents, size * nmemb);
+
+    return tee -> write(contents, size, nmemb, tee -> write_data);
+}
+
+static bool call_ok(const struct upstream_call *call, CURLcode res) {
+    return res == CURLE_OK || (call -> abort_ok && res == CURLE_WRITE_ERROR);
+}
+
+/**
+ * 把请求地址、请求体和写回调设置到句柄上；tee 不为 NULL 时写回调经由 tee_write 转发
+ */
+static void apply_call(CURL *curl, const struct upstream_call *call, struct upstream_tee *tee) {
+    curl_easy_setopt(curl, CURLOPT_URL, call -> url);
+
+    if (call -> post) curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, call -> post);
+
+    if (!call -> write) return;
+
+    if (tee) {
+        tee -> write = call -> write;
+        tee -> write_data = call -> write_data;
+
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, tee_write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) tee);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, call -> write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, call -> write_data);
+    }
+}
+
+/**
+ * 回放模式：按 CAPTURE_REPLAY_CHUNK 分块把捕获的响应交给写回调，行为与真实传输一致
+ *
+ * @return CURLE_OK 表示完整交付；没有录制过该请求时返回 CURLE_COULDNT_CONNECT；
+ *         写回调中止时返回 CURLE_WRITE_ERROR
+ */
+static CURLcode replay_call(struct upstream_call *call) {
+    const char *body = NULL;
+    size_t len = 0;
+
+    if (capture_lookup(call -> source, call -> url, call -> post, &call -> status, &body, &len) != 0) {
+        return CURLE_COULDNT_CONNECT;
+    }
+
+    for (size_t off = 0; off < len && call -> write; ) {
+        size_t n = len - off < CAPTURE_REPLAY_CHUNK ? len - off : CAPTURE_REPLAY_CHUNK;
+
+        if (call -> write((void *) (body + off), 1, n, call -> write_data) != n) return CURLE_WRITE_ERROR;
+
+        off += n;
+    }
+
+    return CURLE_OK;
+}
+
+/**
+ * 结束一个异步请求：计量、录制、回调，然后释放请求本身
+ */
+static void finish_req(struct upstream_req *req, CURLcode res, bool performed) {
+    struct upstream_call *call = &req -> call;
+
+    if (performed) curl_easy_getinfo(req -> curl, CURLINFO_RESPONSE_CODE, &call -> status);
+
+    metrics_upstream_end(call -> source, performed ? req -> curl : NULL, call_ok(call, res));
+
+    if (performed && capture_get_mode() == CAPTURE_RECORD && call_ok(call, res)) {
+        capture_record(call -> source, call -> url, call -> post, call -> status, req -> tee.copy.data, req -> tee.copy.size);
+    }
+
+    memory_release(&req -> tee.copy);
+
+    if (call -> status_out) *call -> status_out = call -> status;
+
+    req -> done(req -> curl, res, req -> userdata);
+
+    free(req -> url);
+    free(req -> post);
+    free(req);
+}
+
+/**
+ * 把队列里已到期的请求加入 multi 句柄（不超过在飞上限）
+ *
+ * @return 距离下一个延迟请求到期的毫秒数，没有延迟请求时返回 -1
+ */
+static long admit_queued(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long next_ms = -1;
+
+    pthread_mutex_lock(&queue_lock);
+
+    struct upstream_req **pp = &queue_head;
+    struct upstream_req *prev = NULL;
+
+    while (*pp) {
+        struct upstream_req *req = *pp;
+
+        if (inflight >= inflight_max) break;
+
+        if (!ready(req, &now)) {
+            long ms = ms_until(&req -> ready_at, &now);
+
+            if (next_ms < 0 || ms < next_ms) next_ms = ms;
+
+            prev = req;
+            pp = &req -> next;
+            continue;
+        }
+
+        *pp = req -> next;
+        if (queue_tail == req) queue_tail = prev;
+
+        // 回放模式不经过 multi，直接在事件循环线程里交付捕获的响应；回调可能重新提交，先放开队列锁
+        if (capture_get_mode() == CAPTURE_REPLAY) {
+            pthread_mutex_unlock(&queue_lock);
+            finish_req(req, replay_call(&req -> call), false);
+            pthread_mutex_lock(&queue_lock);
+            pp = prev ? &prev -> next : &queue_head;
+            continue;
+        }
+
+        curl_easy_setopt(req -> curl, CURLOPT_PRIVATE, req);
+
+        if (curl_multi_add_handle(multi, req -> curl) == CURLM_OK) {
+            inflight++;
+        } else {
+            pthread_mutex_unlock(&queue_lock);
+            finish_req(req, CURLE_FAILED_INIT, false);
+            pthread_mutex_lock(&queue_lock);
+            pp = prev ? &prev -> next : &queue_head;
+        }
+    }
+
+    pthread_mutex_unlock(&queue_lock);
+
+    return next_ms;
+}
+
+static void reap_finished(void) {
+    CURLMsg *msg;
+    int left;
+
+    while ((msg = curl_multi_info_read(multi, &left))) {
+        if (msg -> msg != CURLMSG_DONE) continue;
+
+        CURL *curl = msg -> easy_handle;
+        CURLcode res = msg -> data.result;
+        struct upstream_req *req = NULL;
+
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **) &req);
+        curl_multi_remove_handle(multi, curl);
+
+        inflight--;
+
+        // 回调里可能会把同一个句柄重新提交（重试），所以先摘下再回调
+        if (req) finish_req(req, res, true);
+    }
+}
+
+static void *loop_main(void *arg) {
+    (void) arg;
+
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        long next_ms = admit_queued();
+        int still_running = 0;
+
+        curl_multi_perform(multi, &still_running);
+        reap_finished();
+
+        int timeout = 1000;
+
+        if (next_ms >= 0 && next_ms < timeout) timeout = (int) next_ms;
+
+        curl_multi_poll(multi, NULL, 0, timeout, NULL);
+    }
+
+    return NULL;
+}
+
+/**
+ * 启动上游事件循环线程
+ *
+ * @param max_inflight 同时在飞的请求上限，0 表示使用 UPSTREAM_MAX_INFLIGHT
+ * @return 0表示成功，-1表示失败
+ */
+int upstream_loop_start(size_t max_inflight) {
+    if (running) return 0;
+
+    multi = curl_multi_init();
+
+    if (!multi) return -1;
+
+    inflight_max = max_inflight ? max_inflight : UPSTREAM_MAX_INFLIGHT;
+    running = true;
+
+    if (pthread_create(&loop_thread, NULL, loop_main, NULL) != 0) {
+        running = false;
+        curl_multi_cleanup(multi);
+        multi = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * 停止事件循环（进程退出前调用）
+ * 仍在队列或在飞的请求不再回调，句柄直接丢弃
+ */
+void upstream_loop_stop(void) {
+    if (!running) return;
+
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    curl_multi_wakeup(multi);
+
+    pthread_join(loop_thread, NULL);
+
+    curl_multi_cleanup(multi);
+    multi = NULL;
+}
+
+/**
+ * 延迟提交一个异步请求（用于重试退避）
+ *
+ * @param curl 已配置好的 CURL 句柄（通常来自 curl_pool_acquire），完成前不得再使用
+ * @param call 请求描述（会被复制，调用后即可释放），其中的地址、请求体和写回调由这里设置到句柄上
+ * @param delay_ms 延迟毫秒数
+ * @param done 完成回调，在事件循环线程中调用，负责处理结果并归还句柄
+ * @param userdata 回调参数
+ * @return 0表示已入队，-1表示失败（此时不会回调）
+ */
+int upstream_submit_delayed(CURL *curl, const struct upstream_call *call, long delay_ms, upstream_done_fn done, void *userdata) {
+    if (!running || !curl || !call || !call -> url || !done) return -1;
+
+    struct upstream_req *req = calloc(1, sizeof(*req));
+
+    if (!req) return -1;
+
+    enum capture_mode mode = capture_get_mode();
+
+    req -> curl = curl;
+    req -> call = *call;
+    req -> call.status = 0;
+    req -> done = done;
+    req -> userdata = userdata;
+
+    // 录制和回放要在完成时用到地址和请求体，调用方的缓冲区那时可能已经不在了
+    if (mode != CAPTURE_OFF) {
+        req -> url = strdup(call -> url);
+        req -> post = call -> post ? strdup(call -> post) : NULL;
+
+        if (!req -> url || (call -> post && !req -> post)) {
+            free(req -> url);
+            free(req -> post);
+            free(req);
+            return -1;
+        }
+
+        req -> call.url = req -> url;
+        req -> call.post = req -> post;
+    }
+
+    if (mode != CAPTURE_REPLAY) apply_call(curl, &req -> call, mode == CAPTURE_RECORD ? &req -> tee : NULL);
+
+    metrics_upstream_begin(call -> source);
+
+    clock_gettime(CLOCK_MONOTONIC, &req -> ready_at);
+
+    if (delay_ms > 0) {
+        req -> ready_at.tv_sec += delay_ms / 1000;
+        req -> ready_at.tv_nsec += (delay_ms % 1000) * 1000000L;
+
+        if (req -> ready_at.tv_nsec >= 1000000000L) {
+            req -> ready_at.tv_sec++;
+            req -> ready_at.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&queue_lock);
+
+    if (queue_tail) queue_tail -> next = req;
+    else queue_head = req;
+
+    queue_tail = req;
+
+    pthread_mutex_unlock(&queue_lock);
+
+    curl_multi_wakeup(multi);
+
+    return 0;
+}
+
+/**
+ * 立即提交一个异步请求
+ *
+ * @see upstream_submit_delayed
+ */
+int upstream_submit(CURL *curl, const struct upstream_call *call, upstream_done_fn done, void *userdata) {
+    return upstream_submit_delayed(curl, call, 0, done, userdata);
+}
+
+/**
+ * 同步执行一次上游请求
+ *
+ * 按 call 设置地址、请求体和写回调后执行，并计入上游指标；
+ * 录制模式下把响应写入捕获文件，回放模式下不访问网络，直接把捕获的响应交给写回调。
+ *
+ * @param curl 已设置好其他选项（请求头、超时等）的句柄
+ * @param call 请求描述，执行后 call -> status 为 HTTP 状态码（没有响应时为 0）
+ * @return curl 的执行结果；回放时没有录制过该请求返回 CURLE_COULDNT_CONNECT
+ */
+CURLcode upstream_perform(CURL *curl, struct upstream_call *call) {
+    enum capture_mode mode = capture_get_mode();
+    CURLcode res;
+
+    call -> status = 0;
+
+    metrics_upstream_begin(call -> source);
+
+    if (mode == CAPTURE_REPLAY) {
+        res = replay_call(call);
+        metrics_upstream_end(call -> source, NULL, call_ok(call, res));
+
+        return res;
+    }
+
+    struct upstream_tee tee = {0};
+
+    apply_call(curl, call, mode == CAPTURE_RECORD ? &tee : NULL);
+
+    res = curl_easy_perform(curl);
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &call -> status);
+
+    metrics_upstream_end(call -> source, curl, call_ok(call, res));
+
+    if (mode == CAPTURE_RECORD) {
+        if (call_ok(call, res)) capture_record(call -> source, call -> url, call -> post, call -> status, tee.copy.data, tee.copy.size);
+
+        memory_release(&tee.copy);
+    }
+
+    return res;
+}
+
+/**
+ * 取上游地址：环境变量有值时用它替换内置的政府站点地址
+ *
+ * 压测和联调时把所有 MO_*_URL 指向 bench/mock_upstream 即可完全脱离真实上游。
+ * 返回的指针直接指向环境变量或默认值，进程生命周期内有效，调用者不要释放。
+ *
+ * @param env 环境变量名，如 "MO_SSPI_URL"
+ * @param fallback 未设置或为空时使用的默认地址
+ * @return 地址字符串
+ */
+const char *upstream_url(const char *env, const char *fallback) {
+    const char *val = getenv(env);
+
+    return val && val[0] ? val : fallback;
+}
@@ -1,97 +1,940 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <microhttpd.h>
 #include "../include/pdrm.h"
 #include "../include/sspi.h"
+#include "../include/curl_pool.h"
+#include "../include/upstream.h"
+#include "../include/access_log.h"
+#include "../include/capture.h"
+#include "../include/company.h"
+#include "../include/sprm.h"
+#include "../include/rmp_wanted.h"
+#include "../include/response.h"
+#include "../include/arena.h"
+#include "../include/lru_cache.h"
+#include "../include/singleflight.h"
+#include "../include/ecourt.h"
+#include "../include/mykad.h"
+#include "../include/bulk.h"
+#include "../include/ssm_registry.h"
+#include "../include/judgment_store.h"
+
+#define MOCK_PORT 18931
+
+static const char sspi_page[] =
+    "<html><body><table><tr><td>"
+    "<span id=\"lblStatuscode\" class=\"label\">Tiada halangan untuk keluar negara</span>"
+    "</td></tr></table></body></html>";
+
+static const char mule_json[] =
+    "{\"status\":\"success\",\"count\":7,\"table_data\":[[\"Jumlah Laporan\",3],[\"Jumlah Carian\",7]]}";
+
+// 黄页搜索结果页：名称、地址里的引号和反斜杠以实体形式出现
+static const char company_page[] =
+    "<html><body><div class=\"item\">"
+    "<h3>Ali &quot;Bob&quot; &#92; Sdn Bhd</h3>"
+    "<span class=\"item-category\">Retail &amp; Trade</span>"
+    "<span class=\"value\">1, Jalan &quot;Ampang&quot;</span>"
+    "<div class=\"item-web\">https://ali.example.my</div>"
+    "</div></body></html>";
+
+// SPRM 名单页：字段有 "标签: 值"、表格单元格、值在下一行和没有标签的法律条文几种写法
+static const char sprm_page[] =
+    "<html><body><div class=\"row\">\n"
+    "<div class=\"col-md-3 div-pesalah\">\n"
+    "  <img class=\"photo\" src=\"/images/p1.jpg?a=1&amp;b=2\">\n"
+    "  <p>Nama: Ahmad bin &quot;Ali&quot;</p>\n"
+    "  <p>No. K/P: 800101-14-5678</p>\n"
+    "  <table><tr><td>Majikan</td><td>Jabatan Kerja Raya</td></tr>\n"
+    "  <tr><td>Jawatan</td><td>Jurutera</td></tr></table>\n"
+    "  <p>Pertuduhan:</p><p>Menerima suapan RM5,000</p>\n"
+    "  <p>Seksyen 165 Kanun Keseksaan</p>\n"
+    "  <p>Hukuman: Penjara 2 tahun</p>\n"
+    "</div>\n"
+    "</div>\n"
+    "<div class=\"col-md-3 div-pesalah\"><p>Nama: Siti</p><p>Negeri: Johor</p></div>  </div>\n"
+    "</body></html>";
+
+// PDRM 通缉名单页：每人一个 wanted-person 块
+static const char wanted_page[] =
+    "<html><body>\n"
+    "<div class=\"wanted-person\"><img src=\"/img/w1.jpg\"><h3> Lim &amp; Tan </h3>"
+    "<span class=\"age\">34</span><p>No. KP: 900101-14-5678</p></div>\n"
+    "<div class=\"wanted-person\"><h3>Raju</h3><span class=\"age\">41</span>"
+    "<p>IC 850505105555, tel 0123456789</p></div>\n"
+    "</body></html>";
+
+// SSPI 结果页：状态前面有一大段无关内容，状态标签跨过 curl 的 16 KB 接收块边界（在测试里生成）
+static char sspi_captured_page[20 * 1024];
 
-// 在这里咱们模拟 HTTP 请求的辅助函数
-static enum MHD_Result test_request(const char* url, char** response) {
-    struct MHD_Daemon* d;
-    struct MHD_Response* r;
-    enum MHD_Result ret;
-    
-    d = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY, 8080, NULL, NULL, &handle_request, NULL, MHD_OPTION_END);
-    if (!d) return MHD_NO;
-    
-    // 模拟请求
-    struct MHD_Connection* connection = MHD_create_connection(d);
-    ret = handle_request(NULL, connection, url, "GET", "HTTP/1.1", NULL, NULL, NULL);
-    
-    if (ret == MHD_YES) {
-        *response = strdup(MHD_get_response_header(r, MHD_HTTP_HEADER_CONTENT));
+static int mule_hits = 0;
+static int sspi_hits = 0;
+// 模拟判决上游的总页数；超过 3 页时换一批五月的判决，模拟积压超过一次回填深度
+static int judgment_pages = 3;
+
+// 在这里咱们用一个本地 MHD 服务模拟上游，测试时把 MO_*_URL 指向它
+static enum MHD_Result mock_handler(void *cls, struct MHD_Connection *connection,
+    const char *url, const char *method, const char *version,
+    const char *upload_data, size_t *upload_data_size, void **con_cls) {
+
+    (void) cls; (void) method; (void) version; (void) upload_data;
+
+    if (!*con_cls) {
+        *con_cls = (void *) 1;
+        return MHD_YES;
     }
-    
-    MHD_destroy_response(r);
-    MHD_stop_daemon(d);
 
+    // eJudgment 搜索按请求体里的 CurrPage 返回对应页，页码记在 con_cls 上（1 表示没有页码）
+    if (*upload_data_size) {
+        const char *p = memmem(upload_data, *upload_data_size, "\"CurrPage\":", 11);
+
+        if (p) *con_cls = (void *) (intptr_t) (atoi(p + 11) + 1);
+
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
+
+    const char *body = "not found";
+    unsigned int status = MHD_HTTP_NOT_FOUND;
+    char judgment[256];
+
+    if (strcmp(url, "/sspi") == 0) {
+        // 稍作停顿，让测试里并发的查询确实重叠
+        __atomic_fetch_add(&sspi_hits, 1, __ATOMIC_RELAXED);
+        usleep(20000);
+        body = sspi_page;
+        status = MHD_HTTP_OK;
+    } else if (strcmp(url, "/sspi/captured") == 0) {
+        body = sspi_captured_page;
+        status = MHD_HTTP_OK;
+    } else if (strcmp(url, "/sprm") == 0) {
+        body = sprm_page;
+        status = MHD_HTTP_OK;
+    } else if (strcmp(url, "/wanted") == 0) {
+        body = wanted_page;
+        status = MHD_HTTP_OK;
+    } else if (strcmp(url, "/company/") == 0) {
+        body = company_page;
+        status = MHD_HTTP_OK;
+    } else if (strcmp(url, "/semakmule") == 0) {
+        __atomic_fetch_add(&mule_hits, 1, __ATOMIC_RELAXED);
+        body = mule_json;
+        status = MHD_HTTP_OK;
+    } else if (strcmp(url, "/EJudgmentWeb/Search") == 0) {
+        int page = (int) (intptr_t) *con_cls - 1;
+
+        if (judgment_pages > 3) {
+            snprintf(judgment, sizeof(judgment),
+                "{\"CurrPage\":%d,\"TotalPage\":%d,\"Data\":[{\"CaseNo\":\"M%d-1\",\"DateOfAP\":\"2024-05-%02d\"}]}",
+                page, judgment_pages, page, 30 - page);
+        } else {
+            snprintf(judgment, sizeof(judgment),
+                "{\"CurrPage\":%d,\"TotalPage\":3,\"TotalRecord\":5,\"Data\":[{\"CaseNo\":\"P%d-1\",\"DateOfAP\":\"2024-04-%02d\"}%s]}",
+                page, page, 10 - page, page < 3 ? ",{\"CaseNo\":\"P2\"}" : "");
+        }
+
+        body = judgment;
+        status = MHD_HTTP_OK;
+    }
+
+    struct MHD_Response *r = MHD_create_response_from_buffer(strlen(body), (void *) body, MHD_RESPMEM_MUST_COPY);
+    enum MHD_Result ret = MHD_queue_response(connection, status, r);
+
+    MHD_destroy_response(r);
     return ret;
 }
 
-// 测试电话号码查询
+// 测试号码规范化与请求体构造
+void test_phone_normalise(void) {
+    printf("测试电话号码规范化...\n");
+
+    char out[32];
+    char payload[256];
+
+    assert(pdrm_mule_normalise("011-2782 9038", out, sizeof(out)) == 11);
+    assert(strcmp(out, "01127829038") == 0);
+
+    assert(pdrm_mule_build_payload(out, payload, sizeof(payload)) == 0);
+    assert(strstr(payload, "\"telNo\":\"01127829038\"") != NULL);
+    assert(pdrm_mule_build_payload(out, payload, 16) == -1);
+
+    printf("电话号码规范化测试通过！\n");
+}
+
+// 测试电话号码查询（经由模拟上游，第二次命中缓存）
 void test_phone_query(void) {
     printf("测试电话号码查询功能...\n");
-    
-    char* response;
-    enum MHD_Result ret = test_request("/?q=01127829038", &response);
-    
-    assert(ret == MHD_YES);
-    assert(response != NULL);
-    assert(strstr(response, "01127829038") != NULL);
-    
-    free(response);
+
+    struct pdrm_mule_result res = {0};
+    bool cached = true;
+
+    assert(pdrm_mule_lookup("01127829038", &res, &cached) == 0);
+    assert(!cached);
+    assert(res.count == 7);
+    assert(res.reported == 3);
+    assert(res.raw && strstr(res.raw, "table_data") != NULL);
+    pdrm_mule_result_free(&res);
+
+    assert(pdrm_mule_lookup("011-2782 9038", &res, &cached) == 0);
+    assert(cached);
+    assert(res.reported == 3);
+    assert(mule_hits == 1);
+    pdrm_mule_result_free(&res);
+
     printf("电话号码查询测试通过！\n");
 }
 
+struct flight_result {
+    int calls;
+    int status;
+    char data[64];
+};
+
+static void on_sspi_async_done(int status, struct sspi_response *resp, void *userdata) {
+    struct flight_result *r = (struct flight_result *) userdata;
+
+    r -> status = status;
+
+    if (resp -> status) snprintf(r -> data, sizeof(r -> data), "%s", resp -> status);
+
+    sspi_response_free(resp);
+    __atomic_store_n(&r -> calls, 1, __ATOMIC_RELEASE);
+}
+
 // 测试身份证号码查询
 void test_ic_query(void) {
     printf("测试身份证号码查询功能...\n");
-    
-    char* response;
-    enum MHD_Result ret = test_request("/?id=990101075678", &response);
-    
-    assert(ret == MHD_YES);
-    assert(response != NULL);
-    assert(strstr(response, "IC") != NULL);
-    
-    free(response);
+
+    struct sspi_response resp;
+
+    assert(sspi_check("990101075678", &resp) == 0);
+    assert(resp.status != NULL);
+    assert(strcmp(resp.status, "Tiada halangan untuk keluar negara") == 0);
+
+    sspi_response_free(&resp);
+
+    // 带连字符和连写的同一号码合并为一次上游请求
+    struct flight_result a = {0}, b = {0};
+    int hits = __atomic_load_n(&sspi_hits, __ATOMIC_RELAXED);
+
+    assert(sspi_check_async("990101-07-5678", 0, on_sspi_async_done, &a) == 0);
+    assert(sspi_check_async(" 990101075678", 0, on_sspi_async_done, &b) == 0);
+
+    while (!__atomic_load_n(&a.calls, __ATOMIC_ACQUIRE) || !__atomic_load_n(&b.calls, __ATOMIC_ACQUIRE)) usleep(1000);
+
+    assert(a.status == 0 && strcmp(a.data, "Tiada halangan untuk keluar negara") == 0);
+    assert(b.status == 0 && strcmp(b.data, "Tiada halangan untuk keluar negara") == 0);
+    assert(__atomic_load_n(&sspi_hits, __ATOMIC_RELAXED) == hits + 1);
+
     printf("身份证号码查询测试通过！\n");
 }
 
+// 测试 LRU 缓存：超出容量时淘汰最久未用的条目，过期条目读取时移除
+void test_lru_cache(void) {
+    printf("测试 LRU 缓存...\n");
+
+    struct lru_cache *cache = lru_cache_new(2);
+    struct lru_cache_stats st;
+    void *value;
+    size_t len;
+
+    assert(cache);
+    assert(lru_cache_put(cache, "a", "1", 1, 60) == 0);
+    assert(lru_cache_put(cache, "b", "2", 1, 60) == 0);
+
+    // 读 a 之后 b 成为最久未用的条目，写入 c 时被淘汰
+    assert(lru_cache_get(cache, "a", &value, &len) == 1 && len == 1 && memcmp(value, "1", 1) == 0);
+    free(value);
+    assert(lru_cache_put(cache, "c", "3", 1, 60) == 0);
+
+    assert(lru_cache_get(cache, "b", &value, &len) == 0);
+    assert(lru_cache_get(cache, "a", &value, &len) == 1);
+    free(value);
+    assert(lru_cache_get(cache, "c", &value, &len) == 1);
+    free(value);
+
+    // 覆盖已有的键不淘汰其他条目
+    assert(lru_cache_put(cache, "a", "11", 2, 60) == 0);
+    assert(lru_cache_get(cache, "a", &value, &len) == 1 && len == 2 && memcmp(value, "11", 2) == 0);
+    free(value);
+
+    lru_cache_get_stats(cache, &st);
+    assert(st.size == 2 && st.capacity == 2 && st.evictions == 1 && st.inserts == 4);
+    assert(st.hits == 4 && st.misses == 1);
+
+    // 有效期按秒计，过期的条目在读取时移除；ttl <= 0 不写入
+    assert(lru_cache_put(cache, "short", "x", 1, 1) == 0);
+    assert(lru_cache_put(cache, "long", "y", 1, 60) == 0);
+    assert(lru_cache_put(cache, "none", "z", 1, 0) == -1);
+    sleep(1);
+
+    assert(lru_cache_get(cache, "short", &value, &len) == 0);
+    assert(lru_cache_get(cache, "long", &value, &len) == 1);
+    free(value);
+
+    lru_cache_get_stats(cache, &st);
+    assert(st.expirations == 1 && st.size == 1);
+
+    lru_cache_free(cache);
+    printf("LRU 缓存测试通过！\n");
+}
+
+
+static void on_flight_done(int status, const char *data, size_t size, void *userdata) {
+    struct flight_result *r = (struct flight_result *) userdata;
+
+    r -> calls++;
+    r -> status = status;
+
+    if (data) snprintf(r -> data, sizeof(r -> data), "%.*s", (int) size, data);
+}
+
+static int flight_load_unused(void *arg, char **data, size_t *size) {
+    (void) arg; (void) data; (void) size;
+
+    // follower 不会调用 load
+    assert(0);
+    return -1;
+}
+
+static void *flight_follower(void *arg) {
+    char *data = NULL;
+    size_t size = 0;
+
+    *(int *) arg = singleflight_do("test", "k2", flight_load_unused, NULL, &data, &size);
+    assert(data == NULL && size == 0);
+
+    return NULL;
+}
+
+// 测试请求合并：同一个键只有 leader 访问上游，结果和错误都原样分发给每个 follower
+void test_singleflight(void) {
+    printf("测试请求合并...\n");
+
+    struct singleflight_stats before, after;
+    struct flight_result r1 = {0}, r2 = {0};
+
+    singleflight_get_stats(&before);
+
+    assert(singleflight_join("test", "k1", on_flight_done, NULL) == 1);
+    assert(singleflight_join("test", "k1", on_flight_done, &r1) == 0);
+    assert(singleflight_join("test", "k1", on_flight_done, &r2) == 0);
+
+    // 不同数据源的同名键互不合并
+    assert(singleflight_join("other", "k1", on_flight_done, NULL) == 1);
+    singleflight_complete("other", "k1", 0, "other", 5);
+
+    singleflight_complete("test", "k1", 0, "result", 6);
+    assert(r1.calls == 1 && r1.status == 0 && strcmp(r1.data, "result") == 0);
+    assert(r2.calls == 1 && r2.status == 0 && strcmp(r2.data, "result") == 0);
+
+    // 完成后 flight 即移除，再来的请求重新成为 leader；leader 的错误码传给 follower
+    memset(&r1, 0, sizeof(r1));
+    assert(singleflight_join("test", "k1", on_flight_done, NULL) == 1);
+    assert(singleflight_join("test", "k1", on_flight_done, &r1) == 0);
+    singleflight_complete("test", "k1", -2, NULL, 0);
+    assert(r1.calls == 1 && r1.status == -2 && r1.data[0] == '\0');
+
+    // 同步版本的 follower 阻塞到 leader 完成，拿到 leader 的错误码
+    int status = 0;
+    pthread_t t;
+
+    assert(singleflight_join("test", "k2", on_flight_done, NULL) == 1);
+    assert(pthread_create(&t, NULL, flight_follower, &status) == 0);
+
+    do {
+        usleep(1000);
+        singleflight_get_stats(&after);
+    } while (after.followers < before.followers + 4);
+
+    singleflight_complete("test", "k2", -3, NULL, 0);
+    pthread_join(t, NULL);
+    assert(status == -3);
+
+    singleflight_get_stats(&after);
+    assert(after.leaders == before.leaders + 4 && after.followers == before.followers + 4);
+    assert(after.in_flight == before.in_flight);
+
+    printf("请求合并测试通过！\n");
+}
+
+// 测试访问日志：本线程缓冲区写满后新记录被丢弃并计数，日志里留下一条丢弃汇总
+void test_access_log_drop(void) {
+    printf("测试访问日志丢弃计数...\n");
+
+    char path[] = "/tmp/mo_access_XXXXXX";
+    int fd = mkstemp(path);
+    struct access_log_stats before, after;
+    struct access_log_entry e;
+
+    assert(fd >= 0);
+    close(fd);
+
+    access_log_get_stats(&before);
+    assert(access_log_start(path, 0, 0) == 0);
+
+    // 写线程每 ACCESS_LOG_FLUSH_MS 才取一次，这里一次性写入比缓冲区多 5 条
+    for (int i = 0; i < ACCESS_LOG_RING_SIZE + 5; i++) {
+        access_log_begin(&e, "GET", "/?q=0123456789", "127.0.0.1");
+        access_log_timing(&e, "SemakMule", 1);
+        access_log_commit(&e, 200, true);
+    }
+
+    access_log_get_stats(&after);
+    assert(after.dropped == before.dropped + 5);
+
+    access_log_stop();
+    access_log_get_stats(&after);
+    assert(after.written == before.written + ACCESS_LOG_RING_SIZE);
+
+    char line[512];
+    bool reported = false;
+    FILE *fp = fopen(path, "r");
+
+    assert(fp);
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (strstr(line, "{\"type\":\"dropped\",\"count\":5,")) reported = true;
+    }
+
+    fclose(fp);
+    unlink(path);
+    assert(reported);
+
+    printf("访问日志丢弃计数测试通过！\n");
+}
+
+// 测试上游流量录制与回放：录下的响应按规范化的键原样取回，回放时不访问网络
+void test_capture_roundtrip(void) {
+    printf("测试录制与回放...\n");
+
+    char path[] = "/tmp/mo_capture_XXXXXX";
+    int fd = mkstemp(path);
+    static const char body[] = "line1\n\0binary";
+    struct capture_stats before, after;
+    struct sspi_response resp;
+    const char *got;
+    size_t len;
+    long status;
+
+    assert(fd >= 0);
+    close(fd);
+
+    capture_get_stats(&before);
+
+    // 直接录两条，再经由上游层录一次真实的 SSPI 查询；同一个键录两次以后一次为准
+    assert(capture_start(CAPTURE_RECORD, path) == 0);
+    assert(capture_record(METRICS_SRC_SSPI, "HTTP://Example.COM/a?b=1#frag", NULL, 200, "old", 3) == 0);
+    assert(capture_record(METRICS_SRC_SSPI, "http://example.com/a?b=1", NULL, 200, body, sizeof(body)) == 0);
+    assert(capture_record(METRICS_SRC_EJUDGMENT, "http://example.com/s", "{\"p\":1}", 500, "", 0) == 0);
+    assert(sspi_check("990101075678", &resp) == 0);
+    sspi_response_free(&resp);
+    capture_stop();
+
+    capture_get_stats(&after);
+    assert(after.recorded == before.recorded + 4);
+
+    assert(capture_start(CAPTURE_REPLAY, path) == 0);
+    assert(capture_get_mode() == CAPTURE_REPLAY);
+
+    // 主机名大小写、#fragment 和末尾的 '?' 不影响匹配；路径和查询串区分大小写
+    assert(capture_lookup(METRICS_SRC_SSPI, "http://EXAMPLE.com/a?b=1?", NULL, &status, &got, &len) == 0);
+    assert(status == 200 && len == sizeof(body) && memcmp(got, body, len) == 0);
+    assert(capture_lookup(METRICS_SRC_SSPI, "http://example.com/A?b=1", NULL, &status, &got, &len) == -1);
+
+    // 数据源和请求体都是键的一部分
+    assert(capture_lookup(METRICS_SRC_EJUDGMENT, "http://example.com/s", "{\"p\":1}", &status, &got, &len) == 0);
+    assert(status == 500 && len == 0);
+    assert(capture_lookup(METRICS_SRC_EJUDGMENT, "http://example.com/s", "{\"p\":2}", &status, &got, &len) == -1);
+    assert(capture_lookup(METRICS_SRC_RMP, "http://example.com/s", "{\"p\":1}", &status, &got, &len) == -1);
+
+    // 录过的查询从捕获文件回放，没录过的直接失败而不是访问模拟上游
+    assert(sspi_check("990101075678", &resp) == 0);
+    assert(resp.status && strcmp(resp.status, "Tiada halangan untuk keluar negara") == 0);
+    sspi_response_free(&resp);
+    assert(sspi_check("990101075679", &resp) != 0);
+    sspi_response_free(&resp);
+
+    capture_get_stats(&after);
+    assert(after.entries == 3);
+    assert(after.replayed == before.replayed + 3 && after.misses == before.misses + 4);
+
+    capture_stop();
+    assert(capture_get_mode() == CAPTURE_OFF);
+    unlink(path);
+
+    printf("录制与回放测试通过！\n");
+}
+
+// 测试 SPRM 名单解析：各种字段写法、实体解码，以及 sprm_run 输出的 JSON 转义
+void test_sprm_extract(void) {
+    printf("测试 SPRM 名单解析...\n");
+
+    PesalahList list = sprm_parse_html(sprm_page);
+
+    assert(list.count == 2);
+    assert(strcmp(list.list[0].name, "Ahmad bin \"Ali\"") == 0);
+    assert(strcmp(list.list[0].ic, "800101-14-5678") == 0);
+    assert(strcmp(list.list[0].employer, "Jabatan Kerja Raya") == 0);
+    assert(strcmp(list.list[0].position, "Jurutera") == 0);
+    assert(strcmp(list.list[0].charge, "Menerima suapan RM5,000") == 0);
+    assert(strcmp(list.list[0].law, "Seksyen 165 Kanun Keseksaan") == 0);
+    assert(strcmp(list.list[0].sentence, "Penjara 2 tahun") == 0);
+    assert(strcmp(list.list[0].image_url, "/images/p1.jpg?a=1&b=2") == 0);
+    assert(strcmp(list.list[1].name, "Siti") == 0 && strcmp(list.list[1].state, "Johor") == 0);
+    assert(list.list[1].ic[0] == '\0' && list.list[1].image_url[0] == '\0');
+    sprm_free_list(&list);
+
+    char *json = sprm_run();
+
+    assert(json && strstr(json, "\"name\":\"Ahmad bin \\\"Ali\\\"\"") != NULL);
+    assert(strstr(json, "\"image_url\":\"/images/p1.jpg?a=1&b=2\"}") != NULL);
+    free(json);
+
+    printf("SPRM 名单解析测试通过！\n");
+}
+
+// 测试通缉名单解析：整页解析和边下载边解析结果一致
+void test_wanted_extract(void) {
+    printf("测试通缉名单解析...\n");
+
+    WantedPerson *list = NULL;
+    char url[64];
+
+    assert(rmp_parse_wanted_list(wanted_page, &list) == 2);
+    assert(strcmp(list[0].name, "Lim & Tan") == 0 && strcmp(list[0].age, "34") == 0);
+    assert(strcmp(list[0].photo_url, "/img/w1.jpg") == 0 && strcmp(list[0].ic, "900101145678") == 0);
+    // 10 位的电话号码不是身份证号
+    assert(strcmp(list[1].name, "Raju") == 0 && strcmp(list[1].ic, "850505105555") == 0);
+    assert(list[1].photo_url[0] == '\0');
+
+    WantedPerson *streamed = NULL;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/wanted", MOCK_PORT);
+    assert(rmp_stream_wanted_list(url, &streamed) == 2);
+
+    for (int i = 0; i < 2; i++) {
+        assert(strcmp(list[i].name, streamed[i].name) == 0 && strcmp(list[i].age, streamed[i].age) == 0);
+        assert(strcmp(list[i].photo_url, streamed[i].photo_url) == 0 && strcmp(list[i].ic, streamed[i].ic) == 0);
+    }
+
+    free(streamed);
+    free(list);
+
+    printf("通缉名单解析测试通过！\n");
+}
+
+// 测试 SSPI 状态提取：状态跨接收块边界、带属性和实体
+void test_sspi_extract(void) {
+    printf("测试 SSPI 状态提取...\n");
+
+    static const char status_tag[] =
+        "<span id=\"lblStatuscode\" class=\"label label-warning\">\n  Sila hubungi pejabat Imigresen &amp; bawa dokumen\n</span>";
+    size_t pad = 16384 - 20;
+    char url[64];
+    char saved[256];
+    struct sspi_response resp;
+
+    memcpy(sspi_captured_page, "<html><body><!--", 16);
+    memset(sspi_captured_page + 16, 'x', pad - 16);
+    snprintf(sspi_captured_page + pad, sizeof(sspi_captured_page) - pad, "-->%s<p>Terima kasih</p></body></html>", status_tag);
+
+    snprintf(saved, sizeof(saved), "%s", getenv("MO_SSPI_URL"));
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/sspi/captured", MOCK_PORT);
+    setenv("MO_SSPI_URL", url, 1);
+
+    assert(sspi_check("880808085888", &resp) == 0);
+    assert(resp.status && strcmp(resp.status, "Sila hubungi pejabat Imigresen & bawa dokumen") == 0);
+    sspi_response_free(&resp);
+
+    setenv("MO_SSPI_URL", saved, 1);
+
+    printf("SSPI 状态提取测试通过！\n");
+}
+
+// 测试黄页搜索：字段解码实体后含有引号和反斜杠，?comp= 输出仍是合法 JSON
+void test_company_search(void) {
+    printf("测试黄页搜索...\n");
+
+    struct company_entry *companies = NULL;
+    size_t count = 0;
+
+    assert(company_search("ali", &companies, &count) == 0 && count == 1);
+    assert(strcmp(companies[0].name, "Ali \"Bob\" \\ Sdn Bhd") == 0);
+    assert(strcmp(companies[0].category, "Retail & Trade") == 0);
+    assert(strcmp(companies[0].address, "1, Jalan \"Ampang\"") == 0);
+    assert(strcmp(companies[0].website, "https://ali.example.my") == 0);
+
+    struct arena arena;
+    struct response_builder out;
+
+    arena_init(&arena, 0);
+    response_builder_init(&out, &arena);
+    assert(company_results_to_json(companies, count, &out) == 0 && !out.failed);
+
+    // 结果数组在响应发出前就释放，输出不能再引用它
+    company_free_results(companies, count);
+
+    char buf[1024];
+    size_t len = 0;
+
+    for (size_t i = 0; i < out.count; i++) {
+        assert(len + out.iov[i].iov_len < sizeof(buf));
+        memcpy(buf + len, out.iov[i].iov_base, out.iov[i].iov_len);
+        len += out.iov[i].iov_len;
+    }
+
+    buf[len] = '\0';
+    response_builder_discard(&out);
+    arena_free(&arena);
+
+    assert(strstr(buf, "\"name\": \"Ali \\\"Bob\\\" \\\\ Sdn Bhd\",") != NULL);
+    assert(strstr(buf, "\"address\": \"1, Jalan \\\"Ampang\\\"\",") != NULL);
+    assert(strstr(buf, "\"source\": \"MalaysiaYP\"\n  }\n]\n") != NULL);
+
+    printf("黄页搜索测试通过！\n");
+}
+
+// 测试身份证号码批量解码（世纪推断、出生地代码表、日期校验）
+void test_mykad_decode(void) {
+    printf("测试身份证号码解码...\n");
+
+    const char *ics[] = { "900101145678", "991231-10-5671", "251231105671", "010229100002", "000229710001", "0512311056x1" };
+    struct mykad_batch b;
+
+    assert(mykad_batch_init(&b, 6) == 0);
+    assert(mykad_decode_batch(ics, 6, 20261017, &b) == 4);
+
+    assert(b.birth[0] == 19900101 && b.place[0] == 14 && b.serial[0] == 5678);
+    assert(b.gender[0] == MYKAD_GENDER_FEMALE && b.flags[0] == MYKAD_VALID);
+    assert(b.birth[1] == 19991231 && b.gender[1] == MYKAD_GENDER_MALE);
+    assert(b.birth[2] == 20251231);
+    assert(b.flags[3] == (MYKAD_DIGITS_OK | MYKAD_PLACE_OK));
+    assert(b.birth[4] == 20000229 && mykad_place(b.place[4]) -> kind == MYKAD_PLACE_REGION);
+    assert(b.flags[5] == 0);
+    assert(mykad_place(41) -> state == 10);
+
+    mykad_batch_free(&b);
+
+    char *json = mykad_check("900101-14-5678", NULL);
+
+    assert(json && strstr(json, "\"birthday\": \"1990-01-01\"") != NULL);
+    free(json);
+
+    // 带连字符和连写两种写法都取到出生地代码 14
+    char *province = mykad_get_birth_province("900101-14-5678", NULL);
+
+    assert(province && strcmp(province, "Kuala Lumpur Federal Territory") == 0);
+    free(province);
+
+    province = mykad_get_birth_province("900101145678", NULL);
+    assert(province && strcmp(province, "Kuala Lumpur Federal Territory") == 0);
+    free(province);
+
+    printf("身份证号码解码测试通过！\n");
+}
+
+// 测试离线批量解码：输出顺序与输入一致，无效行也要输出
+void test_bulk_decode(void) {
+    printf("测试离线批量解码...\n");
+
+    char in_path[] = "/tmp/mo_bulk_in_XXXXXX";
+    char out_path[] = "/tmp/mo_bulk_out_XXXXXX";
+    FILE *in = fdopen(mkstemp(in_path), "w");
+    int out_fd = mkstemp(out_path);
+
+    assert(in && out_fd >= 0);
+    close(out_fd);
+
+    fputs("202001012345\r\n\n  1234\n201903000005", in);
+    fclose(in);
+
+    struct bulk_config cfg = { BULK_SSM, BULK_CSV, 4, in_path, out_path };
+    struct bulk_stats st;
+
+    assert(bulk_run(&cfg, &st) == 0);
+    assert(st.lines == 3 && st.valid == 2 && st.dropped == 0);
+
+    char buf[512] = {0};
+    FILE *out = fopen(out_path, "r");
+
+    assert(out && fread(buf, 1, sizeof(buf) - 1, out) > 0);
+    fclose(out);
+
+    assert(strcmp(buf,
+        "ssm,valid,formatted,year,entity_code,entity\n"
+        "202001012345,true,202001012345,2020,01,Local Company\n"
+        "1234,false,,,,\n"
+        "201903000005,true,201903000005,2019,03,Business Entity\n") == 0);
+
+    unlink(in_path);
+    unlink(out_path);
+
+    printf("离线批量解码测试通过！\n");
+}
+
+// 测试本地 SSM 注册库：CSV 导入、按注册号和公司名查询
+void test_ssm_registry(void) {
+    printf("测试本地 SSM 注册库...\n");
+
+    char csv_path[] = "/tmp/mo_ssm_csv_XXXXXX";
+    char reg_path[] = "/tmp/mo_ssm_reg_XXXXXX";
+    FILE *csv = fdopen(mkstemp(csv_path), "w");
+    int reg_fd = mkstemp(reg_path);
+
+    assert(csv && reg_fd >= 0);
+    close(reg_fd);
+
+    fputs("Registration No.,Old Registration No.,Company Name,Status,Entity Type\n"
+          "202001012345,1234567-A,\"Maju \"\"Jaya\"\" Sdn. Bhd.\",Existing,Private Limited\n"
+          "201903000005,,Kedai Runcit Maju,Dissolved,Business\r\n"
+          ",,No Number Trading,Existing,Business\n", csv);
+    fclose(csv);
+
+    size_t count = 0;
+
+    assert(ssm_registry_import(csv_path, reg_path, &count) == 0 && count == 2);
+    assert(ssm_registry_open(reg_path) == 0);
+
+    struct ssm_company c[4];
+
+    assert(ssm_registry_lookup("1234567a", &c[0]) == 0);
+    assert(strcmp(c[0].number, "202001012345") == 0 && strcmp(c[0].name, "Maju \"Jaya\" Sdn. Bhd.") == 0);
+    assert(strcmp(c[0].status, "Existing") == 0 && strcmp(c[0].type, "Private Limited") == 0);
+    assert(ssm_registry_lookup("201903000006", &c[0]) != 0);
+
+    // 前缀匹配排在前面，子串匹配补在后面
+    assert(ssm_registry_search("maju", c, 4) == 2);
+    assert(strcmp(c[0].number, "202001012345") == 0 && strcmp(c[1].number, "201903000005") == 0);
+    assert(ssm_registry_search("jaya sdn bhd", c, 4) == 1);
+    assert(ssm_registry_search("no number", c, 4) == 0);
+
+    ssm_registry_close();
+    unlink(csv_path);
+    unlink(reg_path);
+
+    printf("本地 SSM 注册库测试通过！\n");
+}
+
+static struct ejudgment_paged *paged_result = NULL;
+static int paged_ready = 0;
+
+static void on_paged_ready(struct ejudgment_paged *paged, void *userdata) {
+    (void) userdata;
+
+    paged_result = paged;
+    __atomic_store_n(&paged_ready, 1, __ATOMIC_RELEASE);
+}
+
+// 测试 eJudgment 分页搜索：第 1 页给出总页数，其余页并发抓取后合并成一个 JSON
+void test_ejudgment_paged(void) {
+    printf("测试 eJudgment 分页搜索...\n");
+
+    const EJudgmentQuery query = {
+        .search = "JOHN DOE", .jurisdictionType = "ALL", .courtCategory = "", .court = "",
+        .judgeName = "", .caseType = "", .ordering = "DATE_OF_AP_DESC",
+    };
+
+    assert(ejudgment_search_paged(&query, 10, 1, 0, "TITLE\n", on_paged_ready, NULL) == 0);
+
+    while (!__atomic_load_n(&paged_ready, __ATOMIC_ACQUIRE)) usleep(1000);
+
+    assert(paged_result != NULL);
+
+    char buf[1024];
+    size_t len = 0;
+    ssize_t n;
+
+    // 没有绑定连接时读取函数不挂起，暂时没有数据就返回 0
+    while ((n = ejudgment_paged_send_chunk(paged_result, len, buf + len, sizeof(buf) - 1 - len)) != MHD_CONTENT_READER_END_OF_STREAM) {
+        if (n == 0) usleep(1000);
+
+        len += (size_t) n;
+    }
+
+    buf[len] = '\0';
+    ejudgment_paged_free(paged_result);
+
+    static const char head[] = "TITLE\n{\"total_results\":5,\"total_pages\":3,\"pages\":3,\"cases\":[";
+
+    assert(strncmp(buf, head, sizeof(head) - 1) == 0);
+    assert(strstr(buf, "\"P1-1\"") && strstr(buf, "\"P2-1\"") && strstr(buf, "\"P3-1\""));
+    assert(strstr(buf, "\"pages_fetched\":3,\"failed_pages\":[]") != NULL);
+
+    printf("eJudgment 分页搜索测试通过！\n");
+}
+
+// 测试本地判决镜像：入库去重、倒排索引查询、重启重建和增量同步
+void test_judgment_store(void) {
+    printf("测试本地判决镜像...\n");
+
+    char path[] = "/tmp/mo_judgment_XXXXXX";
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+    assert(judgment_store_open(path) == 0);
+
+    static const char page[] =
+        "{\"Data\":[\n"
+        "  {\"DocumentId\":\"D1\",\"Parties\":\"Ahmad bin Ali v PP\",\"CaseNo\":\"WA-44-12/2023\",\n"
+        "   \"Court\":\"Mahkamah Tinggi Kuala Lumpur\",\"DateOfAP\":\"2024-03-01T00:00:00\"},\n"
+        "  {\"DocumentId\":\"D2\",\"Parties\":\"PP v Ahmad Bin Ali\",\"JudgeName\":\"Tan Sri Lim\",\"DateOfAP\":\"/Date(1709568000000)/\"},\n"
+        "  {\"DocumentId\":\"D1\",\"Parties\":\"Ahmad bin Ali v PP\"}\n"
+        "]}";
+    uint32_t oldest = 0;
+
+    assert(judgment_store_ingest(page, strlen(page), &oldest) == 2);
+    assert(oldest == 20240301);
+    assert(judgment_store_ingest(page, strlen(page), NULL) == 0);
+
+    size_t returned, total, len;
+    char *cases = judgment_store_search("AHMAD_BIN_ALI", 10, &returned, &total, &len);
+
+    // 新的判决在前；/Date(ms)/ 按马来西亚时间取日期
+    assert(cases && returned == 2 && total == 2 && len == strlen(cases));
+    assert(strstr(cases, "\"D2\"") < strstr(cases, "\"D1\""));
+    assert(strchr(cases + 1, '\n') == strstr(cases, ",\n") + 1);
+    free(cases);
+
+    cases = judgment_store_search("ahmad lim", 10, &returned, &total, &len);
+    assert(cases && total == 1 && strstr(cases, "\"D2\""));
+    free(cases);
+
+    cases = judgment_store_search("wa-44-12/2023", 1, &returned, &total, &len);
+    assert(cases && total == 1 && strstr(cases, "\"D1\""));
+    free(cases);
+
+    assert(judgment_store_search("nobody", 10, &returned, &total, &len) == NULL && total == 0);
+
+    // 重启后从文件重建索引，写到一半的最后一行被截掉
+    judgment_store_close();
+
+    FILE *fp = fopen(path, "a");
+
+    assert(fp);
+    fputs("{\"DocumentId\":\"D3\"", fp);
+    fclose(fp);
+
+    struct judgment_store_stats st;
+
+    assert(judgment_store_open(path) == 0);
+    judgment_store_get_stats(&st);
+    // 线上入库的判决不推进同步水位
+    assert(st.judgments == 2 && st.watermark == 20240305 && st.sync_watermark == 0);
+
+    // 模拟上游 3 页共 4 份新判决（第 p 页日期为 4 月 10-p 日），翻完后同步水位推进到最新日期；
+    // 第二次同步读到第 2 页比水位更旧的判决就停止
+    assert(judgment_store_sync_once() == 4);
+    judgment_store_get_stats(&st);
+    assert(st.watermark == 20240409 && st.sync_watermark == 20240409);
+    assert(judgment_store_sync_once() == 0);
+
+    // 同步水位随镜像持久化
+    judgment_store_close();
+    assert(judgment_store_open(path) == 0);
+    judgment_store_get_stats(&st);
+    assert(st.sync_watermark == 20240409);
+
+    cases = judgment_store_search("p3 1", 10, &returned, &total, &len);
+    assert(cases && total == 1);
+    free(cases);
+
+    // 积压超过 JUDGMENT_SYNC_MAX_PAGES 页时也要一直翻到水位，水位才能推进
+    judgment_pages = JUDGMENT_SYNC_MAX_PAGES + 5;
+    assert(judgment_store_sync_once() == judgment_pages);
+    judgment_store_get_stats(&st);
+    assert(st.sync_watermark == 20240529);
+    judgment_pages = 3;
+
+    judgment_store_close();
+    assert(!judgment_store_loaded());
+    unlink(path);
+
+    char sync_path[sizeof(path) + 8];
+
+    snprintf(sync_path, sizeof(sync_path), "%s.sync", path);
+    unlink(sync_path);
+
+    printf("本地判决镜像测试通过！\n");
+}
+
 // 测试错误处理
 void test_error_handling(void) {
     printf("测试错误处理...\n");
-    
-    char* response;
-    enum MHD_Result ret;
-    
-    // 测试无参数
-    ret = test_request("/", &response);
-
-    assert(ret == MHD_YES);
-    assert(strstr(response, "Missing parameter") != NULL);
-
-    free(response);
-    
-    // 测试无效参数
-    ret = test_request("/?invalid=123", &response);
-
-    assert(ret == MHD_YES);
-    assert(strstr(response, "Missing parameter") != NULL);
-    
-    free(response);
-    
+
+    struct sspi_response resp;
+
+    // 上游地址不可达
+    setenv("MO_SSPI_URL", "http://127.0.0.1:1/sspi", 1);
+    assert(sspi_check("990101075679", &resp) == -2);
+    assert(resp.status == NULL);
+
+    // 上游返回的不是 JSON
+    struct semak_mule_response bad = { strdup("<html>oops</html>"), 17 };
+    struct pdrm_mule_result res = {0};
+
+    assert(pdrm_parse_mule_result(&bad, &res) != 0);
+    pdrm_semak_mule_response_free(&bad);
+
     printf("错误处理测试通过！\n");
 }
 
 int main(void) {
     printf("开始运行单元测试...\n\n");
-    
+
+    struct MHD_Daemon *d = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, MOCK_PORT, NULL, NULL, &mock_handler, NULL, MHD_OPTION_END);
+
+    assert(d != NULL);
+
+    char url[64];
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/sspi", MOCK_PORT);
+    setenv("MO_SSPI_URL", url, 1);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/semakmule", MOCK_PORT);
+    setenv("MO_SEMAKMULE_URL", url, 1);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d", MOCK_PORT);
+    setenv("MO_EJUDGMENT_URL", url, 1);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/company", MOCK_PORT);
+    setenv("MO_COMPANY_URL", url, 1);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/sprm", MOCK_PORT);
+    setenv("MO_SPRM_URL", url, 1);
+
+    assert(curl_pool_init() == 0);
+    assert(upstream_loop_start(0) == 0);
+    assert(pdrm_mule_cache_init(16, 60, 60) == 0);
+
+    test_phone_normalise();
     test_phone_query();
     test_ic_query();
+    test_lru_cache();
+    test_singleflight();
+    test_access_log_drop();
+    test_capture_roundtrip();
+    test_company_search();
+    test_sprm_extract();
+    test_wanted_extract();
+    test_sspi_extract();
+    test_mykad_decode();
+    test_bulk_decode();
+    test_ssm_registry();
+    test_ejudgment_paged();
+    test_judgment_store();
     test_error_handling();
-    
+
+    upstream_loop_stop();
+    pdrm_mule_cache_cleanup();
+    curl_pool_cleanup();
+    MHD_stop_daemon(d);
+
     printf("\n所有测试都通过了！\n");
     return 0;
-}
\ No newline at end of file
+}